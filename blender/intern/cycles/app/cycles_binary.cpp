@@ -0,0 +1,519 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "node_binary.h"
+
+#include "background.h"
+#include "camera.h"
+#include "film.h"
+#include "graph.h"
+#include "integrator.h"
+#include "light.h"
+#include "mesh.h"
+#include "nodes.h"
+#include "object.h"
+#include "shader.h"
+#include "scene.h"
+
+#include "subd_dice.h"
+
+#include "util_foreach.h"
+#include "util_path.h"
+
+#include "cycles_binary.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Bump when the layout of the file changes. */
+static const char BINARY_SCENE_HEADER[8] = {'C', 'Y', 'C', 'S', 'C', 'N', '0', '2'};
+
+/* Shader */
+
+static void binary_write_shader(BinaryWriter& writer, Shader *shader)
+{
+	binary_write_node(writer, shader);
+
+	/* nodes, OSL script nodes have no registered type and can't be stored */
+	vector<ShaderNode*> nodes;
+	map<ShaderNode*, int> node_index;
+
+	if(shader->graph) {
+		foreach(ShaderNode *node, shader->graph->nodes) {
+			if(node->special_type == SHADER_SPECIAL_TYPE_SCRIPT) {
+				fprintf(stderr, "Skipping OSL node \"%s\" in shader \"%s\".\n",
+				        node->name.c_str(), shader->name.c_str());
+				continue;
+			}
+
+			node_index[node] = nodes.size();
+			nodes.push_back(node);
+		}
+	}
+
+	writer.write_int(nodes.size());
+
+	foreach(ShaderNode *node, nodes) {
+		writer.write_string(node->type->name.string());
+		binary_write_node(writer, node);
+	}
+
+	/* links, by socket name */
+	int num_links = 0;
+
+	foreach(ShaderNode *node, nodes)
+		foreach(ShaderInput *input, node->inputs)
+			if(input->link && node_index.find(input->link->parent) != node_index.end())
+				num_links++;
+
+	writer.write_int(num_links);
+
+	foreach(ShaderNode *node, nodes) {
+		foreach(ShaderInput *input, node->inputs) {
+			if(!input->link || node_index.find(input->link->parent) == node_index.end())
+				continue;
+
+			writer.write_int(node_index[input->link->parent]);
+			writer.write_string(input->link->socket_type.name.string());
+			writer.write_int(node_index[node]);
+			writer.write_string(input->socket_type.name.string());
+		}
+	}
+}
+
+static ShaderOutput *binary_find_output(ShaderNode *node, const string& name)
+{
+	foreach(ShaderOutput *output, node->outputs)
+		if(output->socket_type.name == name)
+			return output;
+
+	return NULL;
+}
+
+static ShaderInput *binary_find_input(ShaderNode *node, const string& name)
+{
+	foreach(ShaderInput *input, node->inputs)
+		if(input->socket_type.name == name)
+			return input;
+
+	return NULL;
+}
+
+static bool binary_read_shader(BinaryReader& reader, Scene *scene, Shader *shader)
+{
+	if(!binary_read_node(reader, shader))
+		return false;
+
+	ShaderGraph *graph = new ShaderGraph();
+	vector<ShaderNode*> nodes;
+	int num_nodes;
+
+	if(!reader.read_int(num_nodes)) {
+		delete graph;
+		return false;
+	}
+
+	for(int i = 0; i < num_nodes; i++) {
+		string type_name;
+
+		if(!reader.read_string(type_name)) {
+			delete graph;
+			return false;
+		}
+
+		ShaderNode *snode;
+
+		if(type_name == "output") {
+			snode = graph->output();
+		}
+		else {
+			const NodeType *node_type = NodeType::find(ustring(type_name));
+
+			if(!node_type || node_type->type != NodeType::SHADER) {
+				fprintf(stderr, "Unknown shader node \"%s\".\n", type_name.c_str());
+				delete graph;
+				return false;
+			}
+
+			snode = (ShaderNode*) node_type->create(node_type);
+			graph->add(snode);
+		}
+
+		if(!binary_read_node(reader, snode)) {
+			delete graph;
+			return false;
+		}
+
+		nodes.push_back(snode);
+	}
+
+	int num_links;
+
+	if(!reader.read_int(num_links)) {
+		delete graph;
+		return false;
+	}
+
+	for(int i = 0; i < num_links; i++) {
+		int from, to;
+		string from_name, to_name;
+
+		if(!reader.read_int(from) || !reader.read_string(from_name) ||
+		   !reader.read_int(to) || !reader.read_string(to_name))
+		{
+			delete graph;
+			return false;
+		}
+
+		if(from < 0 || from >= (int)nodes.size() || to < 0 || to >= (int)nodes.size())
+			continue;
+
+		ShaderOutput *output = binary_find_output(nodes[from], from_name);
+		ShaderInput *input = binary_find_input(nodes[to], to_name);
+
+		if(output && input)
+			graph->connect(output, input);
+		else
+			fprintf(stderr, "Unknown socket in link \"%s\" to \"%s\".\n", from_name.c_str(), to_name.c_str());
+	}
+
+	shader->set_graph(graph);
+	shader->tag_update(scene);
+
+	return true;
+}
+
+/* Mesh */
+
+static void binary_write_attributes(BinaryWriter& writer, AttributeSet& attributes)
+{
+	/* voxel attributes refer to images, which are not stored */
+	int num_attributes = 0;
+
+	foreach(Attribute& attr, attributes.attributes)
+		if(attr.element != ATTR_ELEMENT_VOXEL)
+			num_attributes++;
+
+	writer.write_int(num_attributes);
+
+	foreach(Attribute& attr, attributes.attributes) {
+		if(attr.element == ATTR_ELEMENT_VOXEL)
+			continue;
+
+		writer.write_string(attr.name.string());
+		writer.write_int(attr.std);
+		writer.write_int(attr.type.basetype);
+		writer.write_int(attr.type.aggregate);
+		writer.write_int(attr.type.vecsemantics);
+		writer.write_int(attr.type.arraylen);
+		writer.write_int(attr.element);
+		writer.write_int(attr.flags);
+		writer.write_array(attr.buffer);
+	}
+}
+
+static bool binary_read_attributes(BinaryReader& reader, AttributeSet& attributes)
+{
+	int num_attributes;
+
+	if(!reader.read_int(num_attributes))
+		return false;
+
+	for(int i = 0; i < num_attributes; i++) {
+		string name;
+		int std, basetype, aggregate, vecsemantics, arraylen, element, flags;
+
+		if(!reader.read_string(name) ||
+		   !reader.read_int(std) ||
+		   !reader.read_int(basetype) ||
+		   !reader.read_int(aggregate) ||
+		   !reader.read_int(vecsemantics) ||
+		   !reader.read_int(arraylen) ||
+		   !reader.read_int(element) ||
+		   !reader.read_int(flags))
+		{
+			return false;
+		}
+
+		Attribute *attr;
+
+		if(std != ATTR_STD_NONE) {
+			attr = attributes.add((AttributeStandard)std, ustring(name));
+		}
+		else {
+			TypeDesc type((TypeDesc::BASETYPE)basetype,
+			              (TypeDesc::AGGREGATE)aggregate,
+			              (TypeDesc::VECSEMANTICS)vecsemantics,
+			              arraylen);
+			attr = attributes.add(ustring(name), type, (AttributeElement)element);
+		}
+
+		attr->flags = flags;
+
+		/* data was written for the same mesh, overwrites the resized buffer */
+		if(!reader.read_array(attr->buffer))
+			return false;
+	}
+
+	return true;
+}
+
+static void binary_write_mesh(BinaryWriter& writer, Mesh *mesh)
+{
+	binary_write_node(writer, mesh);
+
+	array<int> used_shaders(mesh->used_shaders.size());
+	for(size_t i = 0; i < mesh->used_shaders.size(); i++)
+		used_shaders[i] = writer.node_index(mesh->used_shaders[i]);
+	writer.write_array(used_shaders);
+
+	/* subdivision surface */
+	writer.write_int(mesh->subdivision_type);
+	writer.write_array(mesh->subd_faces);
+	writer.write_array(mesh->subd_face_corners);
+	writer.write_array(mesh->subd_creases);
+	writer.write_int(mesh->num_ngons);
+
+	writer.write_int(mesh->subd_params != NULL);
+	if(mesh->subd_params) {
+		writer.write_value(mesh->subd_params->dicing_rate);
+		writer.write_value(mesh->subd_params->objecttoworld);
+	}
+
+	binary_write_attributes(writer, mesh->attributes);
+	binary_write_attributes(writer, mesh->curve_attributes);
+	binary_write_attributes(writer, mesh->subd_attributes);
+}
+
+static bool binary_read_mesh(BinaryReader& reader, Scene *scene, Mesh *mesh)
+{
+	if(!binary_read_node(reader, mesh))
+		return false;
+
+	array<int> used_shaders;
+	if(!reader.read_array(used_shaders))
+		return false;
+
+	for(size_t i = 0; i < used_shaders.size(); i++) {
+		Node *node = reader.node(used_shaders[i]);
+		Shader *shader = (node && node->type == Shader::node_type)? (Shader*)node: scene->default_surface;
+		mesh->used_shaders.push_back(shader);
+	}
+
+	int subdivision_type, num_ngons, has_subd_params;
+
+	if(!reader.read_int(subdivision_type) ||
+	   !reader.read_array(mesh->subd_faces) ||
+	   !reader.read_array(mesh->subd_face_corners) ||
+	   !reader.read_array(mesh->subd_creases) ||
+	   !reader.read_int(num_ngons) ||
+	   !reader.read_int(has_subd_params))
+	{
+		return false;
+	}
+
+	mesh->subdivision_type = (Mesh::SubdivisionType)subdivision_type;
+	mesh->num_ngons = num_ngons;
+
+	if(has_subd_params) {
+		mesh->subd_params = new SubdParams(mesh);
+
+		if(!reader.read_value(mesh->subd_params->dicing_rate) ||
+		   !reader.read_value(mesh->subd_params->objecttoworld))
+		{
+			return false;
+		}
+
+		scene->camera->update();
+		mesh->subd_params->camera = scene->camera;
+	}
+
+	return binary_read_attributes(reader, mesh->attributes) &&
+	       binary_read_attributes(reader, mesh->curve_attributes) &&
+	       binary_read_attributes(reader, mesh->subd_attributes);
+}
+
+/* File */
+
+bool binary_file_check(const char *filepath)
+{
+	FILE *f = path_fopen(filepath, "rb");
+	char header[sizeof(BINARY_SCENE_HEADER)];
+
+	if(!f)
+		return false;
+
+	bool found = (fread(header, 1, sizeof(header), f) == sizeof(header) &&
+	              memcmp(header, BINARY_SCENE_HEADER, sizeof(header)) == 0);
+	fclose(f);
+
+	return found;
+}
+
+bool binary_write_file(Scene *scene, const char *filepath)
+{
+	BinaryWriter writer;
+
+	if(!writer.open(filepath, BINARY_SCENE_HEADER)) {
+		fprintf(stderr, "%s write error: could not open file.\n", filepath);
+		return false;
+	}
+
+	/* settings */
+	Camera *cam = scene->camera;
+
+	binary_write_node(writer, scene->film);
+	binary_write_node(writer, scene->integrator);
+	binary_write_node(writer, cam);
+	writer.write_int(cam->width);
+	writer.write_int(cam->height);
+
+	/* nodes are linked by the index they were written with, so shaders go
+	 * before the background, meshes and lights linking to them, and meshes
+	 * before the objects linking to them */
+	writer.write_int(scene->shaders.size());
+	foreach(Shader *shader, scene->shaders)
+		binary_write_shader(writer, shader);
+
+	binary_write_node(writer, scene->background);
+
+	writer.write_int(scene->meshes.size());
+	foreach(Mesh *mesh, scene->meshes)
+		binary_write_mesh(writer, mesh);
+
+	writer.write_int(scene->objects.size());
+	foreach(Object *object, scene->objects)
+		binary_write_node(writer, object);
+
+	writer.write_int(scene->lights.size());
+	foreach(Light *light, scene->lights)
+		binary_write_node(writer, light);
+
+	if(!writer.close()) {
+		fprintf(stderr, "%s write error: could not write file.\n", filepath);
+		return false;
+	}
+
+	return true;
+}
+
+static bool binary_read_scene(BinaryReader& reader, Scene *scene)
+{
+	/* settings */
+	Camera *cam = scene->camera;
+
+	if(!binary_read_node(reader, scene->film) ||
+	   !binary_read_node(reader, scene->integrator) ||
+	   !binary_read_node(reader, cam) ||
+	   !reader.read_int(cam->width) ||
+	   !reader.read_int(cam->height))
+	{
+		return false;
+	}
+
+	cam->full_width = cam->width;
+	cam->full_height = cam->height;
+	cam->need_update = true;
+	cam->update();
+
+	/* shaders, the default shaders of the scene are written first and are
+	 * reused so the scene keeps pointing to them */
+	int num_shaders;
+	if(!reader.read_int(num_shaders))
+		return false;
+
+	for(int i = 0; i < num_shaders; i++) {
+		Shader *shader;
+
+		if(i < (int)scene->shaders.size()) {
+			shader = scene->shaders[i];
+		}
+		else {
+			shader = new Shader();
+			scene->shaders.push_back(shader);
+		}
+
+		if(!binary_read_shader(reader, scene, shader))
+			return false;
+	}
+
+	if(!binary_read_node(reader, scene->background))
+		return false;
+
+	/* meshes */
+	int num_meshes;
+	if(!reader.read_int(num_meshes))
+		return false;
+
+	for(int i = 0; i < num_meshes; i++) {
+		Mesh *mesh = new Mesh();
+		scene->meshes.push_back(mesh);
+
+		if(!binary_read_mesh(reader, scene, mesh))
+			return false;
+	}
+
+	/* objects */
+	int num_objects;
+	if(!reader.read_int(num_objects))
+		return false;
+
+	for(int i = 0; i < num_objects; i++) {
+		Object *object = new Object();
+		scene->objects.push_back(object);
+
+		if(!binary_read_node(reader, object))
+			return false;
+	}
+
+	/* lights */
+	int num_lights;
+	if(!reader.read_int(num_lights))
+		return false;
+
+	for(int i = 0; i < num_lights; i++) {
+		Light *light = new Light();
+		scene->lights.push_back(light);
+
+		if(!binary_read_node(reader, light))
+			return false;
+	}
+
+	return true;
+}
+
+bool binary_read_file(Scene *scene, const char *filepath)
+{
+	BinaryReader reader;
+
+	if(!reader.open(filepath, BINARY_SCENE_HEADER)) {
+		fprintf(stderr, "%s read error: not a Cycles binary scene file.\n", filepath);
+		return false;
+	}
+
+	if(!binary_read_scene(reader, scene)) {
+		fprintf(stderr, "%s read error: file is corrupt or from a different version.\n", filepath);
+		return false;
+	}
+
+	scene->params.bvh_type = SceneParams::BVH_STATIC;
+
+	return true;
+}
+
+CCL_NAMESPACE_END
+
@@ -19,17 +19,21 @@
 #include "buffers.h"
 #include "camera.h"
 #include "device.h"
+#include "film.h"
 #include "scene.h"
 #include "session.h"
 #include "integrator.h"
 
 #include "util_args.h"
+#include "util_debug.h"
 #include "util_foreach.h"
 #include "util_function.h"
+#include "util_guarded_allocator.h"
 #include "util_logging.h"
 #include "util_path.h"
 #include "util_progress.h"
 #include "util_string.h"
+#include "util_system.h"
 #include "util_time.h"
 #include "util_transform.h"
 #include "util_version.h"
@@ -38,6 +42,7 @@
 #include "util_view.h"
 #endif
 
+#include "cycles_binary.h"
 #include "cycles_xml.h"
 
 CCL_NAMESPACE_BEGIN
@@ -46,11 +51,15 @@ struct Options {
 	Session *session;
 	Scene *scene;
 	string filepath;
+	vector<string> filepaths;
 	int width, height;
 	SceneParams scene_params;
 	SessionParams session_params;
 	bool quiet;
 	bool show_help, interactive, pause;
+	bool benchmark;
+	string benchmark_output;
+	string binary_output;
 } options;
 
 static void session_print(const string& str)
@@ -97,6 +106,13 @@ static BufferParams& session_buffer_params()
 	buffer_params.full_width = options.width;
 	buffer_params.full_height = options.height;
 
+	/* feature passes guiding the denoiser */
+	if(options.session_params.denoising_radius > 0) {
+		Pass::add(PASS_NORMAL, buffer_params.passes);
+		Pass::add(PASS_DIFFUSE_COLOR, buffer_params.passes);
+		Pass::add(PASS_DEPTH, buffer_params.passes);
+	}
+
 	return buffer_params;
 }
 
@@ -122,8 +138,14 @@ static void scene_init()
 {
 	options.scene = new Scene(options.scene_params, options.session_params.device);
 
-	/* Read XML */
-	xml_read_file(options.scene, options.filepath.c_str());
+	/* Read binary or XML file */
+	if(binary_file_check(options.filepath.c_str())) {
+		if(!binary_read_file(options.scene, options.filepath.c_str()))
+			exit(EXIT_FAILURE);
+	}
+	else {
+		xml_read_file(options.scene, options.filepath.c_str());
+	}
 
 	/* Camera width/height override? */
 	if(!(options.width == 0 || options.height == 0)) {
@@ -135,8 +157,12 @@ static void scene_init()
 		options.height = options.scene->camera->height;
 	}
 
-	/* Calculate Viewplane */
+	/* Calculate Viewplane, the camera was already updated while reading */
 	options.scene->camera->compute_auto_viewplane();
+	options.scene->camera->tag_update();
+
+	/* Film passes must match the session buffers */
+	options.scene->film->tag_passes_update(options.scene, session_buffer_params().passes);
 }
 
 static void session_exit()
@@ -319,10 +345,191 @@ static void keyboard(unsigned char key)
 }
 #endif
 
+/* Benchmark
+ *
+ * Renders every given file once for each CPU kernel supported by this CPU,
+ * and writes timings of scene update stages, rays per second, peak memory
+ * and thread utilization as JSON, to compare performance between builds. */
+
+static const char *benchmark_kernels[] = {"avx2", "avx", "sse41", "sse3", "sse2"};
+
+/* Limit the CPU device to the given kernel by disabling all newer
+ * instruction sets, returns false when the CPU doesn't support it. */
+static bool benchmark_kernel_set(int index)
+{
+	DebugFlagsRef flags = DebugFlags();
+	bool *instruction_sets[] = {&flags.cpu.avx2,
+	                            &flags.cpu.avx,
+	                            &flags.cpu.sse41,
+	                            &flags.cpu.sse3,
+	                            &flags.cpu.sse2};
+
+	flags.cpu.reset();
+
+	for(int i = 0; i < index; i++)
+		*instruction_sets[i] = false;
+
+	switch(index) {
+		case 0: return system_cpu_support_avx2();
+		case 1: return system_cpu_support_avx();
+		case 2: return system_cpu_support_sse41();
+		case 3: return system_cpu_support_sse3();
+		case 4: return system_cpu_support_sse2();
+	}
+
+	return false;
+}
+
+static string benchmark_json_string(const string& str)
+{
+	string result = "\"";
+
+	foreach(char c, str) {
+		if(c == '"' || c == '\\')
+			result += '\\';
+		result += c;
+	}
+
+	return result + "\"";
+}
+
+static string benchmark_run_json(const char *kernel)
+{
+	int width = options.width, height = options.height;
+
+	util_guarded_reset_mem_peak();
+
+	double time_start = time_dt();
+	scene_init();
+	double load_time = time_dt() - time_start;
+	session_init();
+	options.session->wait();
+	double total_time = time_dt() - time_start;
+
+	Stats& stats = options.session->stats;
+	Scene *scene = options.session->scene;
+
+	/* Threads render until no tiles are left, so the slowest thread tells
+	 * the render time and the others are idle for the remainder. The tail is
+	 * the time from the first thread running out of work to the end. */
+	double render_time = 0.0;
+	double first_idle_time = DBL_MAX;
+	foreach(double time, stats.render_thread_times) {
+		render_time = std::max(render_time, time);
+		first_idle_time = std::min(first_idle_time, time);
+	}
+	double tail_time = (render_time > 0.0)? render_time - first_idle_time: 0.0;
+
+	string json = "\t\t\t\t{\n";
+	json += string_printf("\t\t\t\t\t\"requested_kernel\": \"%s\",\n", kernel);
+	json += string_printf("\t\t\t\t\t\"kernel\": %s,\n", benchmark_json_string(stats.render_kernel).c_str());
+	json += string_printf("\t\t\t\t\t\"width\": %d,\n", options.width);
+	json += string_printf("\t\t\t\t\t\"height\": %d,\n", options.height);
+	json += string_printf("\t\t\t\t\t\"load_time\": %f,\n", load_time);
+	json += string_printf("\t\t\t\t\t\"total_time\": %f,\n", total_time);
+	json += string_printf("\t\t\t\t\t\"render_time\": %f,\n", render_time);
+	json += string_printf("\t\t\t\t\t\"tail_time\": %f,\n", tail_time);
+	json += string_printf("\t\t\t\t\t\"rays\": %llu,\n", (unsigned long long)stats.render_rays);
+	json += string_printf("\t\t\t\t\t\"rays_per_second\": %f,\n",
+	                      (render_time > 0.0)? stats.render_rays / render_time: 0.0);
+
+	json += "\t\t\t\t\t\"scene_update\": {";
+	bool first = true;
+	for(map<string, double>::iterator it = scene->update_times.times.begin();
+	    it != scene->update_times.times.end();
+	    ++it)
+	{
+		json += string_printf("%s\n\t\t\t\t\t\t%s: %f",
+		                      first? "": ",",
+		                      benchmark_json_string(it->first).c_str(),
+		                      it->second);
+		first = false;
+	}
+	json += "\n\t\t\t\t\t},\n";
+
+	json += "\t\t\t\t\t\"peak_memory\": {\n";
+	json += string_printf("\t\t\t\t\t\t\"host\": %llu,\n", (unsigned long long)util_guarded_get_mem_peak());
+	json += string_printf("\t\t\t\t\t\t\"device\": %llu\n", (unsigned long long)stats.mem_peak);
+	json += "\t\t\t\t\t},\n";
+
+	/* Fraction of the render time each thread spent rendering tiles. */
+	json += "\t\t\t\t\t\"thread_utilization\": [";
+	for(size_t i = 0; i < stats.render_thread_busy_times.size(); i++) {
+		double utilization = (render_time > 0.0)? stats.render_thread_busy_times[i] / render_time: 0.0;
+		json += string_printf("%s%f", (i == 0)? "": ", ", utilization);
+	}
+	json += "]\n";
+	json += "\t\t\t\t}";
+
+	session_exit();
+
+	options.width = width;
+	options.height = height;
+
+	return json;
+}
+
+static bool benchmark_run()
+{
+	string json = "{\n";
+	json += string_printf("\t\"version\": \"%s\",\n", CYCLES_VERSION_STRING);
+	json += string_printf("\t\"cpu\": %s,\n", benchmark_json_string(system_cpu_brand_string()).c_str());
+	json += string_printf("\t\"threads\": %d,\n", (options.session_params.threads)?
+	                                                  options.session_params.threads:
+	                                                  system_cpu_thread_count());
+	json += string_printf("\t\"samples\": %d,\n", options.session_params.samples);
+	json += "\t\"scenes\": [\n";
+
+	for(size_t i = 0; i < options.filepaths.size(); i++) {
+		options.filepath = options.filepaths[i];
+
+		json += "\t\t{\n";
+		json += string_printf("\t\t\t\"file\": %s,\n", benchmark_json_string(path_filename(options.filepath)).c_str());
+		json += "\t\t\t\"runs\": [\n";
+
+		const int num_kernels = sizeof(benchmark_kernels)/sizeof(*benchmark_kernels);
+		bool first = true;
+
+		for(int k = 0; k < num_kernels; k++) {
+			if(!benchmark_kernel_set(k))
+				continue;
+
+			fprintf(stderr, "Benchmarking %s with %s kernel\n",
+			        path_filename(options.filepath).c_str(), benchmark_kernels[k]);
+
+			if(!first)
+				json += ",\n";
+			json += benchmark_run_json(benchmark_kernels[k]);
+			first = false;
+		}
+
+		json += "\n\t\t\t]\n";
+		json += (i + 1 == options.filepaths.size())? "\t\t}\n": "\t\t},\n";
+	}
+
+	json += "\t]\n}\n";
+
+	DebugFlags().cpu.reset();
+
+	if(options.benchmark_output == "") {
+		printf("%s", json.c_str());
+		return true;
+	}
+
+	if(!path_write_text(options.benchmark_output, json)) {
+		fprintf(stderr, "Failed to write benchmark results to %s\n", options.benchmark_output.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 static int files_parse(int argc, const char *argv[])
 {
-	if(argc > 0)
+	if(argc > 0) {
 		options.filepath = argv[0];
+		options.filepaths.push_back(argv[0]);
+	}
 
 	return 0;
 }
@@ -334,6 +541,7 @@ static void options_parse(int argc, const char **argv)
 	options.filepath = "";
 	options.session = NULL;
 	options.quiet = false;
+	options.benchmark = false;
 
 	/* device names */
 	string device_names = "";
@@ -377,7 +585,12 @@ static void options_parse(int argc, const char **argv)
 		"--height %d", &options.height, "Window height in pixel",
 		"--tile-width %d", &options.session_params.tile_size.x, "Tile width in pixels",
 		"--tile-height %d", &options.session_params.tile_size.y, "Tile height in pixels",
+		"--denoising-radius %d", &options.session_params.denoising_radius, "Denoise tiles of background renders with this filter radius in pixels",
+		"--denoising-strength %f", &options.session_params.denoising_strength, "How much the denoiser mixes neighboring pixels with different colors",
 		"--list-devices", &list, "List information about all available devices",
+		"--benchmark", &options.benchmark, "Render all files with every supported CPU kernel and print statistics as JSON",
+		"--benchmark-output %s", &options.benchmark_output, "File path to write benchmark statistics to, instead of standard output",
+		"--write-binary %s", &options.binary_output, "Convert the scene to a binary scene file for faster loading, without rendering",
 #ifdef WITH_CYCLES_LOGGING
 		"--debug", &debug, "Enable debug logging",
 		"--verbose %d", &verbosity, "Set verbosity of the logger",
@@ -468,12 +681,48 @@ static void options_parse(int argc, const char **argv)
 		fprintf(stderr, "No file path specified\n");
 		exit(EXIT_FAILURE);
 	}
+	else if(options.benchmark && options.session_params.device.type != DEVICE_CPU) {
+		fprintf(stderr, "Benchmark only works with CPU device\n");
+		exit(EXIT_FAILURE);
+	}
 
 	/* For smoother Viewport */
 	options.session_params.start_resolution = 64;
 
+	/* Denoised tiles must be rendered with all samples at once */
+	if(options.session_params.denoising_radius > 0 && options.session_params.background)
+		options.session_params.progressive = false;
+
+	/* Devices of a multi device only accumulate samples of the tiles they
+	 * rendered themselves, so tiles must get all samples at once as well */
+	if(options.session_params.device.type == DEVICE_MULTI && options.session_params.background)
+		options.session_params.progressive = false;
+
+	/* Use QBVH on the CPU like Blender does, ray stream kernels need it */
+	options.scene_params.use_qbvh = (options.session_params.device.type == DEVICE_CPU &&
+	                                 DebugFlags().cpu.qbvh && system_cpu_support_sse2());
+
+	if(options.benchmark) {
+		/* Render all samples of a tile at once, and keep standard output
+		 * for the results. */
+		options.session_params.background = true;
+		options.session_params.progressive = false;
+		options.quiet = true;
+
+		if(options.session_params.samples == INT_MAX)
+			options.session_params.samples = 16;
+
+		return;
+	}
+
 	/* load scene */
 	scene_init();
+
+	/* convert only */
+	if(!options.binary_output.empty()) {
+		bool success = binary_write_file(options.scene, options.binary_output.c_str());
+		exit(success? EXIT_SUCCESS: EXIT_FAILURE);
+	}
 }
 
 CCL_NAMESPACE_END
@@ -486,6 +735,9 @@ int main(int argc, const char **argv)
 	path_init();
 	options_parse(argc, argv);
 
+	if(options.benchmark)
+		return benchmark_run()? EXIT_SUCCESS: EXIT_FAILURE;
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
 	if(options.session_params.background) {
 #endif
@@ -138,17 +138,43 @@ def free(engine):
         del engine.session
 
 
+# Times of the last profiled render, a dict with "phases", "shaders" and
+# "objects" lists of (name, seconds) pairs, most expensive first. The
+# "render_time" pass is a (width, height, pixels) tuple with microseconds
+# per sample for each pixel of the last render layer, rows from the bottom,
+# or None when no CPU device rendered.
+profiling_results = None
+
+
 def render(engine):
     import _cycles
+    global profiling_results
     if hasattr(engine, "session"):
         _cycles.render(engine.session)
 
+        results = _cycles.profiling_results(engine.session)
+        if results["phases"]:
+            profiling_results = results
+
 
 def bake(engine, obj, pass_type, pass_filter, object_id, pixel_array, num_pixels, depth, result):
     import _cycles
     session = getattr(engine, "session", None)
     if session is not None:
-        _cycles.bake(engine.session, obj.as_pointer(), pass_type, pass_filter, object_id, pixel_array.as_pointer(), num_pixels, depth, result.as_pointer())
+        return _cycles.bake(engine.session, obj.as_pointer(), pass_type, pass_filter, object_id, pixel_array.as_pointer(), num_pixels, depth, result.as_pointer())
+
+
+# Bake many objects and passes with one scene sync, packing their pixels into
+# as few device tasks as possible. jobs is a sequence of the arguments of
+# bake() after the engine. Returns a dict with the number of baked "pixels",
+# the "time" in seconds and "pixels_per_second", like bake().
+def bake_batch(engine, jobs):
+    import _cycles
+    session = getattr(engine, "session", None)
+    if session is not None:
+        jobs = [(obj.as_pointer(), pass_type, pass_filter, object_id, pixel_array.as_pointer(), num_pixels, depth, result.as_pointer())
+                for obj, pass_type, pass_filter, object_id, pixel_array, num_pixels, depth, result in jobs]
+        return _cycles.bake_batch(engine.session, jobs)
 
 
 def reset(engine, data, scene):
@@ -21,7 +21,8 @@ from bpy.props import (BoolProperty,
                        EnumProperty,
                        FloatProperty,
                        IntProperty,
-                       PointerProperty)
+                       PointerProperty,
+                       StringProperty)
 
 # enums
 
@@ -248,6 +249,56 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 default='SOBOL',
                 )
 
+        cls.use_adaptive_sampling = BoolProperty(
+                name="Adaptive Sampling",
+                description="Stop sampling pixels whose noise level is below the threshold, "
+                            "only used for final renders without progressive refine",
+                default=False,
+                )
+        cls.adaptive_threshold = FloatProperty(
+                name="Adaptive Threshold",
+                description="Noise level at which a pixel is considered converged, "
+                            "lower values give less noise at the cost of render time",
+                min=0.001, max=1.0,
+                default=0.01,
+                precision=4,
+                )
+        cls.adaptive_min_samples = IntProperty(
+                name="Adaptive Min Samples",
+                description="Minimum number of samples a pixel receives before it can be "
+                            "considered converged",
+                min=4, max=4096,
+                default=16,
+                )
+
+        cls.use_denoising = BoolProperty(
+                name="Denoising",
+                description="Denoise finished tiles of final renders on the CPU, "
+                            "guided by normal, diffuse color and depth passes",
+                default=False,
+                )
+        cls.denoising_radius = IntProperty(
+                name="Denoising Radius",
+                description="Size of the pixel neighborhood used for denoising, "
+                            "larger values remove more low frequency noise but are slower",
+                min=1, max=25,
+                default=8,
+                )
+        cls.denoising_strength = FloatProperty(
+                name="Denoising Strength",
+                description="How much neighboring pixels with different colors are mixed, "
+                            "higher values remove more noise but may blur details",
+                min=0.0, max=1.0,
+                default=0.1,
+                )
+
+        cls.use_profiling = BoolProperty(
+                name="Profile Render",
+                description="Measure time spent per kernel phase, shader, object and pixel during final renders, "
+                            "and print a report when rendering finished",
+                default=False,
+                )
+
         cls.use_layer_samples = EnumProperty(
                 name="Layer Samples",
                 description="How to use per render layer sample settings",
@@ -364,6 +415,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 min=2, max=65536
                 )
 
+        cls.volume_skip_empty = BoolProperty(
+                name="Skip Empty Voxels",
+                description="Don't evaluate volume shaders where all smoke grids of the volume are empty, "
+                            "this ignores any density the shader adds outside of the smoke (CPU only)",
+                default=False,
+                )
+
         cls.dicing_rate = FloatProperty(
                 name="Dicing Rate",
                 description="Size of a micropolygon in pixels",
@@ -504,6 +562,38 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 description="Use special type BVH optimized for hair (uses more ram but renders faster)",
                 default=True,
                 )
+        cls.use_compressed_attributes = BoolProperty(
+                name="Compress Geometry",
+                description="Store vertex normals and UV maps with reduced precision "
+                            "(uses less memory on large scenes, UVs may lose precision with high resolution textures)",
+                default=False,
+                )
+        cls.use_bvh_cache = BoolProperty(
+                name="Cache BVH",
+                description="Store BVH on disk for final renders and reuse it when geometry did not change "
+                            "(faster startup for repeated renders, uses disk space)",
+                default=False,
+                )
+        cls.use_shader_cache = BoolProperty(
+                name="Cache Shaders",
+                description="Store compiled shaders on disk for final renders and reuse them when materials did not change "
+                            "(faster startup for repeated renders, uses disk space)",
+                default=False,
+                )
+        cls.cache_directory = StringProperty(
+                name="Cache Directory",
+                description="Directory to store cached BVHs and shaders in, can be shared between computers "
+                            "(uses the user cache directory when empty)",
+                subtype='DIR_PATH',
+                default="",
+                )
+        cls.cache_size_limit = IntProperty(
+                name="Cache Size Limit",
+                description="Size in megabytes the cache directory is kept under, removing least recently used files "
+                            "(0 for no limit)",
+                min=0, max=1 << 20,
+                default=4096,
+                )
         cls.tile_order = EnumProperty(
                 name="Tile Order",
                 description="Tile order for rendering",
@@ -594,6 +684,7 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         cls.debug_use_cpu_sse3 = BoolProperty(name="SSE3", default=True)
         cls.debug_use_cpu_sse2 = BoolProperty(name="SSE2", default=True)
         cls.debug_use_qbvh = BoolProperty(name="QBVH", default=True)
+        cls.debug_use_cpu_ray_stream = BoolProperty(name="Ray Stream", default=False)
 
         cls.debug_use_cuda_adaptive_compile = BoolProperty(name="Adaptive Compile", default=False)
 
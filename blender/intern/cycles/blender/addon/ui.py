@@ -199,6 +199,22 @@ class CyclesRender_PT_sampling(CyclesButtonsPanel, Panel):
         if not (use_opencl(context) and cscene.feature_set != 'EXPERIMENTAL'):
             layout.row().prop(cscene, "sampling_pattern", text="Pattern")
 
+        row = layout.row(align=True)
+        row.active = use_cpu(context)
+        row.prop(cscene, "use_adaptive_sampling", text="Adaptive")
+        sub = row.row(align=True)
+        sub.active = use_cpu(context) and cscene.use_adaptive_sampling
+        sub.prop(cscene, "adaptive_threshold", text="Threshold")
+        sub.prop(cscene, "adaptive_min_samples", text="Min Samples")
+
+        row = layout.row(align=True)
+        row.active = use_cpu(context)
+        row.prop(cscene, "use_denoising", text="Denoise")
+        sub = row.row(align=True)
+        sub.active = use_cpu(context) and cscene.use_denoising
+        sub.prop(cscene, "denoising_radius", text="Radius")
+        sub.prop(cscene, "denoising_strength", text="Strength")
+
         for rl in scene.render.layers:
             if rl.samples > 0:
                 layout.separator()
@@ -227,6 +243,7 @@ class CyclesRender_PT_geometery(CyclesButtonsPanel, Panel):
             sub.label("Volume Sampling:")
             sub.prop(cscene, "volume_step_size")
             sub.prop(cscene, "volume_max_steps")
+            sub.prop(cscene, "volume_skip_empty")
 
             col = split.column()
 
@@ -242,6 +259,8 @@ class CyclesRender_PT_geometery(CyclesButtonsPanel, Panel):
             row = layout.row()
             row.prop(cscene, "volume_step_size")
             row.prop(cscene, "volume_max_steps")
+            row = layout.row()
+            row.prop(cscene, "volume_skip_empty")
 
 
 class CyclesRender_PT_light_paths(CyclesButtonsPanel, Panel):
@@ -396,6 +415,13 @@ class CyclesRender_PT_performance(CyclesButtonsPanel, Panel):
 
         col.label(text="Final Render:")
         col.prop(rd, "use_persistent_data", text="Persistent Images")
+        col.prop(cscene, "use_bvh_cache")
+        col.prop(cscene, "use_shader_cache")
+        sub = col.column()
+        sub.active = cscene.use_bvh_cache or cscene.use_shader_cache
+        sub.prop(cscene, "cache_directory", text="")
+        sub.prop(cscene, "cache_size_limit", text="Size Limit (MB)")
+        col.prop(cscene, "use_profiling")
 
         col.separator()
 
@@ -403,6 +429,11 @@ class CyclesRender_PT_performance(CyclesButtonsPanel, Panel):
         col.prop(cscene, "debug_use_spatial_splits")
         col.prop(cscene, "debug_use_hair_bvh")
 
+        col.separator()
+
+        col.label(text="Geometry:")
+        col.prop(cscene, "use_compressed_attributes")
+
 
 class CyclesRender_PT_layer_options(CyclesButtonsPanel, Panel):
     bl_label = "Layer"
@@ -1516,6 +1547,7 @@ class CyclesRender_PT_debug(CyclesButtonsPanel, Panel):
         row.prop(cscene, "debug_use_cpu_avx", toggle=True)
         row.prop(cscene, "debug_use_cpu_avx2", toggle=True)
         col.prop(cscene, "debug_use_qbvh")
+        col.prop(cscene, "debug_use_cpu_ray_stream")
 
         col = layout.column()
         col.label('CUDA Flags:')
@@ -430,6 +430,8 @@ static void attr_create_uv_map(Scene *scene,
 				else
 					attr = mesh->subd_attributes.add(name, TypeDesc::TypePoint, ATTR_ELEMENT_CORNER);
 
+				attr->flags |= ATTR_UV_MAP;
+
 				if(subdivide_uvs) {
 					attr->flags |= ATTR_SUBDIVIDED;
 				}
@@ -463,6 +465,8 @@ static void attr_create_uv_map(Scene *scene,
 				else
 					attr = mesh->attributes.add(name, TypeDesc::TypePoint, ATTR_ELEMENT_CORNER);
 
+				attr->flags |= ATTR_UV_MAP;
+
 				BL::MeshTextureFaceLayer::data_iterator t;
 				float3 *fdata = attr->data_float3();
 				size_t i = 0;
@@ -356,6 +356,11 @@ Object *BlenderSync::sync_object(BL::Object& b_parent,
 		object_updated = true;
 	
 	bool use_holdout = (layer_flag & render_layer.holdout_layer) != 0;
+
+	/* state before sync, to detect transform only changes */
+	Mesh *prev_mesh = object->mesh;
+	uint prev_visibility = object->visibility;
+	bool prev_use_holdout = object->use_holdout;
 	
 	/* mesh sync */
 	object->mesh = sync_mesh(b_ob, object_updated, hide_tris);
@@ -394,6 +399,11 @@ Object *BlenderSync::sync_object(BL::Object& b_parent,
 	 * transform comparison should not be needed, but duplis don't work perfect
 	 * in the depsgraph and may not signal changes, so this is a workaround */
 	if(object_updated || (object->mesh && object->mesh->need_update) || tfm != object->tfm) {
+		int prev_pass_id = object->pass_id;
+		uint prev_random_id = object->random_id;
+		float3 prev_dupli_generated = object->dupli_generated;
+		float2 prev_dupli_uv = object->dupli_uv;
+
 		object->name = b_ob.name().c_str();
 		object->pass_id = b_ob.pass_index();
 		object->tfm = tfm;
@@ -442,7 +452,23 @@ Object *BlenderSync::sync_object(BL::Object& b_parent,
 			object->dupli_uv = make_float2(0.0f, 0.0f);
 		}
 
-		object->tag_update(scene);
+		/* moving existing objects is common in interactive layout work, allow
+		 * incremental device update in that case */
+		bool transform_only = object->mesh &&
+		                      object->mesh == prev_mesh &&
+		                      !object->mesh->need_update &&
+		                      scene->need_motion() == Scene::MOTION_NONE &&
+		                      object->visibility == prev_visibility &&
+		                      object->use_holdout == prev_use_holdout &&
+		                      object->pass_id == prev_pass_id &&
+		                      object->random_id == prev_random_id &&
+		                      object->dupli_generated == prev_dupli_generated &&
+		                      object->dupli_uv == prev_dupli_uv;
+
+		if(transform_only)
+			object->tag_transform_update(scene);
+		else
+			object->tag_update(scene);
 	}
 
 	return object;
@@ -71,6 +71,7 @@ bool debug_flags_sync_from_scene(BL::Scene b_scene)
 	flags.cpu.sse3 = get_boolean(cscene, "debug_use_cpu_sse3");
 	flags.cpu.sse2 = get_boolean(cscene, "debug_use_cpu_sse2");
 	flags.cpu.qbvh = get_boolean(cscene, "debug_use_qbvh");
+	flags.cpu.ray_stream = get_boolean(cscene, "debug_use_cpu_ray_stream");
 	/* Synchronize CUDA flags. */
 	flags.cuda.adaptive_compile = get_boolean(cscene, "debug_use_cuda_adaptive_compile");
 	/* Synchronize OpenCL kernel type. */
@@ -291,6 +292,74 @@ static PyObject *render_func(PyObject * /*self*/, PyObject *value)
 	Py_RETURN_NONE;
 }
 
+static PyObject *profiling_times_to_list(const Session::ProfilingTimes& times)
+{
+	PyObject *list = PyList_New(times.size());
+
+	for(size_t i = 0; i < times.size(); i++) {
+		PyObject *item = Py_BuildValue("(sd)", times[i].first.c_str(), times[i].second);
+		PyList_SET_ITEM(list, i, item);
+	}
+
+	return list;
+}
+
+static PyObject *profiling_results_func(PyObject * /*self*/, PyObject *value)
+{
+	BlenderSession *session = (BlenderSession*)PyLong_AsVoidPtr(value);
+	Session::ProfilingTimes events, shaders, objects;
+
+	session->session->get_profiling_times(events, shaders, objects);
+
+	PyObject *results = PyDict_New();
+	PyObject *list;
+
+	list = profiling_times_to_list(events);
+	PyDict_SetItemString(results, "phases", list);
+	Py_DECREF(list);
+
+	list = profiling_times_to_list(shaders);
+	PyDict_SetItemString(results, "shaders", list);
+	Py_DECREF(list);
+
+	list = profiling_times_to_list(objects);
+	PyDict_SetItemString(results, "objects", list);
+	Py_DECREF(list);
+
+	/* render time pass as (width, height, pixels), None when not rendered */
+	int width, height;
+	vector<float> pixels;
+	session->session->get_render_time_pass(width, height, pixels);
+
+	if(!pixels.empty()) {
+		list = PyList_New(pixels.size());
+		for(size_t i = 0; i < pixels.size(); i++)
+			PyList_SET_ITEM(list, i, PyFloat_FromDouble(pixels[i]));
+
+		PyObject *render_time = Py_BuildValue("(iiN)", width, height, list);
+		PyDict_SetItemString(results, "render_time", render_time);
+		Py_DECREF(render_time);
+	}
+	else {
+		PyDict_SetItemString(results, "render_time", Py_None);
+	}
+
+	return results;
+}
+
+/* number of baked pixels, time and pixels per second of the last bake */
+static PyObject *bake_stats(BlenderSession *session)
+{
+	BakeManager *bake_manager = session->scene->bake_manager;
+	double pixels_per_second = (bake_manager->bake_time > 0.0)?
+		bake_manager->num_baked_pixels / bake_manager->bake_time: 0.0;
+
+	return Py_BuildValue("{s:n,s:d,s:d}",
+	                     "pixels", (Py_ssize_t)bake_manager->num_baked_pixels,
+	                     "time", bake_manager->bake_time,
+	                     "pixels_per_second", pixels_per_second);
+}
+
 /* pixel_array and result passed as pointers */
 static PyObject *bake_func(PyObject * /*self*/, PyObject *args)
 {
@@ -320,7 +389,59 @@ static PyObject *bake_func(PyObject * /*self*/, PyObject *args)
 
 	python_thread_state_restore(&session->python_thread_state);
 
-	Py_RETURN_NONE;
+	return bake_stats(session);
+}
+
+/* jobs is a sequence of the arguments of bake() after the session, with
+ * the object, pixel_array and result passed as pointers */
+static PyObject *bake_batch_func(PyObject * /*self*/, PyObject *args)
+{
+	PyObject *pysession, *pyjobs;
+
+	if(!PyArg_ParseTuple(args, "OO", &pysession, &pyjobs))
+		return NULL;
+
+	BlenderSession *session = (BlenderSession*)PyLong_AsVoidPtr(pysession);
+
+	PyObject *pyjobs_fast = PySequence_Fast(pyjobs, "jobs must be a sequence");
+	if(!pyjobs_fast)
+		return NULL;
+
+	Py_ssize_t num_jobs = PySequence_Fast_GET_SIZE(pyjobs_fast);
+	vector<BlenderBakeJob> jobs;
+
+	for(Py_ssize_t i = 0; i < num_jobs; i++) {
+		PyObject *pyjob = PySequence_Fast_GET_ITEM(pyjobs_fast, i);
+		PyObject *pyobject, *pypixel_array, *pyresult;
+		const char *pass_type;
+		int num_pixels, depth, object_id, pass_filter;
+
+		if(!PyArg_ParseTuple(pyjob, "OsiiOiiO", &pyobject, &pass_type, &pass_filter, &object_id, &pypixel_array, &num_pixels, &depth, &pyresult)) {
+			Py_DECREF(pyjobs_fast);
+			return NULL;
+		}
+
+		PointerRNA objectptr;
+		RNA_id_pointer_create((ID*)PyLong_AsVoidPtr(pyobject), &objectptr);
+		BL::Object b_object(objectptr);
+
+		PointerRNA bakepixelptr;
+		RNA_pointer_create(NULL, &RNA_BakePixel, PyLong_AsVoidPtr(pypixel_array), &bakepixelptr);
+		BL::BakePixel b_bake_pixel(bakepixelptr);
+
+		jobs.push_back(BlenderBakeJob(b_object, pass_type, pass_filter, object_id, b_bake_pixel,
+		                              (size_t)num_pixels, (float *)PyLong_AsVoidPtr(pyresult)));
+	}
+
+	Py_DECREF(pyjobs_fast);
+
+	python_thread_state_save(&session->python_thread_state);
+
+	session->bake_batch(jobs);
+
+	python_thread_state_restore(&session->python_thread_state);
+
+	return bake_stats(session);
 }
 
 static PyObject *draw_func(PyObject * /*self*/, PyObject *args)
@@ -682,7 +803,9 @@ static PyMethodDef methods[] = {
 	{"create", create_func, METH_VARARGS, ""},
 	{"free", free_func, METH_O, ""},
 	{"render", render_func, METH_O, ""},
+	{"profiling_results", profiling_results_func, METH_O, ""},
 	{"bake", bake_func, METH_VARARGS, ""},
+	{"bake_batch", bake_batch_func, METH_VARARGS, ""},
 	{"draw", draw_func, METH_VARARGS, ""},
 	{"sync", sync_func, METH_O, ""},
 	{"reset", reset_func, METH_VARARGS, ""},
@@ -111,7 +111,7 @@ void BlenderSession::create_session()
 {
 	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
 	bool is_cpu = session_params.device.type == DEVICE_CPU;
-	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background, is_cpu);
+	SceneParams scene_params = BlenderSync::get_scene_params(b_data, b_scene, background, is_cpu);
 	bool session_pause = BlenderSync::get_session_pause(b_scene, background);
 
 	/* reset status/progress */
@@ -175,7 +175,7 @@ void BlenderSession::reset_session(BL::BlendData& b_data_, BL::Scene& b_scene_)
 
 	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
 	const bool is_cpu = session_params.device.type == DEVICE_CPU;
-	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background, is_cpu);
+	SceneParams scene_params = BlenderSync::get_scene_params(b_data, b_scene, background, is_cpu);
 
 	width = render_resolution_x(b_render);
 	height = render_resolution_y(b_render);
@@ -310,6 +310,8 @@ static PassType get_pass_type(BL::RenderPass& b_pass)
 				return PASS_BVH_TRAVERSED_INSTANCES;
 			if(b_pass.debug_type() == BL::RenderPass::debug_type_RAY_BOUNCES)
 				return PASS_RAY_BOUNCES;
+			if(b_pass.debug_type() == BL::RenderPass::debug_type_ADAPTIVE_ERROR)
+				return PASS_ADAPTIVE_ERROR;
 			break;
 		}
 #endif
@@ -387,8 +389,10 @@ void BlenderSession::do_write_update_render_tile(RenderTile& rtile, bool do_upda
 	int w = params.width;
 	int h = params.height;
 
-	/* get render result */
+	/* get render result, only passes are written without the lock */
+	thread_scoped_lock result_lock(render_result_mutex);
 	BL::RenderResult b_rr = begin_render_result(b_engine, x, y, w, h, b_rlay_name.c_str(), b_rview_name.c_str());
+	result_lock.unlock();
 
 	/* can happen if the intersected rectangle gives 0 width or height */
 	if(b_rr.ptr.data == NULL) {
@@ -415,11 +419,14 @@ void BlenderSession::do_write_update_render_tile(RenderTile& rtile, bool do_upda
 			update_render_result(b_rr, b_rlay, rtile);
 		}
 
+		result_lock.lock();
 		end_render_result(b_engine, b_rr, true, true);
 	}
 	else {
 		/* write result */
 		write_render_result(b_rr, b_rlay, rtile);
+
+		result_lock.lock();
 		end_render_result(b_engine, b_rr, false, true);
 	}
 }
@@ -492,6 +499,20 @@ void BlenderSession::render()
 			}
 		}
 
+		if(session->use_adaptive_sampling())
+			Pass::add(PASS_ADAPTIVE_AUX, passes);
+
+		/* feature passes guiding the denoiser */
+		if(session->use_denoising()) {
+			Pass::add(PASS_NORMAL, passes);
+			Pass::add(PASS_DIFFUSE_COLOR, passes);
+			Pass::add(PASS_DEPTH, passes);
+		}
+
+		/* per pixel render time, only written by the CPU device */
+		if(session->params.use_profiling)
+			Pass::add(PASS_RENDER_TIME, passes);
+
 		buffer_params.passes = passes;
 		scene->film->pass_alpha_threshold = b_layer_iter->pass_alpha_threshold();
 		scene->film->tag_passes_update(scene, passes);
@@ -550,6 +571,12 @@ void BlenderSession::render()
 	VLOG(1) << "Total render time: " << total_time;
 	VLOG(1) << "Render time (without synchronization): " << render_time;
 
+	if(session->params.use_profiling && !session->progress.get_cancel()) {
+		string report = session->get_profiling_report();
+		if(!report.empty())
+			printf("\n%s\n", report.c_str());
+	}
+
 	/* clear callback */
 	session->write_render_tile_cb = function_null;
 	session->update_render_tile_cb = function_null;
@@ -619,32 +646,50 @@ void BlenderSession::bake(BL::Object& b_object,
                           const int /*depth*/,
                           float result[])
 {
-	ShaderEvalType shader_type = get_shader_type(pass_type);
-	size_t object_index = OBJECT_NONE;
-	int tri_offset = 0;
+	vector<BlenderBakeJob> jobs;
+	jobs.push_back(BlenderBakeJob(b_object, pass_type, pass_filter, object_id, pixel_array, num_pixels, result));
+
+	bake_batch(jobs);
+}
 
+void BlenderSession::bake_batch(vector<BlenderBakeJob>& jobs)
+{
 	/* Set baking flag in advance, so kernel loading can check if we need
 	 * any baking capabilities.
 	 */
 	scene->bake_manager->set_baking(true);
 
+	/* no statistics from an earlier bake when this one is cancelled */
+	scene->bake_manager->num_baked_pixels = 0;
+	scene->bake_manager->bake_time = 0.0;
+
 	/* ensure kernels are loaded before we do any scene updates */
 	session->load_kernels();
 
 	if(session->progress.get_cancel())
 		return;
 
-	if(shader_type == SHADER_EVAL_UV) {
-		/* force UV to be available */
-		Pass::add(PASS_UV, scene->film->passes);
-	}
+	vector<ShaderEvalType> shader_types;
+	vector<int> bake_pass_filters;
+
+	foreach(BlenderBakeJob& job, jobs) {
+		ShaderEvalType shader_type = get_shader_type(job.pass_type);
+
+		if(shader_type == SHADER_EVAL_UV) {
+			/* force UV to be available */
+			Pass::add(PASS_UV, scene->film->passes);
+		}
+
+		int bake_pass_filter = bake_pass_filter_get(job.pass_filter);
+		bake_pass_filter = BakeManager::shader_type_to_pass_filter(shader_type, bake_pass_filter);
 
-	int bake_pass_filter = bake_pass_filter_get(pass_filter);
-	bake_pass_filter = BakeManager::shader_type_to_pass_filter(shader_type, bake_pass_filter);
+		/* force use_light_pass to be true if we bake more than just colors */
+		if(bake_pass_filter & ~BAKE_FILTER_COLOR) {
+			scene->film->use_bake_light_pass = true;
+		}
 
-	/* force use_light_pass to be true if we bake more than just colors */
-	if(bake_pass_filter & ~BAKE_FILTER_COLOR) {
-		Pass::add(PASS_LIGHT, scene->film->passes);
+		shader_types.push_back(shader_type);
+		bake_pass_filters.push_back(bake_pass_filter);
 	}
 
 	/* create device and update scene */
@@ -672,20 +717,30 @@ void BlenderSession::bake(BL::Object& b_object,
 	session->reset(buffer_params, session_params.samples);
 	session->update_scene();
 
-	/* find object index. todo: is arbitrary - copied from mesh_displace.cpp */
-	for(size_t i = 0; i < scene->objects.size(); i++) {
-		if(strcmp(scene->objects[i]->name.c_str(), b_object.name().c_str()) == 0) {
-			object_index = i;
-			tri_offset = scene->objects[i]->mesh->tri_offset;
-			break;
+	vector<BakeJob> bake_jobs;
+
+	for(size_t j = 0; j < jobs.size(); j++) {
+		BlenderBakeJob& job = jobs[j];
+		size_t object_index = OBJECT_NONE;
+		int tri_offset = 0;
+
+		/* find object index. todo: is arbitrary - copied from mesh_displace.cpp */
+		for(size_t i = 0; i < scene->objects.size(); i++) {
+			if(strcmp(scene->objects[i]->name.c_str(), job.b_object.name().c_str()) == 0) {
+				object_index = i;
+				tri_offset = scene->objects[i]->mesh->tri_offset;
+				break;
+			}
 		}
-	}
 
-	int object = object_index;
+		int object = object_index;
+
+		BakeData *bake_data = new BakeData(object, tri_offset, job.num_pixels);
 
-	BakeData *bake_data = scene->bake_manager->init(object, tri_offset, num_pixels);
+		populate_bake_data(bake_data, job.object_id, job.pixel_array, job.num_pixels);
 
-	populate_bake_data(bake_data, object_id, pixel_array, num_pixels);
+		bake_jobs.push_back(BakeJob(bake_data, shader_types[j], bake_pass_filters[j], job.result));
+	}
 
 	/* set number of samples */
 	session->tile_manager.set_samples(session_params.samples);
@@ -694,7 +749,10 @@ void BlenderSession::bake(BL::Object& b_object,
 
 	session->progress.set_update_callback(function_bind(&BlenderSession::update_bake_progress, this));
 
-	scene->bake_manager->bake(scene->device, &scene->dscene, scene, session->progress, shader_type, bake_pass_filter, bake_data, result);
+	scene->bake_manager->bake(scene->device, &scene->dscene, scene, session->progress, bake_jobs);
+
+	foreach(BakeJob& bake_job, bake_jobs)
+		delete bake_job.data;
 
 	/* free all memory used (host and device), so we wouldn't leave render
 	 * engine with extra memory allocated
@@ -719,8 +777,7 @@ void BlenderSession::do_write_update_render_result(BL::RenderResult& b_rr,
 
 	BufferParams& params = buffers->params;
 	float exposure = scene->film->exposure;
-
-	vector<float> pixels(params.width*params.height*4);
+	int size = params.width*params.height;
 
 	/* Adjust absolute sample number to the range. */
 	int sample = rtile.sample;
@@ -730,7 +787,11 @@ void BlenderSession::do_write_update_render_result(BL::RenderResult& b_rr,
 	}
 
 	if(!do_update_only) {
-		/* copy each pass */
+		/* convert all passes at once into a single staging buffer, then
+		 * copy each pass into the render result */
+		vector<BL::RenderPass> b_passes;
+		vector<RenderPassRect> rects;
+		size_t pixels_size = 0;
 		BL::RenderLayer::passes_iterator b_iter;
 
 		for(b_rlay.passes.begin(b_iter); b_iter != b_rlay.passes.end(); ++b_iter) {
@@ -740,14 +801,28 @@ void BlenderSession::do_write_update_render_result(BL::RenderResult& b_rr,
 			PassType pass_type = get_pass_type(b_pass);
 			int components = b_pass.channels();
 
-			/* copy pixels */
-			if(!buffers->get_pass_rect(pass_type, exposure, sample, components, &pixels[0]))
-				memset(&pixels[0], 0, pixels.size()*sizeof(float));
+			b_passes.push_back(b_pass);
+			rects.push_back(RenderPassRect(pass_type, components, NULL));
+			pixels_size += size*components;
+		}
+
+		vector<float> pixels(pixels_size);
+		float *pixels_ptr = (pixels_size)? &pixels[0]: NULL;
 
-			b_pass.rect(&pixels[0]);
+		for(size_t i = 0; i < rects.size(); i++) {
+			rects[i].pixels = pixels_ptr;
+			pixels_ptr += size*rects[i].components;
 		}
+
+		buffers->get_pass_rects(rects, exposure, sample);
+
+		/* copy pixels */
+		for(size_t i = 0; i < rects.size(); i++)
+			b_passes[i].rect(rects[i].pixels);
 	}
 	else {
+		vector<float> pixels(size*4);
+
 		/* copy combined pass */
 		BL::RenderPass b_combined_pass(b_rlay.passes.find_by_type(BL::RenderPass::type_COMBINED, b_rview_name.c_str()));
 		if(buffers->get_pass_rect(PASS_COMBINED, exposure, sample, 4, &pixels[0]))
@@ -755,6 +830,7 @@ void BlenderSession::do_write_update_render_result(BL::RenderResult& b_rr,
 	}
 
 	/* tag result as updated */
+	thread_scoped_lock result_lock(render_result_mutex);
 	b_engine.update_result(b_rr);
 }
 
@@ -781,7 +857,7 @@ void BlenderSession::synchronize()
 	/* on session/scene parameter changes, we recreate session entirely */
 	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
 	const bool is_cpu = session_params.device.type == DEVICE_CPU;
-	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background, is_cpu);
+	SceneParams scene_params = BlenderSync::get_scene_params(b_data, b_scene, background, is_cpu);
 	bool session_pause = BlenderSync::get_session_pause(b_scene, background);
 
 	if(session->params.modified(session_params) ||
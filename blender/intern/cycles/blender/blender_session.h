@@ -31,6 +31,28 @@ class Session;
 class RenderBuffers;
 class RenderTile;
 
+/* Object and pass to bake, as given to the render engine bake callback. */
+struct BlenderBakeJob {
+	BlenderBakeJob(BL::Object& b_object_,
+	               const string& pass_type_,
+	               const int pass_filter_,
+	               const int object_id_,
+	               BL::BakePixel& pixel_array_,
+	               const size_t num_pixels_,
+	               float *result_)
+	: b_object(b_object_), pass_type(pass_type_), pass_filter(pass_filter_),
+	  object_id(object_id_), pixel_array(pixel_array_), num_pixels(num_pixels_),
+	  result(result_) {}
+
+	BL::Object b_object;
+	string pass_type;
+	int pass_filter;
+	int object_id;
+	BL::BakePixel pixel_array;
+	size_t num_pixels;
+	float *result;
+};
+
 class BlenderSession {
 public:
 	BlenderSession(BL::RenderEngine& b_engine,
@@ -69,6 +91,10 @@ public:
 	          const int depth,
 	          float pixels[]);
 
+	/* Bake many objects and passes with a single scene sync, in as few
+	 * device tasks as possible. */
+	void bake_batch(vector<BlenderBakeJob>& jobs);
+
 	void write_render_result(BL::RenderResult& b_rr,
 	                         BL::RenderLayer& b_rlay,
 	                         RenderTile& rtile);
@@ -144,6 +170,10 @@ protected:
 	                                   bool do_update_only);
 	void do_write_update_render_tile(RenderTile& rtile, bool do_update_only);
 
+	/* Tiles are written by multiple render threads, while beginning, updating
+	 * and ending render results of the engine is not thread safe. */
+	thread_mutex render_result_mutex;
+
 	int builtin_image_frame(const string &builtin_name);
 	void builtin_image_info(const string &builtin_name, void *builtin_data, bool &is_float, int &width, int &height, int &depth, int &channels);
 	bool builtin_image_pixels(const string &builtin_name, void *builtin_data, unsigned char *pixels);
@@ -249,6 +249,7 @@ void BlenderSync::sync_integrator()
 
 	integrator->volume_max_steps = get_int(cscene, "volume_max_steps");
 	integrator->volume_step_size = get_float(cscene, "volume_step_size");
+	integrator->volume_skip_empty = get_boolean(cscene, "volume_skip_empty");
 
 	integrator->caustics_reflective = get_boolean(cscene, "caustics_reflective");
 	integrator->caustics_refractive = get_boolean(cscene, "caustics_refractive");
@@ -463,7 +464,8 @@ void BlenderSync::sync_images()
 
 /* Scene Parameters */
 
-SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
+SceneParams BlenderSync::get_scene_params(BL::BlendData& b_data,
+                                          BL::Scene& b_scene,
                                           bool background,
                                           bool is_cpu)
 {
@@ -494,6 +496,12 @@ SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
 	else
 		params.persistent_data = false;
 
+	params.use_bvh_cache = background && RNA_boolean_get(&cscene, "use_bvh_cache");
+	params.use_shader_cache = background && RNA_boolean_get(&cscene, "use_shader_cache");
+	params.cache_directory = blender_absolute_path(b_data, b_scene, get_string(cscene, "cache_directory"));
+	params.cache_size_limit = (uint64_t)RNA_int_get(&cscene, "cache_size_limit") << 20;
+	params.use_compressed_attributes = RNA_boolean_get(&cscene, "use_compressed_attributes");
+
 #if !(defined(__GNUC__) && (defined(i386) || defined(_M_IX86)))
 	if(is_cpu) {
 		params.use_qbvh = DebugFlags().cpu.qbvh && system_cpu_support_sse2();
@@ -591,6 +599,21 @@ SessionParams BlenderSync::get_session_params(BL::RenderEngine& b_engine,
 		}
 	}
 
+	/* adaptive sampling */
+	if(get_boolean(cscene, "use_adaptive_sampling")) {
+		params.adaptive_threshold = get_float(cscene, "adaptive_threshold");
+		params.adaptive_min_samples = get_int(cscene, "adaptive_min_samples");
+	}
+
+	/* denoising */
+	if(get_boolean(cscene, "use_denoising")) {
+		params.denoising_radius = get_int(cscene, "denoising_radius");
+		params.denoising_strength = get_float(cscene, "denoising_strength");
+	}
+
+	/* profiling, only meaningful for final renders which run to completion */
+	params.use_profiling = background && get_boolean(cscene, "use_profiling");
+
 	/* tiles */
 	if(params.device.type != DEVICE_CPU && !background) {
 		/* currently GPU could be much slower than CPU when using tiles,
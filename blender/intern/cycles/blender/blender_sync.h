@@ -78,7 +78,8 @@ public:
 	inline int get_layer_bound_samples() { return render_layer.bound_samples; }
 
 	/* get parameters */
-	static SceneParams get_scene_params(BL::Scene& b_scene,
+	static SceneParams get_scene_params(BL::BlendData& b_data,
+	                                    BL::Scene& b_scene,
 	                                    bool background,
 	                                    bool is_cpu);
 	static SessionParams get_session_params(BL::RenderEngine& b_engine,
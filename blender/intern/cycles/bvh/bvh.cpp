@@ -26,6 +26,7 @@
 #include "bvh_params.h"
 #include "bvh_unaligned.h"
 
+#include "util_cache.h"
 #include "util_debug.h"
 #include "util_foreach.h"
 #include "util_logging.h"
@@ -111,15 +112,134 @@ void BVH::build(Progress& progress)
 
 void BVH::refit(Progress& progress)
 {
-	progress.set_substatus("Packing BVH primitives");
-	pack_primitives();
+	/* Primitives of the top level BVH only change together with meshes,
+	 * which requires full rebuild. Refit only updates bounds of its nodes
+	 * from the object bounds, instanced BVHs are left untouched.
+	 */
+	if(!params.top_level) {
+		progress.set_substatus("Packing BVH primitives");
+		pack_primitives();
 
-	if(progress.get_cancel()) return;
+		if(progress.get_cancel()) return;
+	}
 
 	progress.set_substatus("Refitting BVH nodes");
 	refit_nodes();
 }
 
+/* Cache */
+
+/* Bump when the packed node layout or the build changes, cached BVHs from
+ * other versions are then never looked up. */
+#define BVH_CACHE_FORMAT_VERSION 1
+
+void BVH::cache_key(CacheData& key)
+{
+	const int format[] = {BVH_CACHE_FORMAT_VERSION,
+	                      BVH_NODE_SIZE, BVH_NODE_LEAF_SIZE,
+	                      BVH_QNODE_SIZE, BVH_QNODE_LEAF_SIZE,
+	                      BVH_UNALIGNED_NODE_SIZE, BVH_UNALIGNED_QNODE_SIZE,
+	                      (int)sizeof(void*)};
+	key.add(format);
+
+	/* Everything the build and packing reads goes into the key. Parameters are
+	 * added one by one, the struct itself has padding bytes. */
+	key.add(params.use_spatial_split);
+	key.add(params.spatial_split_alpha);
+	key.add(params.unaligned_split_threshold);
+	key.add(params.sah_node_cost);
+	key.add(params.sah_primitive_cost);
+	key.add(params.min_leaf_size);
+	key.add(params.max_triangle_leaf_size);
+	key.add(params.max_curve_leaf_size);
+	key.add(params.top_level);
+	key.add(params.use_qbvh);
+	key.add(params.primitive_mask);
+	key.add(params.use_unaligned_nodes);
+
+	foreach(Object *ob, objects) {
+		Mesh *mesh = ob->mesh;
+
+		/* Instanced meshes are built in object space, their BVH doesn't
+		 * depend on the object transform. */
+		if(params.top_level || mesh->transform_applied) {
+			key.add(ob->tfm);
+			key.add(ob->bounds);
+			key.add(ob->use_motion);
+			key.add(ob->motion);
+		}
+		key.add(ob->visibility);
+
+		key.add(mesh->triangles);
+		key.add(mesh->verts);
+		key.add(mesh->curve_keys);
+		key.add(mesh->curve_radius);
+		key.add(mesh->curve_first_key);
+		key.add(mesh->motion_steps);
+		key.add(mesh->use_motion_blur);
+
+		Attribute *attr_mP = mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+		if(attr_mP)
+			key.add(attr_mP->buffer);
+
+		Attribute *curve_attr_mP = mesh->curve_attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
+		if(curve_attr_mP)
+			key.add(curve_attr_mP->buffer);
+
+		if(params.top_level) {
+			/* instancing decision and offsets into the global arrays */
+			key.add(mesh->transform_applied);
+			key.add(mesh->has_surface_bssrdf);
+			key.add(mesh->tri_offset);
+			key.add(mesh->curve_offset);
+		}
+	}
+}
+
+bool BVH::cache_read(CacheData& key)
+{
+	CacheData value;
+
+	if(!Cache::global.lookup(key, value))
+		return false;
+
+	if(!(value.read(pack.root_index) &&
+	     value.read(pack.nodes) &&
+	     value.read(pack.leaf_nodes) &&
+	     value.read(pack.object_node) &&
+	     value.read(pack.prim_tri_index) &&
+	     value.read(pack.prim_tri_verts) &&
+	     value.read(pack.prim_type) &&
+	     value.read(pack.prim_visibility) &&
+	     value.read(pack.prim_index) &&
+	     value.read(pack.prim_object)))
+	{
+		VLOG(1) << "Invalid BVH cache file, rebuilding.";
+		pack = PackedBVH();
+		return false;
+	}
+
+	return true;
+}
+
+void BVH::cache_write(CacheData& key)
+{
+	CacheData value;
+
+	value.add(pack.root_index);
+	value.add(pack.nodes);
+	value.add(pack.leaf_nodes);
+	value.add(pack.object_node);
+	value.add(pack.prim_tri_index);
+	value.add(pack.prim_tri_verts);
+	value.add(pack.prim_type);
+	value.add(pack.prim_visibility);
+	value.add(pack.prim_index);
+	value.add(pack.prim_object);
+
+	Cache::global.insert(key, value);
+}
+
 /* Triangles */
 
 void BVH::pack_triangle(int idx, float4 tri_verts[3])
@@ -622,8 +742,6 @@ void RegularBVH::pack_nodes(const BVHNode *root)
 
 void RegularBVH::refit_nodes()
 {
-	assert(!params.top_level);
-
 	BoundBox bbox = BoundBox::empty;
 	uint visibility = 0;
 	refit_node(0, (pack.root_index == -1)? true: false, bbox, visibility);
@@ -636,8 +754,11 @@ void RegularBVH::refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility
 		const int4 *data = &pack.leaf_nodes[idx];
 		const int c0 = data[0].x;
 		const int c1 = data[0].y;
+		/* object instance leaf in top level BVH stores ~prim */
+		const int prim_lo = (c0 < 0)? ~c0: c0;
+		const int prim_hi = (c0 < 0)? ~c0 + 1: c1;
 		/* refit leaf node */
-		for(int prim = c0; prim < c1; prim++) {
+		for(int prim = prim_lo; prim < prim_hi; prim++) {
 			int pidx = pack.prim_index[prim];
 			int tob = pack.prim_object[prim];
 			Object *ob = objects[tob];
@@ -1033,8 +1154,6 @@ void QBVH::pack_nodes(const BVHNode *root)
 
 void QBVH::refit_nodes()
 {
-	assert(!params.top_level);
-
 	BoundBox bbox = BoundBox::empty;
 	uint visibility = 0;
 	refit_node(0, (pack.root_index == -1)? true: false, bbox, visibility);
@@ -1045,8 +1164,11 @@ void QBVH::refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility)
 	if(leaf) {
 		int4 *data = &pack.leaf_nodes[idx];
 		int4 c = data[0];
+		/* Object instance leaf in top level BVH stores ~prim. */
+		const int prim_lo = (c.x < 0)? ~c.x: c.x;
+		const int prim_hi = (c.x < 0)? ~c.x + 1: c.y;
 		/* Refit leaf node. */
-		for(int prim = c.x; prim < c.y; prim++) {
+		for(int prim = prim_lo; prim < prim_hi; prim++) {
 			int pidx = pack.prim_index[prim];
 			int tob = pack.prim_object[prim];
 			Object *ob = objects[tob];
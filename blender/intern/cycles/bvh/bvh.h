@@ -27,6 +27,7 @@ CCL_NAMESPACE_BEGIN
 
 class BVHNode;
 struct BVHStackEntry;
+class CacheData;
 class BVHParams;
 class BoundBox;
 class LeafNode;
@@ -93,6 +94,11 @@ public:
 	void build(Progress& progress);
 	void refit(Progress& progress);
 
+	/* disk cache */
+	void cache_key(CacheData& key);
+	bool cache_read(CacheData& key);
+	void cache_write(CacheData& key);
+
 protected:
 	BVH(const BVHParams& params, const vector<Object*>& objects);
 
@@ -221,6 +221,8 @@ public:
 	/* regular memory */
 	virtual void mem_alloc(device_memory& mem, MemoryType type) = 0;
 	virtual void mem_copy_to(device_memory& mem) = 0;
+	/* copy size bytes starting at offset, memory must be allocated already */
+	virtual void mem_copy_to(device_memory& mem, size_t offset, size_t size) = 0;
 	virtual void mem_copy_from(device_memory& mem,
 		int y, int w, int h, int elem) = 0;
 	virtual void mem_zero(device_memory& mem) = 0;
@@ -267,7 +269,7 @@ public:
 
 #ifdef WITH_NETWORK
 	/* networking */
-	void server_run();
+	void server_run(int port);
 #endif
 
 	/* multi device */
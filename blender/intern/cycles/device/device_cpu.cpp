@@ -45,14 +45,264 @@
 #include "util_progress.h"
 #include "util_system.h"
 #include "util_thread.h"
+#include "util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
+/* Work stealing at the end of a frame.
+ *
+ * Tiles are handed out by the session in the configured tile order. Once there
+ * are none left, idle threads split off the bottom half of the rows of the
+ * in-progress tile with the most remaining work. The split happens at a sample
+ * boundary, the stolen part continues from that sample on into the same render
+ * buffers. The thread which acquired the tile waits for all stolen parts to
+ * finish before releasing it. */
+class CPUTileStealing {
+public:
+	/* Minimum number of rows on either side of a split. */
+	static const int MIN_ROWS = 4;
+
+	struct Work;
+
+	struct Request {
+		bool answered;
+		bool granted;
+		RenderTile tile;
+		Work *root;
+	};
+
+	struct Work {
+		Work(RenderTile *tile_, Work *root_)
+		: tile(tile_), root(root_ ? root_ : this), num_stolen(0), request(NULL)
+		{}
+
+		/* Tile being rendered, rows shrink when parts are stolen. */
+		RenderTile *tile;
+		/* Work of the tile as acquired from the session. */
+		Work *root;
+		/* Stolen parts still being rendered, only used by the root. */
+		int num_stolen;
+		/* Pending request of an idle thread. */
+		Request * volatile request;
+	};
+
+	void begin(Work *work)
+	{
+		thread_scoped_lock lock(mutex);
+		works.push_back(work);
+		cond.notify_all();
+	}
+
+	void end(Work *work)
+	{
+		thread_scoped_lock lock(mutex);
+
+		works.remove(work);
+		if(work->request) {
+			answer(work->request, false);
+			work->request = NULL;
+		}
+
+		if(work->root != work) {
+			work->root->num_stolen--;
+			cond.notify_all();
+		}
+		else {
+			while(work->num_stolen > 0)
+				cond.wait(lock);
+		}
+	}
+
+	/* Called by the rendering thread after each sample. */
+	void split_if_requested(Work *work, int end_sample)
+	{
+		if(work->request == NULL)
+			return;
+
+		thread_scoped_lock lock(mutex);
+		Request *request = work->request;
+		RenderTile& tile = *work->tile;
+
+		if(splittable(tile, end_sample)) {
+			int h = tile.h/2;
+
+			request->tile = tile;
+			request->tile.y = tile.y + h;
+			request->tile.h = tile.h - h;
+			request->root = work->root;
+			tile.h = h;
+
+			work->root->num_stolen++;
+			answer(request, true);
+		}
+		else {
+			answer(request, false);
+		}
+
+		work->request = NULL;
+	}
+
+	/* Called by an idle thread, returns false when there is nothing left
+	 * worth stealing. */
+	bool steal(RenderTile *tile, Work **root)
+	{
+		thread_scoped_lock lock(mutex);
+
+		for(;;) {
+			Work *victim = NULL;
+			int64_t victim_work = 0;
+			bool requests_pending = false;
+
+			foreach(Work *work, works) {
+				RenderTile& work_tile = *work->tile;
+				int end_sample = work_tile.start_sample + work_tile.num_samples;
+
+				if(!splittable(work_tile, end_sample))
+					continue;
+
+				if(work->request) {
+					requests_pending = true;
+					continue;
+				}
+
+				int64_t remaining_work = (int64_t)work_tile.w * work_tile.h *
+				                         (end_sample - work_tile.sample);
+				if(remaining_work > victim_work) {
+					victim = work;
+					victim_work = remaining_work;
+				}
+			}
+
+			if(victim == NULL) {
+				if(!requests_pending)
+					return false;
+
+				/* With more threads than tiles, all splittable tiles can have
+				 * a request of another idle thread. Wait for those to be
+				 * answered, the parts they get can be split again. */
+				cond.wait(lock);
+				continue;
+			}
+
+			Request request;
+			request.answered = false;
+			request.granted = false;
+			victim->request = &request;
+
+			while(!request.answered)
+				cond.wait(lock);
+
+			if(request.granted) {
+				*tile = request.tile;
+				*root = request.root;
+				return true;
+			}
+		}
+	}
+
+protected:
+	static bool splittable(const RenderTile& tile, int end_sample)
+	{
+		return tile.h >= 2*MIN_ROWS && end_sample - tile.sample >= 2;
+	}
+
+	void answer(Request *request, bool granted)
+	{
+		request->granted = granted;
+		request->answered = true;
+		cond.notify_all();
+	}
+
+	thread_mutex mutex;
+	thread_condition_variable cond;
+	list<Work*> works;
+};
+
+/* Kernels for the best instruction set the CPU supports, picked once per
+ * render thread. Ray streams are only traced in SSE4.1 and newer kernels. */
+struct CPUKernels {
+	void(*path_trace)(KernelGlobals*, float*, unsigned int*, int, int, int, int, int);
+	void(*path_trace_stream)(KernelGlobals*, float*, unsigned int*, int, int, int, int, int, int);
+	bool(*adaptive_convergence_check)(KernelGlobals*, float*, float, int, int, int, int);
+	void(*adaptive_post_adjust)(KernelGlobals*, float*, float, int, int, int, int);
+	void(*denoise_tile)(KernelGlobals*, float*, float4*, int4, int4, int, int, int, float, float);
+	const char *name;
+
+	CPUKernels()
+	: path_trace_stream(NULL)
+	{
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+		if(system_cpu_support_avx2()) {
+			path_trace = kernel_cpu_avx2_path_trace;
+			adaptive_convergence_check = kernel_cpu_avx2_adaptive_convergence_check;
+			adaptive_post_adjust = kernel_cpu_avx2_adaptive_post_adjust;
+			denoise_tile = kernel_cpu_avx2_denoise_tile;
+			name = "avx2";
+			if(DebugFlags().cpu.ray_stream)
+				path_trace_stream = kernel_cpu_avx2_path_trace_stream;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
+		if(system_cpu_support_avx()) {
+			path_trace = kernel_cpu_avx_path_trace;
+			adaptive_convergence_check = kernel_cpu_avx_adaptive_convergence_check;
+			adaptive_post_adjust = kernel_cpu_avx_adaptive_post_adjust;
+			denoise_tile = kernel_cpu_avx_denoise_tile;
+			name = "avx";
+			if(DebugFlags().cpu.ray_stream)
+				path_trace_stream = kernel_cpu_avx_path_trace_stream;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41
+		if(system_cpu_support_sse41()) {
+			path_trace = kernel_cpu_sse41_path_trace;
+			adaptive_convergence_check = kernel_cpu_sse41_adaptive_convergence_check;
+			adaptive_post_adjust = kernel_cpu_sse41_adaptive_post_adjust;
+			denoise_tile = kernel_cpu_sse41_denoise_tile;
+			name = "sse41";
+			if(DebugFlags().cpu.ray_stream)
+				path_trace_stream = kernel_cpu_sse41_path_trace_stream;
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE3
+		if(system_cpu_support_sse3()) {
+			path_trace = kernel_cpu_sse3_path_trace;
+			adaptive_convergence_check = kernel_cpu_sse3_adaptive_convergence_check;
+			adaptive_post_adjust = kernel_cpu_sse3_adaptive_post_adjust;
+			denoise_tile = kernel_cpu_sse3_denoise_tile;
+			name = "sse3";
+		}
+		else
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE2
+		if(system_cpu_support_sse2()) {
+			path_trace = kernel_cpu_sse2_path_trace;
+			adaptive_convergence_check = kernel_cpu_sse2_adaptive_convergence_check;
+			adaptive_post_adjust = kernel_cpu_sse2_adaptive_post_adjust;
+			denoise_tile = kernel_cpu_sse2_denoise_tile;
+			name = "sse2";
+		}
+		else
+#endif
+		{
+			path_trace = kernel_cpu_path_trace;
+			adaptive_convergence_check = kernel_cpu_adaptive_convergence_check;
+			adaptive_post_adjust = kernel_cpu_adaptive_post_adjust;
+			denoise_tile = kernel_cpu_denoise_tile;
+			name = "default";
+		}
+	}
+};
+
 class CPUDevice : public Device
 {
 public:
 	TaskPool task_pool;
 	KernelGlobals kernel_globals;
+	CPUTileStealing tile_stealing;
 
 #ifdef WITH_OSL
 	OSLGlobals osl_globals;
@@ -124,6 +374,11 @@ public:
 		/* no-op */
 	}
 
+	void mem_copy_to(device_memory& /*mem*/, size_t /*offset*/, size_t /*size*/)
+	{
+		/* no-op */
+	}
+
 	void mem_copy_from(device_memory& /*mem*/,
 	                   int /*y*/, int /*w*/, int /*h*/,
 	                   int /*elem*/)
@@ -215,70 +470,66 @@ public:
 				return;
 		}
 
+		double time_start = time_dt();
+		double time_busy = 0.0;
 		KernelGlobals kg = thread_kernel_globals_init();
 		RenderTile tile;
+		CPUTileStealing::Work *root;
 
-		void(*path_trace_kernel)(KernelGlobals*, float*, unsigned int*, int, int, int, int, int);
+		CPUKernels kernels;
+		const bool use_tile_stealing = DebugFlags().cpu.tile_stealing;
 
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
-		if(system_cpu_support_avx2()) {
-			path_trace_kernel = kernel_cpu_avx2_path_trace;
-		}
-		else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
-		if(system_cpu_support_avx()) {
-			path_trace_kernel = kernel_cpu_avx_path_trace;
+		if(kernels.path_trace_stream) {
+			VLOG(1) << "Tracing camera rays as ray streams.";
 		}
-		else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41
-		if(system_cpu_support_sse41()) {
-			path_trace_kernel = kernel_cpu_sse41_path_trace;
-		}
-		else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE3
-		if(system_cpu_support_sse3()) {
-			path_trace_kernel = kernel_cpu_sse3_path_trace;
-		}
-		else
-#endif
-#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE2
-		if(system_cpu_support_sse2()) {
-			path_trace_kernel = kernel_cpu_sse2_path_trace;
-		}
-		else
-#endif
-		{
-			path_trace_kernel = kernel_cpu_path_trace;
-		}
-		
-		while(task.acquire_tile(this, tile)) {
-			float *render_buffer = (float*)tile.buffer;
-			uint *rng_state = (uint*)tile.rng_state;
-			int start_sample = tile.start_sample;
-			int end_sample = tile.start_sample + tile.num_samples;
-
-			for(int sample = start_sample; sample < end_sample; sample++) {
-				if(task.get_cancel() || task_pool.canceled()) {
-					if(task.need_finish_queue == false)
-						break;
-				}
 
-				for(int y = tile.y; y < tile.y + tile.h; y++) {
-					for(int x = tile.x; x < tile.x + tile.w; x++) {
-						path_trace_kernel(&kg, render_buffer, rng_state,
-						                  sample, x, y, tile.offset, tile.stride);
-					}
+		if(stats.profiler.active())
+			stats.profiler.add_state(&kg.profiler);
+
+		for(;;) {
+			if(task.acquire_tile(this, tile)) {
+				if(tile.task == RenderTile::DENOISE) {
+					double time_denoise = time_dt();
+					thread_denoise_tile(&kg, kernels, task, tile);
+					time_busy += time_dt() - time_denoise;
+
+					task.release_tile(tile);
+					continue;
 				}
 
-				tile.sample = sample + 1;
+				int y = tile.y, h = tile.h;
+				CPUTileStealing::Work work(&tile, NULL);
 
-				task.update_progress(&tile);
+				tile.sample = tile.start_sample;
+
+				double time_render = time_dt();
+				tile_stealing.begin(&work);
+				thread_render_tile(&kg, kernels, task, &work);
+				tile_stealing.end(&work);
+				time_busy += time_dt() - time_render;
+
+				/* Parts stolen from this tile are finished now, restore the
+				 * full tile before it's written. */
+				tile.y = y;
+				tile.h = h;
+
+				task.release_tile(tile);
 			}
+			else if(use_tile_stealing &&
+			        !(task.get_cancel() || task_pool.canceled()) &&
+			        tile_stealing.steal(&tile, &root))
+			{
+				CPUTileStealing::Work work(&tile, root);
 
-			task.release_tile(tile);
+				double time_render = time_dt();
+				tile_stealing.begin(&work);
+				thread_render_tile(&kg, kernels, task, &work);
+				tile_stealing.end(&work);
+				time_busy += time_dt() - time_render;
+			}
+			else {
+				break;
+			}
 
 			if(task_pool.canceled()) {
 				if(task.need_finish_queue == false)
@@ -286,9 +537,166 @@ public:
 			}
 		}
 
+		stats.render_thread_done(kernels.name, time_dt() - time_start, time_busy, kg.num_rays);
+		stats.profiler.remove_state(&kg.profiler);
+
 		thread_kernel_globals_free(&kg);
 	}
 
+	/* Render samples of the tile starting from tile.sample. Parts of the tile
+	 * stolen by other threads are only counted in the progress by the thread
+	 * which acquired the tile. */
+	void thread_render_tile(KernelGlobals *kg,
+	                        const CPUKernels& kernels,
+	                        DeviceTask& task,
+	                        CPUTileStealing::Work *work)
+	{
+		RenderTile& tile = *work->tile;
+		float *render_buffer = (float*)tile.buffer;
+		uint *rng_state = (uint*)tile.rng_state;
+		int start_sample = tile.start_sample;
+		int end_sample = tile.start_sample + tile.num_samples;
+		const bool is_stolen = (work->root != work);
+		const bool use_adaptive_sampling = (task.adaptive_threshold > 0.0f);
+
+		for(int sample = tile.sample; sample < end_sample; sample++) {
+			if(task.get_cancel() || task_pool.canceled()) {
+				if(task.need_finish_queue == false)
+					break;
+			}
+
+			for(int y = tile.y; y < tile.y + tile.h; y++) {
+				if(kernels.path_trace_stream) {
+					for(int x = tile.x; x < tile.x + tile.w; x += RAY_STREAM_SIZE) {
+						int num_pixels = min(RAY_STREAM_SIZE, tile.x + tile.w - x);
+						kernels.path_trace_stream(kg, render_buffer, rng_state,
+						                          sample, x, y, num_pixels, tile.offset, tile.stride);
+					}
+				}
+				else {
+					for(int x = tile.x; x < tile.x + tile.w; x++) {
+						kernels.path_trace(kg, render_buffer, rng_state,
+						                   sample, x, y, tile.offset, tile.stride);
+					}
+				}
+			}
+
+			tile.sample = sample + 1;
+
+			if(use_adaptive_sampling &&
+			   tile.sample - start_sample >= task.adaptive_min_samples &&
+			   (tile.sample - start_sample) % ADAPTIVE_SAMPLING_STEP == 0 &&
+			   tile.sample < end_sample)
+			{
+				if(thread_adaptive_convergence_check(kg, kernels, task, tile)) {
+					/* All pixels of the tile converged, account the
+					 * skipped samples in the progress and finish. */
+					if(!is_stolen)
+						task.update_progress(&tile, end_sample - tile.sample + 1);
+					tile.sample = end_sample;
+					break;
+				}
+			}
+
+			if(!is_stolen)
+				task.update_progress(&tile);
+
+			/* Hand out half of the remaining rows to an idle thread. */
+			tile_stealing.split_if_requested(work, end_sample);
+		}
+
+		if(use_adaptive_sampling && tile.sample == end_sample) {
+			thread_adaptive_post_adjust(kg, kernels, tile);
+		}
+	}
+
+	bool thread_adaptive_convergence_check(KernelGlobals *kg,
+	                                       const CPUKernels& kernels,
+	                                       DeviceTask& task,
+	                                       RenderTile& tile)
+	{
+		bool all_converged = true;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				all_converged &= kernels.adaptive_convergence_check(kg, (float*)tile.buffer,
+				                                                    task.adaptive_threshold,
+				                                                    x, y, tile.offset, tile.stride);
+			}
+		}
+
+		return all_converged;
+	}
+
+	void thread_adaptive_post_adjust(KernelGlobals *kg,
+	                                 const CPUKernels& kernels,
+	                                 RenderTile& tile)
+	{
+		float num_samples = (float)tile.num_samples;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				kernels.adaptive_post_adjust(kg, (float*)tile.buffer, num_samples,
+				                             x, y, tile.offset, tile.stride);
+			}
+		}
+	}
+
+	void thread_denoise_tile(KernelGlobals *kg,
+	                         const CPUKernels& kernels,
+	                         DeviceTask& task,
+	                         RenderTile& tile)
+	{
+		RenderTile neighbors[9];
+		task.map_neighbor_tiles(tile, neighbors);
+
+		/* Copy the noisy tile and the borders of its neighbors the filter
+		 * reads into one buffer, so pixels along tile borders see the same
+		 * neighbors as in an untiled image. */
+		int pass_stride = kg->__data.film.pass_stride;
+		int overlap = task.denoising_radius + DENOISE_PATCH_RADIUS;
+		int x0 = tile.x - (neighbors[3].buffers? min(overlap, neighbors[3].w): 0);
+		int y0 = tile.y - (neighbors[1].buffers? min(overlap, neighbors[1].h): 0);
+		int x1 = tile.x + tile.w + (neighbors[5].buffers? min(overlap, neighbors[5].w): 0);
+		int y1 = tile.y + tile.h + (neighbors[7].buffers? min(overlap, neighbors[7].h): 0);
+		int width = x1 - x0;
+		vector<float> pixels(width*(y1 - y0)*pass_stride);
+
+		for(int i = 0; i < 9; i++) {
+			RenderTile& ntile = neighbors[i];
+
+			if(!ntile.buffers)
+				continue;
+
+			int nx0 = max(ntile.x, x0), nx1 = min(ntile.x + ntile.w, x1);
+			int ny0 = max(ntile.y, y0), ny1 = min(ntile.y + ntile.h, y1);
+
+			for(int y = ny0; y < ny1; y++) {
+				float *from = (float*)ntile.buffer + (ntile.offset + nx0 + y*ntile.stride)*pass_stride;
+				memcpy(&pixels[((y - y0)*width + nx0 - x0)*pass_stride], from,
+				       sizeof(float)*(nx1 - nx0)*pass_stride);
+			}
+		}
+
+		tile.sample = tile.start_sample + tile.num_samples;
+		vector<float4> temp(tile.w*tile.h);
+
+		kernels.denoise_tile(kg, &pixels[0], &temp[0],
+		                     make_int4(tile.x, tile.y, tile.x + tile.w, tile.y + tile.h),
+		                     make_int4(x0, y0, x1, y1),
+		                     -(x0 + y0*width), width,
+		                     task.denoising_radius, task.denoising_strength,
+		                     1.0f/tile.sample);
+
+		/* The tile gets its own buffer for the result, the noisy pixels are
+		 * still read by neighbors denoised later. */
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			float *to = (float*)tile.buffer + (tile.offset + tile.x + y*tile.stride)*pass_stride;
+			memcpy(to, &pixels[((y - y0)*width + tile.x - x0)*pass_stride],
+			       sizeof(float)*tile.w*pass_stride);
+		}
+	}
+
 	void thread_film_convert(DeviceTask& task)
 	{
 		float sample_scale = 1.0f/(task.sample + 1);
@@ -488,6 +896,7 @@ protected:
 			kg.decoupled_volume_steps[i] = NULL;
 		}
 		kg.decoupled_volume_steps_index = 0;
+		kg.num_rays = 0;
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
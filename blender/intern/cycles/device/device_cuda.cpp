@@ -476,6 +476,18 @@ public:
 		cuda_pop_context();
 	}
 
+	void mem_copy_to(device_memory& mem, size_t offset, size_t size)
+	{
+		assert(offset + size <= mem.memory_size());
+
+		cuda_push_context();
+		if(mem.device_pointer) {
+			cuda_assert(cuMemcpyHtoD((CUdeviceptr)(mem.device_pointer + offset),
+			                         (uchar*)mem.data_pointer + offset, size));
+		}
+		cuda_pop_context();
+	}
+
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 	{
 		size_t offset = elem*y*w;
@@ -20,13 +20,15 @@
 CCL_NAMESPACE_BEGIN
 
 class Device;
+class NetworkTileStealing;
 
 Device *device_cpu_create(DeviceInfo& info, Stats &stats, bool background);
 bool device_opencl_init(void);
 Device *device_opencl_create(DeviceInfo& info, Stats &stats, bool background);
 bool device_cuda_init(void);
 Device *device_cuda_create(DeviceInfo& info, Stats &stats, bool background);
-Device *device_network_create(DeviceInfo& info, Stats &stats, const char *address);
+Device *device_network_create(DeviceInfo& info, Stats &stats, const char *address,
+                              NetworkTileStealing *tile_stealing = NULL);
 Device *device_multi_create(DeviceInfo& info, Stats &stats, bool background);
 
 void device_cpu_info(vector<DeviceInfo>& devices);
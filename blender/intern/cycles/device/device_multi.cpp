@@ -35,11 +35,12 @@ class MultiDevice : public Device
 {
 public:
 	struct SubDevice {
-		explicit SubDevice(Device *device_)
-		: device(device_) {}
+		explicit SubDevice(Device *device_, bool network_ = false)
+		: device(device_), network(network_) {}
 
 		Device *device;
 		map<device_ptr, device_ptr> ptr_map;
+		bool network;
 	};
 
 	list<SubDevice> devices;
@@ -51,6 +52,10 @@ public:
 		Device *device;
 
 		foreach(DeviceInfo& subinfo, info.multi_devices) {
+			/* servers are discovered below */
+			if(subinfo.type == DEVICE_NETWORK)
+				continue;
+
 			device = Device::create(subinfo, sub_stats_, background);
 			devices.push_back(SubDevice(device));
 		}
@@ -63,9 +68,9 @@ public:
 		vector<string> servers = discovery.get_server_list();
 
 		foreach(string& server, servers) {
-			device = device_network_create(info, stats, server.c_str());
+			device = device_network_create(info, stats, server.c_str(), &network_tile_stealing);
 			if(device)
-				devices.push_back(SubDevice(device));
+				devices.push_back(SubDevice(device, true));
 		}
 #endif
 	}
@@ -122,6 +127,18 @@ public:
 		mem.device_pointer = tmp;
 	}
 
+	void mem_copy_to(device_memory& mem, size_t offset, size_t size)
+	{
+		device_ptr tmp = mem.device_pointer;
+
+		foreach(SubDevice& sub, devices) {
+			mem.device_pointer = sub.ptr_map[tmp];
+			sub.device->mem_copy_to(mem, offset, size);
+		}
+
+		mem.device_pointer = tmp;
+	}
+
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 	{
 		device_ptr tmp = mem.device_pointer;
@@ -331,8 +348,24 @@ public:
 
 	void task_wait()
 	{
-		foreach(SubDevice& sub, devices)
-			sub.device->task_wait();
+		/* Network devices only hand out tiles to their server while waiting,
+		 * wait for them at the same time so all servers keep rendering. */
+		vector<thread*> network_threads;
+
+		foreach(SubDevice& sub, devices) {
+			if(sub.network)
+				network_threads.push_back(new thread(function_bind(&Device::task_wait, sub.device)));
+		}
+
+		foreach(SubDevice& sub, devices) {
+			if(!sub.network)
+				sub.device->task_wait();
+		}
+
+		foreach(thread *network_thread, network_threads) {
+			network_thread->join();
+			delete network_thread;
+		}
 	}
 
 	void task_cancel()
@@ -343,6 +376,11 @@ public:
 
 protected:
 	Stats sub_stats_;
+
+#ifdef WITH_NETWORK
+	/* Tiles of network devices are split between their servers. */
+	NetworkTileStealing network_tile_stealing;
+#endif
 };
 
 Device *device_multi_create(DeviceInfo& info, Stats &stats, bool background)
@@ -463,6 +501,21 @@ void device_multi_info(vector<DeviceInfo>& devices)
 		device_multi_add(devices, DEVICE_OPENCL, false, false, "OPENCL_MULTI_%d", num++);
 	if(!device_multi_add(devices, DEVICE_OPENCL, true, true, "OPENCL_MULTI_%d", num++))
 		device_multi_add(devices, DEVICE_OPENCL, true, false, "OPENCL_MULTI_%d", num++);
+
+#ifdef WITH_NETWORK
+	/* render on the servers found on the network only */
+	DeviceInfo info;
+
+	info.type = DEVICE_MULTI;
+	info.description = "Network Servers";
+	info.id = "NETWORK_MULTI";
+	info.num = 0;
+	info.advanced_shading = true;
+	info.pack_images = false;
+	device_network_info(info.multi_devices);
+
+	devices.push_back(info);
+#endif
 }
 
 CCL_NAMESPACE_END
@@ -18,8 +18,10 @@
 #include "device_intern.h"
 #include "device_network.h"
 
+#include "util_algorithm.h"
 #include "util_foreach.h"
 #include "util_logging.h"
+#include "util_set.h"
 
 #if defined(WITH_NETWORK)
 
@@ -29,16 +31,207 @@ typedef map<device_ptr, device_ptr> PtrMap;
 typedef vector<uint8_t> DataVector;
 typedef map<device_ptr, DataVector> DataMap;
 
-/* tile list */
-typedef vector<RenderTile> TileList;
+/* rows of a tile, as first row and number of rows */
+typedef pair<int, int> RowSpan;
+typedef vector<RowSpan> RowSpanList;
 
-/* search a list of tiles and find the one that matches the passed render tile */
-static TileList::iterator tile_list_find(TileList& tile_list, RenderTile& tile)
+/* byte offset of the first pixel of a tile row in its render buffer */
+static size_t tile_row_offset(const RenderTile& tile, int y, size_t pixel_size)
 {
-	for(TileList::iterator it = tile_list.begin(); it != tile_list.end(); ++it)
-		if(tile.x == it->x && tile.y == it->y && tile.start_sample == it->start_sample)
-			return it;
-	return tile_list.end();
+	return (size_t)(tile.offset + tile.x + y*tile.stride) * pixel_size;
+}
+
+static bool tile_match(const RenderTile& a, const RenderTile& b)
+{
+	return a.x == b.x && a.y == b.y && a.start_sample == b.start_sample;
+}
+
+/* Tile Stealing */
+
+NetworkTileStealing::Work::Work(Device *device_, const RenderTile& tile_, Work *root_)
+: device(device_), tile(tile_), full_tile(tile_), root(root_ ? root_ : this),
+  num_stolen(0), released(false), request(NULL)
+{
+	/* Only tiles with their own buffers are split, the thief has to
+	 * allocate matching buffers on its own server. */
+	BufferParams& params = tile.buffers->params;
+	stealable = (params.full_x == tile.x && params.full_y == tile.y &&
+	             params.width == tile.w && params.height == tile.h);
+}
+
+NetworkTileStealing::Work *NetworkTileStealing::begin(Device *device, const RenderTile& tile, Work *root)
+{
+	thread_scoped_lock lock(mutex);
+
+	Work *work = new Work(device, tile, root);
+	if(root)
+		work->stealable = root->stealable;
+
+	works.push_back(work);
+	return work;
+}
+
+NetworkTileStealing::Work *NetworkTileStealing::find(Device *device, const RenderTile& tile)
+{
+	thread_scoped_lock lock(mutex);
+
+	foreach(Work *work, works)
+		if(work->device == device && tile_match(work->full_tile, tile))
+			return work;
+
+	return NULL;
+}
+
+int NetworkTileStealing::split_if_requested(Work *work, const RenderTile& tile)
+{
+	thread_scoped_lock lock(mutex);
+
+	work->tile.y = tile.y;
+	work->tile.h = tile.h;
+	work->tile.sample = tile.sample;
+
+	Request *request = work->request;
+
+	if(request == NULL)
+		return tile.h;
+
+	work->request = NULL;
+
+	if(!splittable(work)) {
+		answer(request, false);
+		return tile.h;
+	}
+
+	int h = tile.h/2;
+
+	request->tile = work->tile;
+	request->tile.y = tile.y + h;
+	request->tile.h = tile.h - h;
+	request->tile.start_sample = tile.sample;
+	request->tile.num_samples = work->full_tile.start_sample + work->full_tile.num_samples - tile.sample;
+	request->tile.sample = tile.sample;
+	request->root = work->root;
+
+	work->tile.h = h;
+	work->root->num_stolen++;
+	answer(request, true);
+
+	return h;
+}
+
+bool NetworkTileStealing::steal(Device *thief, RenderTile *tile, Work **root)
+{
+	thread_scoped_lock lock(mutex);
+
+	/* Devices waiting for a steal can't answer requests themselves, so
+	 * they never become victims. This also avoids waiting in circles. */
+	stealing.insert(thief);
+
+	foreach(Work *work, works) {
+		if(work->device == thief && work->request) {
+			answer(work->request, false);
+			work->request = NULL;
+		}
+	}
+
+	bool result = false;
+
+	for(;;) {
+		Work *victim = NULL;
+		int64_t victim_work = 0;
+
+		foreach(Work *work, works) {
+			if(work->device == thief || stealing.count(work->device))
+				continue;
+			if(work->request || !splittable(work))
+				continue;
+
+			int end_sample = work->full_tile.start_sample + work->full_tile.num_samples;
+			int64_t remaining_work = (int64_t)work->tile.w * work->tile.h *
+			                         (end_sample - work->tile.sample);
+			if(remaining_work > victim_work) {
+				victim = work;
+				victim_work = remaining_work;
+			}
+		}
+
+		if(victim == NULL)
+			break;
+
+		Request request;
+		request.answered = false;
+		request.granted = false;
+		victim->request = &request;
+
+		while(!request.answered)
+			cond.wait(lock);
+
+		if(request.granted) {
+			*tile = request.tile;
+			*root = request.root;
+			result = true;
+			break;
+		}
+	}
+
+	stealing.erase(thief);
+	return result;
+}
+
+bool NetworkTileStealing::end(Work *work, RenderTile *release_tile)
+{
+	thread_scoped_lock lock(mutex);
+
+	works.remove(work);
+	if(work->request) {
+		answer(work->request, false);
+		work->request = NULL;
+	}
+
+	Work *root = work->root;
+
+	if(root != work) {
+		root->num_stolen--;
+		delete work;
+	}
+	else {
+		root->released = true;
+	}
+
+	if(root->released && root->num_stolen == 0) {
+		*release_tile = root->full_tile;
+		delete root;
+		return true;
+	}
+
+	return false;
+}
+
+void NetworkTileStealing::cancel(Device *device)
+{
+	thread_scoped_lock lock(mutex);
+
+	foreach(Work *work, works) {
+		if(work->device == device && work->request) {
+			answer(work->request, false);
+			work->request = NULL;
+		}
+	}
+
+	stealing.erase(device);
+}
+
+bool NetworkTileStealing::splittable(const Work *work)
+{
+	int end_sample = work->full_tile.start_sample + work->full_tile.num_samples;
+	return work->stealable && work->tile.h >= 2*MIN_ROWS && end_sample - work->tile.sample >= 2;
+}
+
+void NetworkTileStealing::answer(Request *request, bool granted)
+{
+	request->granted = granted;
+	request->answered = true;
+	cond.notify_all();
 }
 
 class NetworkDevice : public Device
@@ -51,15 +244,39 @@ public:
 
 	thread_mutex rpc_lock;
 
-	NetworkDevice(DeviceInfo& info, Stats &stats, const char *address)
+	/* Buffers the server pushes pixels for, their host memory is up to date
+	 * and doesn't need to be copied back. Protected by rpc_lock. */
+	set<device_ptr> pushed_buffers;
+
+	/* Compress scene data sent to the server. */
+	bool use_compression;
+
+	/* Shared with the other network devices of a multi device. */
+	NetworkTileStealing *tile_stealing;
+	NetworkTileStealing own_tile_stealing;
+
+	NetworkDevice(DeviceInfo& info, Stats &stats, const char *address, NetworkTileStealing *tile_stealing_)
 	: Device(info, stats, true), socket(io_service)
 	{
+		tile_stealing = (tile_stealing_)? tile_stealing_: &own_tile_stealing;
+
 		error_func = NetworkError();
+
+		/* address may be followed by a port */
+		string host = address;
 		stringstream portstr;
-		portstr << SERVER_PORT;
+		size_t port_pos = host.rfind(':');
+
+		if(port_pos != string::npos) {
+			portstr << host.substr(port_pos + 1);
+			host = host.substr(0, port_pos);
+		}
+		else {
+			portstr << SERVER_PORT;
+		}
 
 		tcp::resolver resolver(io_service);
-		tcp::resolver::query query(address, portstr.str());
+		tcp::resolver::query query(host, portstr.str());
 		tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
 		tcp::resolver::iterator end;
 
@@ -73,7 +290,13 @@ public:
 		if(error)
 			error_func.network_error(error.message());
 
+		/* calls are small and latency bound */
+		if(!error)
+			socket.set_option(tcp::no_delay(true));
+
 		mem_counter = 0;
+
+		use_compression = (getenv("CYCLES_NETWORK_COMPRESSION") != NULL);
 	}
 
 	~NetworkDevice()
@@ -102,15 +325,29 @@ public:
 		RPCSend snd(socket, &error_func, "mem_copy_to");
 
 		snd.add(mem);
-		snd.write();
-		snd.write_buffer((void*)mem.data_pointer, mem.memory_size());
+		snd.add_buffer((void*)mem.data_pointer, mem.memory_size());
+		snd.write(use_compression);
+	}
+
+	void mem_copy_to(device_memory& mem, size_t offset, size_t size)
+	{
+		thread_scoped_lock lock(rpc_lock);
+
+		RPCSend snd(socket, &error_func, "mem_copy_to_range");
+
+		snd.add(mem);
+		snd.add(offset);
+		snd.add(size);
+		snd.add_buffer((uint8_t*)mem.data_pointer + offset, size);
+		snd.write(use_compression);
 	}
 
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 	{
 		thread_scoped_lock lock(rpc_lock);
 
-		size_t data_size = mem.memory_size();
+		if(pushed_buffers.count(mem.device_pointer))
+			return;
 
 		RPCSend snd(socket, &error_func, "mem_copy_from");
 
@@ -121,14 +358,21 @@ public:
 		snd.add(elem);
 		snd.write();
 
+		/* only the requested rows are sent, other devices of a multi device
+		 * may fill in the rest */
+		size_t offset = (size_t)y*w*elem;
+		size_t size = (size_t)w*h*elem;
+
 		RPCReceive rcv(socket, &error_func);
-		rcv.read_buffer((void*)mem.data_pointer, data_size);
+		rcv.read_buffer((uint8_t*)mem.data_pointer + offset, size);
 	}
 
 	void mem_zero(device_memory& mem)
 	{
 		thread_scoped_lock lock(rpc_lock);
 
+		pushed_buffers.erase(mem.device_pointer);
+
 		RPCSend snd(socket, &error_func, "mem_zero");
 
 		snd.add(mem);
@@ -140,6 +384,8 @@ public:
 		if(mem.device_pointer) {
 			thread_scoped_lock lock(rpc_lock);
 
+			pushed_buffers.erase(mem.device_pointer);
+
 			RPCSend snd(socket, &error_func, "mem_free");
 
 			snd.add(mem);
@@ -159,8 +405,8 @@ public:
 
 		snd.add(name_string);
 		snd.add(size);
-		snd.write();
-		snd.write_buffer(host, size);
+		snd.add_buffer(host, size);
+		snd.write(use_compression);
 	}
 
 	void tex_alloc(const char *name,
@@ -184,8 +430,8 @@ public:
 		snd.add(mem);
 		snd.add(interpolation);
 		snd.add(extension);
-		snd.write();
-		snd.write_buffer((void*)mem.data_pointer, mem.memory_size());
+		snd.add_buffer((void*)mem.data_pointer, mem.memory_size());
+		snd.write(use_compression);
 	}
 
 	void tex_free(device_memory& mem)
@@ -243,8 +489,6 @@ public:
 
 		lock.unlock();
 
-		TileList the_tiles;
-
 		/* todo: run this threaded for connecting to multiple clients */
 		for(;;) {
 			if(error_func.have_error())
@@ -258,36 +502,122 @@ public:
 			if(rcv.name == "acquire_tile") {
 				lock.unlock();
 
+				NetworkTileStealing::Work *work = NULL;
+				NetworkTileStealing::Work *root = NULL;
+				RenderBuffers *stolen_buffers = NULL;
+
 				/* todo: watch out for recursive calls! */
 				if(the_task.acquire_tile(this, tile)) { /* write return as bool */
-					the_tiles.push_back(tile);
+					work = tile_stealing->begin(this, tile, NULL);
+				}
+				else if(!the_task.get_cancel() &&
+				        tile_stealing->steal(this, &tile, &root))
+				{
+					/* The stolen rows get buffers on this server, they are
+					 * filled with the pixels rendered so far. */
+					BufferParams buffer_params = root->full_tile.buffers->params;
+					buffer_params.full_x = tile.x;
+					buffer_params.full_y = tile.y;
+					buffer_params.width = tile.w;
+					buffer_params.height = tile.h;
+
+					stolen_buffers = new RenderBuffers(this);
+					stolen_buffers->reset(this, buffer_params);
+
+					buffer_params.get_offset_stride(tile.offset, tile.stride);
+					tile.buffer = stolen_buffers->buffer.device_pointer;
+					tile.rng_state = stolen_buffers->rng_state.device_pointer;
+					tile.buffers = stolen_buffers;
+
+					work = tile_stealing->begin(this, tile, root);
+
+					VLOG(1) << "Stole " << tile.h << " rows of tile at "
+					        << tile.x << ", " << root->full_tile.y
+					        << " from sample " << tile.sample << ".";
+				}
+
+				lock.lock();
+				if(work) {
+					RenderTile& root_tile = work->root->full_tile;
+					int pass_stride = root_tile.buffers->params.get_passes_size();
+					size_t pixel_size = pass_stride*sizeof(float);
+					bool with_pixels = (stolen_buffers != NULL);
 
-					lock.lock();
 					RPCSend snd(socket, &error_func, "acquire_tile");
 					snd.add(tile);
+					snd.add(pass_stride);
+					snd.add(with_pixels);
+
+					if(with_pixels) {
+						uint8_t *pixels = (uint8_t*)root_tile.buffers->buffer.data_pointer;
+
+						if(root_tile.stride == root_tile.w) {
+							snd.add_buffer(pixels + tile_row_offset(root_tile, tile.y, pixel_size),
+							               tile.h*tile.w*pixel_size);
+						}
+						else {
+							for(int y = tile.y; y < tile.y + tile.h; y++)
+								snd.add_buffer(pixels + tile_row_offset(root_tile, y, pixel_size),
+								               tile.w*pixel_size);
+						}
+					}
+
 					snd.write();
-					lock.unlock();
 				}
 				else {
-					lock.lock();
 					RPCSend snd(socket, &error_func, "acquire_tile_none");
 					snd.write();
-					lock.unlock();
 				}
+				lock.unlock();
 			}
-			else if(rcv.name == "release_tile") {
+			else if(rcv.name == "update_tile") {
 				rcv.read(tile);
+
+				NetworkTileStealing::Work *work = tile_stealing->find(this, tile);
+				int keep_rows = tile.h;
+
+				if(work) {
+					read_tile_pixels(rcv, work);
+
+					keep_rows = tile_stealing->split_if_requested(work, tile);
+				}
+
+				RPCSend snd(socket, &error_func, "update_tile");
+				snd.add(keep_rows);
+				snd.write();
 				lock.unlock();
 
-				TileList::iterator it = tile_list_find(the_tiles, tile);
-				if(it != the_tiles.end()) {
-					tile.buffers = it->buffers;
-					the_tiles.erase(it);
+				if(work && the_task.update_tile_sample) {
+					RenderTile update_tile = work->root->full_tile;
+					update_tile.sample = tile.sample;
+					the_task.update_tile_sample(update_tile);
 				}
+			}
+			else if(rcv.name == "release_tile") {
+				rcv.read(tile);
+
+				NetworkTileStealing::Work *work = tile_stealing->find(this, tile);
+
+				if(work)
+					read_tile_pixels(rcv, work);
+
+				lock.unlock();
+
+				assert(work != NULL);
+
+				if(work) {
+					RenderBuffers *stolen_buffers = NULL;
+					RenderTile release_tile;
+
+					if(work->root != work)
+						stolen_buffers = work->full_tile.buffers;
 
-				assert(tile.buffers != NULL);
+					if(tile_stealing->end(work, &release_tile))
+						the_task.release_tile(release_tile);
 
-				the_task.release_tile(tile);
+					/* frees the buffers while the server still listens */
+					delete stolen_buffers;
+				}
 
 				lock.lock();
 				RPCSend snd(socket, &error_func, "release_tile");
@@ -301,6 +631,8 @@ public:
 			else
 				lock.unlock();
 		}
+
+		tile_stealing->cancel(this);
 	}
 
 	void task_cancel()
@@ -316,12 +648,46 @@ public:
 	}
 
 private:
+	/* Read pixels the server pushes for a tile into the host memory of the
+	 * render buffers the tile was acquired with. Must be called with the rpc
+	 * lock held. */
+	void read_tile_pixels(RPCReceive& rcv, NetworkTileStealing::Work *work)
+	{
+		RenderTile& root_tile = work->root->full_tile;
+		size_t pixel_size = root_tile.buffers->params.get_passes_size()*sizeof(float);
+		uint8_t *pixels = (uint8_t*)root_tile.buffers->buffer.data_pointer;
+		int num_spans;
+
+		rcv.read(num_spans);
+
+		for(int i = 0; i < num_spans; i++) {
+			RowSpan span;
+			rcv.read(span.first);
+			rcv.read(span.second);
+
+			if(root_tile.stride == root_tile.w) {
+				/* rows are contiguous */
+				rcv.read_buffer(pixels + tile_row_offset(root_tile, span.first, pixel_size),
+				                span.second*root_tile.w*pixel_size);
+			}
+			else {
+				for(int y = span.first; y < span.first + span.second; y++) {
+					rcv.read_buffer(pixels + tile_row_offset(root_tile, y, pixel_size),
+					                root_tile.w*pixel_size);
+				}
+			}
+		}
+
+		pushed_buffers.insert(work->full_tile.buffer);
+	}
+
 	NetworkError error_func;
 };
 
-Device *device_network_create(DeviceInfo& info, Stats &stats, const char *address)
+Device *device_network_create(DeviceInfo& info, Stats &stats, const char *address,
+                              NetworkTileStealing *tile_stealing)
 {
-	return new NetworkDevice(info, stats, address);
+	return new NetworkDevice(info, stats, address, tile_stealing);
 }
 
 void device_network_info(vector<DeviceInfo>& devices)
@@ -366,6 +732,22 @@ public:
 	}
 
 protected:
+	/* Tiles being rendered, with device pointers of this server. */
+	struct ActiveTile {
+		RenderTile tile;
+		int pass_stride;
+		/* rows taken over by other servers */
+		RowSpanList given;
+	};
+
+	/* Answers of the client to acquire, update and release calls. */
+	struct AcquireEntry {
+		string name;
+		RenderTile tile;
+		int pass_stride;
+		int keep_rows;
+	};
+
 	void listen_step()
 	{
 		thread_scoped_lock lock(rpc_lock);
@@ -375,6 +757,9 @@ protected:
 			stop = true;
 		else
 			process(rcv, lock);
+
+		/* wake up threads waiting for answers of the client */
+		acquire_cond.notify_all();
 	}
 
 	/* create a memory buffer for a device buffer and insert it into mem_data */
@@ -485,7 +870,6 @@ protected:
 			network_device_memory mem;
 
 			rcv.read(mem);
-			lock.unlock();
 
 			device_ptr client_pointer = mem.device_pointer;
 
@@ -498,6 +882,7 @@ protected:
 
 			/* copy data from network into memory buffer */
 			rcv.read_buffer((uint8_t*)mem.data_pointer, data_size);
+			lock.unlock();
 
 			/* translate the client pointer to a real device pointer */
 			mem.device_pointer = device_ptr_from_client_pointer(client_pointer);
@@ -505,6 +890,30 @@ protected:
 			/* copy the data from the memory buffer to the device buffer */
 			device->mem_copy_to(mem);
 		}
+		else if(rcv.name == "mem_copy_to_range") {
+			network_device_memory mem;
+			size_t offset, size;
+
+			rcv.read(mem);
+			rcv.read(offset);
+			rcv.read(size);
+
+			device_ptr client_pointer = mem.device_pointer;
+
+			DataVector &data_v = data_vector_find(client_pointer);
+
+			assert(offset + size <= data_v.size());
+
+			mem.data_pointer = (device_ptr)&data_v[0];
+
+			/* only the range is sent, the rest of the buffer is unchanged */
+			rcv.read_buffer((uint8_t*)mem.data_pointer + offset, size);
+			lock.unlock();
+
+			mem.device_pointer = device_ptr_from_client_pointer(client_pointer);
+
+			device->mem_copy_to(mem, offset, size);
+		}
 		else if(rcv.name == "mem_copy_from") {
 			network_device_memory mem;
 			int y, w, h, elem;
@@ -524,11 +933,12 @@ protected:
 
 			device->mem_copy_from(mem, y, w, h, elem);
 
-			size_t data_size = mem.memory_size();
+			size_t offset = (size_t)y*w*elem;
+			size_t size = (size_t)w*h*elem;
 
 			RPCSend snd(socket, &error_func, "mem_copy_from");
+			snd.add_buffer((uint8_t*)mem.data_pointer + offset, size);
 			snd.write();
-			snd.write_buffer((uint8_t*)mem.data_pointer, data_size);
 			lock.unlock();
 		}
 		else if(rcv.name == "mem_zero") {
@@ -555,6 +965,8 @@ protected:
 
 			client_pointer = mem.device_pointer;
 
+			/* size the device counted when allocating */
+			mem.device_size = data_vector_find(client_pointer).size();
 			mem.device_pointer = device_ptr_from_client_pointer_erase(client_pointer);
 
 			device->mem_free(mem);
@@ -583,7 +995,6 @@ protected:
 			rcv.read(mem);
 			rcv.read(interpolation);
 			rcv.read(extension_type);
-			lock.unlock();
 
 			client_pointer = mem.device_pointer;
 
@@ -597,6 +1008,7 @@ protected:
 				mem.data_pointer = 0;
 
 			rcv.read_buffer((uint8_t*)mem.data_pointer, data_size);
+			lock.unlock();
 
 			device->tex_alloc(name.c_str(), mem, interpolation, extension_type);
 
@@ -611,6 +1023,8 @@ protected:
 
 			client_pointer = mem.device_pointer;
 
+			/* size the device counted when allocating */
+			mem.device_size = data_vector_find(client_pointer).size();
 			mem.device_pointer = device_ptr_from_client_pointer_erase(client_pointer);
 
 			device->tex_free(mem);
@@ -663,13 +1077,15 @@ protected:
 			device->task_add(task);
 		}
 		else if(rcv.name == "task_wait") {
+			/* from now on threads waiting for answers receive calls themselves */
+			blocked_waiting = true;
 			lock.unlock();
+			acquire_cond.notify_all();
 
-			blocked_waiting = true;
 			device->task_wait();
-			blocked_waiting = false;
 
 			lock.lock();
+			blocked_waiting = false;
 			RPCSend snd(socket, &error_func, "task_wait_done");
 			snd.write();
 			lock.unlock();
@@ -680,8 +1096,18 @@ protected:
 		}
 		else if(rcv.name == "acquire_tile") {
 			AcquireEntry entry;
+			bool with_pixels;
+
 			entry.name = rcv.name;
 			rcv.read(entry.tile);
+			rcv.read(entry.pass_stride);
+			rcv.read(with_pixels);
+
+			/* rows stolen from another server come with the pixels rendered
+			 * so far */
+			if(with_pixels)
+				tile_pixels_read(rcv, entry.tile, entry.pass_stride);
+
 			acquire_queue.push_back(entry);
 			lock.unlock();
 		}
@@ -691,6 +1117,13 @@ protected:
 			acquire_queue.push_back(entry);
 			lock.unlock();
 		}
+		else if(rcv.name == "update_tile") {
+			AcquireEntry entry;
+			entry.name = rcv.name;
+			rcv.read(entry.keep_rows);
+			acquire_queue.push_back(entry);
+			lock.unlock();
+		}
 		else if(rcv.name == "release_tile") {
 			AcquireEntry entry;
 			entry.name = rcv.name;
@@ -712,34 +1145,30 @@ protected:
 		RPCSend snd(socket, &error_func, "acquire_tile");
 		snd.write();
 
-		do {
-			if(blocked_waiting)
-				listen_step();
-
-			/* todo: avoid busy wait loop */
-			thread_scoped_lock lock(rpc_lock);
+		AcquireEntry entry;
 
-			if(!acquire_queue.empty()) {
-				AcquireEntry entry = acquire_queue.front();
-				acquire_queue.pop_front();
+		while(acquire_queue_pop(entry)) {
+			if(entry.name == "acquire_tile") {
+				tile = entry.tile;
 
-				if(entry.name == "acquire_tile") {
-					tile = entry.tile;
+				if(tile.buffer) tile.buffer = ptr_map[tile.buffer];
+				if(tile.rng_state) tile.rng_state = ptr_map[tile.rng_state];
 
-					if(tile.buffer) tile.buffer = ptr_map[tile.buffer];
-					if(tile.rng_state) tile.rng_state = ptr_map[tile.rng_state];
+				ActiveTile active;
+				active.tile = tile;
+				active.pass_stride = entry.pass_stride;
+				active_tiles.push_back(active);
 
-					result = true;
-					break;
-				}
-				else if(entry.name == "acquire_tile_none") {
-					break;
-				}
-				else {
-					cout << "Error: unexpected acquire RPC receive call \"" + entry.name + "\"\n";
-				}
+				result = true;
+				break;
+			}
+			else if(entry.name == "acquire_tile_none") {
+				break;
+			}
+			else {
+				cout << "Error: unexpected acquire RPC receive call \"" + entry.name + "\"\n";
 			}
-		} while(acquire_queue.empty() && !stop && !have_error());
+		}
 
 		return result;
 	}
@@ -749,15 +1178,54 @@ protected:
 		; /* skip */
 	}
 
-	void task_update_tile_sample(RenderTile&)
+	/* Push the pixels of the tile to the client, which may answer by taking
+	 * away rows for another server. */
+	void task_update_tile_sample(RenderTile& tile)
 	{
-		; /* skip */
+		thread_scoped_lock acquire_lock(acquire_mutex);
+
+		list<ActiveTile>::iterator active = active_tile_find(tile);
+		if(active == active_tiles.end())
+			return;
+
+		RenderTile client_tile = tile;
+
+		if(client_tile.buffer) client_tile.buffer = ptr_imap[client_tile.buffer];
+		if(client_tile.rng_state) client_tile.rng_state = ptr_imap[client_tile.rng_state];
+
+		{
+			thread_scoped_lock lock(rpc_lock);
+			RPCSend snd(socket, &error_func, "update_tile");
+			snd.add(client_tile);
+			tile_pixels_add(snd, *active);
+			snd.write();
+			lock.unlock();
+		}
+
+		AcquireEntry entry;
+
+		while(acquire_queue_pop(entry)) {
+			if(entry.name == "update_tile") {
+				if(entry.keep_rows < tile.h) {
+					/* rows are taken over by another server */
+					active->given.push_back(RowSpan(tile.y + entry.keep_rows,
+					                                tile.h - entry.keep_rows));
+					tile.h = entry.keep_rows;
+				}
+				break;
+			}
+			else {
+				cout << "Error: unexpected update RPC receive call \"" + entry.name + "\"\n";
+			}
+		}
 	}
 
 	void task_release_tile(RenderTile& tile)
 	{
 		thread_scoped_lock acquire_lock(acquire_mutex);
 
+		list<ActiveTile>::iterator active = active_tile_find(tile);
+
 		if(tile.buffer) tile.buffer = ptr_imap[tile.buffer];
 		if(tile.rng_state) tile.rng_state = ptr_imap[tile.rng_state];
 
@@ -765,30 +1233,55 @@ protected:
 			thread_scoped_lock lock(rpc_lock);
 			RPCSend snd(socket, &error_func, "release_tile");
 			snd.add(tile);
+			if(active != active_tiles.end()) {
+				tile_pixels_add(snd, *active);
+			}
+			else {
+				int num_spans = 0;
+				snd.add(num_spans);
+			}
 			snd.write();
 			lock.unlock();
 		}
 
-		do {
+		if(active != active_tiles.end())
+			active_tiles.erase(active);
+
+		AcquireEntry entry;
+
+		while(acquire_queue_pop(entry)) {
+			if(entry.name == "release_tile") {
+				break;
+			}
+			else {
+				cout << "Error: unexpected release RPC receive call \"" + entry.name + "\"\n";
+			}
+		}
+	}
+
+	/* Wait for the next answer of the client to an acquire, update or release
+	 * call. While the listening thread is blocked in the device task, the
+	 * caller receives calls itself. Returns false once the connection stops. */
+	bool acquire_queue_pop(AcquireEntry& entry)
+	{
+		for(;;) {
 			if(blocked_waiting)
 				listen_step();
 
-			/* todo: avoid busy wait loop */
 			thread_scoped_lock lock(rpc_lock);
 
+			while(acquire_queue.empty() && !blocked_waiting && !stop && !have_error())
+				acquire_cond.wait(lock);
+
 			if(!acquire_queue.empty()) {
-				AcquireEntry entry = acquire_queue.front();
+				entry = acquire_queue.front();
 				acquire_queue.pop_front();
-
-				if(entry.name == "release_tile") {
-					lock.unlock();
-					break;
-				}
-				else {
-					cout << "Error: unexpected release RPC receive call \"" + entry.name + "\"\n";
-				}
+				return true;
 			}
-		} while(acquire_queue.empty() && !stop);
+
+			if(stop || have_error())
+				return false;
+		}
 	}
 
 	bool task_get_cancel()
@@ -796,6 +1289,94 @@ protected:
 		return false;
 	}
 
+	list<ActiveTile>::iterator active_tile_find(const RenderTile& tile)
+	{
+		for(list<ActiveTile>::iterator it = active_tiles.begin(); it != active_tiles.end(); ++it)
+			if(tile_match(it->tile, tile))
+				return it;
+		return active_tiles.end();
+	}
+
+	/* Memory descriptor of a tile buffer, to copy rows between the device and
+	 * the memory buffer for devices which don't render into host memory. */
+	void tile_buffer_memory(network_device_memory& mem, device_ptr real_pointer)
+	{
+		DataVector &data_v = data_vector_find(ptr_imap[real_pointer]);
+
+		mem.data_type = TYPE_UCHAR;
+		mem.data_elements = 1;
+		mem.data_size = data_v.size();
+		mem.data_width = data_v.size();
+		mem.data_height = 0;
+		mem.data_depth = 0;
+		mem.data_pointer = (device_ptr)&data_v[0];
+		mem.device_pointer = real_pointer;
+	}
+
+	/* Add the rows of the tile which were not given away to other servers to
+	 * the payload, straight from the memory buffer. */
+	void tile_pixels_add(RPCSend& snd, ActiveTile& active)
+	{
+		const RenderTile& tile = active.tile;
+		size_t pixel_size = active.pass_stride*sizeof(float);
+
+		RowSpanList spans;
+		int y = tile.y;
+
+		sort(active.given.begin(), active.given.end());
+
+		foreach(RowSpan& given, active.given) {
+			if(given.first > y)
+				spans.push_back(RowSpan(y, given.first - y));
+			y = max(y, given.first + given.second);
+		}
+		if(y < tile.y + tile.h)
+			spans.push_back(RowSpan(y, tile.y + tile.h - y));
+
+		network_device_memory mem;
+		tile_buffer_memory(mem, tile.buffer);
+
+		int num_spans = spans.size();
+		snd.add(num_spans);
+
+		foreach(RowSpan& span, spans) {
+			int first_row = tile_row_offset(tile, span.first, 1) / tile.stride;
+			device->mem_copy_from(mem, first_row, tile.stride, span.second, pixel_size);
+
+			snd.add(span.first);
+			snd.add(span.second);
+
+			uint8_t *pixels = (uint8_t*)mem.data_pointer;
+
+			if(tile.stride == tile.w) {
+				snd.add_buffer(pixels + tile_row_offset(tile, span.first, pixel_size),
+				               span.second*tile.w*pixel_size);
+			}
+			else {
+				for(int y = span.first; y < span.first + span.second; y++)
+					snd.add_buffer(pixels + tile_row_offset(tile, y, pixel_size),
+					               tile.w*pixel_size);
+			}
+		}
+	}
+
+	/* Read pixels of a tile from the client into its memory buffer and copy
+	 * them to the device. The tile has client pointers. */
+	void tile_pixels_read(RPCReceive& rcv, const RenderTile& tile, int pass_stride)
+	{
+		size_t pixel_size = pass_stride*sizeof(float);
+
+		network_device_memory mem;
+		tile_buffer_memory(mem, device_ptr_from_client_pointer(tile.buffer));
+
+		uint8_t *pixels = (uint8_t*)mem.data_pointer;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++)
+			rcv.read_buffer(pixels + tile_row_offset(tile, y, pixel_size), tile.w*pixel_size);
+
+		device->mem_copy_to(mem);
+	}
+
 	/* properties */
 	Device *device;
 	tcp::socket& socket;
@@ -805,13 +1386,11 @@ protected:
 	PtrMap ptr_imap;
 	DataMap mem_data;
 
-	struct AcquireEntry {
-		string name;
-		RenderTile tile;
-	};
-
 	thread_mutex acquire_mutex;
 	list<AcquireEntry> acquire_queue;
+	thread_condition_variable acquire_cond;
+
+	list<ActiveTile> active_tiles;
 
 	bool stop;
 	bool blocked_waiting;
@@ -822,27 +1401,30 @@ private:
 
 };
 
-void Device::server_run()
+void Device::server_run(int port)
 {
 	try {
 		/* starts thread that responds to discovery requests */
-		ServerDiscovery discovery;
+		ServerDiscovery discovery(false, port);
 
 		for(;;) {
 			/* accept connection */
 			boost::asio::io_service io_service;
-			tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), SERVER_PORT));
+			tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), port));
 
 			tcp::socket socket(io_service);
 			acceptor.accept(socket);
+			socket.set_option(tcp::no_delay(true));
 
 			string remote_address = socket.remote_endpoint().address().to_string();
 			printf("Connected to remote client at: %s\n", remote_address.c_str());
+			fflush(stdout);
 
 			DeviceServer server(this, socket);
 			server.listen();
 
 			printf("Disconnected.\n");
+			fflush(stdout);
 		}
 	}
 	catch(exception& e) {
@@ -19,29 +19,35 @@
 
 #ifdef WITH_NETWORK
 
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
-#include <boost/serialization/vector.hpp>
 #include <boost/thread.hpp>
+#include <boost/type_traits/is_pod.hpp>
 
 #include <iostream>
 #include <sstream>
 #include <deque>
 
+#include <string.h>
+#include <zlib.h>
+
 #include "buffers.h"
 
 #include "util_foreach.h"
 #include "util_list.h"
+#include "util_logging.h"
 #include "util_map.h"
+#include "util_set.h"
+#include "util_static_assert.h"
 #include "util_string.h"
+#include "util_thread.h"
+#include "util_types.h"
 
 CCL_NAMESPACE_BEGIN
 
+class Device;
+
 using std::cout;
 using std::cerr;
 using std::hex;
@@ -55,20 +61,118 @@ static const int DISCOVER_PORT = 5121;
 static const string DISCOVER_REQUEST_MSG = "REQUEST_RENDER_SERVER_IP";
 static const string DISCOVER_REPLY_MSG = "REPLY_RENDER_SERVER_IP";
 
-#if 0
-typedef boost::archive::text_oarchive o_archive;
-typedef boost::archive::text_iarchive i_archive;
-#else
-typedef boost::archive::binary_oarchive o_archive;
-typedef boost::archive::binary_iarchive i_archive;
-#endif
+/* Wire format
+ *
+ * Every remote procedure call is a single frame made of a fixed size binary
+ * header, the serialized arguments and an optional payload of raw memory.
+ * The payload is sent straight from and received straight into the memory
+ * of device buffers, unless it is compressed. Both ends are expected to have
+ * the same byte order and type sizes. */
+
+static const uint32_t RPC_MAGIC = 0x43525043; /* "CPRC" */
+
+enum RPCFlag {
+	RPC_COMPRESSED = (1 << 0),
+};
+
+/* Payloads below this size are never compressed. */
+static const size_t RPC_COMPRESS_MIN_SIZE = 64*1024;
+
+/* Largest chunk passed to zlib at once, its sizes are 32 bit. */
+static const size_t RPC_COMPRESS_CHUNK_SIZE = 1 << 30;
+
+struct RPCHeader {
+	uint32_t magic;
+	uint32_t flags;
+	uint64_t archive_size;
+	uint64_t payload_size;
+	uint64_t payload_raw_size;
+};
+
+/* Serialization of call arguments, plain old data is copied as is. */
+
+class network_oarchive {
+public:
+	template<typename T> network_oarchive& operator&(const T& data)
+	{
+		static_assert(boost::is_pod<T>::value, "Only plain old data can be copied as is");
+		const char *bytes = (const char*)&data;
+		this->data.insert(this->data.end(), bytes, bytes + sizeof(T));
+		return *this;
+	}
+
+	network_oarchive& operator&(const string& str)
+	{
+		uint64_t size = str.size();
+		*this & size;
+		data.insert(data.end(), str.begin(), str.end());
+		return *this;
+	}
+
+	vector<char> data;
+};
+
+class network_iarchive {
+public:
+	network_iarchive()
+	: position(0), valid(true)
+	{
+	}
+
+	template<typename T> network_iarchive& operator&(T& data)
+	{
+		static_assert(boost::is_pod<T>::value, "Only plain old data can be copied as is");
+		read(&data, sizeof(T));
+		return *this;
+	}
+
+	network_iarchive& operator&(string& str)
+	{
+		uint64_t size = 0;
+		*this & size;
+
+		if(size == 0) {
+			str.clear();
+		}
+		else if(valid && size <= data.size() - position) {
+			str.assign(&data[0] + position, size);
+			position += size;
+		}
+		else {
+			str.clear();
+			valid = false;
+		}
+
+		return *this;
+	}
+
+	vector<char> data;
+	size_t position;
+	bool valid;
+
+protected:
+	void read(void *dst, size_t size)
+	{
+		if(size == 0) {
+			return;
+		}
+		else if(valid && size <= data.size() - position) {
+			memcpy(dst, &data[0] + position, size);
+			position += size;
+		}
+		else {
+			memset(dst, 0, size);
+			valid = false;
+		}
+	}
+};
 
 /* Serialization of device memory */
 
 class network_device_memory : public device_memory
 {
 public:
-	network_device_memory() {}
+	network_device_memory() { device_size = 0; }
 	~network_device_memory() { device_pointer = 0; };
 
 	vector<char> local_data;
@@ -104,11 +208,11 @@ private:
 class RPCSend {
 public:
 	RPCSend(tcp::socket& socket_, NetworkError* e, const string& name_ = "")
-	: name(name_), socket(socket_), archive(archive_stream), sent(false)
+	: name(name_), socket(socket_), sent(false), payload_size(0)
 	{
 		archive & name_;
 		error_func = e;
-		fprintf(stderr, "rpc send %s\n", name.c_str());
+		VLOG(4) << "RPC send " << name << ".";
 	}
 
 	~RPCSend()
@@ -134,7 +238,9 @@ public:
 		archive & task.offset & task.stride;
 		archive & task.shader_input & task.shader_output & task.shader_output_luma & task.shader_eval_type;
 		archive & task.shader_x & task.shader_w;
-		archive & task.need_finish_queue;
+		archive & task.need_finish_queue & task.integrator_branched;
+		archive & task.adaptive_threshold & task.adaptive_min_samples;
+		archive & task.denoising_radius & task.denoising_strength;
 	}
 
 	void add(const RenderTile& tile)
@@ -145,54 +251,127 @@ public:
 		archive & tile.buffer & tile.rng_state;
 	}
 
-	void write()
+	/* Append memory to the payload of the call. It is not copied, so it must
+	 * stay valid until the call is written. */
+	void add_buffer(const void *buffer, size_t size)
+	{
+		if(size == 0)
+			return;
+
+		payload.push_back(boost::asio::const_buffer(buffer, size));
+		payload_size += size;
+	}
+
+	/* Send header, arguments and payload in one go. Compression is only used
+	 * when it is requested and actually makes the payload smaller. */
+	void write(bool compress = false)
 	{
 		boost::system::error_code error;
 
-		/* get string from stream */
-		string archive_str = archive_stream.str();
+		RPCHeader header;
+		header.magic = RPC_MAGIC;
+		header.flags = 0;
+		header.archive_size = archive.data.size();
+		header.payload_size = payload_size;
+		header.payload_raw_size = payload_size;
 
-		/* first send fixed size header with size of following data */
-		ostringstream header_stream;
-		header_stream << setw(8) << hex << archive_str.size();
-		string header_str = header_stream.str();
+		vector<uint8_t> compressed;
 
-		boost::asio::write(socket,
-			boost::asio::buffer(header_str),
-			boost::asio::transfer_all(), error);
+		if(compress && payload_size >= RPC_COMPRESS_MIN_SIZE && compress_payload(compressed)) {
+			VLOG(3) << "RPC " << name << " payload compressed from "
+			        << string_human_readable_size(payload_size) << " to "
+			        << string_human_readable_size(compressed.size()) << ".";
 
-		if(error.value())
-			error_func->network_error(error.message());
+			header.flags |= RPC_COMPRESSED;
+			header.payload_size = compressed.size();
+
+			payload.clear();
+			payload.push_back(boost::asio::const_buffer(&compressed[0], compressed.size()));
+		}
+
+		vector<boost::asio::const_buffer> buffers;
+		buffers.push_back(boost::asio::const_buffer(&header, sizeof(header)));
+		if(archive.data.size())
+			buffers.push_back(boost::asio::const_buffer(&archive.data[0], archive.data.size()));
+		buffers.insert(buffers.end(), payload.begin(), payload.end());
+
+		boost::asio::write(socket, buffers, boost::asio::transfer_all(), error);
 
-		/* then send actual data */
-		boost::asio::write(socket,
-			boost::asio::buffer(archive_str),
-			boost::asio::transfer_all(), error);
-		
 		if(error.value())
 			error_func->network_error(error.message());
 
 		sent = true;
 	}
 
-	void write_buffer(void *buffer, size_t size)
+protected:
+	bool compress_payload(vector<uint8_t>& compressed)
 	{
-		boost::system::error_code error;
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
 
-		boost::asio::write(socket,
-			boost::asio::buffer(buffer, size),
-			boost::asio::transfer_all(), error);
-		
-		if(error.value())
-			error_func->network_error(error.message());
+		if(deflateInit(&stream, Z_BEST_SPEED) != Z_OK)
+			return false;
+
+		/* Give up as soon as the output gets as big as the input. */
+		compressed.resize(payload_size);
+
+		size_t out_size = 0;
+		bool result = true;
+
+		for(size_t i = 0; i < payload.size() && result; i++) {
+			const uint8_t *in = boost::asio::buffer_cast<const uint8_t*>(payload[i]);
+			size_t in_size = boost::asio::buffer_size(payload[i]);
+			bool last_buffer = (i == payload.size() - 1);
+
+			do {
+				size_t chunk_size = std::min(in_size, RPC_COMPRESS_CHUNK_SIZE);
+				bool finish = last_buffer && chunk_size == in_size;
+
+				stream.next_in = (Bytef*)in;
+				stream.avail_in = (uInt)chunk_size;
+
+				do {
+					size_t out_chunk_size = std::min(compressed.size() - out_size, RPC_COMPRESS_CHUNK_SIZE);
+
+					if(out_chunk_size == 0) {
+						result = false;
+						break;
+					}
+
+					stream.next_out = &compressed[out_size];
+					stream.avail_out = (uInt)out_chunk_size;
+
+					int status = deflate(&stream, finish? Z_FINISH: Z_NO_FLUSH);
+					out_size += out_chunk_size - stream.avail_out;
+
+					if(status == Z_STREAM_ERROR) {
+						result = false;
+						break;
+					}
+					if(status == Z_STREAM_END)
+						break;
+				} while(stream.avail_in != 0 || finish);
+
+				in += chunk_size;
+				in_size -= chunk_size;
+			} while(in_size != 0 && result);
+		}
+
+		deflateEnd(&stream);
+
+		if(!result || out_size >= payload_size)
+			return false;
+
+		compressed.resize(out_size);
+		return true;
 	}
 
-protected:
 	string name;
 	tcp::socket& socket;
-	ostringstream archive_stream;
-	o_archive archive;
+	network_oarchive archive;
 	bool sent;
+	vector<boost::asio::const_buffer> payload;
+	size_t payload_size;
 	NetworkError *error_func;
 };
 
@@ -201,78 +380,105 @@ protected:
 class RPCReceive {
 public:
 	RPCReceive(tcp::socket& socket_, NetworkError* e )
-	: socket(socket_), archive_stream(NULL), archive(NULL)
+	: socket(socket_), payload_size(0), payload_raw_size(0),
+	  compressed(false), inflating(false)
 	{
 		error_func = e;
+		memset(&stream, 0, sizeof(stream));
+
 		/* read head with fixed size */
-		vector<char> header(8);
+		RPCHeader header;
 		boost::system::error_code error;
-		size_t len = boost::asio::read(socket, boost::asio::buffer(header), error);
+		size_t len = boost::asio::read(socket, boost::asio::buffer(&header, sizeof(header)), error);
 
 		if(error.value()) {
 			error_func->network_error(error.message());
 		}
 
 		/* verify if we got something */
-		if(len == header.size()) {
-			/* decode header */
-			string header_str(&header[0], header.size());
-			istringstream header_stream(header_str);
+		if(len != sizeof(header)) {
+			error_func->network_error("Network receive error: invalid header size");
+			return;
+		}
 
-			size_t data_size;
+		if(header.magic != RPC_MAGIC) {
+			error_func->network_error("Network receive error: invalid header");
+			return;
+		}
 
-			if((header_stream >> hex >> data_size)) {
+		archive.data.resize(header.archive_size);
 
-				vector<char> data(data_size);
-				size_t len = boost::asio::read(socket, boost::asio::buffer(data), error);
+		if(header.archive_size) {
+			len = boost::asio::read(socket, boost::asio::buffer(archive.data), error);
 
-				if(error.value())
-					error_func->network_error(error.message());
+			if(error.value())
+				error_func->network_error(error.message());
 
+			if(len != header.archive_size) {
+				error_func->network_error("Network receive error: data size doesn't match header");
+				return;
+			}
+		}
 
-				if(len == data_size) {
-					archive_str = (data.size())? string(&data[0], data.size()): string("");
+		payload_size = header.payload_size;
+		payload_raw_size = header.payload_raw_size;
+		compressed = (header.flags & RPC_COMPRESSED) != 0;
 
-					archive_stream = new istringstream(archive_str);
-					archive = new i_archive(*archive_stream);
+		archive & name;
+		VLOG(4) << "RPC receive " << name << ".";
+	}
 
-					*archive & name;
-					fprintf(stderr, "rpc receive %s\n", name.c_str());
-				}
-				else {
-					error_func->network_error("Network receive error: data size doesn't match header");
+	~RPCReceive()
+	{
+		/* Skip the part of the payload nobody asked for, so the next call
+		 * starts at a frame header. */
+		if(payload_size) {
+			vector<char> skip(std::min(payload_size, (size_t)65536));
+
+			while(payload_size) {
+				boost::system::error_code error;
+				size_t size = std::min(payload_size, skip.size());
+				size_t len = boost::asio::read(socket, boost::asio::buffer(&skip[0], size), error);
+
+				if(error.value() || len != size) {
+					error_func->network_error("Network receive error: can't skip payload");
+					break;
 				}
-			}
-			else {
-				error_func->network_error("Network receive error: can't decode data size from header");
+
+				payload_size -= size;
 			}
 		}
-		else {
-			error_func->network_error("Network receive error: invalid header size");
-		}
-	}
 
-	~RPCReceive()
-	{
-		delete archive;
-		delete archive_stream;
+		if(inflating)
+			inflateEnd(&stream);
 	}
 
 	void read(network_device_memory& mem)
 	{
-		*archive & mem.data_type & mem.data_elements & mem.data_size;
-		*archive & mem.data_width & mem.data_height & mem.data_depth & mem.device_pointer;
+		archive & mem.data_type & mem.data_elements & mem.data_size;
+		archive & mem.data_width & mem.data_height & mem.data_depth & mem.device_pointer;
 
 		mem.data_pointer = 0;
 	}
 
 	template<typename T> void read(T& data)
 	{
-		*archive & data;
+		archive & data;
 	}
 
+	/* Read the next part of the payload directly into the buffer. */
 	void read_buffer(void *buffer, size_t size)
 	{
+		if(compressed) {
+			read_compressed_buffer((uint8_t*)buffer, size);
+			return;
+		}
+
+		if(size > payload_size) {
+			error_func->network_error("Network receive error: buffer size doesn't match expected size");
+			return;
+		}
+
 		boost::system::error_code error;
 		size_t len = boost::asio::read(socket, boost::asio::buffer(buffer, size), error);
 
@@ -280,30 +486,40 @@ public:
 			error_func->network_error(error.message());
 		}
 
+		payload_size -= len;
+
 		if(len != size)
-			cout << "Network receive error: buffer size doesn't match expected size\n";
+			error_func->network_error("Network receive error: buffer size doesn't match expected size");
+	}
+
+	/* Size of the payload once decompressed. */
+	size_t buffer_size()
+	{
+		return payload_raw_size;
 	}
 
 	void read(DeviceTask& task)
 	{
 		int type;
 
-		*archive & type & task.x & task.y & task.w & task.h;
-		*archive & task.rgba_byte & task.rgba_half & task.buffer & task.sample & task.num_samples;
-		*archive & task.offset & task.stride;
-		*archive & task.shader_input & task.shader_output & task.shader_output_luma & task.shader_eval_type;
-		*archive & task.shader_x & task.shader_w;
-		*archive & task.need_finish_queue;
+		archive & type & task.x & task.y & task.w & task.h;
+		archive & task.rgba_byte & task.rgba_half & task.buffer & task.sample & task.num_samples;
+		archive & task.offset & task.stride;
+		archive & task.shader_input & task.shader_output & task.shader_output_luma & task.shader_eval_type;
+		archive & task.shader_x & task.shader_w;
+		archive & task.need_finish_queue & task.integrator_branched;
+		archive & task.adaptive_threshold & task.adaptive_min_samples;
+		archive & task.denoising_radius & task.denoising_strength;
 
 		task.type = (DeviceTask::Type)type;
 	}
 
 	void read(RenderTile& tile)
 	{
-		*archive & tile.x & tile.y & tile.w & tile.h;
-		*archive & tile.start_sample & tile.num_samples & tile.sample;
-		*archive & tile.resolution & tile.offset & tile.stride;
-		*archive & tile.buffer & tile.rng_state;
+		archive & tile.x & tile.y & tile.w & tile.h;
+		archive & tile.start_sample & tile.num_samples & tile.sample;
+		archive & tile.resolution & tile.offset & tile.stride;
+		archive & tile.buffer & tile.rng_state;
 
 		tile.buffers = NULL;
 	}
@@ -311,19 +527,159 @@ public:
 	string name;
 
 protected:
+	void read_compressed_buffer(uint8_t *buffer, size_t size)
+	{
+		if(!inflating) {
+			/* Compressed payloads are received in full before decoding. */
+			compressed_data.resize(payload_size);
+
+			if(payload_size) {
+				boost::system::error_code error;
+				size_t len = boost::asio::read(socket, boost::asio::buffer(compressed_data), error);
+
+				if(error.value())
+					error_func->network_error(error.message());
+
+				if(len != payload_size) {
+					error_func->network_error("Network receive error: buffer size doesn't match expected size");
+					return;
+				}
+			}
+
+			payload_size = 0;
+
+			if(inflateInit(&stream) != Z_OK) {
+				error_func->network_error("Network receive error: can't decompress buffer");
+				return;
+			}
+
+			inflating = true;
+		}
+
+		while(size) {
+			size_t in_consumed = stream.total_in;
+			size_t chunk_size = std::min(size, RPC_COMPRESS_CHUNK_SIZE);
+
+			stream.next_in = compressed_data.size()? &compressed_data[0] + in_consumed: NULL;
+			stream.avail_in = (uInt)std::min(compressed_data.size() - in_consumed, RPC_COMPRESS_CHUNK_SIZE);
+			stream.next_out = buffer;
+			stream.avail_out = (uInt)chunk_size;
+
+			int status = inflate(&stream, Z_SYNC_FLUSH);
+			size_t out_size = chunk_size - stream.avail_out;
+
+			if(status != Z_OK && status != Z_STREAM_END) {
+				error_func->network_error("Network receive error: can't decompress buffer");
+				return;
+			}
+
+			if(out_size == 0) {
+				error_func->network_error("Network receive error: buffer size doesn't match expected size");
+				return;
+			}
+
+			buffer += out_size;
+			size -= out_size;
+		}
+	}
+
 	tcp::socket& socket;
-	string archive_str;
-	istringstream *archive_stream;
-	i_archive *archive;
+	network_iarchive archive;
+	size_t payload_size;
+	size_t payload_raw_size;
 	NetworkError *error_func;
+
+	/* decompression state */
+	bool compressed;
+	bool inflating;
+	z_stream stream;
+	vector<uint8_t> compressed_data;
+};
+
+/* Tile Stealing
+ *
+ * Tiles are pulled from the session by every server on its own, so faster
+ * servers already take more tiles. Once the session runs out of tiles, an
+ * idle server steals the bottom half of the rows of a tile another server is
+ * still working on. Servers only look at steal requests when they report the
+ * progress of a tile, together with the current pixels of the tile. The thief
+ * gets those pixels and continues from the reported sample, writing back into
+ * the render buffers of the original tile. The original tile is released to
+ * the session once all of its parts are finished.
+ *
+ * Owned by the multi device and shared by its network devices, a network
+ * device on its own has its own instance. */
+
+class NetworkTileStealing {
+public:
+	/* Minimum number of rows on either side of a split. */
+	static const int MIN_ROWS = 4;
+
+	struct Work;
+
+	struct Request {
+		bool answered;
+		bool granted;
+		RenderTile tile;
+		Work *root;
+	};
+
+	struct Work {
+		Work(Device *device_, const RenderTile& tile_, Work *root_);
+
+		/* Server rendering the tile. */
+		Device *device;
+		/* Rows the server is working on and its last reported sample. */
+		RenderTile tile;
+		/* Tile as handed to the server. */
+		RenderTile full_tile;
+		/* Work of the tile as acquired from the session, its buffers receive
+		 * the pixels of all parts. */
+		Work *root;
+		/* Stolen parts still being rendered and whether the server finished
+		 * its own part, only used by the root. */
+		int num_stolen;
+		bool released;
+		bool stealable;
+		/* Pending request of an idle server. */
+		Request *request;
+	};
+
+	Work *begin(Device *device, const RenderTile& tile, Work *root);
+	Work *find(Device *device, const RenderTile& tile);
+
+	/* Called when the server reports progress of a tile, returns the number
+	 * of rows the server keeps rendering. */
+	int split_if_requested(Work *work, const RenderTile& tile);
+
+	/* Called by the device of an idle server, returns false when there is
+	 * nothing left worth stealing. */
+	bool steal(Device *thief, RenderTile *tile, Work **root);
+
+	/* Called when the server finished a tile or a stolen part of one. Returns
+	 * true when the tile acquired from the session is complete and should be
+	 * released, which is then stored in release_tile. */
+	bool end(Work *work, RenderTile *release_tile);
+
+	/* Answer pending requests of a device which stops handling its tiles. */
+	void cancel(Device *device);
+
+protected:
+	static bool splittable(const Work *work);
+	void answer(Request *request, bool granted);
+
+	thread_mutex mutex;
+	thread_condition_variable cond;
+	list<Work*> works;
+	set<Device*> stealing;
 };
 
 /* Server auto discovery */
 
 class ServerDiscovery {
 public:
-	explicit ServerDiscovery(bool discover = false)
-	: listen_socket(io_service), collect_servers(false)
+	explicit ServerDiscovery(bool discover = false, int server_port_ = SERVER_PORT)
+	: listen_socket(io_service), collect_servers(false), server_port(server_port_)
 	{
 		/* setup listen socket */
 		listen_endpoint.address(boost::asio::ip::address_v4::any());
@@ -384,8 +740,10 @@ private:
 
 			/* handle incoming message */
 			if(collect_servers) {
-				if(msg == DISCOVER_REPLY_MSG) {
+				if(string_startswith(msg, DISCOVER_REPLY_MSG.c_str())) {
+					/* servers which don't use the default port append it */
 					string address = receive_endpoint.address().to_string();
+					address += msg.substr(DISCOVER_REPLY_MSG.size());
 
 					mutex.lock();
 
@@ -401,8 +759,12 @@ private:
 			}
 			else {
 				/* reply to request */
-				if(msg == DISCOVER_REQUEST_MSG)
-					broadcast_message(DISCOVER_REPLY_MSG);
+				if(msg == DISCOVER_REQUEST_MSG) {
+					if(server_port == SERVER_PORT)
+						broadcast_message(DISCOVER_REPLY_MSG);
+					else
+						broadcast_message(string_printf("%s:%d", DISCOVER_REPLY_MSG.c_str(), server_port));
+				}
 			}
 		}
 
@@ -462,6 +824,9 @@ private:
 	/* collection of server addresses in list */
 	bool collect_servers;
 	vector<string> servers;
+
+	/* port the server accepts connections on */
+	int server_port;
 };
 
 CCL_NAMESPACE_END
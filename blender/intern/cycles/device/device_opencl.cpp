@@ -1138,6 +1138,22 @@ public:
 		}
 	}
 
+	void mem_copy_to(device_memory& mem, size_t offset, size_t size)
+	{
+		/* this is blocking */
+		assert(offset + size <= mem.memory_size());
+		if(size != 0) {
+			opencl_assert(clEnqueueWriteBuffer(cqCommandQueue,
+			                                   CL_MEM_PTR(mem.device_pointer),
+			                                   CL_TRUE,
+			                                   offset,
+			                                   size,
+			                                   (uchar*)mem.data_pointer + offset,
+			                                   0,
+			                                   NULL, NULL));
+		}
+	}
+
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 	{
 		size_t offset = elem*y*w;
@@ -56,17 +56,29 @@ public:
 	int get_subtask_count(int num, int max_size = 0);
 	void split(list<DeviceTask>& tasks, int num, int max_size = 0);
 
-	void update_progress(RenderTile *rtile);
+	void update_progress(RenderTile *rtile, int num_samples = 1);
 
 	function<bool(Device *device, RenderTile&)> acquire_tile;
 	function<void(void)> update_progress_sample;
 	function<void(RenderTile&)> update_tile_sample;
 	function<void(RenderTile&)> release_tile;
+	/* Fill the 3x3 rendered tiles around a tile to denoise, row by row with
+	 * the noisy tile itself in the middle. Tiles outside of the image have no
+	 * buffers. */
+	function<void(const RenderTile&, RenderTile*)> map_neighbor_tiles;
 	function<bool(void)> get_cancel;
 
 	bool need_finish_queue;
 	bool integrator_branched;
 	int2 requested_tile_size;
+
+	/* Adaptive sampling, disabled when threshold is zero. */
+	float adaptive_threshold;
+	int adaptive_min_samples;
+
+	/* Denoising of finished tiles, disabled when radius is zero. */
+	int denoising_radius;
+	float denoising_strength;
 protected:
 	double last_update_time;
 };
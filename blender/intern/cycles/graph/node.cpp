@@ -18,6 +18,7 @@
 #include "node_type.h"
 
 #include "util_foreach.h"
+#include "util_md5.h"
 #include "util_param.h"
 #include "util_transform.h"
 
@@ -403,5 +404,89 @@ bool Node::equals(const Node& other) const
 	return true;
 }
 
-CCL_NAMESPACE_END
+/* hash */
+
+template<typename T>
+static void value_hash(const Node *node, const SocketType& socket, MD5Hash& md5)
+{
+	md5.append(((const uint8_t*)node) + socket.struct_offset, sizeof(T));
+}
+
+static void string_hash(const string& str, MD5Hash& md5)
+{
+	size_t size = str.size();
+	md5.append((const uint8_t*)&size, sizeof(size));
+	md5.append(str);
+}
+
+static void float3_hash(const float3& f, MD5Hash& md5)
+{
+	/* don't hash 4th element, it's only padding */
+	md5.append((const uint8_t*)&f, sizeof(float)*3);
+}
 
+template<typename T>
+static void array_hash(const Node *node, const SocketType& socket, MD5Hash& md5)
+{
+	const array<T>& a = *(const array<T>*)(((const char*)node) + socket.struct_offset);
+	size_t size = a.size();
+	md5.append((const uint8_t*)&size, sizeof(size));
+	for(size_t i = 0; i < a.size(); i++)
+		md5.append((const uint8_t*)&a[i], sizeof(T));
+}
+
+void Node::hash(MD5Hash& md5) const
+{
+	string_hash(type->name.string(), md5);
+
+	foreach(const SocketType& socket, type->inputs) {
+		const void *value = ((const char*)this) + socket.struct_offset;
+
+		string_hash(socket.name.string(), md5);
+
+		switch(socket.type) {
+			case SocketType::BOOLEAN: value_hash<bool>(this, socket, md5); break;
+			case SocketType::FLOAT: value_hash<float>(this, socket, md5); break;
+			case SocketType::INT: value_hash<int>(this, socket, md5); break;
+			case SocketType::UINT: value_hash<uint>(this, socket, md5); break;
+			case SocketType::COLOR:
+			case SocketType::VECTOR:
+			case SocketType::POINT:
+			case SocketType::NORMAL: float3_hash(*(const float3*)value, md5); break;
+			case SocketType::POINT2: value_hash<float2>(this, socket, md5); break;
+			case SocketType::CLOSURE: break;
+			/* strings are hashed by content, pointers differ between sessions */
+			case SocketType::STRING: string_hash(((const ustring*)value)->string(), md5); break;
+			case SocketType::ENUM: value_hash<int>(this, socket, md5); break;
+			case SocketType::TRANSFORM: value_hash<Transform>(this, socket, md5); break;
+			case SocketType::NODE: value_hash<void*>(this, socket, md5); break;
+
+			case SocketType::BOOLEAN_ARRAY: array_hash<bool>(this, socket, md5); break;
+			case SocketType::FLOAT_ARRAY: array_hash<float>(this, socket, md5); break;
+			case SocketType::INT_ARRAY: array_hash<int>(this, socket, md5); break;
+			case SocketType::COLOR_ARRAY:
+			case SocketType::VECTOR_ARRAY:
+			case SocketType::POINT_ARRAY:
+			case SocketType::NORMAL_ARRAY: {
+				const array<float3>& a = *(const array<float3>*)value;
+				size_t size = a.size();
+				md5.append((const uint8_t*)&size, sizeof(size));
+				for(size_t i = 0; i < a.size(); i++)
+					float3_hash(a[i], md5);
+				break;
+			}
+			case SocketType::POINT2_ARRAY: array_hash<float2>(this, socket, md5); break;
+			case SocketType::STRING_ARRAY: {
+				const array<ustring>& a = *(const array<ustring>*)value;
+				for(size_t i = 0; i < a.size(); i++)
+					string_hash(a[i].string(), md5);
+				break;
+			}
+			case SocketType::TRANSFORM_ARRAY: array_hash<Transform>(this, socket, md5); break;
+			case SocketType::NODE_ARRAY: array_hash<void*>(this, socket, md5); break;
+			default: assert(0); break;
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,607 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "node_binary.h"
+
+#include "util_foreach.h"
+#include "util_path.h"
+#include "util_transform.h"
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+CCL_NAMESPACE_BEGIN
+
+/* Alignment of block data in the file, enough for float3 and Transform. */
+static const size_t BINARY_BLOCK_ALIGNMENT = 16;
+
+static size_t binary_align(size_t offset)
+{
+	return (offset + BINARY_BLOCK_ALIGNMENT - 1) & ~(BINARY_BLOCK_ALIGNMENT - 1);
+}
+
+/* Writer */
+
+BinaryWriter::BinaryWriter()
+: file(NULL), offset(0), failed(false)
+{
+}
+
+BinaryWriter::~BinaryWriter()
+{
+	close();
+}
+
+bool BinaryWriter::open(const string& filepath, const char header[8])
+{
+	close();
+
+	file = path_fopen(filepath, "wb");
+	offset = 0;
+	failed = (file == NULL);
+	node_map.clear();
+
+	if(failed)
+		return false;
+
+	write(header, 8);
+	return !failed;
+}
+
+bool BinaryWriter::close()
+{
+	if(file) {
+		if(fclose(file) != 0)
+			failed = true;
+		file = NULL;
+	}
+
+	return !failed;
+}
+
+void BinaryWriter::write(const void *data, size_t size)
+{
+	if(failed || size == 0)
+		return;
+
+	if(fwrite(data, 1, size, file) != size)
+		failed = true;
+
+	offset += size;
+}
+
+void BinaryWriter::write_block(const void *data, size_t size)
+{
+	static const uint8_t zero[BINARY_BLOCK_ALIGNMENT] = {0};
+
+	uint64_t size64 = size;
+	write(&size64, sizeof(size64));
+	write(zero, binary_align(offset) - offset);
+	write(data, size);
+}
+
+void BinaryWriter::write_int(int value)
+{
+	int32_t value32 = value;
+	write(&value32, sizeof(value32));
+}
+
+void BinaryWriter::write_string(const string& value)
+{
+	write_block(value.c_str(), value.size());
+}
+
+int BinaryWriter::node_index(const Node *node) const
+{
+	map<const Node*, int>::const_iterator it = node_map.find(node);
+	return (it != node_map.end())? it->second: -1;
+}
+
+void BinaryWriter::add_node(const Node *node)
+{
+	if(node_map.find(node) == node_map.end()) {
+		int index = node_map.size();
+		node_map[node] = index;
+	}
+}
+
+/* Reader */
+
+BinaryReader::BinaryReader()
+: map_data(NULL), map_size(0), map_offset(0), failed(false)
+{
+}
+
+BinaryReader::~BinaryReader()
+{
+	close();
+}
+
+bool BinaryReader::open(const string& filepath, const char header[8])
+{
+	close();
+
+	failed = true;
+
+#ifdef _WIN32
+	if(!path_read_binary(filepath, file_data) || file_data.empty())
+		return false;
+
+	map_data = &file_data[0];
+	map_size = file_data.size();
+#else
+	int fd = ::open(filepath.c_str(), O_RDONLY);
+
+	if(fd == -1)
+		return false;
+
+	struct stat st;
+
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if(data == MAP_FAILED)
+		return false;
+
+	map_data = (const uint8_t*)data;
+	map_size = st.st_size;
+#endif
+
+	if(map_size < 8 || memcmp(map_data, header, 8) != 0) {
+		close();
+		failed = true;
+		return false;
+	}
+
+	map_offset = 8;
+	failed = false;
+
+	return true;
+}
+
+void BinaryReader::close()
+{
+#ifndef _WIN32
+	if(map_data)
+		munmap((void*)map_data, map_size);
+#endif
+
+	file_data.clear();
+	map_data = NULL;
+	map_size = 0;
+	map_offset = 0;
+	nodes.clear();
+}
+
+const void *BinaryReader::read_block(size_t& size)
+{
+	uint64_t size64;
+
+	size = 0;
+
+	if(failed || map_data == NULL || map_size - map_offset < sizeof(size64)) {
+		failed = true;
+		return NULL;
+	}
+
+	memcpy(&size64, map_data + map_offset, sizeof(size64));
+
+	size_t data_offset = binary_align(map_offset + sizeof(size64));
+
+	if(data_offset > map_size || size64 > map_size - data_offset) {
+		failed = true;
+		return NULL;
+	}
+
+	size = (size_t)size64;
+	map_offset = data_offset + size;
+
+	return (size)? map_data + data_offset: NULL;
+}
+
+bool BinaryReader::read_int(int& value)
+{
+	int32_t value32;
+
+	if(failed || map_data == NULL || map_size - map_offset < sizeof(value32)) {
+		failed = true;
+		return false;
+	}
+
+	memcpy(&value32, map_data + map_offset, sizeof(value32));
+	map_offset += sizeof(value32);
+
+	value = value32;
+	return true;
+}
+
+bool BinaryReader::read_string(string& value)
+{
+	size_t size;
+	const char *data = (const char*)read_block(size);
+
+	if(failed)
+		return false;
+
+	value = (size)? string(data, size): string();
+	return true;
+}
+
+Node *BinaryReader::node(int index) const
+{
+	return (index >= 0 && index < (int)nodes.size())? nodes[index]: NULL;
+}
+
+void BinaryReader::add_node(Node *node)
+{
+	nodes.push_back(node);
+}
+
+/* Nodes */
+
+void binary_write_node(BinaryWriter& writer, const Node *node)
+{
+	/* count sockets first, only non-default values are written */
+	int num_sockets = 0;
+
+	foreach(const SocketType& socket, node->type->inputs) {
+		if(socket.type == SocketType::CLOSURE || socket.type == SocketType::UNDEFINED)
+			continue;
+		if(socket.flags & SocketType::INTERNAL)
+			continue;
+		if(node->has_default_value(socket))
+			continue;
+
+		num_sockets++;
+	}
+
+	writer.write_string(node->name.string());
+	writer.write_int(num_sockets);
+
+	foreach(const SocketType& socket, node->type->inputs) {
+		if(socket.type == SocketType::CLOSURE || socket.type == SocketType::UNDEFINED)
+			continue;
+		if(socket.flags & SocketType::INTERNAL)
+			continue;
+		if(node->has_default_value(socket))
+			continue;
+
+		writer.write_string(socket.name.string());
+		writer.write_int(socket.type);
+
+		switch(socket.type)
+		{
+			case SocketType::BOOLEAN:
+				writer.write_value(node->get_bool(socket));
+				break;
+			case SocketType::FLOAT:
+				writer.write_value(node->get_float(socket));
+				break;
+			case SocketType::INT:
+				writer.write_value(node->get_int(socket));
+				break;
+			case SocketType::UINT:
+				writer.write_value(node->get_uint(socket));
+				break;
+			case SocketType::COLOR:
+			case SocketType::VECTOR:
+			case SocketType::POINT:
+			case SocketType::NORMAL:
+				writer.write_value(node->get_float3(socket));
+				break;
+			case SocketType::POINT2:
+				writer.write_value(node->get_float2(socket));
+				break;
+			case SocketType::STRING:
+			case SocketType::ENUM:
+				writer.write_string(node->get_string(socket).string());
+				break;
+			case SocketType::TRANSFORM:
+				writer.write_value(node->get_transform(socket));
+				break;
+			case SocketType::NODE:
+				writer.write_value(writer.node_index(node->get_node(socket)));
+				break;
+			case SocketType::BOOLEAN_ARRAY:
+				writer.write_array(node->get_bool_array(socket));
+				break;
+			case SocketType::FLOAT_ARRAY:
+				writer.write_array(node->get_float_array(socket));
+				break;
+			case SocketType::INT_ARRAY:
+				writer.write_array(node->get_int_array(socket));
+				break;
+			case SocketType::COLOR_ARRAY:
+			case SocketType::VECTOR_ARRAY:
+			case SocketType::POINT_ARRAY:
+			case SocketType::NORMAL_ARRAY:
+				writer.write_array(node->get_float3_array(socket));
+				break;
+			case SocketType::POINT2_ARRAY:
+				writer.write_array(node->get_float2_array(socket));
+				break;
+			case SocketType::TRANSFORM_ARRAY:
+				writer.write_array(node->get_transform_array(socket));
+				break;
+			case SocketType::STRING_ARRAY:
+			{
+				/* zero terminated strings, one after the other */
+				const array<ustring>& value = node->get_string_array(socket);
+				string data;
+				for(size_t i = 0; i < value.size(); i++) {
+					data += value[i].string();
+					data.push_back('\0');
+				}
+				writer.write_string(data);
+				break;
+			}
+			case SocketType::NODE_ARRAY:
+			{
+				const array<Node*>& value = node->get_node_array(socket);
+				array<int> indices(value.size());
+				for(size_t i = 0; i < value.size(); i++)
+					indices[i] = writer.node_index(value[i]);
+				writer.write_array(indices);
+				break;
+			}
+			case SocketType::CLOSURE:
+			case SocketType::UNDEFINED:
+				break;
+		}
+	}
+
+	writer.add_node(node);
+}
+
+/* Read the value of a socket, or skip it when socket is NULL. */
+static bool binary_read_socket(BinaryReader& reader, Node *node, const SocketType *socket, SocketType::Type type)
+{
+	switch(type)
+	{
+		case SocketType::BOOLEAN:
+		{
+			bool value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::FLOAT:
+		{
+			float value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::INT:
+		{
+			int value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::UINT:
+		{
+			uint value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::COLOR:
+		case SocketType::VECTOR:
+		case SocketType::POINT:
+		case SocketType::NORMAL:
+		{
+			float3 value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::POINT2:
+		{
+			float2 value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::STRING:
+		case SocketType::ENUM:
+		{
+			string value;
+			if(!reader.read_string(value))
+				return false;
+			if(socket) {
+				ustring uvalue(value);
+				if(type == SocketType::ENUM && !socket->enum_values->exists(uvalue)) {
+					fprintf(stderr, "Unknown value \"%s\" for attribute \"%s\".\n", value.c_str(), socket->name.c_str());
+					return true;
+				}
+				node->set(*socket, uvalue);
+			}
+			return true;
+		}
+		case SocketType::TRANSFORM:
+		{
+			Transform value;
+			if(!reader.read_value(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::NODE:
+		{
+			int index;
+			if(!reader.read_value(index))
+				return false;
+			if(socket) {
+				Node *value = reader.node(index);
+				if(value && value->type == *(socket->node_type))
+					node->set(*socket, value);
+			}
+			return true;
+		}
+		case SocketType::BOOLEAN_ARRAY:
+		{
+			array<bool> value;
+			if(!reader.read_array(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::FLOAT_ARRAY:
+		{
+			array<float> value;
+			if(!reader.read_array(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::INT_ARRAY:
+		{
+			array<int> value;
+			if(!reader.read_array(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::COLOR_ARRAY:
+		case SocketType::VECTOR_ARRAY:
+		case SocketType::POINT_ARRAY:
+		case SocketType::NORMAL_ARRAY:
+		{
+			array<float3> value;
+			if(!reader.read_array(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::POINT2_ARRAY:
+		{
+			array<float2> value;
+			if(!reader.read_array(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::TRANSFORM_ARRAY:
+		{
+			array<Transform> value;
+			if(!reader.read_array(value))
+				return false;
+			if(socket)
+				node->set(*socket, value);
+			return true;
+		}
+		case SocketType::STRING_ARRAY:
+		{
+			string data;
+			if(!reader.read_string(data))
+				return false;
+			if(socket) {
+				array<ustring> value;
+				size_t start = 0;
+				for(size_t i = 0; i < data.size(); i++) {
+					if(data[i] == '\0') {
+						value.push_back_slow(ustring(data.substr(start, i - start)));
+						start = i + 1;
+					}
+				}
+				node->set(*socket, value);
+			}
+			return true;
+		}
+		case SocketType::NODE_ARRAY:
+		{
+			array<int> indices;
+			if(!reader.read_array(indices))
+				return false;
+			if(socket) {
+				array<Node*> value(indices.size());
+				for(size_t i = 0; i < indices.size(); i++) {
+					Node *value_node = reader.node(indices[i]);
+					value[i] = (value_node && value_node->type == *(socket->node_type))? value_node: NULL;
+				}
+				node->set(*socket, value);
+			}
+			return true;
+		}
+		case SocketType::CLOSURE:
+		case SocketType::UNDEFINED:
+			break;
+	}
+
+	return false;
+}
+
+bool binary_read_node(BinaryReader& reader, Node *node)
+{
+	string name;
+	int num_sockets;
+
+	if(!reader.read_string(name) || !reader.read_int(num_sockets))
+		return false;
+
+	node->name = ustring(name);
+
+	for(int i = 0; i < num_sockets; i++) {
+		string socket_name;
+		int type;
+
+		if(!reader.read_string(socket_name) || !reader.read_int(type))
+			return false;
+
+		/* skip values of sockets which don't exist or changed type */
+		const SocketType *socket = node->type->find_input(ustring(socket_name));
+		if(socket && socket->type != type)
+			socket = NULL;
+
+		if(!binary_read_socket(reader, node, socket, (SocketType::Type)type))
+			return false;
+	}
+
+	reader.add_node(node);
+
+	return true;
+}
+
+CCL_NAMESPACE_END
+
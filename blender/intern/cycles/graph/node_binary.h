@@ -0,0 +1,167 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include "node.h"
+
+#include "util_map.h"
+#include "util_string.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Binary Node Files
+ *
+ * Compact alternative to node_xml. Everything is stored as blocks of a size
+ * followed by the data, padded so the data of each block is 16 byte aligned
+ * in the file. Reading maps the file into memory, so array sockets are a
+ * single copy out of the mapped file instead of parsing text.
+ *
+ * Node sockets are written through the node type reflection. Sockets unknown
+ * to the reader, for example from a newer version, are skipped. Links to other
+ * nodes are stored as the index of that node in the order nodes were written,
+ * so nodes must be written before the nodes linking to them. */
+
+class BinaryWriter {
+public:
+	BinaryWriter();
+	~BinaryWriter();
+
+	bool open(const string& filepath, const char header[8]);
+	bool close();
+
+	void write_block(const void *data, size_t size);
+	void write_int(int value);
+	void write_string(const string& value);
+
+	template<typename T> void write_value(const T& value)
+	{
+		write_block(&value, sizeof(T));
+	}
+
+	template<typename T> void write_array(const array<T>& value)
+	{
+		write_int(sizeof(T));
+		write_block(value.data(), value.size()*sizeof(T));
+	}
+
+	template<typename T> void write_array(const vector<T>& value)
+	{
+		write_int(sizeof(T));
+		write_block((value.size())? &value[0]: NULL, value.size()*sizeof(T));
+	}
+
+	/* Index of a node written before, -1 for NULL or unknown nodes. */
+	int node_index(const Node *node) const;
+	void add_node(const Node *node);
+
+protected:
+	void write(const void *data, size_t size);
+
+	FILE *file;
+	size_t offset;
+	bool failed;
+	map<const Node*, int> node_map;
+};
+
+class BinaryReader {
+public:
+	BinaryReader();
+	~BinaryReader();
+
+	bool open(const string& filepath, const char header[8]);
+	void close();
+
+	/* Returns a pointer into the mapped file, valid until the reader is
+	 * closed. NULL on errors, or for empty blocks. */
+	const void *read_block(size_t& size);
+	bool read_int(int& value);
+	bool read_string(string& value);
+
+	template<typename T> bool read_value(T& value)
+	{
+		size_t size;
+		const void *data = read_block(size);
+
+		if(failed || size != sizeof(T)) {
+			failed = true;
+			return false;
+		}
+
+		memcpy(&value, data, sizeof(T));
+		return true;
+	}
+
+	template<typename T> bool read_array(array<T>& value)
+	{
+		int element_size;
+		size_t size;
+
+		if(!read_int(element_size) || element_size != sizeof(T)) {
+			failed = true;
+			return false;
+		}
+
+		const void *data = read_block(size);
+		if(failed || size % sizeof(T) != 0) {
+			failed = true;
+			return false;
+		}
+
+		value.resize(size/sizeof(T));
+		if(size)
+			memcpy(value.data(), data, size);
+
+		return true;
+	}
+
+	template<typename T> bool read_array(vector<T>& value)
+	{
+		array<T> data;
+
+		if(!read_array(data))
+			return false;
+
+		value.resize(data.size());
+		if(data.size())
+			memcpy(&value[0], data.data(), data.size()*sizeof(T));
+
+		return true;
+	}
+
+	bool error() const { return failed; }
+
+	/* Node for an index stored by the writer, NULL if out of range. */
+	Node *node(int index) const;
+	void add_node(Node *node);
+
+protected:
+	const uint8_t *map_data;
+	size_t map_size;
+	size_t map_offset;
+	vector<uint8_t> file_data;
+	bool failed;
+	vector<Node*> nodes;
+};
+
+void binary_write_node(BinaryWriter& writer, const Node *node);
+bool binary_read_node(BinaryReader& reader, Node *node);
+
+CCL_NAMESPACE_END
+
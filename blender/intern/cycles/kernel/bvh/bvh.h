@@ -34,6 +34,11 @@ CCL_NAMESPACE_BEGIN
 #  include "qbvh_nodes.h"
 #endif
 
+/* Ray stream traversal */
+#ifdef __RAY_STREAM__
+#  include "qbvh_stream.h"
+#endif
+
 /* Regular BVH traversal */
 
 #include "bvh_nodes.h"
@@ -166,6 +171,8 @@ ccl_device_intersect bool scene_intersect(KernelGlobals *kg,
                                           float difl,
                                           float extmax)
 {
+	BVH_COUNT_RAYS(1);
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #  ifdef __HAIR__
@@ -209,6 +216,8 @@ ccl_device_intersect void scene_intersect_subsurface(KernelGlobals *kg,
                                                      uint *lcg_state,
                                                      int max_hits)
 {
+	BVH_COUNT_RAYS(1);
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 		return bvh_intersect_subsurface_motion(kg,
@@ -231,6 +240,8 @@ ccl_device_intersect void scene_intersect_subsurface(KernelGlobals *kg,
 #ifdef __SHADOW_RECORD_ALL__
 ccl_device_intersect bool scene_intersect_shadow_all(KernelGlobals *kg, const Ray *ray, Intersection *isect, uint max_hits, uint *num_hits)
 {
+	BVH_COUNT_RAYS(1);
+
 #  ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #    ifdef __HAIR__
@@ -262,6 +273,8 @@ ccl_device_intersect bool scene_intersect_volume(KernelGlobals *kg,
                                                  Intersection *isect,
                                                  const uint visibility)
 {
+	BVH_COUNT_RAYS(1);
+
 #  ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 		return bvh_intersect_volume_motion(kg, ray, isect, visibility);
@@ -290,6 +303,8 @@ ccl_device_intersect uint scene_intersect_volume_all(KernelGlobals *kg,
                                                      const uint max_hits,
                                                      const uint visibility)
 {
+	BVH_COUNT_RAYS(1);
+
 #  ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 		return bvh_intersect_volume_all_motion(kg, ray, isect, max_hits, visibility);
@@ -303,6 +318,28 @@ ccl_device_intersect uint scene_intersect_volume_all(KernelGlobals *kg,
 }
 #endif  /* __VOLUME_RECORD_ALL__ */
 
+#ifdef __RAY_STREAM__
+/* Ray stream traversal is only implemented for QBVH with triangles and static
+ * instances, for other scenes rays must be traced one by one. */
+ccl_device_inline bool scene_intersect_stream_supported(KernelGlobals *kg)
+{
+	return kernel_data.bvh.use_qbvh &&
+	       !kernel_data.bvh.have_curves &&
+	       !kernel_data.bvh.have_motion;
+}
+
+ccl_device_intersect void scene_intersect_stream(KernelGlobals *kg,
+                                                 const Ray *rays,
+                                                 Intersection *isects,
+                                                 int num_rays,
+                                                 const uint visibility)
+{
+	kernel_assert(scene_intersect_stream_supported(kg));
+	BVH_COUNT_RAYS(num_rays);
+	qbvh_intersect_stream(kg, rays, isects, num_rays, visibility);
+}
+#endif  /* __RAY_STREAM__ */
+
 
 /* Ray offset to avoid self intersection.
  *
@@ -61,12 +61,30 @@ CCL_NAMESPACE_BEGIN
 	do { \
 		++isect->num_traversed_instances; \
 	} while(0)
+#  define BVH_DEBUG_STREAM_NEXT_STEP(i) \
+	do { \
+		++isects[i].num_traversal_steps; \
+	} while(0)
+#  define BVH_DEBUG_STREAM_NEXT_INSTANCE(i) \
+	do { \
+		++isects[i].num_traversed_instances; \
+	} while(0)
 #else  /* __KERNEL_DEBUG__ */
 #  define BVH_DEBUG_INIT()
 #  define BVH_DEBUG_NEXT_STEP()
 #  define BVH_DEBUG_NEXT_INSTANCE()
+#  define BVH_DEBUG_STREAM_NEXT_STEP(i)
+#  define BVH_DEBUG_STREAM_NEXT_INSTANCE(i)
 #endif  /* __KERNEL_DEBUG__ */
 
+/* Count traced rays for render statistics, only on the CPU where every
+ * thread has its own KernelGlobals. */
+#ifdef __KERNEL_CPU__
+#  define BVH_COUNT_RAYS(n) (kg->num_rays += (n))
+#else
+#  define BVH_COUNT_RAYS(n)
+#endif
+
 CCL_NAMESPACE_END
 
 #endif  /* __BVH_TYPES__ */
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Ray stream traversal for coherent rays on the CPU.
+ *
+ * Instead of traversing the QBVH once per ray, up to RAY_STREAM_SIZE rays are
+ * traversed together. Every node is fetched once for all rays that reach it
+ * and tested against each of them with the regular SIMD node test, children
+ * are then visited with the subset of rays that hit them. For coherent rays,
+ * like camera rays of neighbouring pixels, this shares node fetches and stack
+ * operations between all rays of the stream.
+ *
+ * Only triangles and static instances are supported, callers must use single
+ * ray traversal when the scene has hair or motion blur.
+ */
+
+typedef struct QBVHStreamRay {
+	/* Ray in the space of the BVH currently traversed. */
+	float3 P;
+	float3 dir;
+	float3 idir;
+
+	/* Precomputed values for node and triangle intersection. */
+	ssef tfar;
+#ifdef __KERNEL_AVX2__
+	sse3f P_idir4;
+#else
+	sse3f org4;
+#endif
+	sse3f idir4;
+	int near_x, near_y, near_z;
+	int far_x, far_y, far_z;
+	IsectPrecalc isect_precalc;
+} QBVHStreamRay;
+
+typedef struct QBVHStreamStackItem {
+	int addr;
+	uint mask;
+} QBVHStreamStackItem;
+
+ccl_device_inline void qbvh_stream_ray_setup(QBVHStreamRay *sray,
+                                             float3 P,
+                                             float3 dir,
+                                             float3 idir,
+                                             float t)
+{
+	sray->P = P;
+	sray->dir = dir;
+	sray->idir = idir;
+
+	sray->tfar = ssef(t);
+#ifdef __KERNEL_AVX2__
+	float3 P_idir = P*idir;
+	sray->P_idir4 = sse3f(P_idir.x, P_idir.y, P_idir.z);
+#else
+	sray->org4 = sse3f(ssef(P.x), ssef(P.y), ssef(P.z));
+#endif
+	sray->idir4 = sse3f(ssef(idir.x), ssef(idir.y), ssef(idir.z));
+
+	if(idir.x >= 0.0f) { sray->near_x = 0; sray->far_x = 1; } else { sray->near_x = 1; sray->far_x = 0; }
+	if(idir.y >= 0.0f) { sray->near_y = 2; sray->far_y = 3; } else { sray->near_y = 3; sray->far_y = 2; }
+	if(idir.z >= 0.0f) { sray->near_z = 4; sray->far_z = 5; } else { sray->near_z = 5; sray->far_z = 4; }
+
+	triangle_intersect_precalc(dir, &sray->isect_precalc);
+}
+
+ccl_device void qbvh_intersect_stream_node(KernelGlobals *kg,
+                                           const Ray *rays,
+                                           QBVHStreamRay *srays,
+                                           Intersection *isects,
+                                           uint *terminated,
+                                           uint mask,
+                                           const uint visibility,
+                                           int root,
+                                           int object)
+{
+	QBVHStreamStackItem traversal_stack[BVH_QSTACK_SIZE];
+	int stack_ptr = 0;
+
+	traversal_stack[0].addr = root;
+	traversal_stack[0].mask = mask;
+
+	const ssef tnear(0.0f);
+
+	while(stack_ptr >= 0) {
+		int node_addr = traversal_stack[stack_ptr].addr;
+		uint node_mask = traversal_stack[stack_ptr].mask & ~(*terminated);
+		--stack_ptr;
+
+		if(node_mask == 0) {
+			continue;
+		}
+
+		if(node_addr >= 0) {
+			/* Inner node, test all rays against the four children. */
+			float4 inodes = kernel_tex_fetch(__bvh_nodes, node_addr+0);
+
+#ifdef __VISIBILITY_FLAG__
+			if((__float_as_uint(inodes.x) & visibility) == 0) {
+				continue;
+			}
+#endif
+
+			uint child_mask[4] = {0, 0, 0, 0};
+			float child_dist[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+			uint ray_mask = node_mask;
+			while(ray_mask != 0) {
+				uint i = __bscf(ray_mask);
+				QBVHStreamRay *sray = &srays[i];
+				ssef dist;
+
+				BVH_DEBUG_STREAM_NEXT_STEP(i);
+
+				int hit_mask = qbvh_aligned_node_intersect(kg,
+				                                           tnear,
+				                                           sray->tfar,
+#ifdef __KERNEL_AVX2__
+				                                           sray->P_idir4,
+#else
+				                                           sray->org4,
+#endif
+				                                           sray->idir4,
+				                                           sray->near_x, sray->near_y, sray->near_z,
+				                                           sray->far_x, sray->far_y, sray->far_z,
+				                                           node_addr,
+				                                           &dist);
+
+				while(hit_mask != 0) {
+					int r = __bscf(hit_mask);
+					child_mask[r] |= (1u << i);
+					child_dist[r] += ((float*)&dist)[r];
+				}
+			}
+
+			/* Push children sorted by the average distance of their rays,
+			 * farthest first so the closest child is visited next. */
+			float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr+7);
+			int order[4];
+			float order_dist[4];
+			int num_children = 0;
+
+			for(int r = 0; r < 4; r++) {
+				if(child_mask[r] == 0) {
+					continue;
+				}
+
+				float d = child_dist[r] / __popcnt(child_mask[r]);
+				int j = num_children++;
+
+				while(j > 0 && order_dist[j-1] < d) {
+					order[j] = order[j-1];
+					order_dist[j] = order_dist[j-1];
+					j--;
+				}
+
+				order[j] = r;
+				order_dist[j] = d;
+			}
+
+			for(int j = 0; j < num_children; j++) {
+				++stack_ptr;
+				kernel_assert(stack_ptr < BVH_QSTACK_SIZE);
+				traversal_stack[stack_ptr].addr = __float_as_int(cnodes[order[j]]);
+				traversal_stack[stack_ptr].mask = child_mask[order[j]];
+			}
+		}
+		else {
+			float4 leaf = kernel_tex_fetch(__bvh_leaf_nodes, (-node_addr-1));
+
+#ifdef __VISIBILITY_FLAG__
+			if((__float_as_uint(leaf.z) & visibility) == 0) {
+				continue;
+			}
+#endif
+
+			int prim_addr = __float_as_int(leaf.x);
+
+			if(prim_addr >= 0) {
+				/* Triangle leaf, intersect primitives for all rays. */
+				int prim_addr2 = __float_as_int(leaf.y);
+				const uint type = __float_as_int(leaf.w);
+
+				kernel_assert((type & PRIMITIVE_ALL) == PRIMITIVE_TRIANGLE);
+				(void)type;
+
+				for(; prim_addr < prim_addr2; prim_addr++) {
+					uint ray_mask = node_mask & ~(*terminated);
+
+					while(ray_mask != 0) {
+						uint i = __bscf(ray_mask);
+
+						BVH_DEBUG_STREAM_NEXT_STEP(i);
+
+						if(triangle_intersect(kg,
+						                      &srays[i].isect_precalc,
+						                      &isects[i],
+						                      srays[i].P,
+						                      visibility,
+						                      object,
+						                      prim_addr))
+						{
+							srays[i].tfar = ssef(isects[i].t);
+
+							/* Shadow ray early termination. */
+							if(visibility == PATH_RAY_SHADOW_OPAQUE) {
+								*terminated |= (1u << i);
+							}
+						}
+					}
+				}
+			}
+			else {
+				/* Instance, traverse its BVH with the rays transformed into
+				 * object space. Instances are never nested. */
+				int ob = kernel_tex_fetch(__prim_object, -prim_addr-1);
+				uint ray_mask = node_mask;
+
+				kernel_assert(object == OBJECT_NONE);
+
+				while(ray_mask != 0) {
+					uint i = __bscf(ray_mask);
+					float3 P, dir, idir;
+
+					bvh_instance_push(kg, ob, &rays[i], &P, &dir, &idir, &isects[i].t);
+					qbvh_stream_ray_setup(&srays[i], P, dir, idir, isects[i].t);
+
+					BVH_DEBUG_STREAM_NEXT_INSTANCE(i);
+				}
+
+				qbvh_intersect_stream_node(kg,
+				                           rays,
+				                           srays,
+				                           isects,
+				                           terminated,
+				                           node_mask,
+				                           visibility,
+				                           kernel_tex_fetch(__object_node, ob),
+				                           ob);
+
+				ray_mask = node_mask;
+
+				while(ray_mask != 0) {
+					uint i = __bscf(ray_mask);
+					float3 P, dir, idir;
+
+					bvh_instance_pop(kg, ob, &rays[i], &P, &dir, &idir, &isects[i].t);
+					qbvh_stream_ray_setup(&srays[i], P, dir, idir, isects[i].t);
+				}
+			}
+		}
+	}
+}
+
+ccl_device void qbvh_intersect_stream(KernelGlobals *kg,
+                                      const Ray *rays,
+                                      Intersection *isects,
+                                      int num_rays,
+                                      const uint visibility)
+{
+	QBVHStreamRay srays[RAY_STREAM_SIZE];
+	uint mask = 0;
+	uint terminated = 0;
+
+	kernel_assert(num_rays <= RAY_STREAM_SIZE);
+
+	for(int i = 0; i < num_rays; i++) {
+		Intersection *isect = &isects[i];
+
+		isect->t = rays[i].t;
+		isect->u = 0.0f;
+		isect->v = 0.0f;
+		isect->prim = PRIM_NONE;
+		isect->object = OBJECT_NONE;
+
+		BVH_DEBUG_INIT();
+
+		float3 dir = bvh_clamp_direction(rays[i].D);
+		qbvh_stream_ray_setup(&srays[i], rays[i].P, dir, bvh_inverse_direction(dir), rays[i].t);
+
+		if(rays[i].t > 0.0f) {
+			mask |= (1u << i);
+		}
+	}
+
+	qbvh_intersect_stream_node(kg,
+	                           rays,
+	                           srays,
+	                           isects,
+	                           &terminated,
+	                           mask,
+	                           visibility,
+	                           kernel_data.bvh.root,
+	                           OBJECT_NONE);
+}
@@ -89,6 +89,22 @@ ccl_device_inline AttributeDescriptor find_attribute(KernelGlobals *kg, const Sh
 	return desc;
 }
 
+/* Compressed attributes */
+
+ccl_device_inline float attribute_half_to_float(uint h)
+{
+	/* shift into float exponent and mantissa, multiplying by 2^112 rebiases
+	 * the exponent and also takes care of zero and denormals */
+	float f = __uint_as_float((h & 0x7FFF) << 13) * __uint_as_float(0x77800000);
+	return (h & 0x8000)? -f: f;
+}
+
+ccl_device_inline float3 attribute_half2_to_float3(float f)
+{
+	uint h = __float_as_uint(f);
+	return make_float3(attribute_half_to_float(h & 0xFFFF), attribute_half_to_float(h >> 16), 0.0f);
+}
+
 /* Transform matrix attribute on meshes */
 
 ccl_device Transform primitive_attribute_matrix(KernelGlobals *kg, const ShaderData *sd, const AttributeDescriptor desc)
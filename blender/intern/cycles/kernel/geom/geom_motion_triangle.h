@@ -71,9 +71,9 @@ ccl_device_inline void motion_triangle_normals_for_step(KernelGlobals *kg, uint4
 {
 	if(step == numsteps) {
 		/* center step: regular vertex location */
-		normals[0] = float4_to_float3(kernel_tex_fetch(__tri_vnormal, tri_vindex.x));
-		normals[1] = float4_to_float3(kernel_tex_fetch(__tri_vnormal, tri_vindex.y));
-		normals[2] = float4_to_float3(kernel_tex_fetch(__tri_vnormal, tri_vindex.z));
+		normals[0] = triangle_vertex_normal(kg, tri_vindex.x);
+		normals[1] = triangle_vertex_normal(kg, tri_vindex.y);
+		normals[2] = triangle_vertex_normal(kg, tri_vindex.z);
 	}
 	else {
 		/* center step not stored in this array */
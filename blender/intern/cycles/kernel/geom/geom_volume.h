@@ -111,6 +111,16 @@ ccl_device float3 volume_attribute_float3(KernelGlobals *kg, const ShaderData *s
 	return float4_to_float3(r);
 }
 
+#ifdef __VOLUME_SPARSE__
+/* Test if the voxel attribute is zero around P because it's in empty tiles
+ * of a sparse image. */
+ccl_device bool volume_attribute_is_empty(KernelGlobals *kg, const ShaderData *sd, const AttributeDescriptor desc, float3 P)
+{
+	P = volume_normalized_position(kg, sd, P);
+	return kernel_tex_image_is_empty_3d(desc.offset, P.x, P.y, P.z);
+}
+#endif
+
 #endif
 
 CCL_NAMESPACE_END
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Adaptive Sampling
+ *
+ * The auxiliary pass stores per pixel the sum of the sample luminance, the sum
+ * of squared luminance and the number of samples taken so far. The w component
+ * is set once the pixel is considered converged, after which the path tracing
+ * kernels skip it. Converged pixels are scaled up to the full sample count of
+ * the tile once it is finished, so the rest of the pipeline is unaffected. */
+
+ccl_device_inline bool kernel_adaptive_pixel_converged(KernelGlobals *kg,
+                                                       ccl_global float *buffer,
+                                                       int sample)
+{
+#ifdef __PASSES__
+	/* First sample overwrites the buffer, flag might be left from a previous render. */
+	if(sample != 0 && (kernel_data.film.pass_flag & PASS_ADAPTIVE_AUX)) {
+		return buffer[kernel_data.film.pass_adaptive_aux + 3] != 0.0f;
+	}
+#endif
+	return false;
+}
+
+ccl_device_inline void kernel_write_adaptive_aux(KernelGlobals *kg,
+                                                 ccl_global float *buffer,
+                                                 int sample,
+                                                 float4 L)
+{
+#ifdef __PASSES__
+	if(!(kernel_data.film.pass_flag & PASS_ADAPTIVE_AUX))
+		return;
+
+	ccl_global float *aux = buffer + kernel_data.film.pass_adaptive_aux;
+	float luminance = linear_rgb_to_gray(float4_to_float3(L));
+
+	/* Components are written separately, float3 stores would clobber the
+	 * convergence flag in w. */
+	kernel_write_pass_float(aux + 0, sample, luminance);
+	kernel_write_pass_float(aux + 1, sample, luminance*luminance);
+	kernel_write_pass_float(aux + 2, sample, 1.0f);
+	if(sample == 0) {
+		aux[3] = 0.0f;
+	}
+#endif
+}
+
+/* Estimate the error of the pixel mean and mark the pixel as converged when it
+ * drops below the threshold. The standard error is normalized by the square
+ * root of the intensity, which roughly matches perceived noise in both dark
+ * and bright regions. Returns true if the pixel is converged. */
+ccl_device bool kernel_adaptive_convergence_check(KernelGlobals *kg,
+                                                  ccl_global float *buffer,
+                                                  float threshold,
+                                                  int x, int y,
+                                                  int offset,
+                                                  int stride)
+{
+	if(!(kernel_data.film.pass_flag & PASS_ADAPTIVE_AUX))
+		return false;
+
+	int index = offset + x + y*stride;
+	buffer += index*kernel_data.film.pass_stride;
+
+	ccl_global float *aux = buffer + kernel_data.film.pass_adaptive_aux;
+
+	if(aux[3] != 0.0f)
+		return true;
+
+	float num_samples = aux[2];
+	if(num_samples < 2.0f)
+		return false;
+
+	float mean = aux[0]/num_samples;
+	float variance = max(aux[1]/num_samples - mean*mean, 0.0f) *
+	                 num_samples/(num_samples - 1.0f);
+	float error = sqrtf(variance/num_samples) / (1e-4f + sqrtf(max(mean, 0.0f)));
+
+#ifdef __KERNEL_DEBUG__
+	if(kernel_data.film.pass_flag & PASS_ADAPTIVE_ERROR) {
+		buffer[kernel_data.film.pass_adaptive_error] = error;
+	}
+#endif
+
+	if(error < threshold) {
+		aux[3] = 1.0f;
+		return true;
+	}
+
+	return false;
+}
+
+/* Scale all accumulated passes of a pixel which stopped early, so it looks as
+ * if num_samples samples were taken. Passes which are only written once per
+ * pixel are left untouched. */
+ccl_device void kernel_adaptive_post_adjust(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            float num_samples,
+                                            int x, int y,
+                                            int offset,
+                                            int stride)
+{
+	if(!(kernel_data.film.pass_flag & PASS_ADAPTIVE_AUX))
+		return;
+
+	int index = offset + x + y*stride;
+	buffer += index*kernel_data.film.pass_stride;
+
+	ccl_global float *aux = buffer + kernel_data.film.pass_adaptive_aux;
+	float pixel_samples = aux[2];
+
+	if(pixel_samples == 0.0f || pixel_samples >= num_samples)
+		return;
+
+	int flag = kernel_data.film.pass_flag;
+	float depth = (flag & PASS_DEPTH)? buffer[kernel_data.film.pass_depth]: 0.0f;
+	float object_id = (flag & PASS_OBJECT_ID)? buffer[kernel_data.film.pass_object_id]: 0.0f;
+	float material_id = (flag & PASS_MATERIAL_ID)? buffer[kernel_data.film.pass_material_id]: 0.0f;
+#ifdef __KERNEL_DEBUG__
+	float error = (flag & PASS_ADAPTIVE_ERROR)? buffer[kernel_data.film.pass_adaptive_error]: 0.0f;
+#endif
+
+	float scale = num_samples/pixel_samples;
+	for(int i = 0; i < kernel_data.film.pass_stride; i++) {
+		buffer[i] *= scale;
+	}
+
+	if(flag & PASS_DEPTH)
+		buffer[kernel_data.film.pass_depth] = depth;
+	if(flag & PASS_OBJECT_ID)
+		buffer[kernel_data.film.pass_object_id] = object_id;
+	if(flag & PASS_MATERIAL_ID)
+		buffer[kernel_data.film.pass_material_id] = material_id;
+#ifdef __KERNEL_DEBUG__
+	if(flag & PASS_ADAPTIVE_ERROR)
+		buffer[kernel_data.film.pass_adaptive_error] = error;
+#endif
+}
+
+CCL_NAMESPACE_END
+
@@ -153,6 +153,22 @@ template<typename T> struct texture_image  {
 		return x - (float)i;
 	}
 
+	/* Voxel lookup for 3D images, which may be stored as sparse tiles. */
+	ccl_always_inline float4 read_3d(int x, int y, int z)
+	{
+		if(sparse_offsets) {
+			int tile = (x >> TEX_SPARSE_TILE_SHIFT) +
+			           ((y >> TEX_SPARSE_TILE_SHIFT) +
+			            (z >> TEX_SPARSE_TILE_SHIFT)*sparse_tiles_y)*sparse_tiles_x;
+			int voxel = (x & TEX_SPARSE_TILE_MASK) +
+			            ((y & TEX_SPARSE_TILE_MASK) << TEX_SPARSE_TILE_SHIFT) +
+			            ((z & TEX_SPARSE_TILE_MASK) << (2*TEX_SPARSE_TILE_SHIFT));
+			return read(data[sparse_offsets[tile] + voxel]);
+		}
+
+		return read(data[x + y*width + z*width*height]);
+	}
+
 	ccl_always_inline float4 interp(float x, float y)
 	{
 		if(UNLIKELY(!data))
@@ -329,7 +345,7 @@ template<typename T> struct texture_image  {
 					return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 			}
 
-			return read(data[ix + iy*width + iz*width*height]);
+			return read_3d(ix, iy, iz);
 		}
 		else if(interpolation == INTERPOLATION_LINEAR) {
 			float tx = frac(x*(float)width - 0.5f, &ix);
@@ -369,15 +385,15 @@ template<typename T> struct texture_image  {
 
 			float4 r;
 
-			r  = (1.0f - tz)*(1.0f - ty)*(1.0f - tx)*read(data[ix + iy*width + iz*width*height]);
-			r += (1.0f - tz)*(1.0f - ty)*tx*read(data[nix + iy*width + iz*width*height]);
-			r += (1.0f - tz)*ty*(1.0f - tx)*read(data[ix + niy*width + iz*width*height]);
-			r += (1.0f - tz)*ty*tx*read(data[nix + niy*width + iz*width*height]);
+			r  = (1.0f - tz)*(1.0f - ty)*(1.0f - tx)*read_3d(ix, iy, iz);
+			r += (1.0f - tz)*(1.0f - ty)*tx*read_3d(nix, iy, iz);
+			r += (1.0f - tz)*ty*(1.0f - tx)*read_3d(ix, niy, iz);
+			r += (1.0f - tz)*ty*tx*read_3d(nix, niy, iz);
 
-			r += tz*(1.0f - ty)*(1.0f - tx)*read(data[ix + iy*width + niz*width*height]);
-			r += tz*(1.0f - ty)*tx*read(data[nix + iy*width + niz*width*height]);
-			r += tz*ty*(1.0f - tx)*read(data[ix + niy*width + niz*width*height]);
-			r += tz*ty*tx*read(data[nix + niy*width + niz*width*height]);
+			r += tz*(1.0f - ty)*(1.0f - tx)*read_3d(ix, iy, niz);
+			r += tz*(1.0f - ty)*tx*read_3d(nix, iy, niz);
+			r += tz*ty*(1.0f - tx)*read_3d(ix, niy, niz);
+			r += tz*ty*tx*read_3d(nix, niy, niz);
 
 			return r;
 		}
@@ -436,20 +452,14 @@ template<typename T> struct texture_image  {
 			}
 
 			const int xc[4] = {pix, ix, nix, nnix};
-			const int yc[4] = {width * piy,
-			                   width * iy,
-			                   width * niy,
-			                   width * nniy};
-			const int zc[4] = {width * height * piz,
-			                   width * height * iz,
-			                   width * height * niz,
-			                   width * height * nniz};
+			const int yc[4] = {piy, iy, niy, nniy};
+			const int zc[4] = {piz, iz, niz, nniz};
 			float u[4], v[4], w[4];
 
 			/* Some helper macro to keep code reasonable size,
 			 * let compiler to inline all the matrix multiplications.
 			 */
-#define DATA(x, y, z) (read(data[xc[x] + yc[y] + zc[z]]))
+#define DATA(x, y, z) (read_3d(xc[x], yc[y], zc[z]))
 #define COL_TERM(col, row) \
 			(v[col] * (u[0] * DATA(0, col, row) + \
 			           u[1] * DATA(1, col, row) + \
@@ -474,6 +484,54 @@ template<typename T> struct texture_image  {
 		}
 	}
 
+	/* Test if all voxels that an interpolated lookup at x, y, z could read
+	 * are in empty tiles of a sparse image. Dense images are never empty. */
+	ccl_always_inline bool is_empty_3d(float x, float y, float z)
+	{
+		if(!sparse_offsets)
+			return false;
+
+		if(extension == EXTENSION_CLIP &&
+		   (x < 0.0f || y < 0.0f || z < 0.0f || x > 1.0f || y > 1.0f || z > 1.0f))
+		{
+			return true;
+		}
+
+		int ix, iy, iz;
+		frac(x*(float)width - 0.5f, &ix);
+		frac(y*(float)height - 0.5f, &iy);
+		frac(z*(float)depth - 0.5f, &iz);
+
+		/* Wrapping around is rare, don't bother finding the tiles. */
+		if(extension == EXTENSION_REPEAT &&
+		   (ix < 1 || iy < 1 || iz < 1 ||
+		    ix + 2 >= width || iy + 2 >= height || iz + 2 >= depth))
+		{
+			return false;
+		}
+
+		/* Tiles covering the cubic filter footprint, linear and closest
+		 * lookups read a subset of these voxels. */
+		const int tiles_z = (depth + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+		const int tx0 = clamp(ix - 1, 0, width - 1) >> TEX_SPARSE_TILE_SHIFT;
+		const int ty0 = clamp(iy - 1, 0, height - 1) >> TEX_SPARSE_TILE_SHIFT;
+		const int tz0 = clamp(iz - 1, 0, depth - 1) >> TEX_SPARSE_TILE_SHIFT;
+		const int tx1 = min(clamp(ix + 2, 0, width - 1) >> TEX_SPARSE_TILE_SHIFT, sparse_tiles_x - 1);
+		const int ty1 = min(clamp(iy + 2, 0, height - 1) >> TEX_SPARSE_TILE_SHIFT, sparse_tiles_y - 1);
+		const int tz1 = min(clamp(iz + 2, 0, depth - 1) >> TEX_SPARSE_TILE_SHIFT, tiles_z - 1);
+
+		for(int tz = tz0; tz <= tz1; tz++) {
+			for(int ty = ty0; ty <= ty1; ty++) {
+				for(int tx = tx0; tx <= tx1; tx++) {
+					if(sparse_offsets[tx + (ty + tz*sparse_tiles_y)*sparse_tiles_x] != 0)
+						return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
 	ccl_always_inline void dimensions_set(int width_, int height_, int depth_)
 	{
 		width = width_;
@@ -481,10 +539,21 @@ template<typename T> struct texture_image  {
 		depth = depth_;
 	}
 
+	ccl_always_inline void sparse_offsets_set(int *offsets)
+	{
+		sparse_offsets = offsets;
+		sparse_tiles_x = (width + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+		sparse_tiles_y = (height + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+	}
+
 	T *data;
 	int interpolation;
 	ExtensionType extension;
 	int width, height, depth;
+
+	/* Tile offsets of sparse 3D images, NULL for dense images. */
+	int *sparse_offsets;
+	int sparse_tiles_x, sparse_tiles_y;
 #undef SET_CUBIC_SPLINE_WEIGHTS
 };
 
@@ -513,6 +582,7 @@ typedef texture_image<half4> texture_image_half4;
 #define kernel_tex_image_interp(tex,x,y) kernel_tex_image_interp_impl(kg,tex,x,y)
 #define kernel_tex_image_interp_3d(tex, x, y, z) kernel_tex_image_interp_3d_impl(kg,tex,x,y,z)
 #define kernel_tex_image_interp_3d_ex(tex, x, y, z, interpolation) kernel_tex_image_interp_3d_ex_impl(kg,tex, x, y, z, interpolation)
+#define kernel_tex_image_is_empty_3d(tex, x, y, z) kernel_tex_image_is_empty_3d_impl(kg,tex,x,y,z)
 
 #define kernel_data (kg->__data)
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Denoising
+ *
+ * Non-local means filter on the combined pass, guided by the normal, diffuse
+ * color and depth passes. Color similarity is measured over small patches,
+ * relative to the pixel intensity so dark and bright regions are filtered
+ * alike. The feature passes converge much faster than the combined pass and
+ * reject neighbors across geometric and texture edges that the noisy color
+ * alone can't detect.
+ *
+ * Neighbors and patches are read from a rect larger than the filtered one.
+ * A tile is denoised once its neighbor tiles finished rendering, with their
+ * pixels up to the filter radius plus DENOISE_PATCH_RADIUS around the tile,
+ * so pixels along tile borders see the same neighbors as inner pixels. */
+
+#define DENOISE_NORMAL_SCALE 10.0f
+#define DENOISE_ALBEDO_SCALE 50.0f
+#define DENOISE_DEPTH_SCALE 20.0f
+
+ccl_device_inline ccl_global float *kernel_denoise_pixel(KernelGlobals *kg,
+                                                         ccl_global float *buffer,
+                                                         int x, int y,
+                                                         int offset,
+                                                         int stride)
+{
+	return buffer + (offset + x + y*stride)*kernel_data.film.pass_stride;
+}
+
+ccl_device_inline float3 kernel_denoise_color(KernelGlobals *kg,
+                                              ccl_global float *buffer,
+                                              int x, int y,
+                                              int offset,
+                                              int stride)
+{
+	ccl_global float *pixel = kernel_denoise_pixel(kg, buffer, x, y, offset, stride) + kernel_data.film.pass_combined;
+	return make_float3(pixel[0], pixel[1], pixel[2]);
+}
+
+/* Relative squared distance of two patches, averaged over the patch pixels
+ * inside the rect that can be read. */
+ccl_device float kernel_denoise_patch_distance(KernelGlobals *kg,
+                                               ccl_global float *buffer,
+                                               int px, int py,
+                                               int qx, int qy,
+                                               int4 rect,
+                                               int offset,
+                                               int stride)
+{
+	float distance = 0.0f;
+	int num = 0;
+
+	for(int dy = -DENOISE_PATCH_RADIUS; dy <= DENOISE_PATCH_RADIUS; dy++) {
+		if(py + dy < rect.y || py + dy >= rect.w || qy + dy < rect.y || qy + dy >= rect.w)
+			continue;
+
+		for(int dx = -DENOISE_PATCH_RADIUS; dx <= DENOISE_PATCH_RADIUS; dx++) {
+			if(px + dx < rect.x || px + dx >= rect.z || qx + dx < rect.x || qx + dx >= rect.z)
+				continue;
+
+			float3 p = kernel_denoise_color(kg, buffer, px + dx, py + dy, offset, stride);
+			float3 q = kernel_denoise_color(kg, buffer, qx + dx, qy + dy, offset, stride);
+			float3 d = (p - q)*(p - q) / (make_float3(1e-4f, 1e-4f, 1e-4f) + p*p + q*q);
+
+			distance += (d.x + d.y + d.z)*(1.0f/3.0f);
+			num++;
+		}
+	}
+
+	return (num > 0)? distance/num: 0.0f;
+}
+
+/* Filter the combined pass of all pixels in rect (x0, y0, x1, y1), reading
+ * neighbors from buffer_rect which contains rect. temp must have room for one
+ * float4 per pixel of rect. sample_scale converts the accumulated feature
+ * passes to averages. */
+ccl_device void kernel_denoise_tile(KernelGlobals *kg,
+                                    ccl_global float *buffer,
+                                    float4 *temp,
+                                    int4 rect,
+                                    int4 buffer_rect,
+                                    int offset,
+                                    int stride,
+                                    int radius,
+                                    float strength,
+                                    float sample_scale)
+{
+	int flag = kernel_data.film.pass_flag;
+	int width = rect.z - rect.x;
+	float inv_h2 = 1.0f/max(strength*strength, 1e-4f);
+
+	for(int y = rect.y; y < rect.w; y++) {
+		for(int x = rect.x; x < rect.z; x++) {
+			ccl_global float *p = kernel_denoise_pixel(kg, buffer, x, y, offset, stride);
+			float3 p_normal = make_float3(0.0f, 0.0f, 0.0f);
+			float3 p_albedo = make_float3(0.0f, 0.0f, 0.0f);
+			float p_depth = 0.0f;
+
+			if(flag & PASS_NORMAL) {
+				ccl_global float *n = p + kernel_data.film.pass_normal;
+				p_normal = safe_normalize(make_float3(n[0], n[1], n[2]));
+			}
+			if(flag & PASS_DIFFUSE_COLOR) {
+				ccl_global float *a = p + kernel_data.film.pass_diffuse_color;
+				p_albedo = make_float3(a[0], a[1], a[2])*sample_scale;
+			}
+			if(flag & PASS_DEPTH)
+				p_depth = p[kernel_data.film.pass_depth];
+
+			float3 sum = make_float3(0.0f, 0.0f, 0.0f);
+			float sum_weight = 0.0f;
+
+			int y0 = max(y - radius, buffer_rect.y), y1 = min(y + radius + 1, buffer_rect.w);
+			int x0 = max(x - radius, buffer_rect.x), x1 = min(x + radius + 1, buffer_rect.z);
+
+			for(int qy = y0; qy < y1; qy++) {
+				for(int qx = x0; qx < x1; qx++) {
+					ccl_global float *q = kernel_denoise_pixel(kg, buffer, qx, qy, offset, stride);
+					float distance = kernel_denoise_patch_distance(kg, buffer, x, y, qx, qy, buffer_rect, offset, stride)*inv_h2;
+
+					if(flag & PASS_NORMAL) {
+						ccl_global float *n = q + kernel_data.film.pass_normal;
+						float3 q_normal = safe_normalize(make_float3(n[0], n[1], n[2]));
+						distance += (1.0f - dot(p_normal, q_normal))*DENOISE_NORMAL_SCALE;
+					}
+					if(flag & PASS_DIFFUSE_COLOR) {
+						ccl_global float *a = q + kernel_data.film.pass_diffuse_color;
+						float3 d = p_albedo - make_float3(a[0], a[1], a[2])*sample_scale;
+						distance += dot(d, d)*DENOISE_ALBEDO_SCALE;
+					}
+					if(flag & PASS_DEPTH) {
+						float q_depth = q[kernel_data.film.pass_depth];
+						distance += fabsf(p_depth - q_depth)/(max(p_depth, q_depth) + 1e-4f)*DENOISE_DEPTH_SCALE;
+					}
+
+					float weight = expf(-distance);
+					ccl_global float *c = q + kernel_data.film.pass_combined;
+
+					sum += make_float3(c[0], c[1], c[2])*weight;
+					sum_weight += weight;
+				}
+			}
+
+			/* Alpha is kept, it converges fast and filtering would blur
+			 * object silhouettes against the background. */
+			float3 color = sum/sum_weight;
+			temp[(y - rect.y)*width + (x - rect.x)] = make_float4(color.x, color.y, color.z,
+			                                                       p[kernel_data.film.pass_combined + 3]);
+		}
+	}
+
+	for(int y = rect.y; y < rect.w; y++) {
+		for(int x = rect.x; x < rect.z; x++) {
+			ccl_global float *c = kernel_denoise_pixel(kg, buffer, x, y, offset, stride) + kernel_data.film.pass_combined;
+			float4 color = temp[(y - rect.y)*width + (x - rect.x)];
+
+			c[0] = color.x;
+			c[1] = color.y;
+			c[2] = color.z;
+			c[3] = color.w;
+		}
+	}
+}
+
+CCL_NAMESPACE_END
+
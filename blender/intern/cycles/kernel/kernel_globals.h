@@ -16,6 +16,12 @@
 
 /* Constant Globals */
 
+#include "kernel_profiling.h"
+
+#ifdef __KERNEL_CPU__
+#  include "util_profiling.h"
+#endif
+
 CCL_NAMESPACE_BEGIN
 
 /* On the CPU, we pass along the struct KernelGlobals to nearly everywhere in
@@ -64,6 +70,12 @@ typedef struct KernelGlobals {
 	/* Storage for decoupled volume steps. */
 	VolumeStep *decoupled_volume_steps[2];
 	int decoupled_volume_steps_index;
+
+	/* Number of rays traced by this thread. */
+	size_t num_rays;
+
+	/* What this thread is busy with, read by the profiler. */
+	ProfilingState profiler;
 } KernelGlobals;
 
 #endif  /* __KERNEL_CPU__ */
@@ -156,6 +156,8 @@ ccl_device_inline void kernel_write_light_passes(KernelGlobals *kg, ccl_global f
 
 	if(!kernel_data.film.use_light_pass)
 		return;
+
+	PROFILING_INIT(kg, PROFILING_WRITE_PASSES);
 	
 	if(flag & PASS_DIFFUSE_INDIRECT)
 		kernel_write_pass_float3(buffer + kernel_data.film.pass_diffuse_indirect, sample, L->indirect_diffuse);
@@ -199,5 +201,31 @@ ccl_device_inline void kernel_write_light_passes(KernelGlobals *kg, ccl_global f
 #endif
 }
 
+#ifdef __KERNEL_CPU__
+/* Add the time spent on one sample of num_pixels consecutive pixels to the
+ * render time pass, in microseconds per pixel. */
+ccl_device_inline void kernel_write_render_time(KernelGlobals *kg,
+                                                ccl_global float *buffer,
+                                                int sample,
+                                                int x, int y,
+                                                int num_pixels,
+                                                int offset,
+                                                int stride,
+                                                double time)
+{
+	if(!(kernel_data.film.pass_flag & PASS_RENDER_TIME))
+		return;
+
+	float pixel_time = (float)(time*1e6/num_pixels);
+
+	for(int i = 0; i < num_pixels; i++) {
+		int index = offset + x + i + y*stride;
+		kernel_write_pass_float(buffer + index*kernel_data.film.pass_stride + kernel_data.film.pass_render_time,
+		                        sample,
+		                        pixel_time);
+	}
+}
+#endif
+
 CCL_NAMESPACE_END
 
@@ -31,6 +31,7 @@
 #include "kernel_shader.h"
 #include "kernel_light.h"
 #include "kernel_passes.h"
+#include "kernel_adaptive_sampling.h"
 
 #ifdef __SUBSURFACE__
 #  include "kernel_subsurface.h"
@@ -63,17 +64,21 @@ ccl_device void kernel_path_indirect(KernelGlobals *kg,
                                      PathState *state,
                                      PathRadiance *L)
 {
+	PROFILING_INIT(kg, PROFILING_PATH_INTEGRATE);
+
 	/* path iteration */
 	for(;;) {
 		/* intersect scene */
 		Intersection isect;
 		uint visibility = path_state_ray_visibility(kg, state);
+		PROFILING_EVENT(PROFILING_INTERSECT);
 		bool hit = scene_intersect(kg,
 		                           *ray,
 		                           visibility,
 		                           &isect,
 		                           NULL,
 		                           0.0f, 0.0f);
+		PROFILING_EVENT(PROFILING_PATH_INTEGRATE);
 
 #ifdef __LAMP_MIS__
 		if(kernel_data.integrator.use_lamp_mis && !(state->flag & PATH_RAY_CAMERA)) {
@@ -605,8 +610,12 @@ ccl_device_inline float4 kernel_path_integrate(KernelGlobals *kg,
                                                RNG *rng,
                                                int sample,
                                                Ray ray,
-                                               ccl_global float *buffer)
+                                               ccl_global float *buffer,
+                                               const Intersection *camera_isect,
+                                               StreamShadowRay *shadow_ray)
 {
+	PROFILING_INIT(kg, PROFILING_PATH_INTEGRATE);
+
 	/* initialize */
 	PathRadiance L;
 	float3 throughput = make_float3(1.0f, 1.0f, 1.0f);
@@ -639,26 +648,41 @@ ccl_device_inline float4 kernel_path_integrate(KernelGlobals *kg,
 		/* intersect scene */
 		Intersection isect;
 		uint visibility = path_state_ray_visibility(kg, &state);
-
+		bool hit;
+
+#ifdef __RAY_STREAM__
+		if(camera_isect) {
+			/* camera ray was already traced as part of a ray stream */
+			isect = *camera_isect;
+			hit = (isect.prim != PRIM_NONE);
+			camera_isect = NULL;
+		}
+		else
+#endif
+		{
 #ifdef __HAIR__
-		float difl = 0.0f, extmax = 0.0f;
-		uint lcg_state = 0;
-
-		if(kernel_data.bvh.have_curves) {
-			if((kernel_data.cam.resolution == 1) && (state.flag & PATH_RAY_CAMERA)) {	
-				float3 pixdiff = ray.dD.dx + ray.dD.dy;
-				/*pixdiff = pixdiff - dot(pixdiff, ray.D)*ray.D;*/
-				difl = kernel_data.curve.minimum_width * len(pixdiff) * 0.5f;
-			}
+			float difl = 0.0f, extmax = 0.0f;
+			uint lcg_state = 0;
+
+			if(kernel_data.bvh.have_curves) {
+				if((kernel_data.cam.resolution == 1) && (state.flag & PATH_RAY_CAMERA)) {	
+					float3 pixdiff = ray.dD.dx + ray.dD.dy;
+					/*pixdiff = pixdiff - dot(pixdiff, ray.D)*ray.D;*/
+					difl = kernel_data.curve.minimum_width * len(pixdiff) * 0.5f;
+				}
 
-			extmax = kernel_data.curve.maximum_width;
-			lcg_state = lcg_state_init(rng, &state, 0x51633e2d);
-		}
+				extmax = kernel_data.curve.maximum_width;
+				lcg_state = lcg_state_init(rng, &state, 0x51633e2d);
+			}
 
-		bool hit = scene_intersect(kg, ray, visibility, &isect, &lcg_state, difl, extmax);
+			PROFILING_EVENT(PROFILING_INTERSECT);
+			hit = scene_intersect(kg, ray, visibility, &isect, &lcg_state, difl, extmax);
 #else
-		bool hit = scene_intersect(kg, ray, visibility, &isect, NULL, 0.0f, 0.0f);
+			PROFILING_EVENT(PROFILING_INTERSECT);
+			hit = scene_intersect(kg, ray, visibility, &isect, NULL, 0.0f, 0.0f);
 #endif
+			PROFILING_EVENT(PROFILING_PATH_INTEGRATE);
+		}
 
 #ifdef __KERNEL_DEBUG__
 		if(state.flag & PATH_RAY_CAMERA) {
@@ -885,7 +909,12 @@ ccl_device_inline float4 kernel_path_integrate(KernelGlobals *kg,
 #endif  /* __SUBSURFACE__ */
 
 		/* direct lighting */
-		kernel_path_surface_connect_light(kg, rng, &sd, &emission_sd, throughput, &state, &L);
+#ifdef __RAY_STREAM__
+		if(kernel_path_surface_can_queue_light(kg, &state, shadow_ray))
+			kernel_path_surface_queue_light(kg, rng, &sd, &emission_sd, throughput, &state, shadow_ray);
+		else
+#endif
+			kernel_path_surface_connect_light(kg, rng, &sd, &emission_sd, throughput, &state, &L);
 
 		/* compute direct lighting and next bounce */
 		if(!kernel_path_surface_bounce(kg, rng, &sd, &throughput, &state, &L, &ray))
@@ -927,6 +956,8 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	ccl_global float *buffer, ccl_global uint *rng_state,
 	int sample, int x, int y, int offset, int stride)
 {
+	PROFILING_INIT(kg, PROFILING_RAY_SETUP);
+
 	/* buffer offset */
 	int index = offset + x + y*stride;
 	int pass_stride = kernel_data.film.pass_stride;
@@ -934,6 +965,10 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	rng_state += index;
 	buffer += index*pass_stride;
 
+	/* skip pixels which adaptive sampling considers converged */
+	if(kernel_adaptive_pixel_converged(kg, buffer, sample))
+		return;
+
 	/* initialize random numbers and ray */
 	RNG rng;
 	Ray ray;
@@ -944,15 +979,170 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 	float4 L;
 
 	if(ray.t != 0.0f)
-		L = kernel_path_integrate(kg, &rng, sample, ray, buffer);
+		L = kernel_path_integrate(kg, &rng, sample, ray, buffer, NULL, NULL);
 	else
 		L = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 
 	/* accumulate result in output buffer */
+	PROFILING_EVENT(PROFILING_WRITE_PASSES);
 	kernel_write_pass_float4(buffer, sample, L);
+	kernel_write_adaptive_aux(kg, buffer, sample, L);
 
 	path_rng_end(kg, rng_state, rng);
 }
 
+#ifdef __RAY_STREAM__
+/* Add the light of an unblocked queued shadow ray to the light passes, and
+ * return it for the combined pass. Light is not clamped when shadow rays are
+ * queued, so adding it separately gives the same sum. */
+ccl_device_inline float3 kernel_path_stream_shadow_write(KernelGlobals *kg,
+                                                         ccl_global float *buffer,
+                                                         StreamShadowRay *shadow_ray)
+{
+	PathRadiance L;
+	path_radiance_init(&L, kernel_data.film.use_light_pass);
+	path_radiance_accum_light(&L,
+	                          shadow_ray->throughput,
+	                          &shadow_ray->L_light,
+	                          make_float3(1.0f, 1.0f, 1.0f),
+	                          1.0f,
+	                          0,
+	                          shadow_ray->is_lamp);
+
+	float3 L_sum = path_radiance_clamp_and_sum(kg, &L);
+
+#ifdef __PASSES__
+	/* the path wrote its passes of this sample already, always add */
+	const int sample = 1;
+	int flag = kernel_data.film.pass_flag;
+
+	if(kernel_data.film.use_light_pass) {
+		if(flag & PASS_DIFFUSE_DIRECT)
+			kernel_write_pass_float3(buffer + kernel_data.film.pass_diffuse_direct, sample, L.direct_diffuse);
+		if(flag & PASS_GLOSSY_DIRECT)
+			kernel_write_pass_float3(buffer + kernel_data.film.pass_glossy_direct, sample, L.direct_glossy);
+		if(flag & PASS_TRANSMISSION_DIRECT)
+			kernel_write_pass_float3(buffer + kernel_data.film.pass_transmission_direct, sample, L.direct_transmission);
+		if(flag & PASS_SUBSURFACE_DIRECT)
+			kernel_write_pass_float3(buffer + kernel_data.film.pass_subsurface_direct, sample, L.direct_subsurface);
+		/* shadow count in w was written by the path already */
+		if(flag & PASS_SHADOW) {
+			float4 shadow = L.shadow;
+			shadow.w = 0.0f;
+			kernel_write_pass_float4(buffer + kernel_data.film.pass_shadow, sample, shadow);
+		}
+	}
+#endif
+
+	return L_sum;
+}
+#endif  /* __RAY_STREAM__ */
+
+#ifdef __KERNEL_CPU__
+/* Path trace a row of up to RAY_STREAM_SIZE pixels, with the camera rays of
+ * all pixels traced together as a ray stream, and the shadow rays of their
+ * first surface hits as another one when they are opaque. Following bounces
+ * are traced per pixel. */
+ccl_device void kernel_path_trace_stream(KernelGlobals *kg,
+	ccl_global float *buffer, ccl_global uint *rng_state,
+	int sample, int x, int y, int num_pixels, int offset, int stride)
+{
+#ifdef __RAY_STREAM__
+	if(scene_intersect_stream_supported(kg)) {
+		PROFILING_INIT(kg, PROFILING_RAY_SETUP);
+
+		int pass_stride = kernel_data.film.pass_stride;
+		RNG rng[RAY_STREAM_SIZE];
+		Ray rays[RAY_STREAM_SIZE];
+		Intersection isects[RAY_STREAM_SIZE];
+		int pixel_index[RAY_STREAM_SIZE];
+		int num_rays = 0;
+
+		kernel_assert(num_pixels <= RAY_STREAM_SIZE);
+
+		/* initialize random numbers and camera rays */
+		for(int i = 0; i < num_pixels; i++) {
+			int index = offset + x + i + y*stride;
+
+			/* skip pixels which adaptive sampling considers converged */
+			if(kernel_adaptive_pixel_converged(kg, buffer + index*pass_stride, sample))
+				continue;
+
+			kernel_path_trace_setup(kg, rng_state + index, sample, x + i, y, &rng[num_rays], &rays[num_rays]);
+			pixel_index[num_rays] = index;
+			num_rays++;
+		}
+
+		/* trace camera rays together */
+		PROFILING_EVENT(PROFILING_INTERSECT);
+		scene_intersect_stream(kg, rays, isects, num_rays, PATH_RAY_CAMERA);
+		PROFILING_EVENT(PROFILING_RAY_SETUP);
+
+		/* integrate, with the shadow ray of the first surface hit queued */
+		StreamShadowRay shadow_rays[RAY_STREAM_SIZE];
+		float4 L[RAY_STREAM_SIZE];
+
+		for(int i = 0; i < num_rays; i++) {
+			ccl_global float *pixel_buffer = buffer + pixel_index[i]*pass_stride;
+
+			shadow_rays[i].queued = false;
+
+			if(rays[i].t != 0.0f)
+				L[i] = kernel_path_integrate(kg, &rng[i], sample, rays[i], pixel_buffer, &isects[i], &shadow_rays[i]);
+			else
+				L[i] = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+			PROFILING_EVENT(PROFILING_RAY_SETUP);
+		}
+
+		/* trace queued shadow rays together */
+		int shadow_index[RAY_STREAM_SIZE];
+		int num_shadow_rays = 0;
+
+		for(int i = 0; i < num_rays; i++) {
+			if(shadow_rays[i].queued) {
+				rays[num_shadow_rays] = shadow_rays[i].ray;
+				shadow_index[num_shadow_rays] = i;
+				num_shadow_rays++;
+			}
+		}
+
+		if(num_shadow_rays) {
+			PROFILING_EVENT(PROFILING_SHADOW);
+			scene_intersect_stream(kg, rays, isects, num_shadow_rays, PATH_RAY_SHADOW_OPAQUE);
+			PROFILING_EVENT(PROFILING_RAY_SETUP);
+		}
+
+		for(int j = 0; j < num_shadow_rays; j++) {
+			if(isects[j].prim == PRIM_NONE) {
+				int i = shadow_index[j];
+				ccl_global float *pixel_buffer = buffer + pixel_index[i]*pass_stride;
+				float3 L_light = kernel_path_stream_shadow_write(kg, pixel_buffer, &shadow_rays[i]);
+
+				L[i] += make_float4(L_light.x, L_light.y, L_light.z, 0.0f);
+			}
+		}
+
+		for(int i = 0; i < num_rays; i++) {
+			ccl_global float *pixel_buffer = buffer + pixel_index[i]*pass_stride;
+
+			/* accumulate result in output buffer */
+			PROFILING_EVENT(PROFILING_WRITE_PASSES);
+			kernel_write_pass_float4(pixel_buffer, sample, L[i]);
+			kernel_write_adaptive_aux(kg, pixel_buffer, sample, L[i]);
+
+			path_rng_end(kg, rng_state + pixel_index[i], rng[i]);
+			PROFILING_EVENT(PROFILING_RAY_SETUP);
+		}
+
+		return;
+	}
+#endif
+
+	for(int i = 0; i < num_pixels; i++)
+		kernel_path_trace(kg, buffer, rng_state, sample, x + i, y, offset, stride);
+}
+#endif  /* __KERNEL_CPU__ */
+
 CCL_NAMESPACE_END
 
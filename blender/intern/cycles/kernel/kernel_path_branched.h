@@ -238,6 +238,8 @@ ccl_device void kernel_branched_path_subsurface_scatter(KernelGlobals *kg,
 
 ccl_device float4 kernel_branched_path_integrate(KernelGlobals *kg, RNG *rng, int sample, Ray ray, ccl_global float *buffer)
 {
+	PROFILING_INIT(kg, PROFILING_PATH_INTEGRATE);
+
 	/* initialize */
 	PathRadiance L;
 	float3 throughput = make_float3(1.0f, 1.0f, 1.0f);
@@ -282,10 +284,13 @@ ccl_device float4 kernel_branched_path_integrate(KernelGlobals *kg, RNG *rng, in
 			lcg_state = lcg_state_init(rng, &state, 0x51633e2d);
 		}
 
+		PROFILING_EVENT(PROFILING_INTERSECT);
 		bool hit = scene_intersect(kg, ray, visibility, &isect, &lcg_state, difl, extmax);
 #else
+		PROFILING_EVENT(PROFILING_INTERSECT);
 		bool hit = scene_intersect(kg, ray, visibility, &isect, NULL, 0.0f, 0.0f);
 #endif
+		PROFILING_EVENT(PROFILING_PATH_INTEGRATE);
 
 #ifdef __KERNEL_DEBUG__
 		debug_data.num_bvh_traversal_steps += isect.num_traversal_steps;
@@ -590,6 +595,8 @@ ccl_device void kernel_branched_path_trace(KernelGlobals *kg,
 	ccl_global float *buffer, ccl_global uint *rng_state,
 	int sample, int x, int y, int offset, int stride)
 {
+	PROFILING_INIT(kg, PROFILING_RAY_SETUP);
+
 	/* buffer offset */
 	int index = offset + x + y*stride;
 	int pass_stride = kernel_data.film.pass_stride;
@@ -597,6 +604,10 @@ ccl_device void kernel_branched_path_trace(KernelGlobals *kg,
 	rng_state += index;
 	buffer += index*pass_stride;
 
+	/* skip pixels which adaptive sampling considers converged */
+	if(kernel_adaptive_pixel_converged(kg, buffer, sample))
+		return;
+
 	/* initialize random numbers and ray */
 	RNG rng;
 	Ray ray;
@@ -612,7 +623,9 @@ ccl_device void kernel_branched_path_trace(KernelGlobals *kg,
 		L = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 
 	/* accumulate result in output buffer */
+	PROFILING_EVENT(PROFILING_WRITE_PASSES);
 	kernel_write_pass_float4(buffer, sample, L);
+	kernel_write_adaptive_aux(kg, buffer, sample, L);
 
 	path_rng_end(kg, rng_state, rng);
 }
@@ -24,6 +24,8 @@ ccl_device_noinline void kernel_branched_path_surface_connect_light(KernelGlobal
 	float num_samples_adjust, PathRadiance *L, int sample_all_lights)
 {
 #ifdef __EMISSION__
+	PROFILING_INIT(kg, PROFILING_LIGHT_SAMPLE);
+
 	/* sample illumination from lights to find path contribution */
 	if(!(ccl_fetch(sd, flag) & SD_BSDF_HAS_EVAL))
 		return;
@@ -192,6 +194,8 @@ ccl_device_inline void kernel_path_surface_connect_light(KernelGlobals *kg, ccl_
 	if(!(kernel_data.integrator.use_direct_light && (ccl_fetch(sd, flag) & SD_BSDF_HAS_EVAL)))
 		return;
 
+	PROFILING_INIT(kg, PROFILING_LIGHT_SAMPLE);
+
 	/* sample illumination from lights to find path contribution */
 	float light_t = path_state_rng_1D(kg, rng, state, PRNG_LIGHT);
 	float light_u, light_v;
@@ -221,6 +225,68 @@ ccl_device_inline void kernel_path_surface_connect_light(KernelGlobals *kg, ccl_
 }
 #endif
 
+/* Light sample of a path whose opaque shadow ray is traced later, together
+ * with the shadow rays of the other paths in a ray stream. */
+typedef struct StreamShadowRay {
+	Ray ray;
+	BsdfEval L_light;
+	float3 throughput;
+	bool is_lamp;
+	bool queued;
+} StreamShadowRay;
+
+#ifdef __RAY_STREAM__
+
+/* Shadow rays can be queued when they are opaque only and the light they
+ * carry is not clamped, so it can be added to the path radiance later. */
+ccl_device_inline bool kernel_path_surface_can_queue_light(KernelGlobals *kg,
+                                                           PathState *state,
+                                                           StreamShadowRay *shadow_ray)
+{
+	return shadow_ray != NULL &&
+	       !shadow_ray->queued &&
+	       state->bounce == 0 &&
+	       !kernel_data.integrator.transparent_shadows &&
+	       kernel_data.integrator.sample_clamp_direct == FLT_MAX
+#ifdef __VOLUME__
+	       && state->volume_stack[0].shader == SHADER_NONE
+#endif
+	       ;
+}
+
+/* Same light sampling as kernel_path_surface_connect_light, with the shadow
+ * ray queued instead of traced. */
+ccl_device_inline void kernel_path_surface_queue_light(KernelGlobals *kg, RNG *rng,
+	ShaderData *sd, ShaderData *emission_sd, float3 throughput, PathState *state,
+	StreamShadowRay *shadow_ray)
+{
+#ifdef __EMISSION__
+	if(!(kernel_data.integrator.use_direct_light && (sd->flag & SD_BSDF_HAS_EVAL)))
+		return;
+
+	PROFILING_INIT(kg, PROFILING_LIGHT_SAMPLE);
+
+	float light_t = path_state_rng_1D(kg, rng, state, PRNG_LIGHT);
+	float light_u, light_v;
+	path_state_rng_2D(kg, rng, state, PRNG_LIGHT_U, &light_u, &light_v);
+
+#ifdef __OBJECT_MOTION__
+	shadow_ray->ray.time = sd->time;
+#endif
+
+	LightSample ls;
+	light_sample(kg, light_t, light_u, light_v, sd->time, sd->P, state->bounce, &ls);
+
+	if(direct_emission(kg, sd, emission_sd, &ls, state,
+	                   &shadow_ray->ray, &shadow_ray->L_light, &shadow_ray->is_lamp))
+	{
+		shadow_ray->throughput = throughput;
+		shadow_ray->queued = true;
+	}
+#endif
+}
+#endif  /* __RAY_STREAM__ */
+
 /* path tracing: bounce off or through surface to with new direction stored in ray */
 ccl_device bool kernel_path_surface_bounce(KernelGlobals *kg,
                                            ccl_addr_space RNG *rng,
@@ -838,6 +838,10 @@ ccl_device float3 shader_holdout_eval(KernelGlobals *kg, ShaderData *sd)
 ccl_device void shader_eval_surface(KernelGlobals *kg, ShaderData *sd, ccl_addr_space RNG *rng,
 	ccl_addr_space PathState *state, float randb, int path_flag, ShaderContext ctx)
 {
+	PROFILING_INIT(kg, PROFILING_SHADER_EVAL);
+	PROFILING_SHADER(ccl_fetch(sd, shader));
+	PROFILING_OBJECT(ccl_fetch(sd, object));
+
 	ccl_fetch(sd, num_closure) = 0;
 	ccl_fetch(sd, num_closure_extra) = 0;
 	ccl_fetch(sd, randb_closure) = randb;
@@ -869,6 +873,9 @@ ccl_device void shader_eval_surface(KernelGlobals *kg, ShaderData *sd, ccl_addr_
 ccl_device float3 shader_eval_background(KernelGlobals *kg, ShaderData *sd,
 	ccl_addr_space PathState *state, int path_flag, ShaderContext ctx)
 {
+	PROFILING_INIT(kg, PROFILING_SHADER_EVAL);
+	PROFILING_SHADER(ccl_fetch(sd, shader));
+
 	ccl_fetch(sd, num_closure) = 0;
 	ccl_fetch(sd, num_closure_extra) = 0;
 	ccl_fetch(sd, randb_closure) = 0.0f;
@@ -1020,12 +1027,17 @@ ccl_device_inline void shader_eval_volume(KernelGlobals *kg,
 	sd->num_closure_extra = 0;
 	sd->flag = 0;
 
+	PROFILING_INIT(kg, PROFILING_SHADER_EVAL);
+
 	for(int i = 0; stack[i].shader != SHADER_NONE; i++) {
 		/* setup shaderdata from stack. it's mostly setup already in
 		 * shader_setup_from_volume, this switching should be quick */
 		sd->object = stack[i].object;
 		sd->shader = stack[i].shader;
 
+		PROFILING_SHADER(sd->shader);
+		PROFILING_OBJECT(sd->object);
+
 		sd->flag &= ~(SD_SHADER_FLAGS|SD_OBJECT_FLAGS);
 		sd->flag |= kernel_tex_fetch(__shader_flag, (sd->shader & SHADER_MASK)*2);
 
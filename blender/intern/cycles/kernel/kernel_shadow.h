@@ -43,6 +43,8 @@ CCL_NAMESPACE_BEGIN
 
 ccl_device_inline bool shadow_blocked(KernelGlobals *kg, ShaderData *shadow_sd, PathState *state, Ray *ray, float3 *shadow)
 {
+	PROFILING_INIT(kg, PROFILING_SHADOW);
+
 	*shadow = make_float3(1.0f, 1.0f, 1.0f);
 
 	if(ray->t == 0.0f)
@@ -186,6 +188,8 @@ ccl_device_noinline bool shadow_blocked(KernelGlobals *kg,
                                         ccl_addr_space Ray *ray_input,
                                         float3 *shadow)
 {
+	PROFILING_INIT(kg, PROFILING_SHADOW);
+
 	*shadow = make_float3(1.0f, 1.0f, 1.0f);
 
 	if(ray_input->t == 0.0f)
@@ -40,6 +40,7 @@ KERNEL_TEX(float4, texture_float4, __objects_vector)
 /* triangles */
 KERNEL_TEX(uint, texture_uint, __tri_shader)
 KERNEL_TEX(float4, texture_float4, __tri_vnormal)
+KERNEL_TEX(uint, texture_uint, __tri_vnormal_oct)
 KERNEL_TEX(uint4, texture_uint4, __tri_vindex)
 KERNEL_TEX(uint, texture_uint, __tri_patch)
 KERNEL_TEX(float2, texture_float2, __tri_patch_uv)
@@ -41,7 +41,9 @@ CCL_NAMESPACE_BEGIN
 #define FILTER_TABLE_SIZE	1024
 #define RAMP_TABLE_SIZE		256
 #define SHUTTER_TABLE_SIZE		256
+#define ADAPTIVE_SAMPLING_STEP	4
 #define PARTICLE_SIZE 		5
+#define DENOISE_PATCH_RADIUS	1
 
 #define BSSRDF_MIN_RADIUS			1e-8f
 #define BSSRDF_MAX_HITS				4
@@ -55,11 +57,17 @@ CCL_NAMESPACE_BEGIN
 
 #define VOLUME_STACK_SIZE		16
 
+/* Number of rays traced together by ray stream traversal on the CPU. */
+#define RAY_STREAM_SIZE			32
+
 /* device capabilities */
 #ifdef __KERNEL_CPU__
 #  ifdef __KERNEL_SSE2__
 #    define __QBVH__
 #  endif
+#  ifdef __KERNEL_SSE41__
+#    define __RAY_STREAM__
+#  endif
 #  define __KERNEL_SHADING__
 #  define __KERNEL_ADV_SHADING__
 #  define __BRANCHED_PATH__
@@ -70,6 +78,7 @@ CCL_NAMESPACE_BEGIN
 #  define __CMJ__
 #  define __VOLUME__
 #  define __VOLUME_DECOUPLED__
+#  define __VOLUME_SPARSE__
 #  define __VOLUME_SCATTER__
 #  define __SHADOW_RECORD_ALL__
 #  define __VOLUME_RECORD_ALL__
@@ -339,12 +348,14 @@ typedef enum PassType {
 	PASS_SUBSURFACE_DIRECT = (1 << 22),
 	PASS_SUBSURFACE_INDIRECT = (1 << 23),
 	PASS_SUBSURFACE_COLOR = (1 << 24),
-	PASS_LIGHT = (1 << 25), /* no real pass, used to force use_light_pass */
+	PASS_RENDER_TIME = (1 << 25), /* only written by CPU kernels when profiling */
 #ifdef __KERNEL_DEBUG__
 	PASS_BVH_TRAVERSAL_STEPS = (1 << 26),
 	PASS_BVH_TRAVERSED_INSTANCES = (1 << 27),
 	PASS_RAY_BOUNCES = (1 << 28),
+	PASS_ADAPTIVE_ERROR = (1 << 30),
 #endif
+	PASS_ADAPTIVE_AUX = (1 << 29), /* no real pass, used by adaptive sampling */
 } PassType;
 
 #define PASS_ALL (~0)
@@ -622,6 +633,10 @@ typedef enum AttributeStandard {
 typedef enum AttributeFlag {
 	ATTR_FINAL_SIZE = (1 << 0),
 	ATTR_SUBDIVIDED = (1 << 1),
+	/* float3 with zero z stored as two half floats in the float array */
+	ATTR_COMPRESSED = (1 << 2),
+	/* texture coordinates from a UV map, z is always zero */
+	ATTR_UV_MAP = (1 << 3),
 } AttributeFlag;
 
 typedef struct AttributeDescriptor {
@@ -1023,18 +1038,23 @@ typedef struct KernelFilm {
 	int pass_shadow;
 	float pass_shadow_scale;
 	int filter_table_offset;
-	int pass_pad2;
+	int pass_adaptive_aux;
 
 	int pass_mist;
 	float mist_start;
 	float mist_inv_depth;
 	float mist_falloff;
 
+	int pass_render_time;
+	int pass_pad1;
+	int pass_pad2;
+	int pass_pad3;
+
 #ifdef __KERNEL_DEBUG__
 	int pass_bvh_traversal_steps;
 	int pass_bvh_traversed_instances;
 	int pass_ray_bounces;
-	int pass_pad3;
+	int pass_adaptive_error;
 #endif
 } KernelFilm;
 static_assert_align(KernelFilm, 16);
@@ -1118,9 +1138,9 @@ typedef struct KernelIntegrator {
 	int volume_max_steps;
 	float volume_step_size;
 	int volume_samples;
+	int volume_skip_empty;
 
 	int pad1;
-	int pad2;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1132,7 +1152,8 @@ typedef struct KernelBVH {
 	int have_curves;
 	int have_instancing;
 	int use_qbvh;
-	int pad1, pad2;
+	int use_compressed_normals;
+	int pad1;
 } KernelBVH;
 static_assert_align(KernelBVH, 16);
 
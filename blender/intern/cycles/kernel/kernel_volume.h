@@ -61,6 +61,48 @@ ccl_device_inline bool volume_shader_extinction_sample(KernelGlobals *kg,
 	return true;
 }
 
+#ifdef __VOLUME_SPARSE__
+/* test if all volumes in the stack are smoke with only empty voxels at P, in
+ * which case we skip shader evaluation. this assumes smoke shaders have no
+ * density outside of the smoke, so it's only done when enabled by the user */
+ccl_device bool volume_stack_is_empty(KernelGlobals *kg, ShaderData *sd, VolumeStack *stack, float3 P)
+{
+	if(!kernel_data.integrator.volume_skip_empty)
+		return false;
+
+	for(int i = 0; stack[i].shader != SHADER_NONE; i++) {
+		if(stack[i].object == OBJECT_NONE)
+			return false;
+
+		sd->object = stack[i].object;
+		sd->flag &= ~SD_OBJECT_FLAGS;
+		sd->flag |= kernel_tex_fetch(__object_flag, sd->object);
+
+#ifdef __OBJECT_MOTION__
+		shader_setup_object_transforms(kg, sd, sd->time);
+#endif
+
+		bool has_voxels = false;
+
+		for(uint std = ATTR_STD_VOLUME_DENSITY; std <= ATTR_STD_VOLUME_HEAT; std++) {
+			const AttributeDescriptor desc = find_attribute(kg, sd, std);
+
+			if(desc.offset == ATTR_STD_NOT_FOUND)
+				continue;
+			if(desc.element != ATTR_ELEMENT_VOXEL || !volume_attribute_is_empty(kg, sd, desc, P))
+				return false;
+
+			has_voxels = true;
+		}
+
+		if(!has_voxels)
+			return false;
+	}
+
+	return true;
+}
+#endif
+
 /* evaluate shader to get absorption, scattering and emission at P */
 ccl_device_inline bool volume_shader_sample(KernelGlobals *kg,
                                             ShaderData *sd,
@@ -68,6 +110,11 @@ ccl_device_inline bool volume_shader_sample(KernelGlobals *kg,
                                             float3 P,
                                             VolumeShaderCoefficients *coeff)
 {
+#ifdef __VOLUME_SPARSE__
+	if(volume_stack_is_empty(kg, sd, state->volume_stack, P))
+		return false;
+#endif
+
 	sd->P = P;
 	shader_eval_volume(kg, sd, state, state->volume_stack, state->flag, SHADER_CONTEXT_VOLUME);
 
@@ -90,6 +90,32 @@ void kernel_tex_copy(KernelGlobals *kg,
 #define KERNEL_IMAGE_TEX(type, ttype, tname)
 #include "kernel_textures.h"
 
+	else if(strstr(name, "__tex_sparse_float4")) {
+		texture_image_float4 *tex = NULL;
+		int id = atoi(name + strlen("__tex_sparse_float4_"));
+		int array_index = id;
+
+		if(array_index >= 0 && array_index < TEX_NUM_FLOAT4_CPU) {
+			tex = &kg->texture_float4_images[array_index];
+		}
+
+		if(tex) {
+			tex->sparse_offsets_set((int*)mem);
+		}
+	}
+	else if(strstr(name, "__tex_sparse_float")) {
+		texture_image_float *tex = NULL;
+		int id = atoi(name + strlen("__tex_sparse_float_"));
+		int array_index = id - TEX_START_FLOAT_CPU;
+
+		if(array_index >= 0 && array_index < TEX_NUM_FLOAT_CPU) {
+			tex = &kg->texture_float_images[array_index];
+		}
+
+		if(tex) {
+			tex->sparse_offsets_set((int*)mem);
+		}
+	}
 	else if(strstr(name, "__tex_image_float4")) {
 		texture_image_float4 *tex = NULL;
 		int id = atoi(name + strlen("__tex_image_float4_"));
@@ -102,6 +128,7 @@ void kernel_tex_copy(KernelGlobals *kg,
 		if(tex) {
 			tex->data = (float4*)mem;
 			tex->dimensions_set(width, height, depth);
+			tex->sparse_offsets_set(NULL);
 			tex->interpolation = interpolation;
 			tex->extension = extension;
 		}
@@ -118,6 +145,7 @@ void kernel_tex_copy(KernelGlobals *kg,
 		if(tex) {
 			tex->data = (float*)mem;
 			tex->dimensions_set(width, height, depth);
+			tex->sparse_offsets_set(NULL);
 			tex->interpolation = interpolation;
 			tex->extension = extension;
 		}
@@ -134,6 +162,7 @@ void kernel_tex_copy(KernelGlobals *kg,
 		if(tex) {
 			tex->data = (uchar4*)mem;
 			tex->dimensions_set(width, height, depth);
+			tex->sparse_offsets_set(NULL);
 			tex->interpolation = interpolation;
 			tex->extension = extension;
 		}
@@ -150,6 +179,7 @@ void kernel_tex_copy(KernelGlobals *kg,
 		if(tex) {
 			tex->data = (uchar*)mem;
 			tex->dimensions_set(width, height, depth);
+			tex->sparse_offsets_set(NULL);
 			tex->interpolation = interpolation;
 			tex->extension = extension;
 		}
@@ -166,6 +196,7 @@ void kernel_tex_copy(KernelGlobals *kg,
 		if(tex) {
 			tex->data = (half4*)mem;
 			tex->dimensions_set(width, height, depth);
+			tex->sparse_offsets_set(NULL);
 			tex->interpolation = interpolation;
 			tex->extension = extension;
 		}
@@ -182,6 +213,7 @@ void kernel_tex_copy(KernelGlobals *kg,
 		if(tex) {
 			tex->data = (half*)mem;
 			tex->dimensions_set(width, height, depth);
+			tex->sparse_offsets_set(NULL);
 			tex->interpolation = interpolation;
 			tex->extension = extension;
 		}
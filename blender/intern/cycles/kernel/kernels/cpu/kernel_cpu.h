@@ -24,6 +24,40 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
                                            int offset,
                                            int stride);
 
+void KERNEL_FUNCTION_FULL_NAME(path_trace_stream)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  unsigned int *rng_state,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int num_pixels,
+                                                  int offset,
+                                                  int stride);
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_convergence_check)(KernelGlobals *kg,
+                                                           float *buffer,
+                                                           float threshold,
+                                                           int x, int y,
+                                                           int offset,
+                                                           int stride);
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_post_adjust)(KernelGlobals *kg,
+                                                     float *buffer,
+                                                     float num_samples,
+                                                     int x, int y,
+                                                     int offset,
+                                                     int stride);
+
+void KERNEL_FUNCTION_FULL_NAME(denoise_tile)(KernelGlobals *kg,
+                                             float *buffer,
+                                             float4 *temp,
+                                             int4 rect,
+                                             int4 buffer_rect,
+                                             int offset,
+                                             int stride,
+                                             int radius,
+                                             float strength,
+                                             float sample_scale);
+
 void KERNEL_FUNCTION_FULL_NAME(convert_to_byte)(KernelGlobals *kg,
                                                 uchar4 *rgba,
                                                 float *buffer,
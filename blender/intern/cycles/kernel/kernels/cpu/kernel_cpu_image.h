@@ -70,6 +70,19 @@ ccl_device float4 kernel_tex_image_interp_3d_ex_impl(KernelGlobals *kg, int tex,
 		return kg->texture_float4_images[tex].interp_3d_ex(x, y, z, interpolation);
 }
 
+/* Only float images are stored sparse, see ImageManager::device_load_image. */
+ccl_device bool kernel_tex_image_is_empty_3d_impl(KernelGlobals *kg, int tex, float x, float y, float z)
+{
+	if(tex >= TEX_START_BYTE_CPU)
+		return false;
+	else if(tex >= TEX_START_FLOAT_CPU)
+		return kg->texture_float_images[tex - TEX_START_FLOAT_CPU].is_empty_3d(x, y, z);
+	else if(tex >= TEX_START_BYTE4_CPU)
+		return false;
+	else
+		return kg->texture_float4_images[tex].is_empty_3d(x, y, z);
+}
+
 CCL_NAMESPACE_END
 
 #endif  // __KERNEL_CPU__
@@ -26,10 +26,13 @@
 #include "kernel_globals.h"
 #include "kernel_cpu_image.h"
 #include "kernel_film.h"
+#include "kernel_denoise.h"
 #include "kernel_path.h"
 #include "kernel_path_branched.h"
 #include "kernel_bake.h"
 
+#include "util_time.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* Path Tracing */
@@ -42,6 +45,9 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
                                            int offset,
                                            int stride)
 {
+	const bool use_render_time = (kernel_data.film.pass_flag & PASS_RENDER_TIME) != 0;
+	const double time_start = (use_render_time)? time_dt(): 0.0;
+
 #ifdef __BRANCHED_PATH__
 	if(kernel_data.integrator.branched) {
 		kernel_branched_path_trace(kg,
@@ -57,6 +63,101 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(KernelGlobals *kg,
 	{
 		kernel_path_trace(kg, buffer, rng_state, sample, x, y, offset, stride);
 	}
+
+	if(use_render_time)
+		kernel_write_render_time(kg, buffer, sample, x, y, 1, offset, stride, time_dt() - time_start);
+}
+
+void KERNEL_FUNCTION_FULL_NAME(path_trace_stream)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  unsigned int *rng_state,
+                                                  int sample,
+                                                  int x, int y,
+                                                  int num_pixels,
+                                                  int offset,
+                                                  int stride)
+{
+	const bool use_render_time = (kernel_data.film.pass_flag & PASS_RENDER_TIME) != 0;
+	const double time_start = (use_render_time)? time_dt(): 0.0;
+
+#ifdef __BRANCHED_PATH__
+	if(kernel_data.integrator.branched) {
+		for(int i = 0; i < num_pixels; i++) {
+			kernel_branched_path_trace(kg,
+			                           buffer,
+			                           rng_state,
+			                           sample,
+			                           x + i, y,
+			                           offset,
+			                           stride);
+		}
+	}
+	else
+#endif
+	{
+		kernel_path_trace_stream(kg, buffer, rng_state, sample, x, y, num_pixels, offset, stride);
+	}
+
+	/* camera rays are traced together, so the time is spread evenly */
+	if(use_render_time)
+		kernel_write_render_time(kg, buffer, sample, x, y, num_pixels, offset, stride, time_dt() - time_start);
+}
+
+/* Adaptive Sampling */
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_convergence_check)(KernelGlobals *kg,
+                                                           float *buffer,
+                                                           float threshold,
+                                                           int x, int y,
+                                                           int offset,
+                                                           int stride)
+{
+	return kernel_adaptive_convergence_check(kg,
+	                                         buffer,
+	                                         threshold,
+	                                         x, y,
+	                                         offset,
+	                                         stride);
+}
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_post_adjust)(KernelGlobals *kg,
+                                                     float *buffer,
+                                                     float num_samples,
+                                                     int x, int y,
+                                                     int offset,
+                                                     int stride)
+{
+	kernel_adaptive_post_adjust(kg,
+	                            buffer,
+	                            num_samples,
+	                            x, y,
+	                            offset,
+	                            stride);
+}
+
+/* Denoising */
+
+void KERNEL_FUNCTION_FULL_NAME(denoise_tile)(KernelGlobals *kg,
+                                             float *buffer,
+                                             float4 *temp,
+                                             int4 rect,
+                                             int4 buffer_rect,
+                                             int offset,
+                                             int stride,
+                                             int radius,
+                                             float strength,
+                                             float sample_scale)
+{
+	kernel_denoise_tile(kg,
+	                    buffer,
+	                    temp,
+	                    rect,
+	                    buffer_rect,
+	                    offset,
+	                    stride,
+	                    radius,
+	                    strength,
+	                    sample_scale);
 }
 
 /* Film */
@@ -132,6 +132,8 @@ typedef enum ShaderNodeType {
 	NODE_TEX_VOXEL,
 	NODE_ENTER_BUMP_EVAL,
 	NODE_LEAVE_BUMP_EVAL,
+
+	NODE_NUM  /* number of node types, not a node */
 } ShaderNodeType;
 
 typedef enum NodeAttributeType {
@@ -17,6 +17,10 @@
 #include "bake.h"
 #include "integrator.h"
 
+#include "util_foreach.h"
+#include "util_logging.h"
+#include "util_time.h"
+
 CCL_NAMESPACE_BEGIN
 
 BakeData::BakeData(const int object, const size_t tri_offset, const size_t num_pixels):
@@ -101,6 +105,10 @@ BakeManager::BakeManager()
 	m_is_baking = false;
 	need_update = true;
 	m_shader_limit = 512 * 512;
+	num_samples = 0;
+	num_parts = 0;
+	num_baked_pixels = 0;
+	bake_time = 0.0;
 }
 
 BakeManager::~BakeManager()
@@ -133,96 +141,169 @@ void BakeManager::set_shader_limit(const size_t x, const size_t y)
 
 bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress, ShaderEvalType shader_type, const int pass_filter, BakeData *bake_data, float result[])
 {
-	size_t num_pixels = bake_data->size();
+	vector<BakeJob> jobs;
+	jobs.push_back(BakeJob(bake_data, shader_type, pass_filter, result));
+
+	return bake(device, dscene, scene, progress, jobs);
+}
+
+/* Valid pixel of a job, pixels of jobs baking the same pass are evaluated
+ * together by the same device tasks. */
+struct BakePixelRef {
+	int job;
+	int pixel;
+
+	BakePixelRef(int job_, int pixel_)
+	: job(job_), pixel(pixel_) {}
+};
+
+struct BakeGroup {
+	ShaderEvalType shader_type;
+	int pass_filter;
+	int num_samples;
+	vector<BakePixelRef> pixels;
+	size_t unit_size;
+};
+
+bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress, vector<BakeJob>& jobs)
+{
+	double time_start = time_dt();
+
+	/* group valid pixels by pass */
+	vector<BakeGroup> groups;
+
+	for(size_t j = 0; j < jobs.size(); j++) {
+		BakeJob& job = jobs[j];
+		size_t g;
+
+		for(g = 0; g < groups.size(); g++)
+			if(groups[g].shader_type == job.shader_type && groups[g].pass_filter == job.pass_filter)
+				break;
+
+		if(g == groups.size()) {
+			BakeGroup group;
+			group.shader_type = job.shader_type;
+			group.pass_filter = job.pass_filter;
+			group.num_samples = is_aa_pass(job.shader_type)? scene->integrator->aa_samples : 1;
+			group.unit_size = 0;
+			groups.push_back(group);
+		}
+
+		BakeData *data = job.data;
+		for(size_t i = 0; i < data->size(); i++)
+			if(data->is_valid(i))
+				groups[g].pixels.push_back(BakePixelRef(j, i));
+	}
 
+	/* split groups into work units of similar size no larger than the
+	 * shader limit, and count the parts for the progress bar. parts are
+	 * weighted by samples since passes may use different sample counts. */
 	progress.reset_sample();
 	this->num_parts = 0;
+	this->num_samples = 1;
+
+	size_t num_pixels = 0;
+
+	foreach(BakeGroup& group, groups) {
+		size_t group_size = group.pixels.size();
+		size_t num_units = (group_size + m_shader_limit - 1) / m_shader_limit;
+
+		if(num_units == 0)
+			continue;
 
-	/* calculate the total parts for the progress bar */
-	for(size_t shader_offset = 0; shader_offset < num_pixels; shader_offset += m_shader_limit) {
-		size_t shader_size = (size_t)fminf(num_pixels - shader_offset, m_shader_limit);
+		group.unit_size = (group_size + num_units - 1) / num_units;
 
-		DeviceTask task(DeviceTask::SHADER);
-		task.shader_w = shader_size;
+		for(size_t offset = 0; offset < group_size; offset += group.unit_size) {
+			DeviceTask task(DeviceTask::SHADER);
+			task.shader_w = std::min(group_size - offset, group.unit_size);
 
-		this->num_parts += device->get_split_task_count(task);
+			this->num_parts += device->get_split_task_count(task) * group.num_samples;
+		}
+
+		num_pixels += group_size;
 	}
 
-	this->num_samples = is_aa_pass(shader_type)? scene->integrator->aa_samples : 1;
+	/* needs to be up to data for attribute access */
+	device->const_copy_to("__data", &dscene->data, sizeof(dscene->data));
 
-	for(size_t shader_offset = 0; shader_offset < num_pixels; shader_offset += m_shader_limit) {
-		size_t shader_size = (size_t)fminf(num_pixels - shader_offset, m_shader_limit);
+	/* offset of the unit in the whole batch, for random number seeds */
+	size_t batch_offset = 0;
 
-		/* setup input for device task */
-		device_vector<uint4> d_input;
-		uint4 *d_input_data = d_input.resize(shader_size * 2);
-		size_t d_input_size = 0;
+	foreach(BakeGroup& group, groups) {
+		size_t group_size = group.pixels.size();
 
-		for(size_t i = shader_offset; i < (shader_offset + shader_size); i++) {
-			d_input_data[d_input_size++] = bake_data->data(i);
-			d_input_data[d_input_size++] = bake_data->differentials(i);
-		}
+		for(size_t unit_offset = 0; unit_offset < group_size; unit_offset += group.unit_size) {
+			size_t shader_size = std::min(group_size - unit_offset, group.unit_size);
 
-		if(d_input_size == 0) {
-			m_is_baking = false;
-			return false;
-		}
+			/* setup input for device task */
+			device_vector<uint4> d_input;
+			uint4 *d_input_data = d_input.resize(shader_size * 2);
 
-		/* run device task */
-		device_vector<float4> d_output;
-		d_output.resize(shader_size);
-
-		/* needs to be up to data for attribute access */
-		device->const_copy_to("__data", &dscene->data, sizeof(dscene->data));
-
-		device->mem_alloc(d_input, MEM_READ_ONLY);
-		device->mem_copy_to(d_input);
-		device->mem_alloc(d_output, MEM_READ_WRITE);
-
-		DeviceTask task(DeviceTask::SHADER);
-		task.shader_input = d_input.device_pointer;
-		task.shader_output = d_output.device_pointer;
-		task.shader_eval_type = shader_type;
-		task.shader_filter = pass_filter;
-		task.shader_x = 0;
-		task.offset = shader_offset;
-		task.shader_w = d_output.size();
-		task.num_samples = this->num_samples;
-		task.get_cancel = function_bind(&Progress::get_cancel, &progress);
-		task.update_progress_sample = function_bind(&Progress::increment_sample_update, &progress);
-
-		device->task_add(task);
-		device->task_wait();
-
-		if(progress.get_cancel()) {
-			device->mem_free(d_input);
-			device->mem_free(d_output);
-			m_is_baking = false;
-			return false;
-		}
+			for(size_t i = 0; i < shader_size; i++) {
+				const BakePixelRef& ref = group.pixels[unit_offset + i];
+				BakeData *data = jobs[ref.job].data;
+
+				d_input_data[i*2 + 0] = data->data(ref.pixel);
+				d_input_data[i*2 + 1] = data->differentials(ref.pixel);
+			}
 
-		device->mem_copy_from(d_output, 0, 1, d_output.size(), sizeof(float4));
-		device->mem_free(d_input);
-		device->mem_free(d_output);
+			/* run device task */
+			device_vector<float4> d_output;
+			d_output.resize(shader_size);
+
+			device->mem_alloc(d_input, MEM_READ_ONLY);
+			device->mem_copy_to(d_input);
+			device->mem_alloc(d_output, MEM_READ_WRITE);
+
+			DeviceTask task(DeviceTask::SHADER);
+			task.shader_input = d_input.device_pointer;
+			task.shader_output = d_output.device_pointer;
+			task.shader_eval_type = group.shader_type;
+			task.shader_filter = group.pass_filter;
+			task.shader_x = 0;
+			task.offset = batch_offset;
+			task.shader_w = d_output.size();
+			task.num_samples = group.num_samples;
+			task.get_cancel = function_bind(&Progress::get_cancel, &progress);
+			task.update_progress_sample = function_bind(&Progress::increment_sample_update, &progress);
+
+			device->task_add(task);
+			device->task_wait();
+
+			if(progress.get_cancel()) {
+				device->mem_free(d_input);
+				device->mem_free(d_output);
+				m_is_baking = false;
+				return false;
+			}
 
-		/* read result */
-		int k = 0;
+			device->mem_copy_from(d_output, 0, 1, d_output.size(), sizeof(float4));
+			device->mem_free(d_input);
+			device->mem_free(d_output);
 
-		float4 *offset = (float4*)d_output.data_pointer;
+			/* write results back to their jobs */
+			float4 *output = (float4*)d_output.data_pointer;
 
-		size_t depth = 4;
-		for(size_t i=shader_offset; i < (shader_offset + shader_size); i++) {
-			size_t index = i * depth;
-			float4 out = offset[k++];
+			for(size_t i = 0; i < shader_size; i++) {
+				const BakePixelRef& ref = group.pixels[unit_offset + i];
+				float *result = jobs[ref.job].result + ref.pixel * 4;
+				float4 out = output[i];
 
-			if(bake_data->is_valid(i)) {
-				for(size_t j=0; j < 4; j++) {
-					result[index + j] = out[j];
-				}
+				for(size_t j = 0; j < 4; j++)
+					result[j] = out[j];
 			}
+
+			batch_offset += shader_size;
 		}
 	}
 
+	num_baked_pixels = num_pixels;
+	bake_time = time_dt() - time_start;
+
+	VLOG(1) << "Baked " << num_pixels << " pixels of " << jobs.size() << " jobs in "
+	        << bake_time << " seconds, "
+	        << ((bake_time > 0.0)? num_pixels / bake_time: 0.0) << " pixels per second.";
+
 	m_is_baking = false;
 	return true;
 }
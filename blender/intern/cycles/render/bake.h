@@ -51,6 +51,18 @@ private:
 	vector<float>m_dvdy;
 };
 
+/* One object and pass to bake, many of them can be baked in one go. */
+class BakeJob {
+public:
+	BakeJob(BakeData *data_, ShaderEvalType shader_type_, int pass_filter_, float *result_)
+	: data(data_), shader_type(shader_type_), pass_filter(pass_filter_), result(result_) {}
+
+	BakeData *data;
+	ShaderEvalType shader_type;
+	int pass_filter;
+	float *result;
+};
+
 class BakeManager {
 public:
 	BakeManager();
@@ -65,6 +77,11 @@ public:
 
 	bool bake(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress, ShaderEvalType shader_type, const int pass_filter, BakeData *bake_data, float result[]);
 
+	/* Bake many objects and passes at once. Valid pixels of all jobs with
+	 * the same pass are packed together into evenly sized device tasks, and
+	 * results are written back to the result array of each job. */
+	bool bake(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress, vector<BakeJob>& jobs);
+
 	void device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_free(Device *device, DeviceScene *dscene);
 
@@ -76,6 +93,10 @@ public:
 	int num_samples;
 	int num_parts;
 
+	/* throughput of the last bake, for statistics */
+	size_t num_baked_pixels;
+	double bake_time;
+
 private:
 	BakeData *m_bake_data;
 	bool m_is_baking;
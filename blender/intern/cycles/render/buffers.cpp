@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "buffers.h"
 #include "device.h"
@@ -25,6 +26,8 @@
 #include "util_image.h"
 #include "util_math.h"
 #include "util_opengl.h"
+#include "util_simd.h"
+#include "util_task.h"
 #include "util_time.h"
 #include "util_types.h"
 
@@ -93,6 +96,9 @@ RenderTile::RenderTile()
 	rng_state = 0;
 
 	buffers = NULL;
+
+	task = PATH_TRACE;
+	tile_index = 0;
 }
 
 /* Render Buffers */
@@ -146,6 +152,27 @@ void RenderBuffers::reset(Device *device, BufferParams& params_)
 	device->mem_copy_to(rng_state);
 }
 
+void RenderBuffers::copy_tile(RenderBuffers *tile)
+{
+	if(!tile->copy_from_device())
+		return;
+
+	BufferParams& tile_params = tile->params;
+	int pass_stride = params.get_passes_size();
+	int to_x = tile_params.full_x - params.full_x;
+	int to_y = tile_params.full_y - params.full_y;
+
+	assert(tile_params.get_passes_size() == pass_stride);
+	assert(to_x >= 0 && to_x + tile_params.width <= params.width);
+	assert(to_y >= 0 && to_y + tile_params.height <= params.height);
+
+	for(int row = 0; row < tile_params.height; row++) {
+		float *from = tile->buffer.get_data() + row*tile_params.width*pass_stride;
+		float *to = buffer.get_data() + ((to_y + row)*params.width + to_x)*pass_stride;
+		memcpy(to, from, sizeof(float)*tile_params.width*pass_stride);
+	}
+}
+
 bool RenderBuffers::copy_from_device()
 {
 	if(!buffer.device_pointer)
@@ -156,7 +183,54 @@ bool RenderBuffers::copy_from_device()
 	return true;
 }
 
+void RenderBuffers::copy_to_device()
+{
+	if(buffer.device_pointer)
+		device->mem_copy_to(buffer);
+}
+
 bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels)
+{
+	return get_pass_rect_range(type, exposure, sample, components, pixels, 0, params.width*params.height);
+}
+
+void RenderBuffers::get_pass_rects_range(vector<RenderPassRect> *rects, float exposure, int sample, int start, int end)
+{
+	foreach(RenderPassRect& rect, *rects) {
+		if(!get_pass_rect_range(rect.type, exposure, sample, rect.components, rect.pixels, start, end - start))
+			memset(rect.pixels + start*rect.components, 0, sizeof(float)*rect.components*(end - start));
+	}
+}
+
+void RenderBuffers::get_pass_rects(vector<RenderPassRect>& rects, float exposure, int sample)
+{
+	/* All passes are converted for a block of pixels at once, so the
+	 * interleaved render buffer is only streamed through memory once.
+	 * Blocks only run in parallel when scheduler threads are idle, like
+	 * for the last tiles of a render, the calling thread converts the
+	 * rest while waiting. */
+	const int size = params.width*params.height;
+	const int block_size = 16384;
+
+	if(size <= block_size) {
+		get_pass_rects_range(&rects, exposure, sample, 0, size);
+		return;
+	}
+
+	TaskPool pool;
+	for(int start = 0; start < size; start += block_size) {
+		pool.push(function_bind(&RenderBuffers::get_pass_rects_range,
+		                        this,
+		                        &rects,
+		                        exposure,
+		                        sample,
+		                        start,
+		                        min(start + block_size, size)));
+	}
+	pool.wait_work();
+}
+
+bool RenderBuffers::get_pass_rect_range(PassType type, float exposure, int sample, int components, float *pixels, int offset, int size)
 {
 	int pass_offset = 0;
 
@@ -168,13 +242,13 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 			continue;
 		}
 
-		float *in = (float*)buffer.data_pointer + pass_offset;
 		int pass_stride = params.get_passes_size();
+		float *in = (float*)buffer.data_pointer + pass_offset + offset*pass_stride;
 
 		float scale = (pass.filter)? 1.0f/(float)sample: 1.0f;
 		float scale_exposure = (pass.exposure)? scale*exposure: scale;
 
-		int size = params.width*params.height;
+		pixels += offset*components;
 
 		if(components == 1) {
 			assert(pass.components == components);
@@ -237,7 +311,7 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 					pass_offset += color_pass.components;
 				}
 
-				float *in_divide = (float*)buffer.data_pointer + pass_offset;
+				float *in_divide = (float*)buffer.data_pointer + pass_offset + offset*pass_stride;
 
 				for(int i = 0; i < size; i++, in += pass_stride, in_divide += pass_stride, pixels += 3) {
 					float3 f = make_float3(in[0], in[1], in[2]);
@@ -286,7 +360,7 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 					pass_offset += color_pass.components;
 				}
 
-				float *in_weight = (float*)buffer.data_pointer + pass_offset;
+				float *in_weight = (float*)buffer.data_pointer + pass_offset + offset*pass_stride;
 
 				for(int i = 0; i < size; i++, in += pass_stride, in_weight += pass_stride, pixels += 4) {
 					float4 f = make_float4(in[0], in[1], in[2], in[3]);
@@ -300,6 +374,16 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 				}
 			}
 			else {
+#ifdef __KERNEL_SSE2__
+				const ssef scale4 = ssef(scale_exposure, scale_exposure, scale_exposure, scale);
+
+				for(int i = 0; i < size; i++, in += pass_stride, pixels += 4) {
+					storeu4f(pixels, loadu4f(in) * scale4);
+
+					/* clamp since alpha might be > 1.0 due to russian roulette */
+					pixels[3] = saturate(pixels[3]);
+				}
+#else
 				for(int i = 0; i < size; i++, in += pass_stride, pixels += 4) {
 					float4 f = make_float4(in[0], in[1], in[2], in[3]);
 
@@ -310,6 +394,7 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 					/* clamp since alpha might be > 1.0 due to russian roulette */
 					pixels[3] = saturate(f.w*scale);
 				}
+#endif
 			}
 		}
 
@@ -27,6 +27,7 @@
 #include "util_string.h"
 #include "util_thread.h"
 #include "util_types.h"
+#include "util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -61,6 +62,21 @@ public:
 	int get_passes_size();
 };
 
+/* Render Pass Rect
+ *
+ * Destination for batched pass extraction, pixels must have room for
+ * width*height*components floats of the buffer params. */
+
+class RenderPassRect {
+public:
+	PassType type;
+	int components;
+	float *pixels;
+
+	RenderPassRect(PassType type, int components, float *pixels)
+	: type(type), components(components), pixels(pixels) {}
+};
+
 /* Render Buffers */
 
 class RenderBuffers {
@@ -77,11 +93,22 @@ public:
 	~RenderBuffers();
 
 	void reset(Device *device, BufferParams& params);
+	/* copy all passes of a tile rendered into its own buffers to the part
+	 * of these buffers it covers, only on the host */
+	void copy_tile(RenderBuffers *tile);
 
 	bool copy_from_device();
+	void copy_to_device();
 	bool get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels);
+	/* convert multiple passes in one sweep over the buffer, split into
+	 * blocks for idle scheduler threads to help with, passes missing from
+	 * the buffer are filled with zeros */
+	void get_pass_rects(vector<RenderPassRect>& rects, float exposure, int sample);
 
 protected:
+	bool get_pass_rect_range(PassType type, float exposure, int sample, int components, float *pixels, int offset, int size);
+	void get_pass_rects_range(vector<RenderPassRect> *rects, float exposure, int sample, int start, int end);
+
 	void device_free();
 
 	Device *device;
@@ -131,6 +158,10 @@ protected:
 
 class RenderTile {
 public:
+	/* tiles of final renders are denoised once all their neighbors finished
+	 * rendering, the filter reads the noisy pixels of the neighbors */
+	typedef enum { PATH_TRACE, DENOISE } Task;
+
 	int x, y, w, h;
 	int start_sample;
 	int num_samples;
@@ -144,6 +175,9 @@ public:
 
 	RenderBuffers *buffers;
 
+	Task task;
+	int tile_index;
+
 	RenderTile();
 };
 
@@ -144,14 +144,15 @@ void Pass::add(PassType type, array<Pass>& passes)
 			pass.components = 4;
 			pass.exposure = false;
 			break;
-		case PASS_LIGHT:
-			/* This isn't a real pass, used by baking to see whether
-			 * light data is needed or not.
-			 *
-			 * Set components to 0 so pass sort below happens in a
-			 * determined way.
-			 */
-			pass.components = 0;
+		case PASS_RENDER_TIME:
+			pass.components = 1;
+			pass.exposure = false;
+			break;
+		case PASS_ADAPTIVE_AUX:
+			/* Luminance sum, squared luminance sum, sample count and
+			 * convergence flag, never written to the render result. */
+			pass.components = 4;
+			pass.filter = false;
 			break;
 #ifdef WITH_CYCLES_DEBUG
 		case PASS_BVH_TRAVERSAL_STEPS:
@@ -166,6 +167,11 @@ void Pass::add(PassType type, array<Pass>& passes)
 			pass.components = 1;
 			pass.exposure = false;
 			break;
+		case PASS_ADAPTIVE_ERROR:
+			pass.components = 1;
+			pass.filter = false;
+			pass.exposure = false;
+			break;
 #endif
 	}
 
@@ -293,6 +299,7 @@ Film::Film()
 	Pass::add(PASS_COMBINED, passes);
 
 	use_light_visibility = false;
+	use_bake_light_pass = false;
 	filter_table_offset = TABLE_OFFSET_INVALID;
 
 	need_update = true;
@@ -315,7 +322,7 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
 	kfilm->exposure = exposure;
 	kfilm->pass_flag = 0;
 	kfilm->pass_stride = 0;
-	kfilm->use_light_pass = use_light_visibility || use_sample_clamp;
+	kfilm->use_light_pass = use_light_visibility || use_sample_clamp || use_bake_light_pass;
 
 	for(size_t i = 0; i < passes.size(); i++) {
 		Pass& pass = passes[i];
@@ -416,8 +423,11 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
 				kfilm->use_light_pass = 1;
 				break;
 
-			case PASS_LIGHT:
-				kfilm->use_light_pass = 1;
+			case PASS_RENDER_TIME:
+				kfilm->pass_render_time = kfilm->pass_stride;
+				break;
+			case PASS_ADAPTIVE_AUX:
+				kfilm->pass_adaptive_aux = kfilm->pass_stride;
 				break;
 
 #ifdef WITH_CYCLES_DEBUG
@@ -430,6 +440,9 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
 			case PASS_RAY_BOUNCES:
 				kfilm->pass_ray_bounces = kfilm->pass_stride;
 				break;
+			case PASS_ADAPTIVE_ERROR:
+				kfilm->pass_adaptive_error = kfilm->pass_stride;
+				break;
 #endif
 
 			case PASS_NONE:
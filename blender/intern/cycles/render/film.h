@@ -69,6 +69,8 @@ public:
 
 	bool use_light_visibility;
 	bool use_sample_clamp;
+	/* baking more than colors needs light passes in the kernel */
+	bool use_bake_light_pass;
 
 	bool need_update;
 
@@ -23,6 +23,7 @@
 #include "util_algorithm.h"
 #include "util_debug.h"
 #include "util_foreach.h"
+#include "util_md5.h"
 #include "util_queue.h"
 #include "util_logging.h"
 
@@ -987,6 +988,45 @@ int ShaderGraph::get_num_closures()
 	return num_closures;
 }
 
+void ShaderGraph::hash(MD5Hash& md5)
+{
+	/* nodes are identified by their order in the graph, pointers and ids are
+	 * different between otherwise identical graphs */
+	map<ShaderNode*, int> node_index;
+	int index = 0;
+
+	foreach(ShaderNode *node, nodes)
+		node_index[node] = index++;
+
+	foreach(ShaderNode *node, nodes) {
+		node->hash(md5);
+		md5.append((const uint8_t*)&node->bump, sizeof(node->bump));
+
+		foreach(ShaderInput *input, node->inputs) {
+			int link[2] = {-1, -1};
+
+			if(input->link) {
+				ShaderNode *from = input->link->parent;
+				link[0] = node_index[from];
+				link[1] = (int)(std::find(from->outputs.begin(), from->outputs.end(), input->link) -
+				                from->outputs.begin());
+			}
+
+			md5.append((const uint8_t*)link, sizeof(link));
+		}
+	}
+}
+
+bool ShaderGraph::has_external_dependency()
+{
+	foreach(ShaderNode *node, nodes) {
+		if(node->has_external_dependency())
+			return true;
+	}
+
+	return false;
+}
+
 void ShaderGraph::dump_graph(const char *filename)
 {
 	FILE *fd = fopen(filename, "w");
@@ -32,6 +32,7 @@
 CCL_NAMESPACE_BEGIN
 
 class AttributeRequestSet;
+class MD5Hash;
 class Scene;
 class Shader;
 class ShaderInput;
@@ -155,6 +156,9 @@ public:
 	virtual bool has_spatial_varying() { return false; }
 	virtual bool has_object_dependency() { return false; }
 	virtual bool has_integrator_dependency() { return false; }
+	/* Compiled code depends on state which is not stored in node sockets,
+	 * like image slots, so it can't be cached by graph hash. */
+	virtual bool has_external_dependency() { return special_type == SHADER_SPECIAL_TYPE_IMAGE_SLOT; }
 
 	vector<ShaderInput*> inputs;
 	vector<ShaderOutput*> outputs;
@@ -263,6 +267,11 @@ public:
 
 	int get_num_closures();
 
+	/* Hash of nodes, their settings and links, identical for graphs which
+	 * compile to the same code. */
+	void hash(MD5Hash& md5);
+	bool has_external_dependency();
+
 	void dump_graph(const char *filename);
 
 protected:
@@ -19,8 +19,11 @@
 #include "scene.h"
 
 #include "util_foreach.h"
+#include "util_logging.h"
+#include "util_md5.h"
 #include "util_path.h"
 #include "util_progress.h"
+#include "util_sparse_grid.h"
 #include "util_texture.h"
 
 #ifdef WITH_OSL
@@ -35,6 +38,7 @@ ImageManager::ImageManager(const DeviceInfo& info)
 	pack_images = false;
 	osl_texture_system = NULL;
 	animation_frame = 0;
+	num_reloads = 0;
 
 	/* In case of multiple devices used we need to know type of an actual
 	 * compute device.
@@ -47,6 +51,9 @@ ImageManager::ImageManager(const DeviceInfo& info)
 		device_type = info.multi_devices[0].type;
 	}
 
+	/* Only the CPU kernel can sample 3D images stored as sparse tiles. */
+	use_sparse_images = (info.type == DEVICE_CPU);
+
 	/* Set image limits */
 #define SET_TEX_IMAGES_LIMITS(ARCH) \
 	{ \
@@ -64,7 +71,8 @@ ImageManager::ImageManager(const DeviceInfo& info)
 		tex_start_images[IMAGE_DATA_TYPE_HALF] = TEX_START_HALF_ ## ARCH; \
 	}
 
-	if(device_type == DEVICE_CPU) {
+	/* Network servers are expected to render on the CPU. */
+	if(device_type == DEVICE_CPU || device_type == DEVICE_NETWORK) {
 		SET_TEX_IMAGES_LIMITS(CPU);
 	}
 	else if(device_type == DEVICE_CUDA) {
@@ -295,6 +303,9 @@ int ImageManager::add_image(const string& filename,
 		type = IMAGE_DATA_TYPE_BYTE4;
 	}
 
+	/* Shaders may be compiled from multiple threads. */
+	thread_scoped_lock images_lock(images_mutex);
+
 	/* Fnd existing image. */
 	for(slot = 0; slot < images[type].size(); slot++) {
 		img = images[type][slot];
@@ -358,6 +369,8 @@ void ImageManager::remove_image(int flat_slot)
 	ImageDataType type;
 	int slot = flattened_slot_to_type_index(flat_slot, &type);
 
+	thread_scoped_lock images_lock(images_mutex);
+
 	Image *image = images[type][slot];
 	assert(image && image->users >= 1);
 
@@ -411,12 +424,51 @@ void ImageManager::tag_reload_image(const string& filename,
 			                                      extension))
 			{
 				images[type][slot]->need_load = true;
+				num_reloads++;
 				break;
 			}
 		}
 	}
 }
 
+void ImageManager::hash_image(int flat_slot, MD5Hash& md5)
+{
+	if(flat_slot == -1) {
+		md5.append((const uint8_t*)&flat_slot, sizeof(flat_slot));
+		return;
+	}
+
+	ImageDataType type;
+	int slot = flattened_slot_to_type_index(flat_slot, &type);
+
+	thread_scoped_lock images_lock(images_mutex);
+
+	if(slot >= images[type].size() || !images[type][slot]) {
+		md5.append((const uint8_t*)&flat_slot, sizeof(flat_slot));
+		return;
+	}
+
+	Image *img = images[type][slot];
+
+	md5.append(img->filename);
+	md5.append((const uint8_t*)&img->builtin_data, sizeof(img->builtin_data));
+	md5.append((const uint8_t*)&img->frame, sizeof(img->frame));
+	md5.append((const uint8_t*)&img->use_alpha, sizeof(img->use_alpha));
+	md5.append((const uint8_t*)&img->interpolation, sizeof(img->interpolation));
+	md5.append((const uint8_t*)&img->extension, sizeof(img->extension));
+
+	/* files may be modified on disk, builtin images are tagged for reload
+	 * when their pixels change, which does not tell which one so any reload
+	 * changes the hash */
+	if(img->builtin_data == NULL) {
+		uint64_t modified_time = path_modified_time(img->filename);
+		md5.append((const uint8_t*)&modified_time, sizeof(modified_time));
+	}
+	else {
+		md5.append((const uint8_t*)&num_reloads, sizeof(num_reloads));
+	}
+}
+
 bool ImageManager::file_load_image_generic(Image *img, ImageInput **in, int &width, int &height, int &depth, int &components)
 {
 	if(img->filename == "")
@@ -768,6 +820,38 @@ bool ImageManager::file_load_half_image(Image *img, ImageDataType type, device_v
 	return true;
 }
 
+template<typename T>
+bool ImageManager::make_sparse_image(const string& filename,
+                                     device_vector<T>& tex_img,
+                                     device_vector<int>& tex_offsets)
+{
+	const int width = tex_img.data_width;
+	const int height = tex_img.data_height;
+	const int depth = tex_img.data_depth;
+	vector<int> offsets;
+	vector<T> tiles;
+
+	if(!sparse_grid_create(tex_img.get_data(), width, height, depth, &offsets, &tiles)) {
+		return false;
+	}
+
+	VLOG(1) << "Storing " << filename << " as sparse image, "
+	        << string_human_readable_size(tex_img.memory_size()) << " dense, "
+	        << string_human_readable_size(tiles.size()*sizeof(T) + offsets.size()*sizeof(int))
+	        << " sparse.";
+
+	tex_img.copy(&tiles[0], tiles.size());
+	tex_offsets.copy(&offsets[0], offsets.size());
+
+	/* Kernel lookups need the resolution of the full image, the packed
+	 * tiles themselves are a flat array. */
+	tex_img.data_width = width;
+	tex_img.data_height = height;
+	tex_img.data_depth = depth;
+
+	return true;
+}
+
 void ImageManager::device_load_image(Device *device, DeviceScene *dscene, ImageDataType type, int slot, Progress *progress)
 {
 	if(progress->get_cancel())
@@ -794,12 +878,20 @@ void ImageManager::device_load_image(Device *device, DeviceScene *dscene, ImageD
 
 	if(type == IMAGE_DATA_TYPE_FLOAT4) {
 		device_vector<float4>& tex_img = dscene->tex_float4_image[slot];
+		device_vector<int>& tex_offsets = dscene->tex_float4_sparse_offsets[slot];
 
 		if(tex_img.device_pointer) {
 			thread_scoped_lock device_lock(device_mutex);
 			device->tex_free(tex_img);
 		}
 
+		if(tex_offsets.device_pointer) {
+			thread_scoped_lock device_lock(device_mutex);
+			device->tex_free(tex_offsets);
+		}
+
+		tex_offsets.clear();
+
 		if(!file_load_float_image(img, type, tex_img)) {
 			/* on failure to load, we set a 1x1 pixels pink image */
 			float *pixels = (float*)tex_img.resize(1, 1);
@@ -810,22 +902,39 @@ void ImageManager::device_load_image(Device *device, DeviceScene *dscene, ImageD
 			pixels[3] = TEX_IMAGE_MISSING_A;
 		}
 
+		if(use_sparse_images && !pack_images && tex_img.data_depth > 1) {
+			make_sparse_image(filename, tex_img, tex_offsets);
+		}
+
 		if(!pack_images) {
 			thread_scoped_lock device_lock(device_mutex);
 			device->tex_alloc(name.c_str(),
 			                  tex_img,
 			                  img->interpolation,
 			                  img->extension);
+
+			if(tex_offsets.size()) {
+				string sparse_name = string_printf("__tex_sparse_%s_%03d", name_from_type(type).c_str(), flat_slot);
+				device->tex_alloc(sparse_name.c_str(), tex_offsets);
+			}
 		}
 	}
 	else if(type == IMAGE_DATA_TYPE_FLOAT) {
 		device_vector<float>& tex_img = dscene->tex_float_image[slot];
+		device_vector<int>& tex_offsets = dscene->tex_float_sparse_offsets[slot];
 
 		if(tex_img.device_pointer) {
 			thread_scoped_lock device_lock(device_mutex);
 			device->tex_free(tex_img);
 		}
 
+		if(tex_offsets.device_pointer) {
+			thread_scoped_lock device_lock(device_mutex);
+			device->tex_free(tex_offsets);
+		}
+
+		tex_offsets.clear();
+
 		if(!file_load_float_image(img, type, tex_img)) {
 			/* on failure to load, we set a 1x1 pixels pink image */
 			float *pixels = (float*)tex_img.resize(1, 1);
@@ -833,12 +942,21 @@ void ImageManager::device_load_image(Device *device, DeviceScene *dscene, ImageD
 			pixels[0] = TEX_IMAGE_MISSING_R;
 		}
 
+		if(use_sparse_images && !pack_images && tex_img.data_depth > 1) {
+			make_sparse_image(filename, tex_img, tex_offsets);
+		}
+
 		if(!pack_images) {
 			thread_scoped_lock device_lock(device_mutex);
 			device->tex_alloc(name.c_str(),
 			                  tex_img,
 			                  img->interpolation,
 			                  img->extension);
+
+			if(tex_offsets.size()) {
+				string sparse_name = string_printf("__tex_sparse_%s_%03d", name_from_type(type).c_str(), flat_slot);
+				device->tex_alloc(sparse_name.c_str(), tex_offsets);
+			}
 		}
 	}
 	else if(type == IMAGE_DATA_TYPE_BYTE4) {
@@ -956,23 +1074,37 @@ void ImageManager::device_free_image(Device *device, DeviceScene *dscene, ImageD
 		}
 		else if(type == IMAGE_DATA_TYPE_FLOAT4) {
 			device_vector<float4>& tex_img = dscene->tex_float4_image[slot];
+			device_vector<int>& tex_offsets = dscene->tex_float4_sparse_offsets[slot];
 
 			if(tex_img.device_pointer) {
 				thread_scoped_lock device_lock(device_mutex);
 				device->tex_free(tex_img);
 			}
 
+			if(tex_offsets.device_pointer) {
+				thread_scoped_lock device_lock(device_mutex);
+				device->tex_free(tex_offsets);
+			}
+
 			tex_img.clear();
+			tex_offsets.clear();
 		}
 		else if(type == IMAGE_DATA_TYPE_FLOAT) {
 			device_vector<float>& tex_img = dscene->tex_float_image[slot];
+			device_vector<int>& tex_offsets = dscene->tex_float_sparse_offsets[slot];
 
 			if(tex_img.device_pointer) {
 				thread_scoped_lock device_lock(device_mutex);
 				device->tex_free(tex_img);
 			}
 
+			if(tex_offsets.device_pointer) {
+				thread_scoped_lock device_lock(device_mutex);
+				device->tex_free(tex_offsets);
+			}
+
 			tex_img.clear();
+			tex_offsets.clear();
 		}
 		else if(type == IMAGE_DATA_TYPE_BYTE4) {
 			device_vector<uchar4>& tex_img = dscene->tex_byte4_image[slot];
@@ -29,6 +29,7 @@ CCL_NAMESPACE_BEGIN
 
 class Device;
 class DeviceScene;
+class MD5Hash;
 class Progress;
 
 class ImageManager {
@@ -67,6 +68,10 @@ public:
 	                      ExtensionType extension);
 	ImageDataType get_image_metadata(const string& filename, void *builtin_data, bool& is_linear);
 
+	/* Hash identifying the image and its pixels, for caching data computed
+	 * from it. Images tagged for reload get a new hash. */
+	void hash_image(int flat_slot, MD5Hash& md5);
+
 	void device_update(Device *device, DeviceScene *dscene, Progress& progress);
 	void device_update_slot(Device *device, DeviceScene *dscene, int flat_slot, Progress *progress);
 	void device_free(Device *device, DeviceScene *dscene);
@@ -101,11 +106,14 @@ private:
 	int tex_start_images[IMAGE_DATA_NUM_TYPES];
 
 	thread_mutex device_mutex;
+	thread_mutex images_mutex;
 	int animation_frame;
+	uint num_reloads;
 
 	vector<Image*> images[IMAGE_DATA_NUM_TYPES];
 	void *osl_texture_system;
 	bool pack_images;
+	bool use_sparse_images;
 
 	bool file_load_image_generic(Image *img, ImageInput **in, int &width, int &height, int &depth, int &components);
 
@@ -118,6 +126,9 @@ private:
 	template<typename T>
 	bool file_load_half_image(Image *img, ImageDataType type, device_vector<T>& tex_img);
 
+	template<typename T>
+	bool make_sparse_image(const string& filename, device_vector<T>& tex_img, device_vector<int>& tex_offsets);
+
 	int type_index_to_flattened_slot(int slot, ImageDataType type);
 	int flattened_slot_to_type_index(int flat_slot, ImageDataType *type);
 	string name_from_type(int type);
@@ -45,6 +45,7 @@ public:
 
 	int volume_max_steps;
 	float volume_step_size;
+	bool volume_skip_empty;
 
 	bool caustics_reflective;
 	bool caustics_refractive;
@@ -20,11 +20,13 @@
 #include "film.h"
 #include "light.h"
 #include "mesh.h"
+#include "nodes.h"
 #include "object.h"
 #include "scene.h"
 #include "shader.h"
 
 #include "util_foreach.h"
+#include "util_md5.h"
 #include "util_progress.h"
 #include "util_logging.h"
 
@@ -514,6 +516,40 @@ static void background_cdf(int start,
 	}
 }
 
+static bool background_map_get_key(Scene *scene, int res, string *key)
+{
+	Background *background = scene->background;
+	Shader *shader = background->shader;
+
+	if(background->use_shader) {
+		if(!shader)
+			shader = scene->default_background;
+	}
+	else {
+		shader = scene->default_empty;
+	}
+
+	MD5Hash md5;
+	md5.append((const uint8_t*)&res, sizeof(res));
+	md5.append((const uint8_t*)&scene->dscene.data.background.surface_shader, sizeof(int));
+
+	/* images are identified by the image manager, other external data can't
+	 * be tracked */
+	foreach(ShaderNode *node, shader->graph->nodes) {
+		if(node->has_external_dependency()) {
+			if(node->special_type != SHADER_SPECIAL_TYPE_IMAGE_SLOT)
+				return false;
+
+			scene->image_manager->hash_image(((ImageSlotTextureNode*)node)->slot, md5);
+		}
+	}
+
+	shader->graph->hash(md5);
+
+	*key = md5.get_hex();
+	return true;
+}
+
 void LightManager::device_update_background(Device *device,
                                             DeviceScene *dscene,
                                             Scene *scene,
@@ -533,6 +569,9 @@ void LightManager::device_update_background(Device *device,
 	/* no background light found, signal renderer to skip sampling */
 	if(!background_light || !background_light->is_enabled) {
 		kintegrator->pdf_background_res = 0;
+		dscene->light_background_marginal_cdf.clear();
+		dscene->light_background_conditional_cdf.clear();
+		background_map_key = "";
 		return;
 	}
 
@@ -546,18 +585,43 @@ void LightManager::device_update_background(Device *device,
 
 	assert(res > 0);
 
+	int cdf_count = res + 1;
+
+	/* reuse importance map when background did not change, camera and
+	 * object edits also trigger light updates */
+	string map_key;
+	if(!background_map_get_key(scene, res, &map_key)) {
+		map_key = "";
+	}
+
+	if(!map_key.empty() &&
+	   map_key == background_map_key &&
+	   dscene->light_background_marginal_cdf.size() == cdf_count &&
+	   dscene->light_background_conditional_cdf.size() == cdf_count * cdf_count)
+	{
+		VLOG(2) << "Reusing background importance map.";
+		device->tex_alloc("__light_background_marginal_cdf", dscene->light_background_marginal_cdf);
+		device->tex_alloc("__light_background_conditional_cdf", dscene->light_background_conditional_cdf);
+		return;
+	}
+
+	background_map_key = "";
+
+	double time_start = time_dt();
+
 	vector<float3> pixels;
 	shade_background_pixels(device, dscene, res, pixels, progress);
 
 	if(progress.get_cancel())
 		return;
 
+	VLOG(2) << "Background shading time " << time_dt() - time_start << "\n";
+
 	/* build row distributions and column distribution for the infinite area environment light */
-	int cdf_count = res + 1;
 	float2 *marg_cdf = dscene->light_background_marginal_cdf.resize(cdf_count);
 	float2 *cond_cdf = dscene->light_background_conditional_cdf.resize(cdf_count * cdf_count);
 
-	double time_start = time_dt();
+	time_start = time_dt();
 	if(res < 512) {
 		/* Small enough resolution, faster to do single-threaded. */
 		background_cdf(0, res, res, cdf_count, &pixels, cond_cdf);
@@ -603,6 +667,8 @@ void LightManager::device_update_background(Device *device,
 
 	VLOG(2) << "Background MIS build time " << time_dt() - time_start << "\n";
 
+	background_map_key = map_key;
+
 	/* update device */
 	device->tex_alloc("__light_background_marginal_cdf", dscene->light_background_marginal_cdf);
 	device->tex_alloc("__light_background_conditional_cdf", dscene->light_background_conditional_cdf);
@@ -839,10 +905,9 @@ void LightManager::device_free(Device *device, DeviceScene *dscene)
 	device->tex_free(dscene->light_background_marginal_cdf);
 	device->tex_free(dscene->light_background_conditional_cdf);
 
+	/* background importance map is kept for reuse, see device_update_background */
 	dscene->light_distribution.clear();
 	dscene->light_data.clear();
-	dscene->light_background_marginal_cdf.clear();
-	dscene->light_background_conditional_cdf.clear();
 }
 
 void LightManager::tag_update(Scene * /*scene*/)
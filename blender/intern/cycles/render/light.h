@@ -115,6 +115,10 @@ protected:
 
 	/* Check whether light manager can use the object as a light-emissive. */
 	bool object_usable_as_light(Object *object);
+
+	/* Hash of the background shader and images the importance map was
+	 * computed from, the map is reused while it does not change. */
+	string background_map_key;
 };
 
 CCL_NAMESPACE_END
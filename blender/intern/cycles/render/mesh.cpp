@@ -33,7 +33,9 @@
 #include "subd_split.h"
 #include "subd_patch_table.h"
 
+#include "util_cache.h"
 #include "util_foreach.h"
+#include "util_half.h"
 #include "util_logging.h"
 #include "util_progress.h"
 #include "util_set.h"
@@ -608,7 +610,7 @@ void Mesh::add_undisplaced()
 	}
 }
 
-void Mesh::pack_normals(Scene *scene, uint *tri_shader, float4 *vnormal)
+void Mesh::pack_normals(Scene *scene, uint *tri_shader, float4 *vnormal, uint *vnormal_oct)
 {
 	Attribute *attr_vN = attributes.find(ATTR_STD_VERTEX_NORMAL);
 	if(attr_vN == NULL) {
@@ -648,7 +650,10 @@ void Mesh::pack_normals(Scene *scene, uint *tri_shader, float4 *vnormal)
 		if(do_transform)
 			vNi = normalize(transform_direction(&ntfm, vNi));
 
-		vnormal[i] = make_float4(vNi.x, vNi.y, vNi.z, 0.0f);
+		if(vnormal_oct)
+			vnormal_oct[i] = float3_to_octahedral(vNi);
+		else
+			vnormal[i] = make_float4(vNi.x, vNi.y, vNi.z, 0.0f);
 	}
 }
 
@@ -799,7 +804,21 @@ void Mesh::compute_bvh(DeviceScene *dscene,
 
 			delete bvh;
 			bvh = BVH::create(bparams, objects);
-			MEM_GUARDED_CALL(progress, bvh->build, *progress);
+
+			if(params->use_bvh_cache) {
+				CacheData key("bvh");
+				bvh->cache_key(key);
+
+				if(!bvh->cache_read(key)) {
+					MEM_GUARDED_CALL(progress, bvh->build, *progress);
+
+					if(!progress->get_cancel())
+						bvh->cache_write(key);
+				}
+			}
+			else {
+				MEM_GUARDED_CALL(progress, bvh->build, *progress);
+			}
 		}
 	}
 
@@ -865,6 +884,9 @@ MeshManager::MeshManager()
 	bvh = NULL;
 	need_update = true;
 	need_flags_update = true;
+	need_bvh_refit = false;
+	compressed_normals_saved = 0;
+	compressed_attributes_saved = 0;
 }
 
 MeshManager::~MeshManager()
@@ -1099,9 +1121,23 @@ void MeshManager::update_svm_attributes(Device *device, DeviceScene *dscene, Sce
 	device->tex_alloc("__attributes_map", dscene->attributes_map);
 }
 
+static bool attribute_compressible(Attribute *mattr, AttributePrimitive prim, bool compress)
+{
+	/* UV maps on triangles are stored as half floats, their third component
+	 * is always zero. Non-active UV maps are synced as named corner points
+	 * flagged as UV maps, other corner points may use all components.
+	 * Subdivision patches evaluate full precision attributes. */
+	return compress &&
+	       prim == ATTR_PRIM_TRIANGLE &&
+	       mattr->element == ATTR_ELEMENT_CORNER &&
+	       mattr->type == TypeDesc::TypePoint &&
+	       (mattr->std == ATTR_STD_UV || (mattr->flags & ATTR_UV_MAP));
+}
+
 static void update_attribute_element_size(Mesh *mesh,
                                           Attribute *mattr,
                                           AttributePrimitive prim,
+                                          bool compress,
                                           size_t *attr_float_size,
                                           size_t *attr_float3_size,
                                           size_t *attr_uchar4_size)
@@ -1115,6 +1151,9 @@ static void update_attribute_element_size(Mesh *mesh,
 		else if(mattr->element == ATTR_ELEMENT_CORNER_BYTE) {
 			*attr_uchar4_size += size;
 		}
+		else if(attribute_compressible(mattr, prim, compress)) {
+			*attr_float_size += size;
+		}
 		else if(mattr->type == TypeDesc::TypeFloat) {
 			*attr_float_size += size;
 		}
@@ -1136,6 +1175,8 @@ static void update_attribute_element_offset(Mesh *mesh,
                                             size_t& attr_uchar4_offset,
                                             Attribute *mattr,
                                             AttributePrimitive prim,
+                                            bool compress,
+                                            size_t *compressed_saved,
                                             TypeDesc& type,
                                             AttributeDescriptor& desc)
 {
@@ -1166,6 +1207,20 @@ static void update_attribute_element_offset(Mesh *mesh,
 			}
 			attr_uchar4_offset += size;
 		}
+		else if(attribute_compressible(mattr, prim, compress)) {
+			float3 *data = mattr->data_float3();
+			offset = attr_float_offset;
+
+			assert(attr_float.capacity() >= offset + size);
+			for(size_t k = 0; k < size; k++) {
+				uint h = float_to_half(data[k].x) | ((uint)float_to_half(data[k].y) << 16);
+				attr_float[offset+k] = __uint_as_float(h);
+			}
+			attr_float_offset += size;
+
+			desc.flags = (AttributeFlag)(desc.flags | ATTR_COMPRESSED);
+			*compressed_saved += size*(sizeof(float4) - sizeof(float));
+		}
 		else if(mattr->type == TypeDesc::TypeFloat) {
 			float *data = mattr->data_float();
 			offset = attr_float_offset;
@@ -1237,6 +1292,8 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 {
 	progress.set_status("Updating Mesh", "Computing attributes");
 
+	scoped_stats_timer timer(&scene->update_times, "attributes");
+
 	/* gather per mesh requested attributes. as meshes may have multiple
 	 * shaders assigned, this merges the requested attributes that have
 	 * been set per shader by the shader manager */
@@ -1259,6 +1316,8 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 	/* Pre-allocate attributes to avoid arrays re-allocation which would
 	 * take 2x of overall attribute memory usage.
 	 */
+	bool compress = scene->params.use_compressed_attributes;
+	size_t compressed_saved = 0;
 	size_t attr_float_size = 0;
 	size_t attr_float3_size = 0;
 	size_t attr_uchar4_size = 0;
@@ -1273,18 +1332,21 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 			update_attribute_element_size(mesh,
 			                              triangle_mattr,
 			                              ATTR_PRIM_TRIANGLE,
+			                              compress,
 			                              &attr_float_size,
 			                              &attr_float3_size,
 			                              &attr_uchar4_size);
 			update_attribute_element_size(mesh,
 			                              curve_mattr,
 			                              ATTR_PRIM_CURVE,
+			                              compress,
 			                              &attr_float_size,
 			                              &attr_float3_size,
 			                              &attr_uchar4_size);
 			update_attribute_element_size(mesh,
 			                              subd_mattr,
 			                              ATTR_PRIM_SUBD,
+			                              compress,
 			                              &attr_float_size,
 			                              &attr_float3_size,
 			                              &attr_uchar4_size);
@@ -1317,6 +1379,8 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 			                                attr_uchar4, attr_uchar4_offset,
 			                                triangle_mattr,
 			                                ATTR_PRIM_TRIANGLE,
+			                                compress,
+			                                &compressed_saved,
 			                                req.triangle_type,
 			                                req.triangle_desc);
 
@@ -1326,6 +1390,8 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 			                                attr_uchar4, attr_uchar4_offset,
 			                                curve_mattr,
 			                                ATTR_PRIM_CURVE,
+			                                compress,
+			                                &compressed_saved,
 			                                req.curve_type,
 			                                req.curve_desc);
 
@@ -1335,6 +1401,8 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 			                                attr_uchar4, attr_uchar4_offset,
 			                                subd_mattr,
 			                                ATTR_PRIM_SUBD,
+			                                compress,
+			                                &compressed_saved,
 			                                req.subd_type,
 			                                req.subd_desc);
 
@@ -1342,6 +1410,8 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 		}
 	}
 
+	compressed_attributes_saved = compressed_saved;
+
 	/* create attribute lookup maps */
 	if(scene->shader_manager->use_osl())
 		update_osl_attributes(device, scene, mesh_attributes);
@@ -1473,8 +1543,10 @@ void MeshManager::device_update_mesh(Device *device,
 		/* normals */
 		progress.set_status("Updating Mesh", "Computing normals");
 
+		bool compress = scene->params.use_compressed_attributes;
 		uint *tri_shader = dscene->tri_shader.resize(tri_size);
-		float4 *vnormal = dscene->tri_vnormal.resize(vert_size);
+		float4 *vnormal = (compress)? NULL: dscene->tri_vnormal.resize(vert_size);
+		uint *vnormal_oct = (compress)? dscene->tri_vnormal_oct.resize(vert_size): NULL;
 		uint4 *tri_vindex = dscene->tri_vindex.resize(tri_size);
 		uint *tri_patch = dscene->tri_patch.resize(tri_size);
 		float2 *tri_patch_uv = dscene->tri_patch_uv.resize(vert_size);
@@ -1482,7 +1554,8 @@ void MeshManager::device_update_mesh(Device *device,
 		foreach(Mesh *mesh, scene->meshes) {
 			mesh->pack_normals(scene,
 			                   &tri_shader[mesh->tri_offset],
-			                   &vnormal[mesh->vert_offset]);
+			                   (vnormal)? &vnormal[mesh->vert_offset]: NULL,
+			                   (vnormal_oct)? &vnormal_oct[mesh->vert_offset]: NULL);
 			mesh->pack_verts(tri_prim_index,
 			                 &tri_vindex[mesh->tri_offset],
 			                 &tri_patch[mesh->tri_offset],
@@ -1496,7 +1569,15 @@ void MeshManager::device_update_mesh(Device *device,
 		progress.set_status("Updating Mesh", "Copying Mesh to device");
 
 		device->tex_alloc("__tri_shader", dscene->tri_shader);
-		device->tex_alloc("__tri_vnormal", dscene->tri_vnormal);
+		if(compress) {
+			device->tex_alloc("__tri_vnormal_oct", dscene->tri_vnormal_oct);
+			compressed_normals_saved = vert_size*(sizeof(float4) - sizeof(uint));
+		}
+		else {
+			device->tex_alloc("__tri_vnormal", dscene->tri_vnormal);
+		}
+
+		dscene->data.bvh.use_compressed_normals = compress;
 		device->tex_alloc("__tri_vindex", dscene->tri_vindex);
 		device->tex_alloc("__tri_patch", dscene->tri_patch);
 		device->tex_alloc("__tri_patch_uv", dscene->tri_patch_uv);
@@ -1555,6 +1636,8 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	/* bvh build */
 	progress.set_status("Updating Scene BVH", "Building");
 
+	scoped_stats_timer timer(&scene->update_times, "bvh");
+
 	VLOG(1) << (scene->params.use_qbvh ? "Using QBVH optimization structure"
 	                                   : "Using regular BVH optimization structure");
 
@@ -1567,7 +1650,21 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 
 	delete bvh;
 	bvh = BVH::create(bparams, scene->objects);
-	bvh->build(progress);
+
+	if(scene->params.use_bvh_cache) {
+		CacheData key("bvh");
+		bvh->cache_key(key);
+
+		if(!bvh->cache_read(key)) {
+			bvh->build(progress);
+
+			if(!progress.get_cancel())
+				bvh->cache_write(key);
+		}
+	}
+	else {
+		bvh->build(progress);
+	}
 
 	if(progress.get_cancel()) return;
 
@@ -1617,6 +1714,63 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	dscene->data.bvh.use_qbvh = scene->params.use_qbvh;
 }
 
+bool MeshManager::device_update_bvh_refit(Device *device,
+                                          DeviceScene *dscene,
+                                          Scene *scene,
+                                          Progress& progress)
+{
+	/* Refit is only possible when the top level BVH contains exactly the same
+	 * objects and meshes, only with different transforms.
+	 */
+	if(bvh == NULL || bvh->objects != scene->objects) {
+		return false;
+	}
+	foreach(Mesh *mesh, scene->meshes) {
+		if(mesh->need_update) {
+			return false;
+		}
+	}
+
+	progress.set_status("Updating Scene BVH", "Refitting");
+
+	scoped_stats_timer timer(&scene->update_times, "bvh_refit");
+
+#ifdef __OBJECT_MOTION__
+	Scene::MotionType need_motion = scene->need_motion(device->info.advanced_shading);
+	bool motion_blur = need_motion == Scene::MOTION_BLUR;
+#else
+	bool motion_blur = false;
+#endif
+
+	foreach(Object *object, scene->objects) {
+		object->compute_bounds(motion_blur);
+	}
+
+	bvh->refit(progress);
+
+	if(progress.get_cancel()) return true;
+
+	need_bvh_refit = false;
+
+	/* Node arrays keep their size, so only re-upload them. */
+	PackedBVH& pack = bvh->pack;
+
+	if(pack.nodes.size()) {
+		device->tex_free(dscene->bvh_nodes);
+		dscene->bvh_nodes.reference((float4*)&pack.nodes[0], pack.nodes.size());
+		device->tex_alloc("__bvh_nodes", dscene->bvh_nodes);
+	}
+	if(pack.leaf_nodes.size()) {
+		device->tex_free(dscene->bvh_leaf_nodes);
+		dscene->bvh_leaf_nodes.reference((float4*)&pack.leaf_nodes[0], pack.leaf_nodes.size());
+		device->tex_alloc("__bvh_leaf_nodes", dscene->bvh_leaf_nodes);
+	}
+
+	VLOG(1) << "Refitted top level BVH of " << scene->objects.size() << " objects.";
+
+	return true;
+}
+
 void MeshManager::device_update_flags(Device * /*device*/,
                                       DeviceScene * /*dscene*/,
                                       Scene * scene,
@@ -1690,8 +1844,15 @@ void MeshManager::device_update_displacement_images(Device *device,
 
 void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
-	if(!need_update)
-		return;
+	if(!need_update) {
+		if(!need_bvh_refit)
+			return;
+		if(device_update_bvh_refit(device, dscene, scene, progress))
+			return;
+		/* Refit is not possible, fall back to full update. */
+	}
+
+	need_bvh_refit = false;
 
 	VLOG(1) << "Total " << scene->meshes.size() << " meshes.";
 
@@ -1817,6 +1978,7 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 		}
 	}
 
+	scoped_stats_timer timer(&scene->update_times, "object_bvh");
 	TaskPool pool;
 
 	i = 0;
@@ -1839,6 +2001,7 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 	pool.wait_work(&summary);
 	VLOG(2) << "Objects BVH build pool statistics:\n"
 	        << summary.full_report();
+	timer.end();
 
 	foreach(Shader *shader, scene->shaders) {
 		shader->need_update_attributes = false;
@@ -1891,6 +2054,7 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	device->tex_free(dscene->prim_object);
 	device->tex_free(dscene->tri_shader);
 	device->tex_free(dscene->tri_vnormal);
+	device->tex_free(dscene->tri_vnormal_oct);
 	device->tex_free(dscene->tri_vindex);
 	device->tex_free(dscene->tri_patch);
 	device->tex_free(dscene->tri_patch_uv);
@@ -1912,6 +2076,7 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	dscene->prim_object.clear();
 	dscene->tri_shader.clear();
 	dscene->tri_vnormal.clear();
+	dscene->tri_vnormal_oct.clear();
 	dscene->tri_vindex.clear();
 	dscene->tri_patch.clear();
 	dscene->tri_patch_uv.clear();
@@ -1923,6 +2088,9 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	dscene->attributes_float3.clear();
 	dscene->attributes_uchar4.clear();
 
+	compressed_normals_saved = 0;
+	compressed_attributes_saved = 0;
+
 #ifdef WITH_OSL
 	OSLGlobals *og = (OSLGlobals*)device->osl_memory();
 
@@ -217,7 +217,7 @@ public:
 	void add_vertex_normals();
 	void add_undisplaced();
 
-	void pack_normals(Scene *scene, uint *shader, float4 *vnormal);
+	void pack_normals(Scene *scene, uint *shader, float4 *vnormal, uint *vnormal_oct);
 	void pack_verts(const vector<uint>& tri_prim_index,
 	                uint4 *tri_vindex,
 	                uint *tri_patch,
@@ -265,6 +265,12 @@ public:
 
 	bool need_update;
 	bool need_flags_update;
+	/* Only object transforms changed, top level BVH can be refitted. */
+	bool need_bvh_refit;
+
+	/* device memory saved by compressed normal and attribute storage */
+	size_t compressed_normals_saved;
+	size_t compressed_attributes_saved;
 
 	MeshManager();
 	~MeshManager();
@@ -307,6 +313,11 @@ protected:
 	                       Scene *scene,
 	                       Progress& progress);
 
+	bool device_update_bvh_refit(Device *device,
+	                             DeviceScene *dscene,
+	                             Scene *scene,
+	                             Progress& progress);
+
 	void device_update_displacement_images(Device *device,
 	                                       DeviceScene *dscene,
 	                                       Scene *scene,
@@ -259,6 +259,7 @@ public:
 
 	bool has_spatial_varying() { return true; }
 	bool has_object_dependency() { return true; }
+	bool has_external_dependency() { return true; }
 
 	ustring filename;
 	NodeTexVoxelSpace space;
@@ -944,6 +945,8 @@ public:
 
 	SHADER_NODE_NO_CLONE_CLASS(OSLNode)
 
+	bool has_external_dependency() { return true; }
+
 	/* ideally we could beter detect this, but we can't query this now */
 	bool has_spatial_varying() { return true; }
 	virtual bool equals(const ShaderNode& /*other*/) { return false; }
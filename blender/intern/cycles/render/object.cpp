@@ -62,6 +62,7 @@ Object::Object()
 	motion.mid = transform_empty();
 	motion.post = transform_empty();
 	use_motion = false;
+	need_transform_update = false;
 }
 
 Object::~Object()
@@ -230,6 +231,29 @@ void Object::tag_update(Scene *scene)
 	scene->object_manager->need_update = true;
 }
 
+void Object::tag_transform_update(Scene *scene)
+{
+	/* Meshes with applied transform have to be re-packed and get their
+	 * primitives back into the top level BVH, needs full update.
+	 */
+	if(!mesh || mesh->transform_applied) {
+		tag_update(scene);
+		return;
+	}
+
+	foreach(Shader *shader, mesh->used_shaders) {
+		if(shader->use_mis && shader->has_surface_emission)
+			scene->light_manager->need_update = true;
+	}
+
+	need_transform_update = true;
+
+	scene->camera->need_flags_update = true;
+	scene->mesh_manager->need_bvh_refit = true;
+	scene->object_manager->need_transform_update = true;
+	scene->object_manager->need_flags_update = true;
+}
+
 vector<float> Object::motion_times()
 {
 	/* compute times at which we sample motion for this object */
@@ -266,6 +290,7 @@ ObjectManager::ObjectManager()
 {
 	need_update = true;
 	need_flags_update = true;
+	need_transform_update = false;
 }
 
 ObjectManager::~ObjectManager()
@@ -533,11 +558,25 @@ void ObjectManager::device_update_transforms(Device *device,
 
 void ObjectManager::device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
-	if(!need_update)
+	if(!need_update && !need_transform_update)
 		return;
 
+	if(!need_update) {
+		progress.set_status("Updating Objects", "Copying Transformations to device");
+		if(device_update_transforms_incremental(device, dscene, scene, progress)) {
+			return;
+		}
+		/* Incremental update is not possible, update everything. */
+		need_update = true;
+	}
+
 	VLOG(1) << "Total " << scene->objects.size() << " objects.";
 
+	need_transform_update = false;
+	foreach(Object *object, scene->objects) {
+		object->need_transform_update = false;
+	}
+
 	device_free(device, dscene);
 
 	if(scene->objects.size() == 0)
@@ -560,6 +599,97 @@ void ObjectManager::device_update(Device *device, DeviceScene *dscene, Scene *sc
 	}
 }
 
+bool ObjectManager::device_update_transforms_incremental(Device *device,
+                                                         DeviceScene *dscene,
+                                                         Scene *scene,
+                                                         Progress& progress)
+{
+	/* Only objects tagged with transform update are re-packed, which is only
+	 * possible when the object arrays are already on the device and their
+	 * layout did not change.
+	 */
+	size_t num_objects = scene->objects.size();
+	Scene::MotionType need_motion = scene->need_motion(device->info.advanced_shading);
+
+	if(num_objects == 0 ||
+	   scene->params.bvh_type == SceneParams::BVH_STATIC ||
+	   need_motion == Scene::MOTION_BLUR ||
+	   dscene->objects.size() != OBJECT_SIZE*num_objects ||
+	   dscene->object_flag.size() != num_objects)
+	{
+		return false;
+	}
+	if(need_motion == Scene::MOTION_PASS &&
+	   dscene->objects_vector.size() != OBJECT_VECTOR_SIZE*num_objects)
+	{
+		return false;
+	}
+
+	UpdateObejctTransformState state;
+	state.need_motion = need_motion;
+	state.have_motion = dscene->data.bvh.have_motion;
+	state.have_curves = dscene->data.bvh.have_curves;
+	state.scene = scene;
+	state.queue_start_object = 0;
+
+	state.object_flag = dscene->object_flag.get_data();
+	state.objects = dscene->objects.get_data();
+	state.objects_vector = (need_motion == Scene::MOTION_PASS)
+	        ? dscene->objects_vector.get_data()
+	        : NULL;
+
+	int numparticles = 1;
+	foreach(ParticleSystem *psys, scene->particle_systems) {
+		state.particle_offset[psys] = numparticles;
+		numparticles += psys->particles.size();
+	}
+
+	/* Range of object slots which were re-packed. */
+	int first_index = (int)num_objects, last_index = -1;
+	int object_index = 0;
+
+	foreach(Object *ob, scene->objects) {
+		if(ob->need_transform_update) {
+			/* Volume flags are maintained by device_update_flags(). */
+			uint volume_flag = state.object_flag[object_index] &
+			                   (SD_OBJECT_HAS_VOLUME | SD_OBJECT_INTERSECTS_VOLUME);
+
+			device_update_object_transform(&state, ob, object_index);
+			state.object_flag[object_index] |= volume_flag;
+			ob->need_transform_update = false;
+
+			first_index = min(first_index, object_index);
+			last_index = object_index;
+		}
+		object_index++;
+	}
+
+	need_transform_update = false;
+
+	if(last_index == -1) {
+		return true;
+	}
+
+	VLOG(1) << "Updated transform of objects " << first_index
+	        << " to " << last_index << " of " << num_objects << ".";
+
+	/* Only copy the range of re-packed objects to the device. */
+	int num_updated = last_index - first_index + 1;
+
+	device->mem_copy_to(dscene->objects,
+	                    sizeof(float4)*OBJECT_SIZE*first_index,
+	                    sizeof(float4)*OBJECT_SIZE*num_updated);
+	if(need_motion == Scene::MOTION_PASS) {
+		device->mem_copy_to(dscene->objects_vector,
+		                    sizeof(float4)*OBJECT_VECTOR_SIZE*first_index,
+		                    sizeof(float4)*OBJECT_VECTOR_SIZE*num_updated);
+	}
+
+	dscene->data.bvh.have_motion = state.have_motion;
+
+	return true;
+}
+
 void ObjectManager::device_update_flags(Device *device,
                                         DeviceScene *dscene,
                                         Scene *scene,
@@ -599,6 +729,8 @@ void ObjectManager::device_update_flags(Device *device,
 		}
 
 		if(bounds_valid) {
+			/* Bounds might have changed since the flag was set. */
+			object_flag[object_index] &= ~SD_OBJECT_INTERSECTS_VOLUME;
 			foreach(Object *volume_object, volume_objects) {
 				if(object == volume_object) {
 					continue;
@@ -618,7 +750,9 @@ void ObjectManager::device_update_flags(Device *device,
 		++object_index;
 	}
 
-	/* allocate object flag */
+	/* allocate object flag, might still be on the device after incremental
+	 * transform update */
+	device->tex_free(dscene->object_flag);
 	device->tex_alloc("__object_flag", dscene->object_flag);
 }
 
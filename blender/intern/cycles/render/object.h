@@ -54,6 +54,9 @@ public:
 	bool hide_on_missing_motion;
 	bool use_holdout;
 
+	/* Only the transform changed since the last device update. */
+	bool need_transform_update;
+
 	float3 dupli_generated;
 	float2 dupli_uv;
 
@@ -64,6 +67,7 @@ public:
 	~Object();
 
 	void tag_update(Scene *scene);
+	void tag_transform_update(Scene *scene);
 
 	void compute_bounds(bool motion_blur);
 	void apply_transform(bool apply_to_motion);
@@ -82,6 +86,7 @@ class ObjectManager {
 public:
 	bool need_update;
 	bool need_flags_update;
+	bool need_transform_update;
 
 	ObjectManager();
 	~ObjectManager();
@@ -93,6 +98,11 @@ public:
 	                              uint *object_flag,
 	                              Progress& progress);
 
+	bool device_update_transforms_incremental(Device *device,
+	                                          DeviceScene *dscene,
+	                                          Scene *scene,
+	                                          Progress& progress);
+
 	void device_update_flags(Device *device,
 	                         DeviceScene *dscene,
 	                         Scene *scene,
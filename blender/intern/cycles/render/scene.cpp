@@ -33,6 +33,7 @@
 #include "svm.h"
 #include "tables.h"
 
+#include "util_cache.h"
 #include "util_foreach.h"
 #include "util_guarded_allocator.h"
 #include "util_logging.h"
@@ -151,96 +152,123 @@ void Scene::device_update(Device *device_, Progress& progress)
 	
 	image_manager->set_pack_images(device->info.pack_images);
 
+	if(params.use_bvh_cache || params.use_shader_cache) {
+		Cache::global.set_directory(params.cache_directory);
+		Cache::global.set_size_limit(params.cache_size_limit);
+	}
+
+	scoped_stats_timer timer(&update_times);
+
 	progress.set_status("Updating Shaders");
+	timer.begin("shaders");
 	shader_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Background");
+	timer.begin("background");
 	background->device_update(device, &dscene, this);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Camera");
+	timer.begin("camera");
 	camera->device_update(device, &dscene, this);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Meshes Flags");
+	timer.begin("mesh_flags");
 	mesh_manager->device_update_flags(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Objects");
+	timer.begin("objects");
 	object_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Meshes");
+	timer.begin("meshes");
 	mesh_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Objects Flags");
+	timer.begin("object_flags");
 	object_manager->device_update_flags(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Images");
+	timer.begin("images");
 	image_manager->device_update(device, &dscene, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Camera Volume");
+	timer.begin("camera_volume");
 	camera->device_update_volume(device, &dscene, this);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Hair Systems");
+	timer.begin("hair");
 	curve_system_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Lookup Tables");
+	timer.begin("lookup_tables");
 	lookup_tables->device_update(device, &dscene);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Lights");
+	timer.begin("lights");
 	light_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Particle Systems");
+	timer.begin("particles");
 	particle_system_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Integrator");
+	timer.begin("integrator");
 	integrator->device_update(device, &dscene, this);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Film");
+	timer.begin("film");
 	film->device_update(device, &dscene, this);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Lookup Tables");
+	timer.begin("lookup_tables");
 	lookup_tables->device_update(device, &dscene);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	progress.set_status("Updating Baking");
+	timer.begin("baking");
 	bake_manager->device_update(device, &dscene, this, progress);
 
 	if(progress.get_cancel() || device->have_error()) return;
 
 	if(device->have_error() == false) {
 		progress.set_status("Updating Device", "Writing constant memory");
+		timer.begin("device");
 		device->const_copy_to("__data", &dscene.data, sizeof(dscene.data));
 	}
 
+	timer.end();
+
 	if(print_stats) {
 		size_t mem_used = util_guarded_get_mem_used();
 		size_t mem_peak = util_guarded_get_mem_peak();
@@ -250,6 +278,12 @@ void Scene::device_update(Device *device_, Progress& progress)
 		        << " (" << string_human_readable_size(mem_used) << ")\n"
 		        << "  Peak: " << string_human_readable_number(mem_peak)
 		        << " (" << string_human_readable_size(mem_peak) << ")";
+
+		if(params.use_compressed_attributes) {
+			VLOG(1) << "Compressed geometry memory savings:\n"
+			        << "  Normals: " << string_human_readable_size(mesh_manager->compressed_normals_saved) << "\n"
+			        << "  Attributes: " << string_human_readable_size(mesh_manager->compressed_attributes_saved);
+		}
 	}
 }
 
@@ -300,7 +334,9 @@ bool Scene::need_data_update()
 	return (background->need_update
 		|| image_manager->need_update
 		|| object_manager->need_update
+		|| object_manager->need_transform_update
 		|| mesh_manager->need_update
+		|| mesh_manager->need_bvh_refit
 		|| light_manager->need_update
 		|| lookup_tables->need_update
 		|| integrator->need_update
@@ -23,6 +23,7 @@
 #include "device_memory.h"
 
 #include "util_param.h"
+#include "util_stats.h"
 #include "util_string.h"
 #include "util_system.h"
 #include "util_texture.h"
@@ -73,6 +74,7 @@ public:
 	/* mesh */
 	device_vector<uint> tri_shader;
 	device_vector<float4> tri_vnormal;
+	device_vector<uint> tri_vnormal_oct;
 	device_vector<uint4> tri_vindex;
 	device_vector<uint> tri_patch;
 	device_vector<float2> tri_patch_uv;
@@ -120,6 +122,10 @@ public:
 	device_vector<half4> tex_half4_image[TEX_NUM_HALF4_CPU];
 	device_vector<half> tex_half_image[TEX_NUM_HALF_CPU];
 
+	/* cpu sparse 3d image tile offsets */
+	device_vector<int> tex_float4_sparse_offsets[TEX_NUM_FLOAT4_CPU];
+	device_vector<int> tex_float_sparse_offsets[TEX_NUM_FLOAT_CPU];
+
 	/* opencl images */
 	device_vector<uchar4> tex_image_byte4_packed;
 	device_vector<float4> tex_image_float4_packed;
@@ -144,7 +150,13 @@ public:
 	bool use_bvh_spatial_split;
 	bool use_bvh_unaligned_nodes;
 	bool use_qbvh;
+	bool use_bvh_cache;
+	bool use_shader_cache;
+	bool use_compressed_attributes;
 	bool persistent_data;
+	/* BVH and shader cache, see Cache */
+	string cache_directory;
+	uint64_t cache_size_limit;
 
 	SceneParams()
 	{
@@ -153,7 +165,11 @@ public:
 		use_bvh_spatial_split = false;
 		use_bvh_unaligned_nodes = true;
 		use_qbvh = false;
+		use_bvh_cache = false;
+		use_shader_cache = false;
+		use_compressed_attributes = false;
 		persistent_data = false;
+		cache_size_limit = (uint64_t)4 << 30;
 	}
 
 	bool modified(const SceneParams& params)
@@ -162,7 +178,12 @@ public:
 		&& use_bvh_spatial_split == params.use_bvh_spatial_split
 		&& use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes
 		&& use_qbvh == params.use_qbvh
-		&& persistent_data == params.persistent_data); }
+		&& use_bvh_cache == params.use_bvh_cache
+		&& use_shader_cache == params.use_shader_cache
+		&& use_compressed_attributes == params.use_compressed_attributes
+		&& persistent_data == params.persistent_data
+		&& cache_directory == params.cache_directory
+		&& cache_size_limit == params.cache_size_limit); }
 };
 
 /* Scene */
@@ -206,6 +227,9 @@ public:
 	/* parameters */
 	SceneParams params;
 
+	/* time spent in each stage of device updates */
+	TimeStats update_times;
+
 	/* mutex must be locked manually by callers */
 	thread_mutex mutex;
 
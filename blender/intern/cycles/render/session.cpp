@@ -28,6 +28,7 @@
 #include "session.h"
 #include "bake.h"
 
+#include "util_algorithm.h"
 #include "util_foreach.h"
 #include "util_function.h"
 #include "util_logging.h"
@@ -55,6 +56,8 @@ Session::Session(const SessionParams& params_)
 
 	device = Device::create(params.device, stats, params.background);
 
+	tile_manager.schedule_denoising = use_denoising();
+
 	if(params.background && params.output_path.empty()) {
 		buffers = NULL;
 		display = NULL;
@@ -81,6 +84,7 @@ Session::Session(const SessionParams& params_)
 	gpu_need_tonemap = false;
 	pause = false;
 	kernels_loaded = false;
+	buffers_copied_on_host = false;
 
 	/* TODO(sergey): Check if it's indeed optimal value for the split kernel. */
 	max_closure_global = 1;
@@ -108,6 +112,10 @@ Session::~Session()
 		/* tonemap and write out image if requested */
 		delete display;
 
+		/* tiles rendered into their own buffers were copied on the host */
+		if(buffers_copied_on_host)
+			buffers->copy_to_device();
+
 		display = new DisplayBuffer(device, false);
 		display->reset(device, buffers->params);
 		tonemap(params.samples);
@@ -362,11 +370,16 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 
 	thread_scoped_lock tile_lock(tile_mutex);
 
-	/* get next tile from manager */
+	/* get next tile from manager, denoise tiles as soon as their neighbors
+	 * finished rendering so the noisy buffers can be freed early */
 	Tile tile;
 	int device_num = device->device_number(tile_device);
 
-	if(!tile_manager.next_tile(tile, device_num))
+	if(tile_manager.next_denoise_tile(tile))
+		rtile.task = RenderTile::DENOISE;
+	else if(tile_manager.next_tile(tile, device_num))
+		rtile.task = RenderTile::PATH_TRACE;
+	else
 		return false;
 	
 	/* fill render tile */
@@ -377,12 +390,18 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	rtile.start_sample = tile_manager.state.sample;
 	rtile.num_samples = tile_manager.state.num_samples;
 	rtile.resolution = tile_manager.state.resolution_divider;
+	rtile.tile_index = tile.index;
 
 	tile_lock.unlock();
 
 	/* in case of a permanent buffer, return it, otherwise we will allocate
-	 * a new temporary buffer */
-	if(!(params.background && params.output_path.empty())) {
+	 * a new temporary buffer. Denoised tiles always get their own buffers,
+	 * the filter needs the noisy pixels of finished neighbors. Devices of a
+	 * multi device would only have their own tiles in their copy of the
+	 * permanent buffer, so they get their own buffers as well. */
+	bool multi_device = (params.device.type == DEVICE_MULTI && !params.progressive_refine);
+
+	if(!(params.background && (params.output_path.empty() || use_denoising() || multi_device))) {
 		tile_manager.state.buffer.get_offset_stride(rtile.offset, rtile.stride);
 
 		rtile.buffer = buffers->buffer.device_pointer;
@@ -439,25 +458,27 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 
 	/* this will tag tile as IN PROGRESS in blender-side render pipeline,
 	 * which is needed to highlight currently rendering tile before first
-	 * sample was processed for it
+	 * sample was processed for it. Tiles to denoise already show their noisy
+	 * pixels, the empty buffer for the result would replace them.
 	 */
-	update_tile_sample(rtile);
+	if(rtile.task == RenderTile::PATH_TRACE)
+		update_tile_sample(rtile);
 
 	return true;
 }
 
 void Session::update_tile_sample(RenderTile& rtile)
 {
-	thread_scoped_lock tile_lock(tile_mutex);
-
 	if(update_render_tile_cb) {
 		if(params.progressive_refine == false) {
-			/* todo: optimize this by making it thread safe and removing lock */
-
+			/* callback is thread safe, other render threads keep acquiring
+			 * and releasing tiles while passes are converted */
 			update_render_tile_cb(rtile);
 		}
 	}
 
+	thread_scoped_lock tile_lock(tile_mutex);
+
 	update_status_time();
 }
 
@@ -465,16 +486,93 @@ void Session::release_tile(RenderTile& rtile)
 {
 	thread_scoped_lock tile_lock(tile_mutex);
 
+	if(use_denoising()) {
+		if(tile_buffers.size() == 0)
+			tile_buffers.resize(tile_manager.state.num_tiles, NULL);
+
+		if(rtile.task == RenderTile::PATH_TRACE) {
+			/* keep the noisy pixels for denoising this tile and its
+			 * neighbors, the denoised tile is written instead */
+			tile_buffers[rtile.tile_index] = rtile.buffers;
+			tile_manager.finish_render(rtile.tile_index);
+
+			update_status_time();
+			return;
+		}
+
+		/* free noisy pixels no neighbor reads anymore */
+		vector<int> done_tiles;
+		tile_manager.finish_denoise(rtile.tile_index, done_tiles);
+
+		foreach(int index, done_tiles) {
+			delete tile_buffers[index];
+			tile_buffers[index] = NULL;
+		}
+	}
+
+	/* without a render result, write to the output buffers */
+	if(!write_render_tile_cb && buffers && rtile.buffers != buffers && !params.progressive_refine) {
+		buffers->copy_tile(rtile.buffers);
+		buffers_copied_on_host = true;
+		delete rtile.buffers;
+	}
+
+	bool write_tile = false;
+
 	if(write_render_tile_cb) {
 		if(params.progressive_refine == false) {
-			/* todo: optimize this by making it thread safe and removing lock */
-			write_render_tile_cb(rtile);
+			if(params.use_profiling)
+				store_render_time(rtile.buffers, rtile.sample);
 
-			delete rtile.buffers;
+			write_tile = true;
 		}
 	}
 
 	update_status_time();
+
+	tile_lock.unlock();
+
+	if(write_tile) {
+		/* callback is thread safe, other render threads keep acquiring
+		 * and releasing tiles while passes are converted */
+		write_render_tile_cb(rtile);
+
+		delete rtile.buffers;
+	}
+}
+
+void Session::map_neighbor_tiles(const RenderTile& rtile, RenderTile *neighbors)
+{
+	thread_scoped_lock tile_lock(tile_mutex);
+
+	int indices[9];
+	tile_manager.get_neighbors(rtile.tile_index, indices);
+
+	for(int i = 0; i < 9; i++) {
+		neighbors[i] = RenderTile();
+
+		if(indices[i] == -1)
+			continue;
+
+		/* neighbors are only freed once this tile is denoised */
+		RenderBuffers *tilebuffers = tile_buffers[indices[i]];
+		assert(tilebuffers != NULL);
+
+		neighbors[i].x = tilebuffers->params.full_x;
+		neighbors[i].y = tilebuffers->params.full_y;
+		neighbors[i].w = tilebuffers->params.width;
+		neighbors[i].h = tilebuffers->params.height;
+		neighbors[i].start_sample = rtile.start_sample;
+		neighbors[i].num_samples = rtile.num_samples;
+		neighbors[i].resolution = rtile.resolution;
+		neighbors[i].buffer = tilebuffers->buffer.device_pointer;
+		neighbors[i].rng_state = tilebuffers->rng_state.device_pointer;
+		neighbors[i].buffers = tilebuffers;
+		neighbors[i].task = RenderTile::DENOISE;
+		neighbors[i].tile_index = indices[i];
+
+		tilebuffers->params.get_offset_stride(neighbors[i].offset, neighbors[i].stride);
+	}
 }
 
 void Session::run_cpu()
@@ -686,10 +784,16 @@ void Session::run()
 		/* reset number of rendered samples */
 		progress.reset_sample();
 
+		/* counters accumulate over all render layers of the session */
+		if(params.use_profiling)
+			stats.profiler.start();
+
 		if(device_use_gl)
 			run_gpu();
 		else
 			run_cpu();
+
+		stats.profiler.stop();
 	}
 
 	/* progress update */
@@ -718,6 +822,8 @@ void Session::reset_(BufferParams& buffer_params, int samples)
 	}
 
 	tile_manager.reset(buffer_params, samples);
+	render_time_pixels.clear();
+	stats.render_reset();
 
 	start_time = time_dt();
 	preview_time = 0.0;
@@ -735,7 +841,7 @@ void Session::reset(BufferParams& buffer_params, int samples)
 	else
 		reset_cpu(buffer_params, samples);
 
-	if(params.progressive_refine) {
+	if(params.progressive_refine || use_denoising()) {
 		thread_scoped_lock buffers_lock(buffers_mutex);
 
 		foreach(RenderBuffers *buffers, tile_buffers)
@@ -920,6 +1026,7 @@ void Session::path_trace()
 	
 	task.acquire_tile = function_bind(&Session::acquire_tile, this, _1, _2);
 	task.release_tile = function_bind(&Session::release_tile, this, _1);
+	task.map_neighbor_tiles = function_bind(&Session::map_neighbor_tiles, this, _1, _2);
 	task.get_cancel = function_bind(&Progress::get_cancel, &this->progress);
 	task.update_tile_sample = function_bind(&Session::update_tile_sample, this, _1);
 	task.update_progress_sample = function_bind(&Session::update_progress_sample, this);
@@ -927,6 +1034,16 @@ void Session::path_trace()
 	task.integrator_branched = scene->integrator->method == Integrator::BRANCHED_PATH;
 	task.requested_tile_size = params.tile_size;
 
+	if(use_adaptive_sampling()) {
+		task.adaptive_threshold = params.adaptive_threshold;
+		task.adaptive_min_samples = max(params.adaptive_min_samples, ADAPTIVE_SAMPLING_STEP);
+	}
+
+	if(use_denoising()) {
+		task.denoising_radius = params.denoising_radius;
+		task.denoising_strength = params.denoising_strength;
+	}
+
 	device->task_add(task);
 }
 
@@ -976,6 +1093,8 @@ bool Session::update_progressive_refine(bool cancel)
 			rtile.sample = sample;
 
 			if(write) {
+				if(params.use_profiling)
+					store_render_time(buffers, sample);
 				if(write_render_tile_cb)
 					write_render_tile_cb(rtile);
 			}
@@ -1005,6 +1124,143 @@ void Session::device_free()
 	 */
 }
 
+bool Session::use_adaptive_sampling() const
+{
+	return params.adaptive_threshold > 0.0f &&
+	       params.device.type == DEVICE_CPU &&
+	       !params.progressive;
+}
+
+static bool profiling_times_greater(const pair<string, double>& a,
+                                    const pair<string, double>& b)
+{
+	return a.second > b.second;
+}
+
+void Session::get_profiling_times(ProfilingTimes& events,
+                                  ProfilingTimes& shaders,
+                                  ProfilingTimes& objects)
+{
+	Profiler& profiler = stats.profiler;
+	double interval = profiler.get_sample_interval();
+
+	events.clear();
+	shaders.clear();
+	objects.clear();
+
+	if(!params.use_profiling || profiler.get_total() == 0)
+		return;
+
+	for(int i = 0; i < PROFILING_NUM_EVENTS; i++) {
+		uint64_t samples = profiler.get_event((ProfilingEvent)i);
+		if(samples > 0)
+			events.push_back(make_pair(string(Profiler::event_name((ProfilingEvent)i)), samples*interval));
+	}
+
+	for(int i = 0; i < profiler.get_num_shaders(); i++) {
+		uint64_t samples = profiler.get_shader(i);
+		if(samples > 0) {
+			string name = (i < scene->shaders.size())? scene->shaders[i]->name.string(): string_printf("Shader %d", i);
+			shaders.push_back(make_pair(name, samples*interval));
+		}
+	}
+
+	for(int i = 0; i < profiler.get_num_objects(); i++) {
+		uint64_t samples = profiler.get_object(i);
+		if(samples > 0) {
+			string name = (i < scene->objects.size())? scene->objects[i]->name.string(): string_printf("Object %d", i);
+			objects.push_back(make_pair(name, samples*interval));
+		}
+	}
+
+	sort(events.begin(), events.end(), profiling_times_greater);
+	sort(shaders.begin(), shaders.end(), profiling_times_greater);
+	sort(objects.begin(), objects.end(), profiling_times_greater);
+}
+
+static void profiling_report_table(string& report,
+                                   const char *title,
+                                   const Session::ProfilingTimes& times,
+                                   double total)
+{
+	report += string_printf("\n%-40s %12s %8s\n", title, "Time (s)", "Share");
+
+	for(size_t i = 0; i < times.size(); i++) {
+		report += string_printf("  %-38s %12.2f %7.2f%%\n",
+		                        times[i].first.c_str(),
+		                        times[i].second,
+		                        100.0*times[i].second/total);
+	}
+}
+
+string Session::get_profiling_report()
+{
+	ProfilingTimes events, shaders, objects;
+	get_profiling_times(events, shaders, objects);
+
+	if(events.empty())
+		return "";
+
+	double total = 0.0;
+	for(size_t i = 0; i < events.size(); i++)
+		total += events[i].second;
+
+	string report = string_printf("Render profile, %.2f s of render thread time\n", total);
+	profiling_report_table(report, "Kernel Phase", events, total);
+	profiling_report_table(report, "Shader", shaders, total);
+	profiling_report_table(report, "Object", objects, total);
+
+	return report;
+}
+
+void Session::store_render_time(RenderBuffers *tile_buffers, int sample)
+{
+	BufferParams& image = tile_manager.params;
+	BufferParams& params = tile_buffers->params;
+
+	if(!Pass::contains(params.passes, PASS_RENDER_TIME) || sample == 0)
+		return;
+
+	vector<float> pixels(params.width*params.height);
+
+	if(!tile_buffers->copy_from_device() ||
+	   !tile_buffers->get_pass_rect(PASS_RENDER_TIME, 1.0f, sample, 1, &pixels[0]))
+	{
+		return;
+	}
+
+	if(render_time_pixels.size() != image.width*image.height)
+		render_time_pixels.resize(image.width*image.height, 0.0f);
+
+	int x = params.full_x - image.full_x;
+	int y = params.full_y - image.full_y;
+
+	for(int row = 0; row < params.height; row++) {
+		memcpy(&render_time_pixels[(y + row)*image.width + x],
+		       &pixels[row*params.width],
+		       sizeof(float)*params.width);
+	}
+}
+
+void Session::get_render_time_pass(int& width, int& height, vector<float>& pixels)
+{
+	thread_scoped_lock tile_lock(tile_mutex);
+
+	width = tile_manager.params.width;
+	height = tile_manager.params.height;
+	pixels = render_time_pixels;
+}
+
+bool Session::use_denoising() const
+{
+	/* Tiles are filtered once, so they must not receive more samples. */
+	return params.denoising_radius > 0 &&
+	       params.device.type == DEVICE_CPU &&
+	       params.background &&
+	       !params.progressive &&
+	       !params.progressive_refine;
+}
+
 int Session::get_max_closure_count()
 {
 	int max_closures = 0;
@@ -55,6 +55,17 @@ public:
 	int start_resolution;
 	int threads;
 
+	/* adaptive sampling, disabled when threshold is zero */
+	float adaptive_threshold;
+	int adaptive_min_samples;
+
+	/* denoising of final render tiles, disabled when radius is zero */
+	int denoising_radius;
+	float denoising_strength;
+
+	/* sample render threads to find expensive shaders and objects */
+	bool use_profiling;
+
 	bool display_buffer_linear;
 
 	double cancel_timeout;
@@ -77,6 +88,14 @@ public:
 		start_resolution = INT_MAX;
 		threads = 0;
 
+		adaptive_threshold = 0.0f;
+		adaptive_min_samples = 16;
+
+		denoising_radius = 0;
+		denoising_strength = 0.1f;
+
+		use_profiling = false;
+
 		display_buffer_linear = false;
 
 		cancel_timeout = 0.1;
@@ -100,6 +119,11 @@ public:
 		&& tile_size == params.tile_size
 		&& start_resolution == params.start_resolution
 		&& threads == params.threads
+		&& adaptive_threshold == params.adaptive_threshold
+		&& adaptive_min_samples == params.adaptive_min_samples
+		&& denoising_radius == params.denoising_radius
+		&& denoising_strength == params.denoising_strength
+		&& use_profiling == params.use_profiling
 		&& display_buffer_linear == params.display_buffer_linear
 		&& cancel_timeout == params.cancel_timeout
 		&& reset_timeout == params.reset_timeout
@@ -126,6 +150,8 @@ public:
 	TileManager tile_manager;
 	Stats stats;
 
+	/* Called from render threads without holding the tile lock, so multiple
+	 * tiles may be written at the same time. */
 	function<void(RenderTile&)> write_render_tile_cb;
 	function<void(RenderTile&)> update_render_tile_cb;
 
@@ -146,6 +172,27 @@ public:
 
 	void device_free();
 
+	/* Adaptive sampling needs all samples of a tile to be rendered at once,
+	 * so it is not used for progressive rendering. Only the CPU device has
+	 * the convergence kernels. */
+	bool use_adaptive_sampling() const;
+	/* Denoising only runs on final render tiles on the CPU device, using the
+	 * normal, diffuse color and depth passes which must be present in the
+	 * buffer. Tiles are rendered into their own buffers and denoised once
+	 * their neighbors finished rendering. */
+	bool use_denoising() const;
+
+	/* Estimated render thread time in seconds per kernel phase, shader and
+	 * object, from most to least expensive. Empty unless profiling. */
+	typedef vector<pair<string, double> > ProfilingTimes;
+	void get_profiling_times(ProfilingTimes& events,
+	                         ProfilingTimes& shaders,
+	                         ProfilingTimes& objects);
+	string get_profiling_report();
+	/* Render thread time per pixel and sample in microseconds, of the last
+	 * render. Empty unless profiling with a CPU device. */
+	void get_render_time_pass(int& width, int& height, vector<float>& pixels);
+
 protected:
 	struct DelayedReset {
 		thread_mutex mutex;
@@ -173,6 +220,10 @@ protected:
 	bool acquire_tile(Device *tile_device, RenderTile& tile);
 	void update_tile_sample(RenderTile& tile);
 	void release_tile(RenderTile& tile);
+	/* rendered tiles around a tile to denoise, see DeviceTask */
+	void map_neighbor_tiles(const RenderTile& tile, RenderTile *neighbors);
+	/* copy the render time pass of tile buffers into render_time_pixels */
+	void store_render_time(RenderBuffers *tile_buffers, int sample);
 
 	void update_progress_sample();
 
@@ -205,6 +256,11 @@ protected:
 	bool update_progressive_refine(bool cancel);
 
 	vector<RenderBuffers *> tile_buffers;
+	/* finished tiles were copied into the host memory of buffers */
+	bool buffers_copied_on_host;
+
+	/* render time pass of the full image, collected from the tiles */
+	vector<float> render_time_pixels;
 
 	DeviceRequestedFeatures get_requested_device_features();
 
@@ -190,6 +190,7 @@ protected:
 
 	typedef unordered_map<ustring, uint, ustringHash> AttributeIDMap;
 	AttributeIDMap unique_attribute_id;
+	thread_mutex attribute_id_mutex;
 
 	thread_mutex lookup_table_mutex;
 	static vector<float> beckmann_table;
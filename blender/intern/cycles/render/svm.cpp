@@ -23,10 +23,13 @@
 #include "shader.h"
 #include "svm.h"
 
+#include "util_cache.h"
 #include "util_debug.h"
 #include "util_logging.h"
 #include "util_foreach.h"
+#include "util_md5.h"
 #include "util_progress.h"
+#include "util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -44,6 +47,208 @@ void SVMShaderManager::reset(Scene * /*scene*/)
 {
 }
 
+/* Bump when the encoding of nodes changes, compiled shaders cached on disk by
+ * other versions are then never used. Adding node or closure types changes
+ * the key already. */
+#define SVM_CACHE_FORMAT_VERSION 1
+
+static void svm_cache_data_key(CacheData& key, const string& cache_key)
+{
+	const int format[] = {SVM_CACHE_FORMAT_VERSION, NODE_NUM, NBUILTIN_CLOSURES};
+
+	key.add(format);
+	key.add(cache_key.c_str(), cache_key.size());
+}
+
+/* Shader flags computed by the compiler, stored along with cached nodes. */
+enum {
+	SVM_SHADER_HAS_SURFACE                 = (1 << 0),
+	SVM_SHADER_HAS_SURFACE_EMISSION        = (1 << 1),
+	SVM_SHADER_HAS_SURFACE_TRANSPARENT     = (1 << 2),
+	SVM_SHADER_HAS_SURFACE_BSSRDF          = (1 << 3),
+	SVM_SHADER_HAS_BSSRDF_BUMP             = (1 << 4),
+	SVM_SHADER_HAS_VOLUME                  = (1 << 5),
+	SVM_SHADER_HAS_DISPLACEMENT            = (1 << 6),
+	SVM_SHADER_HAS_SURFACE_SPATIAL_VARYING = (1 << 7),
+	SVM_SHADER_HAS_VOLUME_SPATIAL_VARYING  = (1 << 8),
+	SVM_SHADER_HAS_OBJECT_DEPENDENCY       = (1 << 9),
+	SVM_SHADER_HAS_INTEGRATOR_DEPENDENCY   = (1 << 10),
+};
+
+static uint svm_shader_flags_get(const Shader *shader)
+{
+	uint flags = 0;
+
+	if(shader->has_surface) flags |= SVM_SHADER_HAS_SURFACE;
+	if(shader->has_surface_emission) flags |= SVM_SHADER_HAS_SURFACE_EMISSION;
+	if(shader->has_surface_transparent) flags |= SVM_SHADER_HAS_SURFACE_TRANSPARENT;
+	if(shader->has_surface_bssrdf) flags |= SVM_SHADER_HAS_SURFACE_BSSRDF;
+	if(shader->has_bssrdf_bump) flags |= SVM_SHADER_HAS_BSSRDF_BUMP;
+	if(shader->has_volume) flags |= SVM_SHADER_HAS_VOLUME;
+	if(shader->has_displacement) flags |= SVM_SHADER_HAS_DISPLACEMENT;
+	if(shader->has_surface_spatial_varying) flags |= SVM_SHADER_HAS_SURFACE_SPATIAL_VARYING;
+	if(shader->has_volume_spatial_varying) flags |= SVM_SHADER_HAS_VOLUME_SPATIAL_VARYING;
+	if(shader->has_object_dependency) flags |= SVM_SHADER_HAS_OBJECT_DEPENDENCY;
+	if(shader->has_integrator_dependency) flags |= SVM_SHADER_HAS_INTEGRATOR_DEPENDENCY;
+
+	return flags;
+}
+
+static void svm_shader_flags_set(Shader *shader, uint flags)
+{
+	shader->has_surface = (flags & SVM_SHADER_HAS_SURFACE) != 0;
+	shader->has_surface_emission = (flags & SVM_SHADER_HAS_SURFACE_EMISSION) != 0;
+	shader->has_surface_transparent = (flags & SVM_SHADER_HAS_SURFACE_TRANSPARENT) != 0;
+	shader->has_surface_bssrdf = (flags & SVM_SHADER_HAS_SURFACE_BSSRDF) != 0;
+	shader->has_bssrdf_bump = (flags & SVM_SHADER_HAS_BSSRDF_BUMP) != 0;
+	shader->has_volume = (flags & SVM_SHADER_HAS_VOLUME) != 0;
+	shader->has_displacement = (flags & SVM_SHADER_HAS_DISPLACEMENT) != 0;
+	shader->has_surface_spatial_varying = (flags & SVM_SHADER_HAS_SURFACE_SPATIAL_VARYING) != 0;
+	shader->has_volume_spatial_varying = (flags & SVM_SHADER_HAS_VOLUME_SPATIAL_VARYING) != 0;
+	shader->has_object_dependency = (flags & SVM_SHADER_HAS_OBJECT_DEPENDENCY) != 0;
+	shader->has_integrator_dependency = (flags & SVM_SHADER_HAS_INTEGRATOR_DEPENDENCY) != 0;
+}
+
+bool SVMShaderManager::compiled_shader_key(Scene * /*scene*/,
+                                           Shader *shader,
+                                           bool background,
+                                           string *cache_key)
+{
+	/* Image slots are assigned while compiling, can't reuse such code. */
+	if(shader->graph->has_external_dependency() ||
+	   (shader->graph_bump && shader->graph_bump->has_external_dependency()))
+	{
+		return false;
+	}
+
+	MD5Hash md5;
+	int settings[4] = {shader->displacement_method,
+	                   shader->used,
+	                   background,
+	                   shader->graph_bump != NULL};
+
+	md5.append((const uint8_t*)settings, sizeof(settings));
+
+	shader->graph->hash(md5);
+	if(shader->graph_bump)
+		shader->graph_bump->hash(md5);
+
+	/* Attribute IDs are stored in the nodes and depend on the order in which
+	 * attribute names were first seen. */
+	foreach(AttributeRequest& req, shader->attributes.requests) {
+		if(req.std == ATTR_STD_NONE) {
+			uint id = get_attribute_id(req.name);
+			md5.append(req.name.string());
+			md5.append((const uint8_t*)&id, sizeof(id));
+		}
+	}
+
+	*cache_key = md5.get_hex();
+	return true;
+}
+
+bool SVMShaderManager::compiled_shader_find(Scene *scene,
+                                            const string& cache_key,
+                                            CompiledShader *compiled)
+{
+	{
+		thread_scoped_lock compiled_shaders_lock(compiled_shaders_mutex);
+		CompiledShaderMap::iterator it = compiled_shaders.find(cache_key);
+
+		if(it != compiled_shaders.end()) {
+			*compiled = it->second;
+			return true;
+		}
+	}
+
+	if(!scene->params.use_shader_cache)
+		return false;
+
+	CacheData key("svm"), value;
+	svm_cache_data_key(key, cache_key);
+
+	if(!Cache::global.lookup(key, value))
+		return false;
+
+	array<int4> svm_nodes;
+
+	if(!(value.read(svm_nodes) && value.read(compiled->flags)) || svm_nodes.size() == 0) {
+		VLOG(1) << "Invalid shader cache file, compiling.";
+		return false;
+	}
+
+	compiled->svm_nodes.assign(svm_nodes.data(), svm_nodes.data() + svm_nodes.size());
+
+	thread_scoped_lock compiled_shaders_lock(compiled_shaders_mutex);
+	compiled_shaders[cache_key] = *compiled;
+
+	return true;
+}
+
+void SVMShaderManager::compiled_shader_insert(Scene *scene,
+                                              const string& cache_key,
+                                              const CompiledShader& compiled)
+{
+	{
+		thread_scoped_lock compiled_shaders_lock(compiled_shaders_mutex);
+
+		/* Identical shaders compiled at the same time, only write once. */
+		if(compiled_shaders.find(cache_key) != compiled_shaders.end())
+			return;
+
+		compiled_shaders[cache_key] = compiled;
+	}
+
+	if(scene->params.use_shader_cache) {
+		CacheData key("svm"), value;
+		svm_cache_data_key(key, cache_key);
+		value.add(compiled.svm_nodes);
+		value.add(compiled.flags);
+		Cache::global.insert(key, value);
+	}
+}
+
+void SVMShaderManager::device_update_shader(Scene *scene,
+                                            Shader *shader,
+                                            Progress *progress,
+                                            CompiledShader *compiled,
+                                            string *cache_key)
+{
+	if(progress->get_cancel()) {
+		return;
+	}
+
+	assert(shader->graph);
+
+	SVMCompiler::Summary summary;
+	SVMCompiler compiler(scene->shader_manager, scene->image_manager);
+	compiler.background = (shader == scene->default_background);
+	compiler.finalize(scene, shader, &summary);
+
+	if(compiled_shader_key(scene, shader, compiler.background, cache_key)) {
+		if(compiled_shader_find(scene, *cache_key, compiled)) {
+			svm_shader_flags_set(shader, compiled->flags);
+			VLOG(2) << "Using cached compilation of shader " << shader->name << ".";
+			return;
+		}
+	}
+	else {
+		cache_key->clear();
+	}
+
+	compiled->svm_nodes.push_back(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
+	compiler.compile(scene, shader, compiled->svm_nodes, 0, &summary);
+	compiled->flags = svm_shader_flags_get(shader);
+
+	if(!cache_key->empty()) {
+		compiled_shader_insert(scene, *cache_key, *compiled);
+	}
+
+	VLOG(2) << "Compilation summary:\n"
+	        << "Shader name: " << shader->name << "\n"
+	        << summary.full_report();
+}
+
 void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	if(!need_update)
@@ -57,32 +262,70 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 	/* determine which shaders are in use */
 	device_update_shaders_used(scene);
 
-	/* svm_nodes */
+	/* Assign attribute IDs in shader order before compiling in parallel, so
+	 * the generated code does not depend on thread scheduling. */
+	foreach(Shader *shader, scene->shaders) {
+		foreach(AttributeRequest& req, shader->attributes.requests) {
+			if(req.std == ATTR_STD_NONE) {
+				get_attribute_id(req.name);
+			}
+		}
+	}
+
+	/* compile shaders in parallel */
+	size_t num_shaders = scene->shaders.size();
+	vector<CompiledShader> compiled(num_shaders);
+	vector<string> cache_keys(num_shaders);
+	TaskPool pool;
+
+	for(size_t i = 0; i < num_shaders; i++) {
+		pool.push(function_bind(&SVMShaderManager::device_update_shader,
+		                        this,
+		                        scene,
+		                        scene->shaders[i],
+		                        &progress,
+		                        &compiled[i],
+		                        &cache_keys[i]));
+	}
+	pool.wait_work();
+
+	if(progress.get_cancel()) return;
+
+	/* svm_nodes, merged in shader order */
 	vector<int4> svm_nodes;
 	size_t i;
 
-	for(i = 0; i < scene->shaders.size(); i++) {
+	for(i = 0; i < num_shaders; i++) {
 		svm_nodes.push_back(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
 	}
 
-	foreach(Shader *shader, scene->shaders) {
-		if(progress.get_cancel()) return;
+	for(i = 0; i < num_shaders; i++) {
+		Shader *shader = scene->shaders[i];
+		const vector<int4>& shader_nodes = compiled[i].svm_nodes;
 
-		assert(shader->graph);
+		/* the jump node is not copied, offsets shift by one */
+		int offset = svm_nodes.size() - 1;
+		int4 jump = shader_nodes[0];
 
-		SVMCompiler::Summary summary;
-		SVMCompiler compiler(scene->shader_manager, scene->image_manager);
-		compiler.background = (shader == scene->default_background);
-		compiler.compile(scene, shader, svm_nodes, shader->id, &summary);
+		svm_nodes[shader->id] = make_int4(NODE_SHADER_JUMP,
+		                                  jump.y + offset,
+		                                  jump.z + offset,
+		                                  jump.w + offset);
+		svm_nodes.insert(svm_nodes.end(), shader_nodes.begin() + 1, shader_nodes.end());
 
 		if(shader->use_mis && shader->has_surface_emission) {
 			scene->light_manager->need_update = true;
 		}
+	}
 
-		VLOG(2) << "Compilation summary:\n"
-		        << "Shader name: " << shader->name << "\n"
-		        << summary.full_report();
+	/* forget about shaders which are no longer in the scene */
+	CompiledShaderMap used_compiled_shaders;
+	for(i = 0; i < num_shaders; i++) {
+		if(!cache_keys[i].empty()) {
+			used_compiled_shaders[cache_keys[i]] = compiled[i];
+		}
 	}
+	compiled_shaders.swap(used_compiled_shaders);
 
 	dscene->svm_nodes.copy((uint4*)&svm_nodes[0], svm_nodes.size());
 	device->tex_alloc("__svm_nodes", dscene->svm_nodes);
@@ -731,17 +974,10 @@ void SVMCompiler::compile_type(Shader *shader, ShaderGraph *graph, ShaderType ty
 	}
 }
 
-void SVMCompiler::compile(Scene *scene,
-                          Shader *shader,
-                          vector<int4>& global_svm_nodes,
-                          int index,
-                          Summary *summary)
+void SVMCompiler::finalize(Scene *scene, Shader *shader, Summary *summary)
 {
 	/* copy graph for shader with bump mapping */
 	ShaderNode *node = shader->graph->output();
-	int start_num_svm_nodes = global_svm_nodes.size();
-
-	const double time_start = time_dt();
 
 	if(node->input("Surface")->link && node->input("Displacement")->link)
 		if(!shader->graph_bump)
@@ -764,6 +1000,17 @@ void SVMCompiler::compile(Scene *scene,
 		                             shader->has_integrator_dependency,
 		                             shader->displacement_method == DISPLACE_BOTH);
 	}
+}
+
+void SVMCompiler::compile(Scene * /*scene*/,
+                          Shader *shader,
+                          vector<int4>& global_svm_nodes,
+                          int index,
+                          Summary *summary)
+{
+	int start_num_svm_nodes = global_svm_nodes.size();
+
+	const double time_start = time_dt();
 
 	current_shader = shader;
 
@@ -21,8 +21,10 @@
 #include "graph.h"
 #include "shader.h"
 
+#include "util_map.h"
 #include "util_set.h"
 #include "util_string.h"
+#include "util_thread.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -46,6 +48,38 @@ public:
 
 	void device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_free(Device *device, DeviceScene *dscene, Scene *scene);
+
+protected:
+	/* SVM nodes of a single shader, starting with its jump node. Offsets are
+	 * relative to the start of these nodes, so they can be merged into the
+	 * global array at any position. */
+	struct CompiledShader {
+		vector<int4> svm_nodes;
+		uint flags;
+	};
+
+	/* Compiled shaders by hash of their finalized graph, kept across scene
+	 * resets so unchanged shaders are not compiled again. */
+	typedef map<string, CompiledShader> CompiledShaderMap;
+	CompiledShaderMap compiled_shaders;
+	thread_mutex compiled_shaders_mutex;
+
+	void device_update_shader(Scene *scene,
+	                          Shader *shader,
+	                          Progress *progress,
+	                          CompiledShader *compiled,
+	                          string *cache_key);
+
+	bool compiled_shader_key(Scene *scene,
+	                         Shader *shader,
+	                         bool background,
+	                         string *cache_key);
+	bool compiled_shader_find(Scene *scene,
+	                          const string& cache_key,
+	                          CompiledShader *compiled);
+	void compiled_shader_insert(Scene *scene,
+	                            const string& cache_key,
+	                            const CompiledShader& compiled);
 };
 
 /* Graph Compiler */
@@ -89,6 +123,8 @@ public:
 	};
 
 	SVMCompiler(ShaderManager *shader_manager, ImageManager *image_manager);
+	/* Graphs have to be finalized before compilation. */
+	void finalize(Scene *scene, Shader *shader, Summary *summary = NULL);
 	void compile(Scene *scene,
 	             Shader *shader,
 	             vector<int4>& svm_nodes,
@@ -17,6 +17,7 @@
 #include "tile.h"
 
 #include "util_algorithm.h"
+#include "util_foreach.h"
 #include "util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -100,6 +101,8 @@ TileManager::TileManager(bool progressive_, int num_samples_, int2 tile_size_, i
 	range_start_sample = 0;
 	range_num_samples = -1;
 
+	schedule_denoising = false;
+
 	BufferParams buffer_params;
 	reset(buffer_params, 0);
 }
@@ -133,6 +136,9 @@ void TileManager::reset(BufferParams& params_, int num_samples_)
 	state.num_samples = 0;
 	state.resolution_divider = divider;
 	state.tiles.clear();
+	state.denoise_tiles.clear();
+	state.denoise_queue.clear();
+	state.grid_size = make_int2(0, 0);
 }
 
 void TileManager::set_samples(int num_samples_)
@@ -205,7 +211,10 @@ int TileManager::gen_tiles(bool sliced)
 				if(pos.x >= 0 && pos.y >= 0 && pos.x < image_w && pos.y < image_h) {
 					int w = min(tile_size.x, image_w - pos.x);
 					int h = min(tile_size.y, image_h - pos.y);
-					tile_list->push_front(Tile(tile_index, pos.x, pos.y, w, h, cur_device));
+					/* Index tiles by their position like the other orders,
+					 * the offset keeps them aligned to the tile grid. */
+					int index = (pos.y/tile_size.y)*tile_w + pos.x/tile_size.x;
+					tile_list->push_front(Tile(index, pos.x, pos.y, w, h, cur_device));
 					cur_tiles++;
 					tile_index++;
 
@@ -304,6 +313,20 @@ void TileManager::set_tiles()
 
 	state.num_tiles = gen_tiles(!background);
 
+	state.denoise_tiles.clear();
+	state.denoise_queue.clear();
+	state.grid_size = make_int2((tile_size.x >= image_w)? 1: (image_w + tile_size.x - 1)/tile_size.x,
+	                            (tile_size.y >= image_h)? 1: (image_h + tile_size.y - 1)/tile_size.y);
+
+	if(schedule_denoising) {
+		assert(background);
+		state.denoise_tiles.resize(state.num_tiles);
+
+		foreach(list<Tile>& tile_list, state.tiles)
+			foreach(Tile& tile, tile_list)
+				state.denoise_tiles[tile.index] = tile;
+	}
+
 	state.buffer.width = image_w;
 	state.buffer.height = image_h;
 
@@ -369,5 +392,84 @@ int TileManager::get_num_effective_samples()
 	                                 : range_num_samples;
 }
 
+void TileManager::get_neighbors(int index, int neighbors[9])
+{
+	int tile_x = index % state.grid_size.x;
+	int tile_y = index / state.grid_size.x;
+
+	for(int dy = -1, i = 0; dy <= 1; dy++) {
+		for(int dx = -1; dx <= 1; dx++, i++) {
+			int x = tile_x + dx, y = tile_y + dy;
+
+			if(x >= 0 && y >= 0 && x < state.grid_size.x && y < state.grid_size.y)
+				neighbors[i] = y*state.grid_size.x + x;
+			else
+				neighbors[i] = -1;
+		}
+	}
+}
+
+bool TileManager::neighbors_reached(int index, Tile::State tile_state)
+{
+	int neighbors[9];
+	get_neighbors(index, neighbors);
+
+	for(int i = 0; i < 9; i++)
+		if(neighbors[i] != -1 && state.denoise_tiles[neighbors[i]].state < tile_state)
+			return false;
+
+	return true;
+}
+
+void TileManager::finish_render(int index)
+{
+	int neighbors[9];
+	get_neighbors(index, neighbors);
+
+	state.denoise_tiles[index].state = Tile::RENDERED;
+
+	for(int i = 0; i < 9; i++) {
+		if(neighbors[i] == -1)
+			continue;
+
+		Tile& tile = state.denoise_tiles[neighbors[i]];
+
+		if(tile.state == Tile::RENDERED && neighbors_reached(tile.index, Tile::RENDERED)) {
+			tile.state = Tile::DENOISE;
+			state.denoise_queue.push_back(tile.index);
+		}
+	}
+}
+
+bool TileManager::next_denoise_tile(Tile& tile)
+{
+	if(state.denoise_queue.empty())
+		return false;
+
+	tile = state.denoise_tiles[state.denoise_queue.front()];
+	state.denoise_queue.pop_front();
+	return true;
+}
+
+void TileManager::finish_denoise(int index, vector<int>& done_tiles)
+{
+	int neighbors[9];
+	get_neighbors(index, neighbors);
+
+	state.denoise_tiles[index].state = Tile::DENOISED;
+
+	for(int i = 0; i < 9; i++) {
+		if(neighbors[i] == -1)
+			continue;
+
+		Tile& tile = state.denoise_tiles[neighbors[i]];
+
+		if(tile.state == Tile::DENOISED && neighbors_reached(tile.index, Tile::DENOISED)) {
+			tile.state = Tile::DONE;
+			done_tiles.push_back(tile.index);
+		}
+	}
+}
+
 CCL_NAMESPACE_END
 
@@ -28,15 +28,21 @@ CCL_NAMESPACE_BEGIN
 
 class Tile {
 public:
+	/* Progress of final render tiles when denoising, a tile is done once it
+	 * and all its neighbors are denoised, since the neighbors read its
+	 * noisy pixels. */
+	typedef enum { RENDER = 0, RENDERED, DENOISE, DENOISED, DONE } State;
+
 	int index;
 	int x, y, w, h;
 	int device;
+	State state;
 
 	Tile()
 	{}
 
 	Tile(int index_, int x_, int y_, int w_, int h_, int device_)
-	: index(index_), x(x_), y(y_), w(w_), h(h_), device(device_) {}
+	: index(index_), x(x_), y(y_), w(w_), h(h_), device(device_), state(RENDER) {}
 };
 
 /* Tile order */
@@ -67,6 +73,11 @@ public:
 		/* This vector contains a list of tiles for every logical device in the session.
 		 * In each list, the tiles are sorted according to the tile order setting. */
 		vector<list<Tile> > tiles;
+		/* When denoising, all tiles by index, which is their position in the
+		 * grid of tiles, and the indices of tiles ready to be denoised. */
+		vector<Tile> denoise_tiles;
+		list<int> denoise_queue;
+		int2 grid_size;
 	} state;
 
 	int num_samples;
@@ -93,6 +104,21 @@ public:
 
 	/* get number of actual samples to render. */
 	int get_num_effective_samples();
+
+	/* ** Denoising of final render tiles. ** */
+
+	/* Tiles are denoised once all their neighbors finished rendering. */
+	bool schedule_denoising;
+
+	/* Queue tiles for denoising of which the neighborhood is now rendered. */
+	void finish_render(int index);
+	bool next_denoise_tile(Tile& tile);
+	/* Return the tiles whose neighborhood is now denoised, so their buffers
+	 * are no longer needed. */
+	void finish_denoise(int index, vector<int>& done_tiles);
+	/* Indices of the 3x3 tiles around a tile, row by row with the tile itself
+	 * in the middle, -1 outside of the image. */
+	void get_neighbors(int index, int neighbors[9]);
 protected:
 
 	void set_tiles();
@@ -124,6 +150,9 @@ protected:
 
 	/* Generate tile list, return number of tiles. */
 	int gen_tiles(bool sliced);
+
+	/* Whether the tile and all its neighbors reached the state. */
+	bool neighbors_reached(int index, Tile::State tile_state);
 };
 
 CCL_NAMESPACE_END
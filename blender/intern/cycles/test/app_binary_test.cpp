@@ -0,0 +1,277 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <stdlib.h>
+
+#include "app/cycles_binary.h"
+
+#include "render/background.h"
+#include "render/camera.h"
+#include "render/graph.h"
+#include "render/light.h"
+#include "render/mesh.h"
+#include "render/nodes.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/shader.h"
+#include "subd/subd_dice.h"
+#include "util/util_foreach.h"
+#include "util/util_path.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+string temp_filepath(const char *filename)
+{
+	const char *dir = getenv("TMPDIR");
+	if(!dir)
+		dir = getenv("TEMP");
+	return path_join((dir)? dir: ".", filename);
+}
+
+Shader *find_shader(Scene *scene, const char *name)
+{
+	foreach(Shader *shader, scene->shaders)
+		if(shader->name == name)
+			return shader;
+
+	return NULL;
+}
+
+ShaderNode *find_node(Shader *shader, const NodeType *type)
+{
+	foreach(ShaderNode *node, shader->graph->nodes)
+		if(node->type == type)
+			return node;
+
+	return NULL;
+}
+
+/* Noise texture into the first color of a mix node, into an emission. */
+Shader *add_surface_shader(Scene *scene, const char *name, float fac)
+{
+	ShaderGraph *graph = new ShaderGraph();
+	NoiseTextureNode *noise = new NoiseTextureNode();
+	MixNode *mix = new MixNode();
+	EmissionNode *emission = new EmissionNode();
+
+	mix->fac = fac;
+
+	graph->add(noise);
+	graph->add(mix);
+	graph->add(emission);
+	graph->connect(noise->output("Color"), mix->input("Color1"));
+	graph->connect(mix->output("Color"), emission->input("Color"));
+	graph->connect(emission->output("Emission"), graph->output()->input("Surface"));
+
+	Shader *shader = new Shader();
+	shader->name = name;
+	shader->set_graph(graph);
+	scene->shaders.push_back(shader);
+
+	return shader;
+}
+
+Shader *add_background_shader(Scene *scene, const char *name)
+{
+	ShaderGraph *graph = new ShaderGraph();
+	BackgroundNode *background = new BackgroundNode();
+
+	background->color = make_float3(0.2f, 0.3f, 0.4f);
+
+	graph->add(background);
+	graph->connect(background->output("Background"), graph->output()->input("Surface"));
+
+	Shader *shader = new Shader();
+	shader->name = name;
+	shader->set_graph(graph);
+	scene->shaders.push_back(shader);
+
+	return shader;
+}
+
+/* Quad made of two triangles with UV and a custom vertex attribute, and the
+ * same quad as a Catmull-Clark subdivision face with a crease. */
+Mesh *add_mesh(Scene *scene, Shader *shader)
+{
+	Mesh *mesh = new Mesh();
+	mesh->used_shaders.push_back(shader);
+
+	mesh->reserve_mesh(4, 2);
+	mesh->add_vertex(make_float3(0.0f, 0.0f, 0.0f));
+	mesh->add_vertex(make_float3(1.0f, 0.0f, 0.0f));
+	mesh->add_vertex(make_float3(1.0f, 1.0f, 0.0f));
+	mesh->add_vertex(make_float3(0.0f, 1.0f, 0.0f));
+	mesh->add_triangle(0, 1, 2, 0, true);
+	mesh->add_triangle(0, 2, 3, 0, true);
+
+	float3 *uv = mesh->attributes.add(ATTR_STD_UV, ustring("UVMap"))->data_float3();
+	for(int i = 0; i < 6; i++)
+		uv[i] = make_float3(i*0.1f, i*0.2f, 0.0f);
+
+	float *temperature = mesh->attributes.add(ustring("temperature"),
+	                                          TypeDesc::TypeFloat,
+	                                          ATTR_ELEMENT_VERTEX)->data_float();
+	for(int i = 0; i < 4; i++)
+		temperature[i] = 20.0f + i;
+
+	int corners[4] = {0, 1, 2, 3};
+	mesh->subdivision_type = Mesh::SUBDIVISION_CATMULL_CLARK;
+	mesh->reserve_subd_faces(1, 0, 4);
+	mesh->add_subd_face(corners, 4, 0, true);
+
+	Mesh::SubdEdgeCrease crease = {{0, 1}, 0.75f};
+	mesh->subd_creases.push_back_slow(crease);
+
+	mesh->subd_params = new SubdParams(mesh);
+	mesh->subd_params->dicing_rate = 0.5f;
+	mesh->subd_params->objecttoworld = transform_translate(make_float3(1.0f, 2.0f, 3.0f));
+
+	float *weight = mesh->subd_attributes.add(ustring("weight"),
+	                                          TypeDesc::TypeFloat,
+	                                          ATTR_ELEMENT_VERTEX)->data_float();
+	for(int i = 0; i < 4; i++)
+		weight[i] = 0.25f*i;
+
+	scene->meshes.push_back(mesh);
+
+	return mesh;
+}
+
+}  // namespace
+
+TEST(app_binary, round_trip)
+{
+	DeviceInfo device_info;
+	SceneParams scene_params;
+	string filepath = temp_filepath("cycles_app_binary_test.bin");
+
+	{
+		Scene scene(scene_params, device_info);
+
+		Shader *surface = add_surface_shader(&scene, "surface", 0.3f);
+		Shader *world = add_background_shader(&scene, "world");
+		scene.background->shader = world;
+
+		Mesh *mesh = add_mesh(&scene, surface);
+
+		Object *object = new Object();
+		object->name = "object";
+		object->mesh = mesh;
+		object->tfm = transform_translate(make_float3(1.0f, 2.0f, 3.0f));
+		scene.objects.push_back(object);
+
+		Light *light = new Light();
+		light->shader = surface;
+		light->co = make_float3(4.0f, 5.0f, 6.0f);
+		scene.lights.push_back(light);
+
+		scene.camera->width = 64;
+		scene.camera->height = 32;
+
+		ASSERT_TRUE(binary_write_file(&scene, filepath.c_str()));
+	}
+
+	EXPECT_TRUE(binary_file_check(filepath.c_str()));
+
+	Scene scene(scene_params, device_info);
+	size_t num_default_shaders = scene.shaders.size();
+
+	ASSERT_TRUE(binary_read_file(&scene, filepath.c_str()));
+	path_remove(filepath);
+
+	EXPECT_EQ(scene.camera->width, 64);
+	EXPECT_EQ(scene.camera->height, 32);
+
+	/* shaders and their links */
+	ASSERT_EQ(scene.shaders.size(), num_default_shaders + 2);
+
+	Shader *surface = find_shader(&scene, "surface");
+	Shader *world = find_shader(&scene, "world");
+	ASSERT_TRUE(surface != NULL);
+	ASSERT_TRUE(world != NULL);
+
+	ShaderNode *noise = find_node(surface, NoiseTextureNode::node_type);
+	MixNode *mix = (MixNode*)find_node(surface, MixNode::node_type);
+	ShaderNode *emission = find_node(surface, EmissionNode::node_type);
+	ASSERT_TRUE(noise != NULL);
+	ASSERT_TRUE(mix != NULL);
+	ASSERT_TRUE(emission != NULL);
+
+	EXPECT_EQ(mix->fac, 0.3f);
+	EXPECT_EQ(mix->input("Color1")->link, noise->output("Color"));
+	EXPECT_TRUE(mix->input("Color2")->link == NULL);
+	EXPECT_EQ(emission->input("Color")->link, mix->output("Color"));
+	EXPECT_EQ(surface->graph->output()->input("Surface")->link, emission->output("Emission"));
+
+	/* links from nodes to shaders */
+	EXPECT_EQ(scene.background->shader, world);
+
+	/* mesh */
+	ASSERT_EQ(scene.meshes.size(), 1);
+	Mesh *mesh = scene.meshes[0];
+
+	ASSERT_EQ(mesh->used_shaders.size(), 1);
+	EXPECT_EQ(mesh->used_shaders[0], surface);
+	ASSERT_EQ(mesh->verts.size(), 4);
+	EXPECT_EQ(mesh->verts[2].x, 1.0f);
+	EXPECT_EQ(mesh->verts[2].y, 1.0f);
+	ASSERT_EQ(mesh->triangles.size(), 6);
+	EXPECT_EQ(mesh->triangles[5], 3);
+
+	Attribute *uv = mesh->attributes.find(ATTR_STD_UV);
+	ASSERT_TRUE(uv != NULL);
+	EXPECT_EQ(uv->name, ustring("UVMap"));
+	EXPECT_EQ(uv->data_float3()[5].y, 5*0.2f);
+
+	Attribute *temperature = mesh->attributes.find(ustring("temperature"));
+	ASSERT_TRUE(temperature != NULL);
+	EXPECT_EQ(temperature->element, ATTR_ELEMENT_VERTEX);
+	EXPECT_EQ(temperature->data_float()[3], 23.0f);
+
+	/* subdivision */
+	EXPECT_EQ(mesh->subdivision_type, Mesh::SUBDIVISION_CATMULL_CLARK);
+	ASSERT_EQ(mesh->subd_faces.size(), 1);
+	EXPECT_EQ(mesh->subd_faces[0].num_corners, 4);
+	ASSERT_EQ(mesh->subd_face_corners.size(), 4);
+	EXPECT_EQ(mesh->subd_face_corners[3], 3);
+	ASSERT_EQ(mesh->subd_creases.size(), 1);
+	EXPECT_EQ(mesh->subd_creases[0].v[1], 1);
+	EXPECT_EQ(mesh->subd_creases[0].crease, 0.75f);
+
+	ASSERT_TRUE(mesh->subd_params != NULL);
+	EXPECT_EQ(mesh->subd_params->dicing_rate, 0.5f);
+	EXPECT_EQ(mesh->subd_params->objecttoworld.x.w, 1.0f);
+	EXPECT_EQ(mesh->subd_params->camera, scene.camera);
+
+	Attribute *weight = mesh->subd_attributes.find(ustring("weight"));
+	ASSERT_TRUE(weight != NULL);
+	EXPECT_EQ(weight->data_float()[2], 0.5f);
+
+	/* objects and lights */
+	ASSERT_EQ(scene.objects.size(), 1);
+	EXPECT_EQ(scene.objects[0]->mesh, mesh);
+	EXPECT_EQ(scene.objects[0]->tfm.z.w, 3.0f);
+
+	ASSERT_EQ(scene.lights.size(), 1);
+	EXPECT_EQ(scene.lights[0]->shader, surface);
+	EXPECT_EQ(scene.lights[0]->co.z, 6.0f);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernel_denoise.h"
+
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Synthetic buffer of two planes with different normals and depth, split
+ * diagonally, with a vertical albedo edge every 24 pixels and noise in the
+ * combined pass. Feature passes are accumulated over NUM_SAMPLES. */
+
+const int WIDTH = 96;
+const int HEIGHT = 64;
+const int TILE_SIZE = 16;
+const int PASS_STRIDE = 11;
+const int NUM_SAMPLES = 16;
+const int RADIUS = 4;
+const float STRENGTH = 0.5f;
+
+class DenoiseTest : public ::testing::Test {
+protected:
+	void SetUp()
+	{
+		kg = new KernelGlobals();
+		memset(&kg->__data, 0, sizeof(kg->__data));
+
+		kernel_data.film.pass_stride = PASS_STRIDE;
+		kernel_data.film.pass_combined = 0;
+		kernel_data.film.pass_normal = 4;
+		kernel_data.film.pass_diffuse_color = 7;
+		kernel_data.film.pass_depth = 10;
+		kernel_data.film.pass_flag = PASS_COMBINED | PASS_NORMAL | PASS_DIFFUSE_COLOR | PASS_DEPTH;
+
+		noisy.resize(WIDTH*HEIGHT*PASS_STRIDE);
+		uint rng = 1;
+
+		for(int y = 0; y < HEIGHT; y++) {
+			for(int x = 0; x < WIDTH; x++) {
+				float *p = &noisy[(y*WIDTH + x)*PASS_STRIDE];
+				bool front = x + y/2 < WIDTH/2;
+				float albedo = (x % 48 < 24)? 0.8f: 0.3f;
+				float3 color = expected(x, y);
+
+				rng = rng*1664525u + 1013904223u;
+				float noise = ((rng >> 8)*(1.0f/16777216.0f) - 0.5f)*0.8f;
+
+				p[0] = color.x*(1.0f + noise);
+				p[1] = color.y*(1.0f + noise);
+				p[2] = color.z*(1.0f + noise);
+				p[3] = 1.0f;
+				p[4] = 0.0f;
+				p[5] = front? 1.0f: 0.0f;
+				p[6] = front? 0.0f: 1.0f;
+				p[7] = p[8] = p[9] = albedo*NUM_SAMPLES;
+				p[10] = front? 5.0f: 8.0f;
+			}
+		}
+	}
+
+	void TearDown()
+	{
+		delete kg;
+	}
+
+	static float3 expected(int x, int y)
+	{
+		bool front = x + y/2 < WIDTH/2;
+		float albedo = (x % 48 < 24)? 0.8f: 0.3f;
+		return front? make_float3(albedo, 0.4f, 0.2f): make_float3(0.1f, 0.5f*albedo, 0.7f);
+	}
+
+	/* Filter the whole buffer in one go. */
+	vector<float> denoise_full()
+	{
+		vector<float> buffer = noisy;
+		vector<float4> temp(WIDTH*HEIGHT);
+		int4 rect = make_int4(0, 0, WIDTH, HEIGHT);
+
+		kernel_denoise_tile(kg, &buffer[0], &temp[0], rect, rect, 0, WIDTH,
+		                    RADIUS, STRENGTH, 1.0f/NUM_SAMPLES);
+		return buffer;
+	}
+
+	/* Filter tile by tile, each one in its own copy of the noisy buffer like
+	 * the separate tile buffers of a render, reading pixels up to overlap
+	 * around the tile. */
+	vector<float> denoise_tiles(int overlap)
+	{
+		vector<float> result = noisy;
+		vector<float4> temp(TILE_SIZE*TILE_SIZE);
+
+		for(int ty = 0; ty < HEIGHT; ty += TILE_SIZE) {
+			for(int tx = 0; tx < WIDTH; tx += TILE_SIZE) {
+				vector<float> buffer = noisy;
+				int4 rect = make_int4(tx, ty, tx + TILE_SIZE, ty + TILE_SIZE);
+				int4 buffer_rect = make_int4(max(tx - overlap, 0),
+				                             max(ty - overlap, 0),
+				                             min(tx + TILE_SIZE + overlap, WIDTH),
+				                             min(ty + TILE_SIZE + overlap, HEIGHT));
+
+				kernel_denoise_tile(kg, &buffer[0], &temp[0], rect, buffer_rect, 0, WIDTH,
+				                    RADIUS, STRENGTH, 1.0f/NUM_SAMPLES);
+
+				for(int y = ty; y < ty + TILE_SIZE; y++) {
+					memcpy(&result[(y*WIDTH + tx)*PASS_STRIDE],
+					       &buffer[(y*WIDTH + tx)*PASS_STRIDE],
+					       sizeof(float)*TILE_SIZE*PASS_STRIDE);
+				}
+			}
+		}
+
+		return result;
+	}
+
+	float error(const vector<float>& buffer)
+	{
+		float sum = 0.0f;
+
+		for(int y = 0; y < HEIGHT; y++) {
+			for(int x = 0; x < WIDTH; x++) {
+				const float *p = &buffer[(y*WIDTH + x)*PASS_STRIDE];
+				float3 d = make_float3(p[0], p[1], p[2]) - expected(x, y);
+				sum += dot(d, d);
+			}
+		}
+
+		return sqrtf(sum/(WIDTH*HEIGHT));
+	}
+
+	KernelGlobals *kg;
+	vector<float> noisy;
+};
+
+}  // namespace
+
+TEST_F(DenoiseTest, reduces_noise)
+{
+	vector<float> result = denoise_full();
+	EXPECT_LT(error(result), 0.25f*error(noisy));
+}
+
+TEST_F(DenoiseTest, tiles_without_seams)
+{
+	/* With an overlap of the filter radius plus the patch radius, every pixel
+	 * sees the same neighbors as when filtering the whole image. */
+	vector<float> full = denoise_full();
+	vector<float> tiled = denoise_tiles(RADIUS + DENOISE_PATCH_RADIUS);
+
+	for(size_t i = 0; i < full.size(); i++) {
+		EXPECT_EQ(full[i], tiled[i]);
+	}
+}
+
+TEST_F(DenoiseTest, alpha_and_features_kept)
+{
+	vector<float> result = denoise_full();
+
+	for(int i = 0; i < WIDTH*HEIGHT; i++) {
+		for(int c = 3; c < PASS_STRIDE; c++) {
+			EXPECT_EQ(noisy[i*PASS_STRIDE + c], result[i*PASS_STRIDE + c]);
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -21,6 +21,7 @@
 #include "render/scene.h"
 #include "render/nodes.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_string.h"
 #include "util/util_vector.h"
 
@@ -1576,4 +1577,39 @@ TEST(render_graph, constant_fold_convert_color_float_color)
 	graph.finalize(&scene);
 }
 
+/*
+ * Test graph hashing used as compiled shader cache key.
+ */
+static string hash_mix_graph(float fac, const string& noise_to)
+{
+	ShaderGraph graph;
+	ShaderGraphBuilder builder(&graph);
+
+	builder
+		.add_node(ShaderNodeBuilder<NoiseTextureNode>("Noise"))
+		.add_node(ShaderNodeBuilder<MixNode>("Mix")
+		          .set(&MixNode::type, NODE_MIX_BLEND)
+		          .set("Fac", fac))
+		.add_connection("Noise::Color", noise_to)
+		.output_color("Mix::Color");
+
+	MD5Hash md5;
+	graph.hash(md5);
+	return md5.get_hex();
+}
+
+TEST(render_graph, hash)
+{
+	const string hash = hash_mix_graph(0.5f, "Mix::Color1");
+
+	/* Identical graphs built separately, node pointers differ. */
+	EXPECT_EQ(hash, hash_mix_graph(0.5f, "Mix::Color1"));
+
+	/* Socket value changed. */
+	EXPECT_NE(hash, hash_mix_graph(0.25f, "Mix::Color1"));
+
+	/* Link changed. */
+	EXPECT_NE(hash, hash_mix_graph(0.5f, "Mix::Color2"));
+}
+
 CCL_NAMESPACE_END
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/tile.h"
+#include "util/util_foreach.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+TileManager *tile_manager_create(TileOrder order, int width, int height, int2 tile_size)
+{
+	TileManager *tile_manager = new TileManager(false, 1, tile_size, INT_MAX,
+	                                            false, true, order);
+	BufferParams params;
+	params.width = width;
+	params.height = height;
+	params.full_width = width;
+	params.full_height = height;
+
+	tile_manager->schedule_denoising = true;
+	tile_manager->reset(params, 1);
+	tile_manager->next();
+
+	return tile_manager;
+}
+
+/* Render tiles in the order the tile manager hands them out and denoise
+ * queued tiles in between, like render threads do. */
+void render_and_denoise(TileOrder order, int width, int height, int2 tile_size)
+{
+	TileManager *tile_manager = tile_manager_create(order, width, height, tile_size);
+	int num_tiles = tile_manager->state.num_tiles;
+	int2 grid_size = tile_manager->state.grid_size;
+
+	ASSERT_EQ(num_tiles, grid_size.x*grid_size.y);
+
+	vector<bool> rendered(num_tiles, false);
+	vector<bool> denoised(num_tiles, false);
+	vector<bool> done(num_tiles, false);
+	int num_rendered = 0, num_denoised = 0, num_done = 0;
+	Tile tile;
+
+	for(;;) {
+		if(tile_manager->next_denoise_tile(tile)) {
+			int neighbors[9];
+			tile_manager->get_neighbors(tile.index, neighbors);
+			EXPECT_EQ(neighbors[4], tile.index);
+
+			/* all neighbors rendered and their buffers still around */
+			for(int i = 0; i < 9; i++) {
+				if(neighbors[i] != -1) {
+					EXPECT_TRUE(rendered[neighbors[i]]);
+					EXPECT_FALSE(done[neighbors[i]]);
+				}
+			}
+
+			EXPECT_FALSE(denoised[tile.index]);
+			denoised[tile.index] = true;
+			num_denoised++;
+
+			vector<int> done_tiles;
+			tile_manager->finish_denoise(tile.index, done_tiles);
+
+			foreach(int index, done_tiles) {
+				tile_manager->get_neighbors(index, neighbors);
+				for(int i = 0; i < 9; i++)
+					if(neighbors[i] != -1)
+						EXPECT_TRUE(denoised[neighbors[i]]);
+
+				EXPECT_FALSE(done[index]);
+				done[index] = true;
+				num_done++;
+			}
+		}
+		else if(tile_manager->next_tile(tile)) {
+			/* tiles are indexed by their position in the grid */
+			EXPECT_EQ(tile.index, (tile.y/tile_size.y)*grid_size.x + tile.x/tile_size.x);
+			EXPECT_FALSE(rendered[tile.index]);
+
+			rendered[tile.index] = true;
+			num_rendered++;
+
+			tile_manager->finish_render(tile.index);
+		}
+		else {
+			break;
+		}
+	}
+
+	EXPECT_EQ(num_rendered, num_tiles);
+	EXPECT_EQ(num_denoised, num_tiles);
+	EXPECT_EQ(num_done, num_tiles);
+
+	delete tile_manager;
+}
+
+}  // namespace
+
+TEST(render_tile, get_neighbors)
+{
+	TileManager *tile_manager = tile_manager_create(TILE_BOTTOM_TO_TOP, 100, 70, make_int2(32, 32));
+	int neighbors[9];
+
+	EXPECT_EQ(tile_manager->state.grid_size.x, 4);
+	EXPECT_EQ(tile_manager->state.grid_size.y, 3);
+
+	/* corner */
+	tile_manager->get_neighbors(0, neighbors);
+	EXPECT_EQ(neighbors[0], -1);
+	EXPECT_EQ(neighbors[3], -1);
+	EXPECT_EQ(neighbors[4], 0);
+	EXPECT_EQ(neighbors[5], 1);
+	EXPECT_EQ(neighbors[7], 4);
+	EXPECT_EQ(neighbors[8], 5);
+
+	/* inner tile */
+	tile_manager->get_neighbors(5, neighbors);
+	for(int i = 0; i < 9; i++)
+		EXPECT_EQ(neighbors[i], (i/3)*4 + i%3);
+
+	/* last tile */
+	tile_manager->get_neighbors(11, neighbors);
+	EXPECT_EQ(neighbors[0], 6);
+	EXPECT_EQ(neighbors[4], 11);
+	EXPECT_EQ(neighbors[5], -1);
+	EXPECT_EQ(neighbors[7], -1);
+
+	delete tile_manager;
+}
+
+TEST(render_tile, denoise_after_neighbors)
+{
+	TileOrder orders[] = {TILE_CENTER,
+	                      TILE_RIGHT_TO_LEFT,
+	                      TILE_LEFT_TO_RIGHT,
+	                      TILE_TOP_TO_BOTTOM,
+	                      TILE_BOTTOM_TO_TOP,
+	                      TILE_HILBERT_SPIRAL};
+
+	for(size_t i = 0; i < sizeof(orders)/sizeof(*orders); i++) {
+		render_and_denoise(orders[i], 320, 240, make_int2(64, 64));
+		render_and_denoise(orders[i], 100, 70, make_int2(16, 16));
+		render_and_denoise(orders[i], 50, 30, make_int2(64, 64));
+	}
+}
+
+CCL_NAMESPACE_END
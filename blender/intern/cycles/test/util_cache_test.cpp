@@ -0,0 +1,287 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#  include <dirent.h>
+#  include <sys/stat.h>
+#  include <utime.h>
+#endif
+
+#include "util/util_cache.h"
+#include "util/util_path.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+string temp_dirpath(const char *dirname)
+{
+	const char *dir = getenv("TMPDIR");
+	if(!dir)
+		dir = getenv("TEMP");
+	return path_join((dir)? dir: ".", dirname);
+}
+
+#ifndef _WIN32
+vector<string> dir_files(const string& dir)
+{
+	vector<string> files;
+	DIR *d = opendir(dir.c_str());
+
+	if(d) {
+		struct dirent *entry;
+		while((entry = readdir(d)) != NULL) {
+			string filepath = path_join(dir, entry->d_name);
+			struct stat st;
+			if(stat(filepath.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+				files.push_back(filepath);
+		}
+		closedir(d);
+	}
+
+	return files;
+}
+
+void dir_remove(const string& dir)
+{
+	vector<string> files = dir_files(dir);
+	for(size_t i = 0; i < files.size(); i++)
+		path_remove(files[i]);
+	path_remove(dir);
+}
+
+time_t file_mtime(const string& filepath)
+{
+	struct stat st;
+	if(stat(filepath.c_str(), &st) != 0)
+		return 0;
+	return st.st_mtime;
+}
+
+void file_set_mtime(const string& filepath, time_t mtime)
+{
+	struct utimbuf times;
+	times.actime = mtime;
+	times.modtime = mtime;
+	utime(filepath.c_str(), &times);
+}
+
+/* Modification times only have a resolution of seconds, so make all files
+ * look older to give them a well defined order. */
+void dir_age_files(const string& dir, time_t seconds)
+{
+	vector<string> files = dir_files(dir);
+	for(size_t i = 0; i < files.size(); i++)
+		file_set_mtime(files[i], file_mtime(files[i]) - seconds);
+}
+
+void file_write(const string& filepath, size_t size)
+{
+	vector<uint8_t> data(size, 0);
+	path_write_binary(filepath, data);
+}
+#endif
+
+}  // namespace
+
+/* ******** Tests for Cache ******** */
+
+TEST(util_cache, insert_lookup)
+{
+	string dir = temp_dirpath("cycles_util_cache_test");
+	Cache cache;
+	cache.set_directory(dir);
+	cache.set_size_limit(0);
+
+	int key_id = 42;
+	float3 key_co = make_float3(1.0f, 2.0f, 3.0f);
+	array<int> value_ints;
+	for(int i = 0; i < 100; i++)
+		value_ints.push_back_slow(i*i);
+	float value_float = 0.5f;
+
+	{
+		CacheData key("test");
+		key.add(key_id);
+		key.add(key_co);
+
+		CacheData value;
+		value.add(value_ints);
+		value.add(value_float);
+
+		cache.insert(key, value);
+	}
+
+	{
+		CacheData key("test");
+		key.add(key_id);
+		key.add(key_co);
+
+		CacheData value;
+		ASSERT_TRUE(cache.lookup(key, value));
+
+		array<int> read_ints;
+		float read_float = 0.0f;
+		ASSERT_TRUE(value.read(read_ints));
+		ASSERT_TRUE(value.read(read_float));
+		ASSERT_EQ(read_ints.size(), 100);
+		EXPECT_EQ(read_ints[99], 99*99);
+		EXPECT_EQ(read_float, 0.5f);
+
+		/* reading past the stored values fails */
+		EXPECT_FALSE(value.read(read_float));
+	}
+
+	{
+		/* values are read in the order they were added, a mismatching size
+		 * is an error */
+		CacheData key("test");
+		key.add(key_id);
+		key.add(key_co);
+
+		CacheData value;
+		ASSERT_TRUE(cache.lookup(key, value));
+
+		float read_float;
+		EXPECT_FALSE(value.read(read_float));
+	}
+
+	{
+		/* different key content or name */
+		int other_id = 43;
+		CacheData key("test");
+		key.add(other_id);
+		key.add(key_co);
+
+		CacheData value;
+		EXPECT_FALSE(cache.lookup(key, value));
+
+		CacheData other_key("other");
+		other_key.add(key_id);
+		other_key.add(key_co);
+		EXPECT_FALSE(cache.lookup(other_key, value));
+	}
+
+#ifndef _WIN32
+	dir_remove(dir);
+#endif
+}
+
+#ifndef _WIN32
+TEST(util_cache, trim_least_recently_used)
+{
+	string dir = temp_dirpath("cycles_util_cache_trim_test");
+	dir_remove(dir);
+
+	vector<uint8_t> payload(1000, 7);
+	size_t file_size = 8 + 8 + payload.size();
+
+	Cache cache;
+	cache.set_directory(dir);
+	cache.set_size_limit(file_size*5/2);
+
+	CacheData key_a("test"), key_b("test"), key_c("test");
+	int id_a = 1, id_b = 2, id_c = 3;
+	key_a.add(id_a);
+	key_b.add(id_b);
+	key_c.add(id_c);
+
+	CacheData value;
+	value.add(payload);
+
+	cache.insert(key_a, value);
+	dir_age_files(dir, 100);
+	cache.insert(key_b, value);
+	dir_age_files(dir, 100);
+	EXPECT_EQ(dir_files(dir).size(), 2);
+
+	/* lookups mark files as used, so b is now the oldest */
+	{
+		CacheData found;
+		ASSERT_TRUE(cache.lookup(key_a, found));
+	}
+
+	cache.insert(key_c, value);
+	EXPECT_EQ(dir_files(dir).size(), 2);
+
+	CacheData found_a, found_b, found_c;
+	EXPECT_TRUE(cache.lookup(key_a, found_a));
+	EXPECT_FALSE(cache.lookup(key_b, found_b));
+	EXPECT_TRUE(cache.lookup(key_c, found_c));
+
+	dir_remove(dir);
+}
+
+/* ******** Tests for path_touch() and path_cache_trim() ******** */
+
+TEST(util_path_touch, updates_mtime)
+{
+	string filepath = temp_dirpath("cycles_util_path_touch_test");
+	file_write(filepath, 10);
+	file_set_mtime(filepath, 1000);
+	ASSERT_EQ(file_mtime(filepath), 1000);
+
+	EXPECT_TRUE(path_touch(filepath));
+	EXPECT_GT(file_mtime(filepath), 1000);
+
+	path_remove(filepath);
+	EXPECT_FALSE(path_touch(filepath));
+}
+
+TEST(util_path_cache_trim, removes_oldest)
+{
+	string dir = temp_dirpath("cycles_util_path_cache_trim_test");
+	dir_remove(dir);
+	path_create_directories(path_join(dir, "subdir/file"));
+
+	string file_old = path_join(dir, "old");
+	string file_mid = path_join(dir, "mid");
+	string file_new = path_join(dir, "new");
+	file_write(file_new, 100);
+	file_write(file_old, 100);
+	file_write(file_mid, 100);
+	file_set_mtime(file_old, 1000);
+	file_set_mtime(file_mid, 2000);
+	file_set_mtime(file_new, 3000);
+
+	/* below the limit nothing is removed */
+	path_cache_trim(dir, 300);
+	EXPECT_EQ(dir_files(dir).size(), 3);
+
+	path_cache_trim(dir, 250);
+	EXPECT_FALSE(path_exists(file_old));
+	EXPECT_TRUE(path_exists(file_mid));
+	EXPECT_TRUE(path_exists(file_new));
+
+	/* directories are not counted or removed */
+	path_cache_trim(dir, 100);
+	EXPECT_FALSE(path_exists(file_mid));
+	EXPECT_TRUE(path_exists(file_new));
+	EXPECT_TRUE(path_exists(path_join(dir, "subdir")));
+
+	path_remove(path_join(dir, "subdir"));
+	dir_remove(dir);
+
+	/* missing directory */
+	path_cache_trim(dir, 0);
+}
+#endif
+
+CCL_NAMESPACE_END
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "util_cache.h"
+#include "util_foreach.h"
+#include "util_logging.h"
+#include "util_md5.h"
+#include "util_path.h"
+#include "util_system.h"
+
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+CCL_NAMESPACE_BEGIN
+
+/* Bump when the layout of cached data changes. */
+static const char CACHE_FILE_HEADER[8] = {'C', 'Y', 'C', 'A', 'C', 'H', 'E', '1'};
+
+/* Default size limit of the cache directory. */
+static const uint64_t CACHE_DEFAULT_SIZE_LIMIT = (uint64_t)4 << 30;
+
+/* Cache Data */
+
+CacheData::CacheData(const string& name_)
+: name(name_), map_data(NULL), map_size(0), map_offset(0)
+{
+}
+
+CacheData::~CacheData()
+{
+	close();
+}
+
+bool CacheData::open(const string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	if(!path_read_binary(filename, file_data))
+		return false;
+
+	map_data = &file_data[0];
+	map_size = file_data.size();
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+
+	if(fd == -1)
+		return false;
+
+	struct stat st;
+
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if(data == MAP_FAILED)
+		return false;
+
+	map_data = (const uint8_t*)data;
+	map_size = st.st_size;
+#endif
+
+	map_offset = sizeof(CACHE_FILE_HEADER);
+
+	if(map_size < map_offset || memcmp(map_data, CACHE_FILE_HEADER, sizeof(CACHE_FILE_HEADER)) != 0) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void CacheData::close()
+{
+#ifndef _WIN32
+	if(map_data)
+		munmap((void*)map_data, map_size);
+#endif
+
+	file_data.clear();
+	map_data = NULL;
+	map_size = 0;
+	map_offset = 0;
+}
+
+bool CacheData::read_size(size_t& size)
+{
+	uint64_t size64;
+
+	if(!read_data(&size64, sizeof(size64)))
+		return false;
+
+	size = (size_t)size64;
+	return true;
+}
+
+bool CacheData::read_data(void *data, size_t size)
+{
+	if(map_data == NULL || size > map_size - map_offset)
+		return false;
+
+	if(size) {
+		memcpy(data, map_data + map_offset, size);
+		map_offset += size;
+	}
+
+	return true;
+}
+
+/* Cache */
+
+Cache Cache::global;
+
+Cache::Cache()
+: size_limit(CACHE_DEFAULT_SIZE_LIMIT),
+  written_since_trim(0),
+  need_trim(true)
+{
+}
+
+void Cache::set_directory(const string& directory_)
+{
+	thread_scoped_lock lock(mutex);
+
+	if(directory != directory_) {
+		directory = directory_;
+		need_trim = true;
+	}
+}
+
+void Cache::set_size_limit(uint64_t size_limit_)
+{
+	thread_scoped_lock lock(mutex);
+
+	if(size_limit != size_limit_) {
+		size_limit = size_limit_;
+		need_trim = true;
+	}
+}
+
+void Cache::trim(uint64_t written_size)
+{
+	thread_scoped_lock lock(mutex);
+
+	if(size_limit == 0)
+		return;
+
+	/* Scanning the directory is expensive with many files, so only do it
+	 * once a fraction of the limit was written since the last scan. The
+	 * directory may exceed the limit by that much in between. */
+	written_since_trim += written_size;
+
+	if(need_trim || written_since_trim > size_limit/16) {
+		string dir = (directory.empty())? path_user_get("cache"): directory;
+		path_cache_trim(dir, size_limit);
+
+		written_since_trim = 0;
+		need_trim = false;
+	}
+}
+
+string Cache::data_filename(CacheData& key)
+{
+	MD5Hash hash;
+
+	foreach(const CacheBuffer& buffer, key.buffers) {
+		/* the hash only takes int sizes */
+		const uint8_t *data = (const uint8_t*)buffer.data;
+		size_t size = buffer.size;
+
+		hash.append((const uint8_t*)&buffer.size, sizeof(buffer.size));
+
+		while(size > 0) {
+			int chunk_size = (int)std::min(size, (size_t)(1 << 30));
+			hash.append(data, chunk_size);
+			data += chunk_size;
+			size -= chunk_size;
+		}
+	}
+
+	string fname = key.name + "_" + hash.get_hex();
+
+	thread_scoped_lock lock(mutex);
+
+	if(directory.empty())
+		return path_user_get(path_join("cache", fname));
+	else
+		return path_join(directory, fname);
+}
+
+void Cache::insert(CacheData& key, CacheData& value)
+{
+	string filename = data_filename(key);
+	path_create_directories(filename);
+
+	/* Write under a unique name first, readers in other processes must never
+	 * see a partially written file. */
+#ifdef _WIN32
+	int pid = _getpid();
+#else
+	int pid = getpid();
+#endif
+	string tmp_filename = filename + string_printf(".%d.tmp", pid);
+	FILE *f = path_fopen(tmp_filename, "wb");
+
+	if(!f) {
+		VLOG(1) << "Failed to open cache file " << tmp_filename << " for writing.";
+		return;
+	}
+
+	bool written = (fwrite(CACHE_FILE_HEADER, sizeof(CACHE_FILE_HEADER), 1, f) == 1);
+	uint64_t written_size = sizeof(CACHE_FILE_HEADER);
+
+	foreach(const CacheBuffer& buffer, value.buffers) {
+		uint64_t size = buffer.size;
+
+		written = written && fwrite(&size, sizeof(size), 1, f) == 1;
+		if(buffer.size)
+			written = written && fwrite(buffer.data, buffer.size, 1, f) == 1;
+
+		written_size += sizeof(size) + size;
+	}
+
+	written = (fclose(f) == 0) && written;
+
+	if(!written || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		VLOG(1) << "Failed to write cache file " << filename << ".";
+		path_remove(tmp_filename);
+		return;
+	}
+
+	VLOG(2) << "Written cache file " << filename << ".";
+
+	trim(written_size);
+}
+
+bool Cache::lookup(CacheData& key, CacheData& value)
+{
+	string filename = data_filename(key);
+
+	if(!value.open(filename))
+		return false;
+
+	/* most recently used files are kept when trimming */
+	path_touch(filename);
+
+	VLOG(2) << "Found cache file " << filename << ".";
+	return true;
+}
+
+CCL_NAMESPACE_END
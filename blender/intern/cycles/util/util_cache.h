@@ -0,0 +1,148 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_CACHE_H__
+#define __UTIL_CACHE_H__
+
+/* Disk Cache
+ *
+ * Content addressed storage of data that is expensive to compute, like BVH
+ * trees. A key is a list of buffers which are hashed, the value is a list of
+ * buffers stored in a file named after that hash. Files are written under a
+ * temporary name and renamed once complete, so multiple processes can share
+ * one cache directory. For lookups the file is mapped into memory and values
+ * are read back in the order they were added.
+ *
+ * With a size limit the least recently used files are removed once the cache
+ * directory grows beyond it, files found by lookups count as used. */
+
+#include "util_string.h"
+#include "util_thread.h"
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class CacheBuffer {
+public:
+	const void *data;
+	size_t size;
+
+	CacheBuffer(const void *data_, size_t size_)
+	: data(data_), size(size_) {}
+};
+
+class CacheData {
+public:
+	vector<CacheBuffer> buffers;
+	string name;
+
+	explicit CacheData(const string& name = "");
+	~CacheData();
+
+	/* Adding data, only pointers are stored so it must stay valid until the
+	 * key is looked up or the value inserted. */
+	template<typename T> void add(const array<T>& data)
+	{
+		add(data.data(), data.size()*sizeof(T));
+	}
+
+	template<typename T> void add(const vector<T>& data)
+	{
+		add((data.size())? &data[0]: NULL, data.size()*sizeof(T));
+	}
+
+	template<typename T> void add(const T& data)
+	{
+		add(&data, sizeof(T));
+	}
+
+	void add(const void *data, size_t size)
+	{
+		buffers.push_back(CacheBuffer(data, size));
+	}
+
+	/* Reading data back from a value found in the cache. */
+	template<typename T> bool read(array<T>& data)
+	{
+		size_t size;
+
+		if(!read_size(size) || size % sizeof(T) != 0)
+			return false;
+
+		data.resize(size/sizeof(T));
+		return read_data(data.data(), size);
+	}
+
+	template<typename T> bool read(T& data)
+	{
+		size_t size;
+
+		if(!read_size(size) || size != sizeof(T))
+			return false;
+
+		return read_data(&data, size);
+	}
+
+protected:
+	friend class Cache;
+
+	bool open(const string& filename);
+	void close();
+	bool read_size(size_t& size);
+	bool read_data(void *data, size_t size);
+
+	/* Mapped file of a value being read. */
+	const uint8_t *map_data;
+	size_t map_size;
+	size_t map_offset;
+	vector<uint8_t> file_data;
+private:
+	/* The mapping is owned and unmapped on destruction, so copies would
+	 * unmap it twice. */
+	CacheData(const CacheData& other);
+	CacheData& operator=(const CacheData& other);
+};
+
+class Cache {
+public:
+	static Cache global;
+
+	Cache();
+
+	/* Directory to store files in, the user cache directory when empty. */
+	void set_directory(const string& directory);
+	/* Size in bytes the directory is trimmed to, zero for no limit. */
+	void set_size_limit(uint64_t size_limit);
+
+	void insert(CacheData& key, CacheData& value);
+	bool lookup(CacheData& key, CacheData& value);
+
+protected:
+	string data_filename(CacheData& key);
+	void trim(uint64_t written_size);
+
+	thread_mutex mutex;
+	string directory;
+	uint64_t size_limit;
+	/* Bytes written since the directory was last trimmed. */
+	uint64_t written_since_trim;
+	bool need_trim;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_CACHE_H__ */
@@ -29,7 +29,9 @@ DebugFlags::CPU::CPU()
     sse41(true),
     sse3(true),
     sse2(true),
-    qbvh(true)
+    qbvh(true),
+    ray_stream(false),
+    tile_stealing(true)
 {
 	reset();
 }
@@ -55,6 +57,8 @@ void DebugFlags::CPU::reset()
 #undef CHECK_CPU_FLAGS
 
 	qbvh = true;
+	ray_stream = (getenv("CYCLES_CPU_RAY_STREAM") != NULL);
+	tile_stealing = (getenv("CYCLES_CPU_NO_TILE_STEALING") == NULL);
 }
 
 DebugFlags::CUDA::CUDA()
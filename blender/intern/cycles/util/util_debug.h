@@ -46,6 +46,12 @@ public:
 
 		/* Whether QBVH usage is allowed or not. */
 		bool qbvh;
+
+		/* Whether camera rays are traced as ray streams. */
+		bool ray_stream;
+
+		/* Whether idle threads split in-progress tiles of other threads. */
+		bool tile_stealing;
 	};
 
 	/* Descriptor of CUDA feature-set to be used. */
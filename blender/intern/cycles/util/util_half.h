@@ -98,6 +98,33 @@ ccl_device_inline float half_to_float(half h)
 	return f;
 }
 
+ccl_device_inline half float_to_half(float f)
+{
+	/* full range float to half, with rounding to nearest, denormals and
+	 * clamping to infinity, for data that is not pixels */
+	union { uint i; float f; } in;
+	in.f = f;
+
+	uint sign = (in.i >> 16) & 0x8000;
+	uint absolute = in.i & 0x7FFFFFFF;
+
+	if(absolute >= 0x47800000) {
+		/* overflow or nan */
+		return (half)(sign | ((absolute > 0x7F800000)? 0x7E00: 0x7C00));
+	}
+	else if(absolute < 0x38800000) {
+		/* denormal */
+		union { uint i; float f; } a;
+		a.i = absolute;
+		return (half)(sign | (uint)(a.f * 16777216.0f + 0.5f));
+	}
+
+	absolute += 0xC8000000;
+	absolute += 0xFFF + ((absolute >> 13) & 1);
+
+	return (half)(sign | (absolute >> 13));
+}
+
 ccl_device_inline float4 half4_to_float4(half4 h)
 {
 	float4 f;
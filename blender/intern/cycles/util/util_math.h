@@ -1582,6 +1582,43 @@ ccl_device_inline float2 map_to_sphere(const float3 co)
 	return make_float2(u, v);
 }
 
+/* Octahedral normal encoding: unit vectors are projected onto an octahedron,
+ * unfolded into a square and stored as two 16 bit signed normalized values. */
+
+ccl_device_inline uint float3_to_octahedral(const float3 n)
+{
+	float d = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	float x = (d > 0.0f)? n.x/d: 0.0f;
+	float y = (d > 0.0f)? n.y/d: 0.0f;
+
+	if(n.z < 0.0f) {
+		float fx = (1.0f - fabsf(y)) * ((x >= 0.0f)? 1.0f: -1.0f);
+		float fy = (1.0f - fabsf(x)) * ((y >= 0.0f)? 1.0f: -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	int ix = (int)floorf(clamp(x, -1.0f, 1.0f)*32767.0f + 0.5f);
+	int iy = (int)floorf(clamp(y, -1.0f, 1.0f)*32767.0f + 0.5f);
+
+	return ((uint)ix & 0xFFFF) | ((uint)iy << 16);
+}
+
+ccl_device_inline float3 octahedral_to_float3(const uint v)
+{
+	/* sign extend 16 bit values */
+	float x = max(((int)(v << 16) >> 16) * (1.0f/32767.0f), -1.0f);
+	float y = max(((int)v >> 16) * (1.0f/32767.0f), -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	/* fold back the lower hemisphere */
+	float t = max(-z, 0.0f);
+	x += (x >= 0.0f)? -t: t;
+	y += (y >= 0.0f)? -t: t;
+
+	return normalize(make_float3(x, y, z));
+}
+
 ccl_device_inline int util_max_axis(float3 vec)
 {
 	if(vec.x > vec.y) {
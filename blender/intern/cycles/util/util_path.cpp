@@ -25,6 +25,7 @@
 
 OIIO_NAMESPACE_USING
 
+#include <algorithm>
 #include <stdio.h>
 
 #include <sys/stat.h>
@@ -33,9 +34,11 @@ OIIO_NAMESPACE_USING
 #  define DIR_SEP '\\'
 #  define DIR_SEP_ALT '/'
 #  include <direct.h>
+#  include <sys/utime.h>
 #else
 #  define DIR_SEP '/'
 #  include <dirent.h>
+#  include <utime.h>
 #endif
 
 #ifdef HAVE_SHLWAPI_H
@@ -717,7 +720,7 @@ bool path_read_text(const string& path, string& text)
 uint64_t path_modified_time(const string& path)
 {
 	path_stat_t st;
-	if(path_stat(path, &st) != 0) {
+	if(path_stat(path, &st) == 0) {
 		return st.st_mtime;
 	}
 	return 0;
@@ -728,6 +731,17 @@ bool path_remove(const string& path)
 	return remove(path.c_str()) == 0;
 }
 
+bool path_touch(const string& path)
+{
+	/* set modification time to now */
+#ifdef _WIN32
+	wstring path_wc = string_to_wstring(path);
+	return _wutime(path_wc.c_str(), NULL) == 0;
+#else
+	return utime(path.c_str(), NULL) == 0;
+#endif
+}
+
 static string line_directive(const string& path, int line)
 {
 	string escaped_path = path;
@@ -815,5 +829,58 @@ void path_cache_clear_except(const string& name, const set<string>& except)
 
 }
 
+namespace {
+
+struct CacheFile {
+	uint64_t modified_time;
+	uint64_t size;
+	string path;
+
+	bool operator<(const CacheFile& other) const
+	{
+		return modified_time < other.modified_time;
+	}
+};
+
+}  /* namespace */
+
+void path_cache_trim(const string& dir, uint64_t max_size)
+{
+	/* remove least recently modified files until the directory fits in max_size */
+	if(!path_exists(dir))
+		return;
+
+	vector<CacheFile> files;
+	uint64_t total_size = 0;
+
+	directory_iterator it(dir), it_end;
+
+	for(; it != it_end; ++it) {
+		CacheFile file;
+		path_stat_t st;
+
+		file.path = it->path();
+
+		if(path_stat(file.path, &st) != 0 || S_ISDIR(st.st_mode))
+			continue;
+
+		file.modified_time = st.st_mtime;
+		file.size = st.st_size;
+		total_size += file.size;
+		files.push_back(file);
+	}
+
+	if(total_size <= max_size)
+		return;
+
+	std::sort(files.begin(), files.end());
+
+	for(size_t i = 0; i < files.size() && total_size > max_size; i++) {
+		/* files may already be removed by another process sharing the directory */
+		path_remove(files[i].path);
+		total_size -= files[i].size;
+	}
+}
+
 CCL_NAMESPACE_END
 
@@ -63,6 +63,7 @@ bool path_read_text(const string& path, string& text);
 
 /* File manipulation. */
 bool path_remove(const string& path);
+bool path_touch(const string& path);
 
 /* source code utility */
 string path_source_replace_includes(const string& source,
@@ -71,6 +72,7 @@ string path_source_replace_includes(const string& source,
 
 /* cache utility */
 void path_cache_clear_except(const string& name, const set<string>& except);
+void path_cache_trim(const string& dir, uint64_t max_size);
 
 CCL_NAMESPACE_END
 
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util_algorithm.h"
+#include "util_foreach.h"
+#include "util_profiling.h"
+#include "util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Sample every millisecond, often enough for tiles which only take a few
+ * seconds while the profiler thread itself stays invisible in the results. */
+static const double PROFILING_SAMPLE_INTERVAL = 1e-3;
+
+Profiler::Profiler()
+: worker(NULL), do_stop_worker(true)
+{
+	memset(event_samples, 0, sizeof(event_samples));
+}
+
+Profiler::~Profiler()
+{
+	stop();
+}
+
+void Profiler::reset()
+{
+	thread_scoped_lock lock(mutex);
+
+	assert(states.empty());
+
+	memset(event_samples, 0, sizeof(event_samples));
+	shader_samples.clear();
+	object_samples.clear();
+}
+
+void Profiler::start()
+{
+	assert(worker == NULL);
+
+	do_stop_worker = false;
+	worker = new thread(function_bind(&Profiler::run, this));
+}
+
+void Profiler::stop()
+{
+	if(worker != NULL) {
+		do_stop_worker = true;
+
+		worker->join();
+		delete worker;
+		worker = NULL;
+	}
+}
+
+bool Profiler::active()
+{
+	return worker != NULL;
+}
+
+void Profiler::run()
+{
+	while(!do_stop_worker) {
+		{
+			thread_scoped_lock lock(mutex);
+
+			foreach(ProfilingState *state, states) {
+				if(!state->active)
+					continue;
+
+				/* Read once, the render thread may change them meanwhile. */
+				uint32_t event = state->event;
+				int32_t shader = state->shader;
+				int32_t object = state->object;
+
+				if(event < PROFILING_NUM_EVENTS)
+					state->event_samples[event]++;
+
+				/* Counters grow as needed, the number of shaders and
+				 * objects isn't known until the scene is updated. */
+				if(shader >= 0) {
+					if((size_t)shader >= state->shader_samples.size())
+						state->shader_samples.resize(shader + 1, 0);
+					state->shader_samples[shader]++;
+				}
+				if(object >= 0) {
+					if((size_t)object >= state->object_samples.size())
+						state->object_samples.resize(object + 1, 0);
+					state->object_samples[object]++;
+				}
+			}
+		}
+
+		time_sleep(PROFILING_SAMPLE_INTERVAL);
+	}
+}
+
+void Profiler::state_counters_accumulate(ProfilingState *state)
+{
+	if(shader_samples.size() < state->shader_samples.size())
+		shader_samples.resize(state->shader_samples.size(), 0);
+	if(object_samples.size() < state->object_samples.size())
+		object_samples.resize(state->object_samples.size(), 0);
+
+	for(int i = 0; i < PROFILING_NUM_EVENTS; i++)
+		event_samples[i] += state->event_samples[i];
+	for(size_t i = 0; i < state->shader_samples.size(); i++)
+		shader_samples[i] += state->shader_samples[i];
+	for(size_t i = 0; i < state->object_samples.size(); i++)
+		object_samples[i] += state->object_samples[i];
+}
+
+void Profiler::add_state(ProfilingState *state)
+{
+	thread_scoped_lock lock(mutex);
+
+	memset(state->event_samples, 0, sizeof(state->event_samples));
+	state->shader_samples.clear();
+	state->object_samples.clear();
+	state->event = PROFILING_UNKNOWN;
+	state->shader = -1;
+	state->object = -1;
+	state->active = true;
+
+	states.push_back(state);
+}
+
+void Profiler::remove_state(ProfilingState *state)
+{
+	thread_scoped_lock lock(mutex);
+
+	vector<ProfilingState*>::iterator it = find(states.begin(), states.end(), state);
+	if(it == states.end())
+		return;
+
+	states.erase(it);
+
+	state->active = false;
+	state_counters_accumulate(state);
+}
+
+uint64_t Profiler::get_event(ProfilingEvent event)
+{
+	assert(states.empty());
+	return event_samples[event];
+}
+
+uint64_t Profiler::get_shader(int shader)
+{
+	assert(states.empty());
+	return (shader >= 0 && (size_t)shader < shader_samples.size())? shader_samples[shader]: 0;
+}
+
+uint64_t Profiler::get_object(int object)
+{
+	assert(states.empty());
+	return (object >= 0 && (size_t)object < object_samples.size())? object_samples[object]: 0;
+}
+
+int Profiler::get_num_shaders()
+{
+	return shader_samples.size();
+}
+
+int Profiler::get_num_objects()
+{
+	return object_samples.size();
+}
+
+uint64_t Profiler::get_total()
+{
+	uint64_t total = 0;
+	for(int i = 0; i < PROFILING_NUM_EVENTS; i++)
+		total += get_event((ProfilingEvent)i);
+	return total;
+}
+
+double Profiler::get_sample_interval()
+{
+	return PROFILING_SAMPLE_INTERVAL;
+}
+
+const char *Profiler::event_name(ProfilingEvent event)
+{
+	switch(event) {
+		case PROFILING_UNKNOWN: return "Other";
+		case PROFILING_RAY_SETUP: return "Ray Setup";
+		case PROFILING_PATH_INTEGRATE: return "Path Integration";
+		case PROFILING_INTERSECT: return "Intersect";
+		case PROFILING_SHADER_EVAL: return "Shader Evaluation";
+		case PROFILING_LIGHT_SAMPLE: return "Light Sampling";
+		case PROFILING_SHADOW: return "Shadow Rays";
+		case PROFILING_WRITE_PASSES: return "Write Passes";
+		case PROFILING_NUM_EVENTS: break;
+	}
+	return "Unknown";
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_PROFILING_H__
+#define __UTIL_PROFILING_H__
+
+#include <string.h>
+
+#include "util_thread.h"
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Sampling Profiler
+ *
+ * Render threads publish what they are currently doing in a ProfilingState:
+ * the kernel phase, shader and object. A separate thread periodically looks at
+ * all registered states and counts which phase, shader and object each thread
+ * was busy with. Render threads never lock, they only write a few integers
+ * when entering a phase. */
+
+enum ProfilingEvent {
+	PROFILING_UNKNOWN = 0,
+	PROFILING_RAY_SETUP,
+	PROFILING_PATH_INTEGRATE,
+	PROFILING_INTERSECT,
+	PROFILING_SHADER_EVAL,
+	PROFILING_LIGHT_SAMPLE,
+	PROFILING_SHADOW,
+	PROFILING_WRITE_PASSES,
+
+	PROFILING_NUM_EVENTS,
+};
+
+/* Per render thread state, counters are only written by the profiler. */
+struct ProfilingState {
+	volatile uint32_t event;
+	volatile int32_t shader;
+	volatile int32_t object;
+	volatile bool active;
+
+	uint64_t event_samples[PROFILING_NUM_EVENTS];
+	vector<uint64_t> shader_samples;
+	vector<uint64_t> object_samples;
+
+	ProfilingState()
+	: event(PROFILING_UNKNOWN), shader(-1), object(-1), active(false)
+	{
+		memset(event_samples, 0, sizeof(event_samples));
+	}
+};
+
+class Profiler {
+public:
+	Profiler();
+	~Profiler();
+
+	/* Clear all counters. */
+	void reset();
+
+	void start();
+	void stop();
+	bool active();
+
+	/* Render threads register their state while rendering. Counters of
+	 * removed states are added to the totals. */
+	void add_state(ProfilingState *state);
+	void remove_state(ProfilingState *state);
+
+	/* Totals over all threads, in number of samples. Must only be called
+	 * while all states are removed. */
+	uint64_t get_event(ProfilingEvent event);
+	uint64_t get_shader(int shader);
+	uint64_t get_object(int object);
+	uint64_t get_total();
+	int get_num_shaders();
+	int get_num_objects();
+
+	/* Time between two samples, in seconds. */
+	double get_sample_interval();
+
+	static const char *event_name(ProfilingEvent event);
+
+protected:
+	void run();
+
+	void state_counters_accumulate(ProfilingState *state);
+
+	thread_mutex mutex;
+	thread *worker;
+	volatile bool do_stop_worker;
+
+	vector<ProfilingState*> states;
+
+	uint64_t event_samples[PROFILING_NUM_EVENTS];
+	vector<uint64_t> shader_samples;
+	vector<uint64_t> object_samples;
+};
+
+/* Sets the event of a state for the lifetime of the helper, the previous
+ * event is restored afterwards so phases can be nested. */
+class ProfilingHelper {
+public:
+	ProfilingHelper(ProfilingState *state, ProfilingEvent event)
+	: state(state)
+	{
+		previous_event = state->event;
+		state->event = event;
+	}
+
+	~ProfilingHelper()
+	{
+		state->event = previous_event;
+	}
+
+	inline void set_event(ProfilingEvent event)
+	{
+		state->event = event;
+	}
+
+	inline void set_shader(int shader)
+	{
+		state->shader = shader;
+	}
+
+	inline void set_object(int object)
+	{
+		state->object = object;
+	}
+
+protected:
+	ProfilingState *state;
+	uint32_t previous_event;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __UTIL_PROFILING_H__ */
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2011-2016 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_SPARSE_GRID_H__
+#define __UTIL_SPARSE_GRID_H__
+
+#include <string.h>
+
+#include "util_math.h"
+#include "util_texture.h"
+#include "util_types.h"
+#include "util_vector.h"
+
+/* Sparse Voxel Grid
+ *
+ * Dense 3D images are split into tiles of TEX_SPARSE_TILE_SIZE^3 voxels and
+ * only tiles containing non-zero voxels are stored. Tiles are packed one after
+ * another with voxels in x, y, z order, and an index with one offset per tile
+ * points to the first voxel of each tile.
+ *
+ * Empty tiles all point to a shared tile of zero voxels at the start of the
+ * data, so lookups never branch and an offset of zero tells that the tile is
+ * empty, which the kernel uses to skip empty space in volumes. */
+
+CCL_NAMESPACE_BEGIN
+
+inline bool sparse_grid_voxel_is_empty(float v)
+{
+	return (v == 0.0f);
+}
+
+inline bool sparse_grid_voxel_is_empty(const float4& v)
+{
+	return (v.x == 0.0f && v.y == 0.0f && v.z == 0.0f && v.w == 0.0f);
+}
+
+/* Convert dense voxels to a sparse grid, returns false when the grid has too
+ * few empty tiles for sparse storage to be worth the slower lookups. */
+template<typename T>
+bool sparse_grid_create(const T *voxels,
+                        int width, int height, int depth,
+                        vector<int> *offsets,
+                        vector<T> *tiles)
+{
+	const int tiles_x = (width + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+	const int tiles_y = (height + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+	const int tiles_z = (depth + TEX_SPARSE_TILE_MASK) >> TEX_SPARSE_TILE_SHIFT;
+	const size_t num_tiles = (size_t)tiles_x*tiles_y*tiles_z;
+	size_t num_active = 0;
+
+	offsets->resize(num_tiles);
+
+	/* Find active tiles first, to tell if sparse storage is worth it. */
+	for(int tz = 0; tz < tiles_z; tz++) {
+		for(int ty = 0; ty < tiles_y; ty++) {
+			for(int tx = 0; tx < tiles_x; tx++) {
+				const int x0 = tx << TEX_SPARSE_TILE_SHIFT;
+				const int y0 = ty << TEX_SPARSE_TILE_SHIFT;
+				const int z0 = tz << TEX_SPARSE_TILE_SHIFT;
+				const int x1 = min(x0 + TEX_SPARSE_TILE_SIZE, width);
+				const int y1 = min(y0 + TEX_SPARSE_TILE_SIZE, height);
+				const int z1 = min(z0 + TEX_SPARSE_TILE_SIZE, depth);
+				bool active = false;
+
+				for(int z = z0; z < z1 && !active; z++) {
+					for(int y = y0; y < y1 && !active; y++) {
+						const T *row = voxels + ((size_t)z*height + y)*width;
+
+						for(int x = x0; x < x1; x++) {
+							if(!sparse_grid_voxel_is_empty(row[x])) {
+								active = true;
+								break;
+							}
+						}
+					}
+				}
+
+				(*offsets)[tx + (ty + (size_t)tz*tiles_y)*tiles_x] = active? 1: 0;
+				if(active)
+					num_active++;
+			}
+		}
+	}
+
+	/* Require at least half of the memory to be saved. */
+	const size_t dense_size = (size_t)width*height*depth*sizeof(T);
+	const size_t sparse_size = (num_active + 1)*TEX_SPARSE_TILE_VOXELS*sizeof(T) +
+	                           num_tiles*sizeof(int);
+
+	if(sparse_size*2 > dense_size)
+		return false;
+
+	tiles->resize((num_active + 1)*TEX_SPARSE_TILE_VOXELS);
+	memset(&(*tiles)[0], 0, tiles->size()*sizeof(T));
+
+	/* Copy active tiles, voxels outside of the image stay zero. */
+	size_t next_offset = TEX_SPARSE_TILE_VOXELS;
+
+	for(int tz = 0; tz < tiles_z; tz++) {
+		for(int ty = 0; ty < tiles_y; ty++) {
+			for(int tx = 0; tx < tiles_x; tx++) {
+				int& offset = (*offsets)[tx + (ty + (size_t)tz*tiles_y)*tiles_x];
+
+				if(offset == 0)
+					continue;
+
+				offset = (int)next_offset;
+				next_offset += TEX_SPARSE_TILE_VOXELS;
+
+				const int x0 = tx << TEX_SPARSE_TILE_SHIFT;
+				const int y0 = ty << TEX_SPARSE_TILE_SHIFT;
+				const int z0 = tz << TEX_SPARSE_TILE_SHIFT;
+				const int x1 = min(x0 + TEX_SPARSE_TILE_SIZE, width);
+				const int y1 = min(y0 + TEX_SPARSE_TILE_SIZE, height);
+				const int z1 = min(z0 + TEX_SPARSE_TILE_SIZE, depth);
+
+				for(int z = z0; z < z1; z++) {
+					for(int y = y0; y < y1; y++) {
+						const T *row = voxels + ((size_t)z*height + y)*width;
+						T *tile_row = &(*tiles)[offset +
+						                        ((z - z0) << (2*TEX_SPARSE_TILE_SHIFT)) +
+						                        ((y - y0) << TEX_SPARSE_TILE_SHIFT)];
+
+						memcpy(tile_row, row + x0, (x1 - x0)*sizeof(T));
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_SPARSE_GRID_H__ */
@@ -18,6 +18,12 @@
 #define __UTIL_STATS_H__
 
 #include "util_atomic.h"
+#include "util_map.h"
+#include "util_profiling.h"
+#include "util_string.h"
+#include "util_thread.h"
+#include "util_time.h"
+#include "util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -25,7 +31,7 @@ class Stats {
 public:
 	enum static_init_t { static_init = 0 };
 
-	Stats() : mem_used(0), mem_peak(0) {}
+	Stats() : mem_used(0), mem_peak(0), render_rays(0) {}
 	explicit Stats(static_init_t) {}
 
 	void mem_alloc(size_t size) {
@@ -38,8 +44,97 @@ public:
 		atomic_sub_z(&mem_used, size);
 	}
 
+	/* Called by device threads when they are done rendering, with the time
+	 * they were running, the part of it spent rendering tiles (excluding
+	 * waiting for tiles) and the number of rays they traced. */
+	void render_thread_done(const char *kernel, double time, double busy_time, size_t num_rays) {
+		thread_scoped_lock lock(render_mutex);
+		render_kernel = kernel;
+		render_thread_times.push_back(time);
+		render_thread_busy_times.push_back(busy_time);
+		render_rays += num_rays;
+	}
+
+	/* Called when rendering restarts, so the statistics only cover the last
+	 * render and don't grow with every viewport update. */
+	void render_reset() {
+		thread_scoped_lock lock(render_mutex);
+		render_kernel = "";
+		render_thread_times.clear();
+		render_thread_busy_times.clear();
+		render_rays = 0;
+	}
+
 	size_t mem_used;
 	size_t mem_peak;
+
+	/* Render statistics, only filled in by the CPU device. */
+	string render_kernel;
+	vector<double> render_thread_times;
+	vector<double> render_thread_busy_times;
+	size_t render_rays;
+
+	/* Sampling profiler for render threads, only used by the CPU device. */
+	Profiler profiler;
+
+protected:
+	thread_mutex render_mutex;
+};
+
+/* Accumulated time spent in named phases, like scene update stages. */
+class TimeStats {
+public:
+	void add(const string& name, double time) {
+		thread_scoped_lock lock(mutex);
+		times[name] += time;
+	}
+
+	void clear() {
+		thread_scoped_lock lock(mutex);
+		times.clear();
+	}
+
+	map<string, double> times;
+
+protected:
+	thread_mutex mutex;
+};
+
+/* Adds the time from begin() to the next begin(), end() or destruction to
+ * the given stats, so consecutive phases can share a single timer. */
+class scoped_stats_timer {
+public:
+	explicit scoped_stats_timer(TimeStats *stats, const char *name = NULL)
+	: stats_(stats), name_(NULL), time_start_(0.0)
+	{
+		if(name)
+			begin(name);
+	}
+
+	~scoped_stats_timer()
+	{
+		end();
+	}
+
+	void begin(const char *name)
+	{
+		end();
+		name_ = name;
+		time_start_ = time_dt();
+	}
+
+	void end()
+	{
+		if(stats_ != NULL && name_ != NULL) {
+			stats_->add(name_, time_dt() - time_start_);
+			name_ = NULL;
+		}
+	}
+
+protected:
+	TimeStats *stats_;
+	const char *name_;
+	double time_start_;
 };
 
 CCL_NAMESPACE_END
@@ -77,6 +77,12 @@ CCL_NAMESPACE_BEGIN
 #define TEX_START_BYTE_OPENCL	(TEX_NUM_FLOAT4_OPENCL + TEX_NUM_BYTE4_OPENCL + TEX_NUM_HALF4_OPENCL + TEX_NUM_FLOAT_OPENCL)
 #define TEX_START_HALF_OPENCL	(TEX_NUM_FLOAT4_OPENCL + TEX_NUM_BYTE4_OPENCL + TEX_NUM_HALF4_OPENCL + TEX_NUM_FLOAT_OPENCL + TEX_NUM_BYTE_OPENCL)
 
+/* Sparse 3D images on the CPU are stored in tiles of this many voxels along
+ * each axis, see util_sparse_grid.h. */
+#define TEX_SPARSE_TILE_SHIFT	3
+#define TEX_SPARSE_TILE_SIZE	(1 << TEX_SPARSE_TILE_SHIFT)
+#define TEX_SPARSE_TILE_MASK	(TEX_SPARSE_TILE_SIZE - 1)
+#define TEX_SPARSE_TILE_VOXELS	(TEX_SPARSE_TILE_SIZE*TEX_SPARSE_TILE_SIZE*TEX_SPARSE_TILE_SIZE)
 
 /* Color to use when textures are not found. */
 #define TEX_IMAGE_MISSING_R 1
@@ -206,6 +206,14 @@ extern const char *(*MEM_name_ptr)(void *vmemh);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/* Keep freed small blocks in per-thread caches for reuse,
+ * avoids contention in the system allocator. Lock-free allocator only. */
+void MEM_use_thread_cache(void);
+
+/* Gather allocation counts, sizes and lifetimes per block name,
+ * printed sorted by size on exit. Lock-free allocator only. */
+void MEM_use_profiling(void);
+
 #ifdef __cplusplus
 /* alloc funcs for C++ only */
 #define MEM_CXX_CLASS_ALLOC_FUNCS(_id)                                        \
@@ -128,3 +128,13 @@ void MEM_use_guarded_allocator(void)
 	MEM_name_ptr = MEM_guarded_name_ptr;
 #endif
 }
+
+void MEM_use_thread_cache(void)
+{
+	MEM_lockfree_use_thread_cache();
+}
+
+void MEM_use_profiling(void)
+{
+	MEM_lockfree_use_profiling();
+}
@@ -33,6 +33,13 @@
 #include <stdarg.h>
 #include <sys/types.h>
 
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#  include <pthread.h>
+#endif
+
 #include "MEM_guardedalloc.h"
 
 /* to ensure strict conversions */
@@ -64,11 +71,19 @@ enum {
 	MEMHEAD_ALIGN_FLAG = 2,
 };
 
+/* Flags stored in the highest bits of the length, no allocation gets this large. */
+#define MEMHEAD_CACHE_FLAG   ((size_t)1 << (sizeof(size_t) * 8 - 1))
+#define MEMHEAD_PROFILE_FLAG ((size_t)1 << (sizeof(size_t) * 8 - 2))
+#define MEMHEAD_FLAG_MASK \
+	((size_t)(MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG) | MEMHEAD_CACHE_FLAG | MEMHEAD_PROFILE_FLAG)
+
 #define MEMHEAD_FROM_PTR(ptr) (((MemHead*) vmemh) - 1)
 #define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
 #define MEMHEAD_ALIGNED_FROM_PTR(ptr) (((MemHeadAligned*) vmemh) - 1)
 #define MEMHEAD_IS_MMAP(memhead) ((memhead)->len & (size_t) MEMHEAD_MMAP_FLAG)
 #define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & (size_t) MEMHEAD_ALIGN_FLAG)
+#define MEMHEAD_IS_CACHED(memhead) ((memhead)->len & MEMHEAD_CACHE_FLAG)
+#define MEMHEAD_IS_PROFILED(memhead) ((memhead)->len & MEMHEAD_PROFILE_FLAG)
 
 /* Uncomment this to have proper peak counter. */
 #define USE_ATOMIC_MAX
@@ -119,10 +134,352 @@ static void mem_unlock_thread(void)
 }
 #endif
 
+/* --------------------------------------------------------------------- */
+/* Thread cache                                                          */
+/* --------------------------------------------------------------------- */
+
+/* Freed small blocks are kept in per-thread lists for reuse, see MEM_use_thread_cache().
+ * Blocks are rounded up to a size class, they remain regular malloc'd blocks
+ * so any thread may free them. */
+
+#ifndef WIN32
+#  define USE_THREAD_CACHE
+#endif
+
+#ifdef USE_THREAD_CACHE
+
+/* Granularity of size classes, including the block headers. */
+#define MEM_CACHE_CLASS_SIZE 16
+/* Blocks up to 512 bytes are cached. */
+#define MEM_CACHE_CLASS_NUM 32
+#define MEM_CACHE_BLOCK_MAX (MEM_CACHE_CLASS_SIZE * MEM_CACHE_CLASS_NUM)
+/* Maximum bytes each thread keeps in a single class. */
+#define MEM_CACHE_CLASS_BYTES (1 << 15)
+
+#define MEM_CACHE_CLASS_INDEX(block_len) (((block_len) - 1) / MEM_CACHE_CLASS_SIZE)
+#define MEM_CACHE_CLASS_BLOCK_LEN(index) (((index) + 1) * MEM_CACHE_CLASS_SIZE)
+
+typedef struct MemCacheBlock {
+	struct MemCacheBlock *next;
+} MemCacheBlock;
+
+typedef struct MemThreadCache {
+	MemCacheBlock *free[MEM_CACHE_CLASS_NUM];
+	unsigned int free_num[MEM_CACHE_CLASS_NUM];
+} MemThreadCache;
+
+static bool use_thread_cache = false;
+static pthread_key_t thread_cache_key;
+
+static void mem_thread_cache_free_all(void *thread_cache)
+{
+	MemThreadCache *cache = thread_cache;
+	unsigned int i;
+
+	for (i = 0; i < MEM_CACHE_CLASS_NUM; i++) {
+		MemCacheBlock *block, *block_next;
+		for (block = cache->free[i]; block; block = block_next) {
+			block_next = block->next;
+			free(block);
+		}
+	}
+	free(cache);
+}
+
+MEM_INLINE MemThreadCache *mem_thread_cache_get(void)
+{
+	MemThreadCache *cache = pthread_getspecific(thread_cache_key);
+
+	if (UNLIKELY(cache == NULL)) {
+		cache = calloc(1, sizeof(*cache));
+		if (cache) {
+			pthread_setspecific(thread_cache_key, cache);
+		}
+	}
+	return cache;
+}
+
+static void *mem_thread_cache_alloc(const size_t block_len)
+{
+	const size_t index = MEM_CACHE_CLASS_INDEX(block_len);
+	MemThreadCache *cache = mem_thread_cache_get();
+
+	if (cache && cache->free[index]) {
+		MemCacheBlock *block = cache->free[index];
+		cache->free[index] = block->next;
+		cache->free_num[index]--;
+		return block;
+	}
+	return malloc(MEM_CACHE_CLASS_BLOCK_LEN(index));
+}
+
+static void mem_thread_cache_free(void *ptr, const size_t block_len)
+{
+	const size_t index = MEM_CACHE_CLASS_INDEX(block_len);
+	MemThreadCache *cache = use_thread_cache ? mem_thread_cache_get() : NULL;
+
+	if (cache && (cache->free_num[index] < MEM_CACHE_CLASS_BYTES / MEM_CACHE_CLASS_BLOCK_LEN(index))) {
+		MemCacheBlock *block = ptr;
+		block->next = cache->free[index];
+		cache->free[index] = block;
+		cache->free_num[index]++;
+	}
+	else {
+		free(ptr);
+	}
+}
+
+#endif  /* USE_THREAD_CACHE */
+
+void MEM_lockfree_use_thread_cache(void)
+{
+#ifdef USE_THREAD_CACHE
+	if (!use_thread_cache) {
+		/* caches are freed when their thread exits */
+		if (pthread_key_create(&thread_cache_key, mem_thread_cache_free_all) == 0) {
+			use_thread_cache = true;
+		}
+	}
+#endif
+}
+
+/* --------------------------------------------------------------------- */
+/* Profiling                                                             */
+/* --------------------------------------------------------------------- */
+
+/* Statistics per allocation name, see MEM_use_profiling().
+ * Profiled blocks store their name and allocation time in front of the MemHead. */
+
+typedef struct MemProfileHead {
+	const char *str;
+	size_t time_alloc;  /* microseconds */
+} MemProfileHead;
+
+typedef struct MemProfileStats {
+	size_t str;  /* (const char *), zero while the slot is unused */
+	size_t alloc_num, free_num;
+	size_t alloc_len;  /* total of all allocations */
+	size_t len_in_use;
+	size_t lifetime_sum, lifetime_max;  /* microseconds */
+} MemProfileStats;
+
+/* Must be a power of two, names not fitting are gathered in the last slot. */
+#define MEM_PROFILE_TABLE_SIZE 4096
+
+static bool use_profiling = false;
+static MemProfileStats profile_table[MEM_PROFILE_TABLE_SIZE + 1];
+
+static size_t mem_profile_time(void)
+{
+#ifdef WIN32
+	return (size_t)GetTickCount() * 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (size_t)tv.tv_sec * 1000000 + (size_t)tv.tv_usec;
+#endif
+}
+
+/* Lock-free open addressing lookup, slots are never removed. */
+static MemProfileStats *mem_profile_stats_ensure(const char *str)
+{
+	const size_t key = (size_t)str;
+	size_t hash = (key >> 4) * 2654435761u;
+	unsigned int i;
+
+	for (i = 0; i < MEM_PROFILE_TABLE_SIZE; i++, hash++) {
+		MemProfileStats *stats = &profile_table[hash & (MEM_PROFILE_TABLE_SIZE - 1)];
+		const size_t stats_key = stats->str;
+		if (stats_key == key) {
+			return stats;
+		}
+		else if (stats_key == 0) {
+			const size_t stats_key_prev = atomic_cas_z(&stats->str, 0, key);
+			if ((stats_key_prev == 0) || (stats_key_prev == key)) {
+				return stats;
+			}
+		}
+	}
+
+	return &profile_table[MEM_PROFILE_TABLE_SIZE];
+}
+
+static void mem_profile_alloc(MemProfileHead *profh, const size_t len, const char *str)
+{
+	MemProfileStats *stats = mem_profile_stats_ensure(str);
+
+	profh->str = str;
+	profh->time_alloc = mem_profile_time();
+
+	atomic_add_z(&stats->alloc_num, 1);
+	atomic_add_z(&stats->alloc_len, len);
+	atomic_add_z(&stats->len_in_use, len);
+}
+
+static void mem_profile_free(const MemProfileHead *profh, const size_t len)
+{
+	MemProfileStats *stats = mem_profile_stats_ensure(profh->str);
+	const size_t lifetime = mem_profile_time() - profh->time_alloc;
+
+	atomic_add_z(&stats->free_num, 1);
+	atomic_sub_z(&stats->len_in_use, len);
+	atomic_add_z(&stats->lifetime_sum, lifetime);
+	update_maximum(&stats->lifetime_max, lifetime);
+}
+
+static int mem_profile_stats_cmp_str(const void *a_v, const void *b_v)
+{
+	const MemProfileStats *a = a_v, *b = b_v;
+	return strcmp((const char *)a->str, (const char *)b->str);
+}
+
+static int mem_profile_stats_cmp_len(const void *a_v, const void *b_v)
+{
+	const MemProfileStats *a = a_v, *b = b_v;
+	if      (a->alloc_len > b->alloc_len) return -1;
+	else if (a->alloc_len < b->alloc_len) return  1;
+	return 0;
+}
+
+static void mem_profile_print(void)
+{
+	MemProfileStats *stats = malloc(sizeof(profile_table));
+	unsigned int i, stats_num = 0, stats_merged_num = 0;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	for (i = 0; i < MEM_PROFILE_TABLE_SIZE; i++) {
+		if (profile_table[i].str) {
+			stats[stats_num++] = profile_table[i];
+		}
+	}
+	if (profile_table[MEM_PROFILE_TABLE_SIZE].alloc_num) {
+		stats[stats_num] = profile_table[MEM_PROFILE_TABLE_SIZE];
+		stats[stats_num++].str = (size_t)"<table full>";
+	}
+
+	/* the same name may be used from multiple places, merge them */
+	qsort(stats, stats_num, sizeof(*stats), mem_profile_stats_cmp_str);
+	for (i = 0; i < stats_num; i++) {
+		if (stats_merged_num && (mem_profile_stats_cmp_str(&stats[stats_merged_num - 1], &stats[i]) == 0)) {
+			MemProfileStats *stats_merged = &stats[stats_merged_num - 1];
+			stats_merged->alloc_num += stats[i].alloc_num;
+			stats_merged->free_num += stats[i].free_num;
+			stats_merged->alloc_len += stats[i].alloc_len;
+			stats_merged->len_in_use += stats[i].len_in_use;
+			stats_merged->lifetime_sum += stats[i].lifetime_sum;
+			if (stats[i].lifetime_max > stats_merged->lifetime_max) {
+				stats_merged->lifetime_max = stats[i].lifetime_max;
+			}
+		}
+		else {
+			stats[stats_merged_num++] = stats[i];
+		}
+	}
+	qsort(stats, stats_merged_num, sizeof(*stats), mem_profile_stats_cmp_len);
+
+	printf("\nMemory profile, sorted by total allocated size:\n");
+	printf("%12s %12s %12s %12s %14s %14s  %s\n",
+	       "allocs", "frees", "total MB", "in use MB", "avg life ms", "max life ms", "name");
+	for (i = 0; i < stats_merged_num; i++) {
+		const MemProfileStats *s = &stats[i];
+		printf("%12lu %12lu %12.3f %12.3f %14.3f %14.3f  %s\n",
+		       (unsigned long)s->alloc_num, (unsigned long)s->free_num,
+		       (double)s->alloc_len / (double)(1024 * 1024),
+		       (double)s->len_in_use / (double)(1024 * 1024),
+		       s->free_num ? ((double)s->lifetime_sum / (double)s->free_num) / 1000.0 : 0.0,
+		       (double)s->lifetime_max / 1000.0,
+		       (const char *)s->str);
+	}
+
+	free(stats);
+}
+
+void MEM_lockfree_use_profiling(void)
+{
+	if (!use_profiling) {
+		use_profiling = true;
+		atexit(mem_profile_print);
+	}
+}
+
+/* --------------------------------------------------------------------- */
+/* Blocks                                                                */
+/* --------------------------------------------------------------------- */
+
+/**
+ * Allocate a block with room for \a len bytes, using the thread cache and profiling when enabled.
+ * Aligned and mmap'd blocks are handled separately.
+ */
+static MemHead *mem_block_alloc(const size_t len, const char *str, const bool clear)
+{
+	size_t flag = 0, block_len = sizeof(MemHead) + len;
+	void *block;
+	MemHead *memh;
+
+	if (UNLIKELY(use_profiling)) {
+		flag |= MEMHEAD_PROFILE_FLAG;
+		block_len += sizeof(MemProfileHead);
+	}
+
+#ifdef USE_THREAD_CACHE
+	if (use_thread_cache && (block_len <= MEM_CACHE_BLOCK_MAX)) {
+		flag |= MEMHEAD_CACHE_FLAG;
+		block = mem_thread_cache_alloc(block_len);
+		if (clear && block) {
+			memset(block, 0, block_len);
+		}
+	}
+	else
+#endif
+	{
+		block = clear ? calloc(1, block_len) : malloc(block_len);
+	}
+
+	if (UNLIKELY(block == NULL)) {
+		return NULL;
+	}
+
+	if (UNLIKELY(flag & MEMHEAD_PROFILE_FLAG)) {
+		mem_profile_alloc(block, len, str);
+		memh = (MemHead *)((MemProfileHead *)block + 1);
+	}
+	else {
+		memh = block;
+	}
+
+	memh->len = len | flag;
+	return memh;
+}
+
+static void mem_block_free(MemHead *memh, const size_t len)
+{
+	size_t block_len = sizeof(MemHead) + len;
+	void *block = memh;
+
+	if (UNLIKELY(MEMHEAD_IS_PROFILED(memh))) {
+		block = (MemProfileHead *)memh - 1;
+		block_len += sizeof(MemProfileHead);
+		mem_profile_free(block, len);
+	}
+
+#ifdef USE_THREAD_CACHE
+	if (MEMHEAD_IS_CACHED(memh)) {
+		mem_thread_cache_free(block, block_len);
+		return;
+	}
+#endif
+
+	(void)block_len;
+	free(block);
+}
+
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
 	if (vmemh) {
-		return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t) (MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG));
+		return MEMHEAD_FROM_PTR(vmemh)->len & ~MEMHEAD_FLAG_MASK;
 	}
 	else {
 		return 0;
@@ -166,7 +523,7 @@ void MEM_lockfree_freeN(void *vmemh)
 			aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
 		}
 		else {
-			free(memh);
+			mem_block_free(memh, len);
 		}
 	}
 }
@@ -187,6 +544,9 @@ void *MEM_lockfree_dupallocN(const void *vmemh)
 				(size_t)memh_aligned->alignment,
 				"dupli_malloc");
 		}
+		else if (UNLIKELY(MEMHEAD_IS_PROFILED(memh))) {
+			newp = MEM_lockfree_mallocN(prev_size, ((MemProfileHead *)memh - 1)->str);
+		}
 		else {
 			newp = MEM_lockfree_mallocN(prev_size, "dupli_malloc");
 		}
@@ -204,7 +564,7 @@ void *MEM_lockfree_reallocN_id(void *vmemh, size_t len, const char *str)
 		size_t old_len = MEM_allocN_len(vmemh);
 
 		if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
-			newp = MEM_lockfree_mallocN(len, "realloc");
+			newp = MEM_lockfree_mallocN(len, str);
 		}
 		else {
 			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
@@ -243,7 +603,7 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
 		size_t old_len = MEM_allocN_len(vmemh);
 
 		if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
-			newp = MEM_lockfree_mallocN(len, "recalloc");
+			newp = MEM_lockfree_mallocN(len, str);
 		}
 		else {
 			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
@@ -283,10 +643,9 @@ void *MEM_lockfree_callocN(size_t len, const char *str)
 
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+	memh = mem_block_alloc(len, str, true);
 
 	if (LIKELY(memh)) {
-		memh->len = len;
 		atomic_add_u(&totblock, 1);
 		atomic_add_z(&mem_in_use, len);
 		update_maximum(&peak_mem, mem_in_use);
@@ -304,14 +663,13 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)malloc(len + sizeof(MemHead));
+	memh = mem_block_alloc(len, str, false);
 
 	if (LIKELY(memh)) {
 		if (UNLIKELY(malloc_debug_memset && len)) {
 			memset(memh + 1, 255, len);
 		}
 
-		memh->len = len;
 		atomic_add_u(&totblock, 1);
 		atomic_add_z(&mem_in_use, len);
 		update_maximum(&peak_mem, mem_in_use);
@@ -74,6 +74,10 @@ typedef struct GHashIterState {
 enum {
 	GHASH_FLAG_ALLOW_DUPES  = (1 << 0),  /* Only checked for in debug mode */
 	GHASH_FLAG_ALLOW_SHRINK = (1 << 1),  /* Allow to shrink buckets' size. */
+	/* Store entries in an open addressing table instead of chained buckets, quicker lookups but
+	 * pointers to keys and values are only valid until the next insertion or removal.
+	 * Setting or clearing it on a non-empty hash converts the existing entries. */
+	GHASH_FLAG_OPEN_ADDRESSING = (1 << 2),
 
 #ifdef GHASH_INTERNAL_API
 	/* Internal usage only */
@@ -0,0 +1,63 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_KDTREE_BUCKET_H__
+#define __BLI_KDTREE_BUCKET_H__
+
+/** \file BLI_kdtree_bucket.h
+ *  \ingroup bli
+ *  \brief A kd-tree for nearest neighbor search on large point sets,
+ *  storing points in leaf buckets and balanced in parallel.
+ *
+ *  Usage matches #KDTree: insert all points, balance, then query.
+ */
+
+#include "BLI_compiler_attrs.h"
+
+struct KDTreeNearest;
+
+struct KDTreeBucket;
+typedef struct KDTreeBucket KDTreeBucket;
+
+KDTreeBucket *BLI_kdtree_bucket_new(unsigned int maxsize);
+void BLI_kdtree_bucket_free(KDTreeBucket *tree);
+void BLI_kdtree_bucket_balance(KDTreeBucket *tree) ATTR_NONNULL(1);
+
+void BLI_kdtree_bucket_insert(
+        KDTreeBucket *tree, int index,
+        const float co[3]) ATTR_NONNULL(1, 3);
+
+int BLI_kdtree_bucket_find_nearest(
+        const KDTreeBucket *tree, const float co[3],
+        struct KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2);
+int BLI_kdtree_bucket_find_nearest_n(
+        const KDTreeBucket *tree, const float co[3],
+        struct KDTreeNearest *r_nearest,
+        unsigned int n) ATTR_NONNULL(1, 2, 3);
+void BLI_kdtree_bucket_range_search_cb(
+        const KDTreeBucket *tree, const float co[3], float range,
+        bool (*search_cb)(void *user_data, int index, const float co[3], float dist_sq), void *user_data)
+        ATTR_NONNULL(1, 2, 4);
+
+void BLI_kdtree_bucket_find_nearest_batch(
+        const KDTreeBucket *tree, const float (*co)[3], unsigned int co_num,
+        struct KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2, 4);
+
+#endif  /* __BLI_KDTREE_BUCKET_H__ */
@@ -31,6 +31,8 @@
  * A general (pointer -> pointer) chaining hash table
  * for 'Abstract Data Types' (known as an ADT Hash Table).
  *
+ * Optionally uses open addressing instead of chaining, see #GHASH_FLAG_OPEN_ADDRESSING.
+ *
  * \note edgehash.c is based on this, make sure they stay in sync.
  */
 
@@ -97,6 +99,31 @@ typedef Entry GSetEntry;
 #define GHASH_ENTRY_SIZE(_is_gset) \
 	((_is_gset) ? sizeof(GSetEntry) : sizeof(GHashEntry))
 
+/* Slot of the open addressing storage.
+ * Same layout as #Entry, so slots can be handed out as entries (iterators, lookup_p, ensure_p...). */
+typedef struct FlatEntry {
+	/* Full hash of the key with the lowest bit set, zero for an empty slot. */
+	uintptr_t hash;
+
+	void *key;
+} FlatEntry;
+
+typedef struct FlatGHashEntry {
+	FlatEntry e;
+
+	void *val;
+} FlatGHashEntry;
+
+#define GHASH_FLAT_BIT_MIN 3
+#define GHASH_FLAT_BIT_MAX 30
+
+/**
+ * Robin Hood hashing keeps probe sequences short even at high load,
+ * higher than what chaining uses since there are no entries allocated separately.
+ */
+#define GHASH_FLAT_LIMIT_GROW(_nslots)   (((_nslots) * 13) / 16)
+#define GHASH_FLAT_LIMIT_SHRINK(_nslots) (((_nslots) * 13) / 64)
+
 struct GHash {
 	GHashHashFP hashfp;
 	GHashCmpFP cmpfp;
@@ -111,6 +138,11 @@ struct GHash {
 	unsigned int bucket_mask, bucket_bit, bucket_bit_min;
 #endif
 
+	/* Open addressing storage, nbuckets is the number of slots (a power of two). */
+	char *slots;
+	unsigned int slot_size;
+	unsigned int slot_mask, slot_bit, slot_bit_min;
+
 	unsigned int nentries;
 	unsigned int flag;
 };
@@ -378,6 +410,389 @@ BLI_INLINE void ghash_buckets_reset(GHash *gh, const unsigned int nentries)
 	ghash_buckets_expand(gh, nentries, (nentries != 0));
 }
 
+/* -------------------------------------------------------------------- */
+/* Open Addressing Storage */
+
+/** \name Open Addressing Storage
+ *
+ * Alternative storage used with #GHASH_FLAG_OPEN_ADDRESSING.
+ *
+ * Entries are stored directly in a power of two sized array of slots, with linear probing
+ * and Robin Hood hashing: an inserted entry takes the slot of any entry that is closer to its
+ * own ideal slot, so probe sequences stay short and looking up a missing key can stop early.
+ * Removal shifts the following entries back instead of leaving tombstones.
+ *
+ * The full hash is stored in each slot, so resizing never calls the hash function and most
+ * non-matching keys are skipped without calling the comparison function.
+ * A lookup typically touches a single cache line, where chaining needs at least two dependent
+ * reads (bucket, then entry).
+ *
+ * \note Entries move on insertion and removal, pointers to keys and values
+ * are only valid until the hash is modified.
+ * \{ */
+
+BLI_INLINE bool ghash_is_flat(GHash *gh)
+{
+	return (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) != 0;
+}
+
+BLI_INLINE FlatEntry *ghash_flat_slot(GHash *gh, const unsigned int index)
+{
+	return (FlatEntry *)(gh->slots + (size_t)index * gh->slot_size);
+}
+
+BLI_INLINE unsigned int ghash_flat_slot_index(GHash *gh, const FlatEntry *e)
+{
+	return (unsigned int)((size_t)((const char *)e - gh->slots) / gh->slot_size);
+}
+
+/**
+ * Hash as stored in slots, never zero.
+ */
+BLI_INLINE uintptr_t ghash_flat_hash(const unsigned int hash)
+{
+	return (uintptr_t)(hash | 1u);
+}
+
+/**
+ * Ideal slot of a stored hash, Fibonacci hashing spreads the weak low bits
+ * of pointer and integer hashes over the whole table.
+ */
+BLI_INLINE unsigned int ghash_flat_home(GHash *gh, const uintptr_t hash)
+{
+	return ((unsigned int)hash * 2654435769u) >> (32 - gh->slot_bit);
+}
+
+/**
+ * Distance of a slot holding \a hash from its ideal slot.
+ */
+BLI_INLINE unsigned int ghash_flat_dist(GHash *gh, const uintptr_t hash, const unsigned int index)
+{
+	return (index - ghash_flat_home(gh, hash)) & gh->slot_mask;
+}
+
+BLI_INLINE void ghash_flat_entry_copy(GHash *gh, FlatEntry *dst, const FlatEntry *src)
+{
+	dst->hash = src->hash;
+	dst->key = src->key;
+	if ((gh->flag & GHASH_FLAG_IS_GSET) == 0) {
+		((FlatGHashEntry *)dst)->val = ((const FlatGHashEntry *)src)->val;
+	}
+}
+
+/**
+ * Robin Hood insertion of a copy of \a e_src, there must be a free slot.
+ * \return the slot where \a e_src ended up.
+ */
+static FlatEntry *ghash_flat_insert_entry(GHash *gh, const FlatEntry *e_src)
+{
+	FlatGHashEntry carry, swap;
+	FlatEntry *e_new = NULL;
+	unsigned int index = ghash_flat_home(gh, e_src->hash);
+	unsigned int dist = 0;
+
+	ghash_flat_entry_copy(gh, &carry.e, e_src);
+
+	for (;; index = (index + 1) & gh->slot_mask, dist++) {
+		FlatEntry *e = ghash_flat_slot(gh, index);
+		unsigned int e_dist;
+
+		if (e->hash == 0) {
+			ghash_flat_entry_copy(gh, e, &carry.e);
+			return e_new ? e_new : e;
+		}
+
+		/* Take the slot of richer entries, and carry on placing them instead. */
+		e_dist = ghash_flat_dist(gh, e->hash, index);
+		if (e_dist < dist) {
+			ghash_flat_entry_copy(gh, &swap.e, e);
+			ghash_flat_entry_copy(gh, e, &carry.e);
+			ghash_flat_entry_copy(gh, &carry.e, &swap.e);
+			if (e_new == NULL) {
+				e_new = e;
+			}
+			dist = e_dist;
+		}
+	}
+}
+
+static void ghash_flat_resize(GHash *gh, const unsigned int slot_bit)
+{
+	char *slots_old = gh->slots;
+	const unsigned int nslots_old = gh->nbuckets;
+	unsigned int i;
+
+	BLI_assert((gh->slot_bit != slot_bit) || !gh->slots);
+
+	gh->slot_bit = slot_bit;
+	gh->nbuckets = 1u << slot_bit;
+	gh->slot_mask = gh->nbuckets - 1;
+	gh->limit_grow   = GHASH_FLAT_LIMIT_GROW(gh->nbuckets);
+	gh->limit_shrink = GHASH_FLAT_LIMIT_SHRINK(gh->nbuckets);
+
+	gh->slots = MEM_callocN((size_t)gh->nbuckets * gh->slot_size, __func__);
+
+	if (slots_old) {
+		for (i = 0; i < nslots_old; i++) {
+			FlatEntry *e = (FlatEntry *)(slots_old + (size_t)i * gh->slot_size);
+			if (e->hash != 0) {
+				ghash_flat_insert_entry(gh, e);
+			}
+		}
+		MEM_freeN(slots_old);
+	}
+}
+
+static void ghash_flat_expand(GHash *gh, const unsigned int nentries, const bool user_defined)
+{
+	unsigned int slot_bit = gh->slot_bit;
+
+	if (LIKELY(gh->slots && (nentries <= gh->limit_grow))) {
+		return;
+	}
+
+	while ((nentries > GHASH_FLAT_LIMIT_GROW(1u << slot_bit)) &&
+	       (slot_bit < GHASH_FLAT_BIT_MAX))
+	{
+		slot_bit++;
+	}
+
+	if (user_defined) {
+		gh->slot_bit_min = slot_bit;
+	}
+
+	if ((slot_bit == gh->slot_bit) && gh->slots) {
+		return;
+	}
+
+	ghash_flat_resize(gh, slot_bit);
+}
+
+static void ghash_flat_contract(
+        GHash *gh, const unsigned int nentries, const bool user_defined, const bool force_shrink)
+{
+	unsigned int slot_bit = gh->slot_bit;
+
+	if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
+		return;
+	}
+
+	if (LIKELY(gh->slots && (nentries > gh->limit_shrink))) {
+		return;
+	}
+
+	while ((nentries < GHASH_FLAT_LIMIT_SHRINK(1u << slot_bit)) &&
+	       (slot_bit > gh->slot_bit_min))
+	{
+		slot_bit--;
+	}
+
+	if (user_defined) {
+		gh->slot_bit_min = slot_bit;
+	}
+
+	if ((slot_bit == gh->slot_bit) && gh->slots) {
+		return;
+	}
+
+	ghash_flat_resize(gh, slot_bit);
+}
+
+/**
+ * Clear and reset \a gh slots, reserve again slots for given number of entries.
+ */
+static void ghash_flat_reset(GHash *gh, const unsigned int nentries)
+{
+	MEM_SAFE_FREE(gh->slots);
+
+	gh->slot_bit = GHASH_FLAT_BIT_MIN;
+	gh->slot_bit_min = GHASH_FLAT_BIT_MIN;
+
+	gh->nentries = 0;
+
+	ghash_flat_expand(gh, nentries, (nentries != 0));
+}
+
+/**
+ * Internal lookup function, counterpart of #ghash_lookup_entry_ex.
+ */
+BLI_INLINE Entry *ghash_flat_lookup(GHash *gh, const void *key, const unsigned int hash)
+{
+	const uintptr_t hash_flat = ghash_flat_hash(hash);
+	unsigned int index = ghash_flat_home(gh, hash_flat);
+	unsigned int dist;
+
+	for (dist = 0; ; index = (index + 1) & gh->slot_mask, dist++) {
+		FlatEntry *e = ghash_flat_slot(gh, index);
+
+		/* Key would have taken the place of any entry closer to its ideal slot. */
+		if ((e->hash == 0) || (ghash_flat_dist(gh, e->hash, index) < dist)) {
+			return NULL;
+		}
+		if ((e->hash == hash_flat) && UNLIKELY(gh->cmpfp(key, e->key) == false)) {
+			return (Entry *)e;
+		}
+	}
+}
+
+/**
+ * Internal insert function, the value (if any) is left for the caller to set.
+ * Resizing happens before insertion, so the returned entry stays valid until the next change.
+ */
+BLI_INLINE Entry *ghash_flat_insert(GHash *gh, void *key, const unsigned int hash)
+{
+	FlatGHashEntry e;
+
+	BLI_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (BLI_ghash_haskey(gh, key) == 0));
+
+	ghash_flat_expand(gh, gh->nentries + 1, false);
+
+	e.e.hash = ghash_flat_hash(hash);
+	e.e.key = key;
+	e.val = NULL;
+	gh->nentries++;
+
+	return (Entry *)ghash_flat_insert_entry(gh, &e.e);
+}
+
+/**
+ * Empty a slot, shifting back the entries following it.
+ */
+static void ghash_flat_remove_index(GHash *gh, unsigned int index)
+{
+	for (;;) {
+		const unsigned int index_next = (index + 1) & gh->slot_mask;
+		FlatEntry *e = ghash_flat_slot(gh, index);
+		FlatEntry *e_next = ghash_flat_slot(gh, index_next);
+
+		if ((e_next->hash == 0) || (ghash_flat_dist(gh, e_next->hash, index_next) == 0)) {
+			e->hash = 0;
+			break;
+		}
+
+		ghash_flat_entry_copy(gh, e, e_next);
+		index = index_next;
+	}
+
+	ghash_flat_contract(gh, --gh->nentries, false, false);
+}
+
+/**
+ * Remove \a key, counterpart of #ghash_remove_ex. The value is returned in \a r_val if given.
+ */
+static bool ghash_flat_remove(
+        GHash *gh, const void *key, const unsigned int hash,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp, void **r_val)
+{
+	Entry *e = ghash_flat_lookup(gh, key, hash);
+
+	BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
+
+	if (e == NULL) {
+		return false;
+	}
+
+	if (keyfreefp) {
+		keyfreefp(e->key);
+	}
+	if (valfreefp) {
+		valfreefp(((GHashEntry *)e)->val);
+	}
+	if (r_val) {
+		*r_val = ((GHashEntry *)e)->val;
+	}
+
+	ghash_flat_remove_index(gh, ghash_flat_slot_index(gh, (FlatEntry *)e));
+	return true;
+}
+
+/**
+ * Find the index of next used slot, starting from \a index (\a gh is assumed non-empty).
+ */
+BLI_INLINE unsigned int ghash_flat_find_next_index(GHash *gh, unsigned int index)
+{
+	if (index >= gh->nbuckets) {
+		index = 0;
+	}
+	for (; ; index = (index + 1) & gh->slot_mask) {
+		if (ghash_flat_slot(gh, index)->hash != 0) {
+			return index;
+		}
+	}
+}
+
+/**
+ * Remove a random entry, counterpart of #ghash_pop.
+ */
+static bool ghash_flat_pop(GHash *gh, GHashIterState *state, void **r_key, void **r_val)
+{
+	unsigned int index;
+	FlatEntry *e;
+
+	if (gh->nentries == 0) {
+		return false;
+	}
+
+	index = ghash_flat_find_next_index(gh, state->curr_bucket);
+	e = ghash_flat_slot(gh, index);
+
+	*r_key = e->key;
+	if (r_val) {
+		*r_val = ((FlatGHashEntry *)e)->val;
+	}
+
+	ghash_flat_remove_index(gh, index);
+
+	state->curr_bucket = index;
+	return true;
+}
+
+static void ghash_flat_free_cb(
+        GHash *gh,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	unsigned int i;
+
+	BLI_assert(keyfreefp  || valfreefp);
+	BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
+
+	for (i = 0; i < gh->nbuckets; i++) {
+		FlatEntry *e = ghash_flat_slot(gh, i);
+
+		if (e->hash != 0) {
+			if (keyfreefp) {
+				keyfreefp(e->key);
+			}
+			if (valfreefp) {
+				valfreefp(((FlatGHashEntry *)e)->val);
+			}
+		}
+	}
+}
+
+/**
+ * Set \a ghi on the first used slot from \a index.
+ */
+static void ghash_flat_iterator_seek(GHashIterator *ghi, unsigned int index)
+{
+	GHash *gh = ghi->gh;
+
+	for (; index < gh->nbuckets; index++) {
+		FlatEntry *e = ghash_flat_slot(gh, index);
+
+		if (e->hash != 0) {
+			ghi->curEntry = (Entry *)e;
+			ghi->curBucket = index;
+			return;
+		}
+	}
+
+	ghi->curEntry = NULL;
+	ghi->curBucket = gh->nbuckets;
+}
+
+/** \} */
+
 /**
  * Internal lookup function.
  * Takes hash and bucket_index arguments to avoid calling #ghash_keyhash and #ghash_bucket_index multiple times.
@@ -425,6 +840,9 @@ BLI_INLINE Entry *ghash_lookup_entry_prev_ex(
 BLI_INLINE Entry *ghash_lookup_entry(GHash *gh, const void *key)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
+	if (ghash_is_flat(gh)) {
+		return ghash_flat_lookup(gh, key, hash);
+	}
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	return ghash_lookup_entry_ex(gh, key, bucket_index);
 }
@@ -438,10 +856,18 @@ static GHash *ghash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
 	gh->cmpfp = cmpfp;
 
 	gh->buckets = NULL;
+	gh->slots = NULL;
+	gh->entrypool = NULL;
+	gh->slot_size = GHASH_ENTRY_SIZE(flag & GHASH_FLAG_IS_GSET);
 	gh->flag = flag;
 
-	ghash_buckets_reset(gh, nentries_reserve);
-	gh->entrypool = BLI_mempool_create(GHASH_ENTRY_SIZE(flag & GHASH_FLAG_IS_GSET), 64, 64, BLI_MEMPOOL_NOP);
+	if (flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_flat_reset(gh, nentries_reserve);
+	}
+	else {
+		ghash_buckets_reset(gh, nentries_reserve);
+		gh->entrypool = BLI_mempool_create(gh->slot_size, 64, 64, BLI_MEMPOOL_NOP);
+	}
 
 	return gh;
 }
@@ -503,6 +929,13 @@ BLI_INLINE void ghash_insert_ex_keyonly(
 BLI_INLINE void ghash_insert(GHash *gh, void *key, void *val)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
+
+	if (ghash_is_flat(gh)) {
+		BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+		((GHashEntry *)ghash_flat_insert(gh, key, hash))->val = val;
+		return;
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 
 	ghash_insert_ex(gh, key, val, bucket_index);
@@ -513,8 +946,11 @@ BLI_INLINE bool ghash_insert_safe(
         GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
-	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
-	GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
+	const bool is_flat = ghash_is_flat(gh);
+	const unsigned int bucket_index = is_flat ? 0 : ghash_bucket_index(gh, hash);
+	GHashEntry *e = (GHashEntry *)(is_flat ?
+	                               ghash_flat_lookup(gh, key, hash) :
+	                               ghash_lookup_entry_ex(gh, key, bucket_index));
 
 	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 
@@ -531,6 +967,10 @@ BLI_INLINE bool ghash_insert_safe(
 		}
 		return false;
 	}
+	else if (is_flat) {
+		((GHashEntry *)ghash_flat_insert(gh, key, hash))->val = val;
+		return true;
+	}
 	else {
 		ghash_insert_ex(gh, key, val, bucket_index);
 		return true;
@@ -542,8 +982,9 @@ BLI_INLINE bool ghash_insert_safe_keyonly(
         GHashKeyFreeFP keyfreefp)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
-	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
-	Entry *e = ghash_lookup_entry_ex(gh, key, bucket_index);
+	const bool is_flat = ghash_is_flat(gh);
+	const unsigned int bucket_index = is_flat ? 0 : ghash_bucket_index(gh, hash);
+	Entry *e = is_flat ? ghash_flat_lookup(gh, key, hash) : ghash_lookup_entry_ex(gh, key, bucket_index);
 
 	BLI_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
 
@@ -556,6 +997,10 @@ BLI_INLINE bool ghash_insert_safe_keyonly(
 		}
 		return false;
 	}
+	else if (is_flat) {
+		ghash_flat_insert(gh, key, hash);
+		return true;
+	}
 	else {
 		ghash_insert_ex_keyonly(gh, key, bucket_index);
 		return true;
@@ -658,6 +1103,29 @@ static GHash *ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP val
 	BLI_assert(!valcopyfp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
 	gh_new = ghash_new(gh->hashfp, gh->cmpfp, __func__, 0, gh->flag);
+
+	if (ghash_is_flat(gh)) {
+		/* Same number of slots, entries can stay at the same place. */
+		if (gh_new->slot_bit != gh->slot_bit) {
+			ghash_flat_resize(gh_new, gh->slot_bit);
+		}
+		gh_new->slot_bit_min = gh->slot_bit_min;
+		memcpy(gh_new->slots, gh->slots, (size_t)gh->nbuckets * gh->slot_size);
+
+		if (keycopyfp || valcopyfp) {
+			for (i = 0; i < gh->nbuckets; i++) {
+				FlatEntry *e = ghash_flat_slot(gh, i);
+				if (e->hash != 0) {
+					ghash_entry_copy(gh_new, (Entry *)ghash_flat_slot(gh_new, i), gh, (Entry *)e,
+					                 keycopyfp, valcopyfp);
+				}
+			}
+		}
+		gh_new->nentries = gh->nentries;
+
+		return gh_new;
+	}
+
 	ghash_buckets_expand(gh_new, reserve_nentries_new, false);
 
 	BLI_assert(gh_new->nbuckets == gh->nbuckets);
@@ -683,6 +1151,60 @@ static GHash *ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP val
 	return gh_new;
 }
 
+/**
+ * Move all entries to the other storage type, used when #GHASH_FLAG_OPEN_ADDRESSING changes.
+ */
+static void ghash_storage_convert(GHash *gh, const bool use_flat)
+{
+	GHash gh_old = *gh;
+	GHashIterator ghi;
+	const bool is_gset = (gh->flag & GHASH_FLAG_IS_GSET) != 0;
+
+	gh->buckets = NULL;
+	gh->slots = NULL;
+	gh->entrypool = NULL;
+
+	if (use_flat) {
+		gh->flag |= GHASH_FLAG_OPEN_ADDRESSING;
+		ghash_flat_reset(gh, 0);
+		ghash_flat_expand(gh, gh_old.nentries, false);
+	}
+	else {
+		gh->flag &= ~(unsigned int)GHASH_FLAG_OPEN_ADDRESSING;
+		ghash_buckets_reset(gh, 0);
+		ghash_buckets_expand(gh, gh_old.nentries, false);
+		gh->entrypool = BLI_mempool_create(gh->slot_size, 64, 64, BLI_MEMPOOL_NOP);
+	}
+
+	GHASH_ITER (ghi, &gh_old) {
+		void *key = BLI_ghashIterator_getKey(&ghi);
+		const unsigned int hash = ghash_keyhash(gh, key);
+		Entry *e;
+
+		if (use_flat) {
+			e = ghash_flat_insert(gh, key, hash);
+		}
+		else {
+			e = BLI_mempool_alloc(gh->entrypool);
+			ghash_insert_ex_keyonly_entry(gh, key, ghash_bucket_index(gh, hash), e);
+		}
+
+		if (!is_gset) {
+			((GHashEntry *)e)->val = BLI_ghashIterator_getValue(&ghi);
+		}
+	}
+
+	if (gh_old.slots) {
+		MEM_freeN(gh_old.slots);
+	}
+	if (gh_old.buckets) {
+		MEM_freeN(gh_old.buckets);
+	}
+	if (gh_old.entrypool) {
+		BLI_mempool_destroy(gh_old.entrypool);
+	}
+}
+
 /** \} */
 
 
@@ -726,6 +1248,12 @@ GHash *BLI_ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcop
  */
 void BLI_ghash_reserve(GHash *gh, const unsigned int nentries_reserve)
 {
+	if (ghash_is_flat(gh)) {
+		ghash_flat_expand(gh, nentries_reserve, true);
+		ghash_flat_contract(gh, nentries_reserve, true, false);
+		return;
+	}
+
 	ghash_buckets_expand(gh, nentries_reserve, true);
 	ghash_buckets_contract(gh, nentries_reserve, true, false);
 }
@@ -822,6 +1350,19 @@ void **BLI_ghash_lookup_p(GHash *gh, const void *key)
 bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
+
+	if (ghash_is_flat(gh)) {
+		GHashEntry *e = (GHashEntry *)ghash_flat_lookup(gh, key, hash);
+		const bool haskey = (e != NULL);
+
+		if (!haskey) {
+			e = (GHashEntry *)ghash_flat_insert(gh, key, hash);
+		}
+
+		*r_val = &e->val;
+		return haskey;
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
 	const bool haskey = (e != NULL);
@@ -845,6 +1386,21 @@ bool BLI_ghash_ensure_p_ex(
         GHash *gh, const void *key, void ***r_key, void ***r_val)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
+
+	if (ghash_is_flat(gh)) {
+		GHashEntry *e = (GHashEntry *)ghash_flat_lookup(gh, key, hash);
+		const bool haskey = (e != NULL);
+
+		if (!haskey) {
+			e = (GHashEntry *)ghash_flat_insert(gh, (void *)key, hash);
+			e->e.key = NULL;  /* caller must re-assign */
+		}
+
+		*r_key = &e->e.key;
+		*r_val = &e->val;
+		return haskey;
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
 	const bool haskey = (e != NULL);
@@ -872,6 +1428,11 @@ bool BLI_ghash_ensure_p_ex(
 bool BLI_ghash_remove(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
+
+	if (ghash_is_flat(gh)) {
+		return ghash_flat_remove(gh, key, hash, keyfreefp, valfreefp, NULL);
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	Entry *e = ghash_remove_ex(gh, key, keyfreefp, valfreefp, bucket_index);
 	if (e) {
@@ -895,6 +1456,14 @@ bool BLI_ghash_remove(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp, GHas
 void *BLI_ghash_popkey(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp)
 {
 	const unsigned int hash = ghash_keyhash(gh, key);
+
+	if (ghash_is_flat(gh)) {
+		void *val = NULL;
+		BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+		ghash_flat_remove(gh, key, hash, keyfreefp, NULL, &val);
+		return val;
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_remove_ex(gh, key, keyfreefp, NULL, bucket_index);
 	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
@@ -928,10 +1497,18 @@ bool BLI_ghash_pop(
         GHash *gh, GHashIterState *state,
         void **r_key, void **r_val)
 {
-	GHashEntry *e = (GHashEntry *)ghash_pop(gh, state);
-
 	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 
+	if (ghash_is_flat(gh)) {
+		if (ghash_flat_pop(gh, state, r_key, r_val)) {
+			return true;
+		}
+		*r_key = *r_val = NULL;
+		return false;
+	}
+
+	GHashEntry *e = (GHashEntry *)ghash_pop(gh, state);
+
 	if (e) {
 		*r_key = e->e.key;
 		*r_val = e->val;
@@ -955,6 +1532,14 @@ bool BLI_ghash_pop(
 void BLI_ghash_clear_ex(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
                         const unsigned int nentries_reserve)
 {
+	if (ghash_is_flat(gh)) {
+		if (keyfreefp || valfreefp)
+			ghash_flat_free_cb(gh, keyfreefp, valfreefp);
+
+		ghash_flat_reset(gh, nentries_reserve);
+		return;
+	}
+
 	if (keyfreefp || valfreefp)
 		ghash_free_cb(gh, keyfreefp, valfreefp);
 
@@ -979,6 +1564,15 @@ void BLI_ghash_clear(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfree
  */
 void BLI_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
+	if (ghash_is_flat(gh)) {
+		if (keyfreefp || valfreefp)
+			ghash_flat_free_cb(gh, keyfreefp, valfreefp);
+
+		MEM_freeN(gh->slots);
+		MEM_freeN(gh);
+		return;
+	}
+
 	BLI_assert((int)gh->nentries == BLI_mempool_count(gh->entrypool));
 	if (keyfreefp || valfreefp)
 		ghash_free_cb(gh, keyfreefp, valfreefp);
@@ -993,6 +1587,9 @@ void BLI_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreef
  */
 void BLI_ghash_flag_set(GHash *gh, unsigned int flag)
 {
+	if ((flag & GHASH_FLAG_OPEN_ADDRESSING) && !ghash_is_flat(gh)) {
+		ghash_storage_convert(gh, true);
+	}
 	gh->flag |= flag;
 }
 
@@ -1001,6 +1598,9 @@ void BLI_ghash_flag_set(GHash *gh, unsigned int flag)
  */
 void BLI_ghash_flag_clear(GHash *gh, unsigned int flag)
 {
+	if ((flag & GHASH_FLAG_OPEN_ADDRESSING) && ghash_is_flat(gh)) {
+		ghash_storage_convert(gh, false);
+	}
 	gh->flag &= ~flag;
 }
 
@@ -1040,6 +1640,10 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
 {
 	ghi->gh = gh;
 	ghi->curEntry = NULL;
+	if (ghash_is_flat(gh)) {
+		ghash_flat_iterator_seek(ghi, 0);
+		return;
+	}
 	ghi->curBucket = UINT_MAX;  /* wraps to zero */
 	if (gh->nentries) {
 		do {
@@ -1058,7 +1662,10 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
  */
 void BLI_ghashIterator_step(GHashIterator *ghi)
 {
-	if (ghi->curEntry) {
+	if (ghi->curEntry && ghash_is_flat(ghi->gh)) {
+		ghash_flat_iterator_seek(ghi, ghi->curBucket + 1);
+	}
+	else if (ghi->curEntry) {
 		ghi->curEntry = ghi->curEntry->next;
 		while (!ghi->curEntry) {
 			ghi->curBucket++;
@@ -1379,6 +1986,13 @@ unsigned int BLI_gset_size(GSet *gs)
 void BLI_gset_insert(GSet *gs, void *key)
 {
 	const unsigned int hash = ghash_keyhash((GHash *)gs, key);
+
+	if (ghash_is_flat((GHash *)gs)) {
+		BLI_assert((((GHash *)gs)->flag & GHASH_FLAG_IS_GSET) != 0);
+		ghash_flat_insert((GHash *)gs, key, hash);
+		return;
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index((GHash *)gs, hash);
 	ghash_insert_ex_keyonly((GHash *)gs, key, bucket_index);
 }
@@ -1403,6 +2017,20 @@ bool BLI_gset_add(GSet *gs, void *key)
 bool BLI_gset_ensure_p_ex(GSet *gs, const void *key, void ***r_key)
 {
 	const unsigned int hash = ghash_keyhash((GHash *)gs, key);
+
+	if (ghash_is_flat((GHash *)gs)) {
+		GSetEntry *e = (GSetEntry *)ghash_flat_lookup((GHash *)gs, key, hash);
+		const bool haskey = (e != NULL);
+
+		if (!haskey) {
+			e = (GSetEntry *)ghash_flat_insert((GHash *)gs, (void *)key, hash);
+			e->key = NULL;  /* caller must re-assign */
+		}
+
+		*r_key = &e->key;
+		return haskey;
+	}
+
 	const unsigned int bucket_index = ghash_bucket_index((GHash *)gs, hash);
 	GSetEntry *e = (GSetEntry *)ghash_lookup_entry_ex((GHash *)gs, key, bucket_index);
 	const bool haskey = (e != NULL);
@@ -1451,6 +2079,14 @@ bool BLI_gset_pop(
         GSet *gs, GSetIterState *state,
         void **r_key)
 {
+	if (ghash_is_flat((GHash *)gs)) {
+		if (ghash_flat_pop((GHash *)gs, (GHashIterState *)state, r_key, NULL)) {
+			return true;
+		}
+		*r_key = NULL;
+		return false;
+	}
+
 	GSetEntry *e = (GSetEntry *)ghash_pop((GHash *)gs, (GHashIterState *)state);
 
 	if (e) {
@@ -1484,12 +2120,12 @@ void BLI_gset_free(GSet *gs, GSetKeyFreeFP keyfreefp)
 
 void BLI_gset_flag_set(GSet *gs, unsigned int flag)
 {
-	((GHash *)gs)->flag |= flag;
+	BLI_ghash_flag_set((GHash *)gs, flag);
 }
 
 void BLI_gset_flag_clear(GSet *gs, unsigned int flag)
 {
-	((GHash *)gs)->flag &= ~flag;
+	BLI_ghash_flag_clear((GHash *)gs, flag);
 }
 
 /** \} */
@@ -1545,6 +2181,56 @@ int BLI_gset_buckets_size(GSet *gs)
 	return BLI_ghash_buckets_size((GHash *)gs);
 }
 
+/**
+ * Open addressing has no buckets, statistics are about probe distances instead:
+ * the variance is the one of distances to the ideal slot, overloaded entries are the ones not in their
+ * ideal slot, the biggest bucket is the longest probe sequence,
+ * and the quality is the average number of slots visited to find an entry (1.0 is ideal).
+ */
+static double ghash_flat_calc_quality_ex(
+        GHash *gh, double *r_load, double *r_variance,
+        double *r_prop_empty_buckets, double *r_prop_overloaded_buckets, int *r_biggest_bucket)
+{
+	uint64_t sum = 0, sum_sq = 0, sum_overloaded = 0;
+	unsigned int dist_max = 0;
+	unsigned int i;
+	double mean;
+
+	for (i = 0; i < gh->nbuckets; i++) {
+		FlatEntry *e = ghash_flat_slot(gh, i);
+
+		if (e->hash != 0) {
+			const unsigned int dist = ghash_flat_dist(gh, e->hash, i);
+			sum += dist;
+			sum_sq += (uint64_t)dist * dist;
+			if (dist > 0) {
+				sum_overloaded++;
+			}
+			dist_max = MAX2(dist_max, dist);
+		}
+	}
+
+	mean = (double)sum / (double)gh->nentries;
+
+	if (r_load) {
+		*r_load = (double)gh->nentries / (double)gh->nbuckets;
+	}
+	if (r_variance) {
+		*r_variance = (double)sum_sq / (double)gh->nentries - mean * mean;
+	}
+	if (r_prop_empty_buckets) {
+		*r_prop_empty_buckets = (double)(gh->nbuckets - gh->nentries) / (double)gh->nbuckets;
+	}
+	if (r_prop_overloaded_buckets) {
+		*r_prop_overloaded_buckets = (double)sum_overloaded / (double)gh->nentries;
+	}
+	if (r_biggest_bucket) {
+		*r_biggest_bucket = (int)dist_max + 1;
+	}
+
+	return mean + 1.0;
+}
+
 /**
  * Measure how well the hash function performs (1.0 is approx as good as random distribution),
  * and return a few other stats like load, variance of the distribution of the entries in the buckets, etc.
@@ -1578,6 +2264,11 @@ double BLI_ghash_calc_quality_ex(
 		return 0.0;
 	}
 
+	if (ghash_is_flat(gh)) {
+		return ghash_flat_calc_quality_ex(
+		        gh, r_load, r_variance, r_prop_empty_buckets, r_prop_overloaded_buckets, r_biggest_bucket);
+	}
+
 	mean = (double)gh->nentries / (double)gh->nbuckets;
 	if (r_load) {
 		*r_load = mean;
@@ -64,6 +64,9 @@ struct Heap {
 	unsigned int size;
 	unsigned int bufsize;
 	HeapNode **tree;
+	/* values of the nodes in 'tree', kept in sync so sifting
+	 * only compares values stored next to each other (not dereferencing nodes) */
+	float *tree_value;
 
 	struct {
 		/* Always keep at least one chunk (never NULL) */
@@ -76,68 +79,104 @@ struct Heap {
 /** \name Internal Functions
  * \{ */
 
-#define HEAP_PARENT(i) (((i) - 1) >> 1)
-#define HEAP_LEFT(i)   (((i) << 1) + 1)
-#define HEAP_RIGHT(i)  (((i) << 1) + 2)
-#define HEAP_COMPARE(a, b) ((a)->value < (b)->value)
+/**
+ * Number of children per node, a 4-ary heap is less deep than a binary heap
+ * and the values of all children share a cache line.
+ */
+#define HEAP_ARITY 4
 
-#if 0  /* UNUSED */
-#define HEAP_EQUALS(a, b) ((a)->value == (b)->value)
-#endif
+#define HEAP_PARENT(i) (((i) - 1) / HEAP_ARITY)
+#define HEAP_CHILD_FIRST(i) (((i) * HEAP_ARITY) + 1)
 
-BLI_INLINE void heap_swap(Heap *heap, const unsigned int i, const unsigned int j)
+BLI_INLINE void heap_tree_set(Heap *heap, const unsigned int i, HeapNode *node, const float value)
 {
-
-#if 0
-	SWAP(unsigned int,  heap->tree[i]->index, heap->tree[j]->index);
-	SWAP(HeapNode *,    heap->tree[i],        heap->tree[j]);
-#else
-	HeapNode **tree = heap->tree;
-	union {
-		unsigned int  index;
-		HeapNode     *node;
-	} tmp;
-	SWAP_TVAL(tmp.index, tree[i]->index, tree[j]->index);
-	SWAP_TVAL(tmp.node,  tree[i],        tree[j]);
-#endif
+	heap->tree[i] = node;
+	heap->tree_value[i] = value;
+	node->index = i;
 }
 
+/**
+ * Sift the node at \a i down, moving smaller children up into the hole it leaves.
+ */
 static void heap_down(Heap *heap, unsigned int i)
 {
 	/* size won't change in the loop */
 	const unsigned int size = heap->size;
+	const float *tree_value = heap->tree_value;
+	HeapNode *node = heap->tree[i];
+	const float value = tree_value[i];
 
 	while (1) {
-		const unsigned int l = HEAP_LEFT(i);
-		const unsigned int r = HEAP_RIGHT(i);
-		unsigned int smallest;
+		const unsigned int c_first = HEAP_CHILD_FIRST(i);
+		unsigned int c, c_end, smallest;
+		float smallest_value;
 
-		smallest = ((l < size) && HEAP_COMPARE(heap->tree[l], heap->tree[i])) ? l : i;
+		if (c_first >= size) {
+			break;
+		}
 
-		if ((r < size) && HEAP_COMPARE(heap->tree[r], heap->tree[smallest])) {
-			smallest = r;
+		c_end = MIN2(c_first + HEAP_ARITY, size);
+		smallest = c_first;
+		smallest_value = tree_value[c_first];
+		for (c = c_first + 1; c < c_end; c++) {
+			if (tree_value[c] < smallest_value) {
+				smallest = c;
+				smallest_value = tree_value[c];
+			}
 		}
 
-		if (smallest == i) {
+		if (!(smallest_value < value)) {
 			break;
 		}
 
-		heap_swap(heap, i, smallest);
+		heap_tree_set(heap, i, heap->tree[smallest], smallest_value);
 		i = smallest;
 	}
+
+	heap_tree_set(heap, i, node, value);
 }
 
+/**
+ * Sift the node at \a i up, moving larger parents down into the hole it leaves.
+ */
 static void heap_up(Heap *heap, unsigned int i)
 {
+	const float *tree_value = heap->tree_value;
+	HeapNode *node = heap->tree[i];
+	const float value = tree_value[i];
+
 	while (i > 0) {
 		const unsigned int p = HEAP_PARENT(i);
 
-		if (HEAP_COMPARE(heap->tree[p], heap->tree[i])) {
+		if (!(value < tree_value[p])) {
 			break;
 		}
-		heap_swap(heap, p, i);
+
+		heap_tree_set(heap, i, heap->tree[p], tree_value[p]);
 		i = p;
 	}
+
+	heap_tree_set(heap, i, node, value);
+}
+
+/**
+ * Remove the node at \a i from the tree, filling the hole with the last node.
+ */
+static void heap_tree_remove(Heap *heap, const unsigned int i)
+{
+	const unsigned int last = --heap->size;
+
+	if (i != last) {
+		const float value = heap->tree_value[last];
+		heap_tree_set(heap, i, heap->tree[last], value);
+
+		if ((i > 0) && (value < heap->tree_value[HEAP_PARENT(i)])) {
+			heap_up(heap, i);
+		}
+		else {
+			heap_down(heap, i);
+		}
+	}
 }
 
 /** \} */
@@ -196,6 +235,7 @@ Heap *BLI_heap_new_ex(unsigned int tot_reserve)
 	heap->size = 0;
 	heap->bufsize = MAX2(1u, tot_reserve);
 	heap->tree = MEM_mallocN(heap->bufsize * sizeof(HeapNode *), "BLIHeapTree");
+	heap->tree_value = MEM_mallocN(heap->bufsize * sizeof(float), "BLIHeapTreeValue");
 
 	heap->nodes.chunk = heap_node_alloc_chunk((tot_reserve > 1) ? tot_reserve : HEAP_CHUNK_DEFAULT_NUM, NULL);
 	heap->nodes.free = NULL;
@@ -227,6 +267,7 @@ void BLI_heap_free(Heap *heap, HeapFreeFP ptrfreefp)
 	} while (chunk);
 
 	MEM_freeN(heap->tree);
+	MEM_freeN(heap->tree_value);
 	MEM_freeN(heap);
 }
 
@@ -258,15 +299,15 @@ HeapNode *BLI_heap_insert(Heap *heap, float value, void *ptr)
 	if (UNLIKELY(heap->size >= heap->bufsize)) {
 		heap->bufsize *= 2;
 		heap->tree = MEM_reallocN(heap->tree, heap->bufsize * sizeof(*heap->tree));
+		heap->tree_value = MEM_reallocN(heap->tree_value, heap->bufsize * sizeof(*heap->tree_value));
 	}
 
 	node = heap_node_alloc(heap);
 
 	node->ptr = ptr;
 	node->value = value;
-	node->index = heap->size;
 
-	heap->tree[node->index] = node;
+	heap_tree_set(heap, heap->size, node, value);
 
 	heap->size++;
 
@@ -297,29 +338,41 @@ void *BLI_heap_popmin(Heap *heap)
 	BLI_assert(heap->size != 0);
 
 	heap_node_free(heap, heap->tree[0]);
-
-	if (--heap->size) {
-		heap_swap(heap, 0, heap->size);
-		heap_down(heap, 0);
-	}
+	heap_tree_remove(heap, 0);
 
 	return ptr;
 }
 
 void BLI_heap_remove(Heap *heap, HeapNode *node)
 {
-	unsigned int i = node->index;
+	const unsigned int i = node->index;
 
 	BLI_assert(heap->size != 0);
+	BLI_assert(heap->tree[i] == node);
 
-	while (i > 0) {
-		unsigned int p = HEAP_PARENT(i);
+	heap_node_free(heap, node);
+	heap_tree_remove(heap, i);
+}
 
-		heap_swap(heap, p, i);
-		i = p;
-	}
+/**
+ * Change the value of a node in the heap, keeping its pointer.
+ * Cheaper than removing and inserting the node again.
+ */
+void BLI_heap_node_value_update(Heap *heap, HeapNode *node, float value)
+{
+	const float value_prev = node->value;
+
+	BLI_assert(heap->tree[node->index] == node);
 
-	BLI_heap_popmin(heap);
+	node->value = value;
+	heap->tree_value[node->index] = value;
+
+	if (value < value_prev) {
+		heap_up(heap, node->index);
+	}
+	else if (value > value_prev) {
+		heap_down(heap, node->index);
+	}
 }
 
 float BLI_heap_node_value(HeapNode *node)
@@ -38,6 +38,8 @@
  *
  * - Ray-cast:
  *   #BLI_bvhtree_ray_cast, #BVHRayCastData
+ * - Batched ray-cast:
+ *   #BLI_bvhtree_ray_cast_batch, #BVHRayCastPacket
  * - Nearest point on surface:
  *   #BLI_bvhtree_find_nearest, #BVHNearestData
  * - Overlapping 2 trees:
@@ -68,8 +70,10 @@
  */
 #ifdef DEBUG
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 0
+#  define KDOPBVH_THREAD_RAY_THRESHOLD 0
 #else
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 1024
+#  define KDOPBVH_THREAD_RAY_THRESHOLD 256
 #endif
 
 
@@ -1898,6 +1902,233 @@ void BLI_bvhtree_ray_cast_all(
 }
 
 
+/* -------------------------------------------------------------------- */
+
+/** \name BLI_bvhtree_ray_cast_batch
+ *
+ * Rays are cast in packets of #BVH_RAY_PACKET_SIZE consecutive rays sharing a single traversal,
+ * a node is visited when any ray of the packet hits its bounds. Bounds of a node are tested against
+ * all rays of the packet at once, using per axis arrays so the loops are vectorized.
+ *
+ * Packets are cast in parallel, coherent rays (neighbor pixels or vertices)
+ * should be next to each other for packets to work well.
+ *
+ * \{ */
+
+#define BVH_RAY_PACKET_SIZE 4
+
+typedef struct BVHRayCastPacket {
+	/* per ray, used by the callbacks and to continue rays on their own */
+	BVHRayCastData data[BVH_RAY_PACKET_SIZE];
+
+	/* per axis, for bounds tests */
+	float origin[3][BVH_RAY_PACKET_SIZE];
+	float idot_axis[3][BVH_RAY_PACKET_SIZE];
+	float hit_dist[BVH_RAY_PACKET_SIZE];
+} BVHRayCastPacket;
+
+typedef struct BVHRayCastBatchData {
+	BVHTree *tree;
+	const float (*co)[3];
+	const float (*dir)[3];
+	int rays_num;
+	float radius;
+	BVHTreeRayHit *hits;
+	BVHTree_RayCastCallback callback;
+	void *userdata;
+	int flag;
+} BVHRayCastBatchData;
+
+/**
+ * Packet version of #fast_ray_nearest_hit.
+ *
+ * \return the rays of \a mask hitting the bounds closer than their current hit,
+ * with the distance to the bounds in \a r_dist.
+ */
+static unsigned int ray_packet_nearest_hit(
+        const BVHRayCastPacket *packet, const float *bv, const unsigned int mask,
+        float r_dist[BVH_RAY_PACKET_SIZE])
+{
+	float t_near[BVH_RAY_PACKET_SIZE], t_far[BVH_RAY_PACKET_SIZE];
+	unsigned int hit_mask = 0;
+	int i, axis;
+
+	for (i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+		t_near[i] = -FLT_MAX;
+		t_far[i] = FLT_MAX;
+	}
+
+	for (axis = 0; axis < 3; axis++, bv += 2) {
+		for (i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+			const float t1 = (bv[0] - packet->origin[axis][i]) * packet->idot_axis[axis][i];
+			const float t2 = (bv[1] - packet->origin[axis][i]) * packet->idot_axis[axis][i];
+			const float t_min = (t1 < t2) ? t1 : t2;
+			const float t_max = (t1 < t2) ? t2 : t1;
+
+			t_near[i] = (t_min > t_near[i]) ? t_min : t_near[i];
+			t_far[i]  = (t_max < t_far[i])  ? t_max : t_far[i];
+		}
+	}
+
+	for (i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+		r_dist[i] = t_near[i];
+		if ((t_near[i] <= t_far[i]) && (t_far[i] >= 0.0f) && (t_near[i] < packet->hit_dist[i])) {
+			hit_mask |= (1u << i);
+		}
+	}
+
+	return hit_mask & mask;
+}
+
+static int ray_packet_first(const unsigned int mask)
+{
+	int i;
+	for (i = 0; (mask & (1u << i)) == 0; i++) {
+		/* pass */
+	}
+	return i;
+}
+
+static void dfs_raycast_packet(BVHRayCastPacket *packet, BVHNode *node, unsigned int mask)
+{
+	float dist[BVH_RAY_PACKET_SIZE];
+	int i;
+
+	/* once rays diverged, testing the whole packet is only overhead */
+	if ((mask & (mask - 1)) == 0) {
+		BVHRayCastData *data = &packet->data[ray_packet_first(mask)];
+		dfs_raycast(data, node);
+		return;
+	}
+
+	mask = ray_packet_nearest_hit(packet, node->bv, mask, dist);
+	if (mask == 0) {
+		return;
+	}
+
+	if (node->totnode == 0) {
+		for (i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+			if (mask & (1u << i)) {
+				BVHRayCastData *data = &packet->data[i];
+
+				if (data->callback) {
+					data->callback(data->userdata, node->index, &data->ray, &data->hit);
+				}
+				else {
+					data->hit.index = node->index;
+					data->hit.dist  = dist[i];
+					madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+				}
+				packet->hit_dist[i] = data->hit.dist;
+			}
+		}
+	}
+	else {
+		/* pick loop direction from the first ray still active, rays of a packet are expected
+		 * to be coherent so this is a good choice for the others too */
+		const BVHRayCastData *data = &packet->data[ray_packet_first(mask)];
+
+		if (data->ray_dot_axis[(int)node->main_axis] > 0.0f) {
+			for (i = 0; i != node->totnode; i++) {
+				dfs_raycast_packet(packet, node->children[i], mask);
+			}
+		}
+		else {
+			for (i = node->totnode - 1; i >= 0; i--) {
+				dfs_raycast_packet(packet, node->children[i], mask);
+			}
+		}
+
+		/* rays continued on their own may have found closer hits */
+		for (i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+			packet->hit_dist[i] = packet->data[i].hit.dist;
+		}
+	}
+}
+
+static void bvhtree_ray_cast_batch_cb(void *userdata, const int packet_index)
+{
+	const BVHRayCastBatchData *batch = userdata;
+	const int ray_start = packet_index * BVH_RAY_PACKET_SIZE;
+	const int totray = min_ii(BVH_RAY_PACKET_SIZE, batch->rays_num - ray_start);
+	BVHNode *root = batch->tree->nodes[batch->tree->totleaf];
+	BVHRayCastPacket packet;
+	int i, axis;
+
+	if (root == NULL) {
+		return;
+	}
+
+	for (i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+		/* unused rays of the last packet repeat the first one, so they are never NAN */
+		const int ray_index = ray_start + ((i < totray) ? i : 0);
+		BVHRayCastData *data = &packet.data[i];
+
+		BLI_ASSERT_UNIT_V3(batch->dir[ray_index]);
+
+		data->tree = batch->tree;
+		data->callback = batch->callback;
+		data->userdata = batch->userdata;
+
+		copy_v3_v3(data->ray.origin,    batch->co[ray_index]);
+		copy_v3_v3(data->ray.direction, batch->dir[ray_index]);
+		data->ray.radius = batch->radius;
+
+		bvhtree_ray_cast_data_precalc(data, batch->flag);
+
+		memcpy(&data->hit, &batch->hits[ray_index], sizeof(data->hit));
+
+		for (axis = 0; axis < 3; axis++) {
+			packet.origin[axis][i] = data->ray.origin[axis];
+			packet.idot_axis[axis][i] = data->idot_axis[axis];
+		}
+		packet.hit_dist[i] = data->hit.dist;
+	}
+
+	/* packet bounds test doesn't support a radius (same as #fast_ray_nearest_hit),
+	 * cast these rays one by one */
+	if (batch->radius != 0.0f) {
+		for (i = 0; i < totray; i++) {
+			dfs_raycast(&packet.data[i], root);
+		}
+	}
+	else {
+		dfs_raycast_packet(&packet, root, (1u << totray) - 1);
+	}
+
+	for (i = 0; i < totray; i++) {
+		memcpy(&batch->hits[ray_start + i], &packet.data[i].hit, sizeof(packet.data[i].hit));
+	}
+}
+
+/**
+ * Cast many rays, giving the same results as calling #BLI_bvhtree_ray_cast_ex for each ray.
+ *
+ * \param hits: Array of \a rays_num hits, initialized by the caller as for a single ray cast:
+ * the index is left untouched when nothing is hit, and the distance limits the cast.
+ *
+ * \note The callback is called from multiple threads at once.
+ */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], const int rays_num, float radius,
+        BVHTreeRayHit *hits,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHRayCastBatchData batch = {
+		.tree = tree, .co = co, .dir = dir, .rays_num = rays_num, .radius = radius,
+		.hits = hits, .callback = callback, .userdata = userdata, .flag = flag,
+	};
+	const int packets_num = (rays_num + BVH_RAY_PACKET_SIZE - 1) / BVH_RAY_PACKET_SIZE;
+
+	BLI_task_parallel_range(
+	        0, packets_num, &batch, bvhtree_ray_cast_batch_cb,
+	        rays_num > KDOPBVH_THREAD_RAY_THRESHOLD);
+}
+
+/** \} */
+
+
 /* -------------------------------------------------------------------- */
 
 /** \name BLI_bvhtree_find_nearest_to_ray functions
@@ -0,0 +1,635 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/BLI_kdtree_bucket.c
+ *  \ingroup bli
+ *
+ * Unlike #KDTree which stores one point per node, internal nodes only hold a split plane,
+ * and leaves hold up to #KD_BUCKET_SIZE points. Leaf coordinates are stored per axis in
+ * fixed size buckets, so the distances to all points of a leaf are computed by a single
+ * loop of constant length the compiler can vectorize.
+ *
+ * Nodes are stored depth first, the left child directly follows its parent.
+ * Since points are split at the median, the size of each subtree is known in advance
+ * and large subtrees are balanced as separate tasks.
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math.h"
+#include "BLI_kdtree.h"
+#include "BLI_kdtree_bucket.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+#include "BLI_strict_flags.h"
+
+#define KD_BUCKET_SIZE 8
+
+#define KD_BUCKET_LEAF ((unsigned int)-1)
+
+/* Subtrees with more points are balanced as a separate task. */
+#define KD_BUCKET_PARALLEL_BALANCE_MIN 10000
+/* Minimum number of points for batched queries to use threads. */
+#define KD_BUCKET_PARALLEL_QUERY_MIN 1000
+
+/* Tree depth is at most 32, range search pushes up to two nodes per level. */
+#define KD_BUCKET_STACK_SIZE 64
+
+typedef struct KDTreeBucketPoint {
+	float co[3];
+	int index;
+} KDTreeBucketPoint;
+
+typedef struct KDTreeBucketNode {
+	unsigned int axis;  /* split axis (0-2), #KD_BUCKET_LEAF for leaves */
+	float split;        /* left points are <= split, right points >= split */
+	unsigned int right;
+	/* leaves only */
+	unsigned int bucket, totpoint;
+} KDTreeBucketNode;
+
+struct KDTreeBucket {
+	KDTreeBucketPoint *points;  /* reordered on balance */
+	unsigned int totpoint;
+	unsigned int maxsize;
+
+	KDTreeBucketNode *nodes;
+	unsigned int totnode;
+
+	/* leaf points, #KD_BUCKET_SIZE per leaf */
+	float *bucket_co[3];
+	int *bucket_index;
+#ifdef DEBUG
+	bool is_balanced;  /* ensure we call balance first */
+#endif
+};
+
+typedef struct KDTreeBucketStack {
+	unsigned int node;
+	float dist_sq;
+} KDTreeBucketStack;
+
+/**
+ * Creates or free a kdtree
+ */
+KDTreeBucket *BLI_kdtree_bucket_new(unsigned int maxsize)
+{
+	KDTreeBucket *tree;
+
+	tree = MEM_callocN(sizeof(KDTreeBucket), "KDTreeBucket");
+	tree->points = MEM_mallocN(sizeof(KDTreeBucketPoint) * maxsize, "KDTreeBucketPoint");
+	tree->maxsize = maxsize;
+
+	return tree;
+}
+
+static void kdtree_bucket_free_nodes(KDTreeBucket *tree)
+{
+	MEM_SAFE_FREE(tree->nodes);
+	MEM_SAFE_FREE(tree->bucket_co[0]);
+	MEM_SAFE_FREE(tree->bucket_co[1]);
+	MEM_SAFE_FREE(tree->bucket_co[2]);
+	MEM_SAFE_FREE(tree->bucket_index);
+	tree->totnode = 0;
+}
+
+void BLI_kdtree_bucket_free(KDTreeBucket *tree)
+{
+	if (tree) {
+		kdtree_bucket_free_nodes(tree);
+		MEM_freeN(tree->points);
+		MEM_freeN(tree);
+	}
+}
+
+/**
+ * Construction: first insert points, then call balance.
+ */
+void BLI_kdtree_bucket_insert(KDTreeBucket *tree, int index, const float co[3])
+{
+	KDTreeBucketPoint *point = &tree->points[tree->totpoint++];
+
+	BLI_assert(tree->totpoint <= tree->maxsize);
+
+	copy_v3_v3(point->co, co);
+	point->index = index;
+
+#ifdef DEBUG
+	tree->is_balanced = false;
+#endif
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Balancing
+ * \{ */
+
+static unsigned int kdtree_bucket_node_count(const unsigned int totpoint)
+{
+	if (totpoint <= KD_BUCKET_SIZE) {
+		return 1;
+	}
+	else {
+		const unsigned int median = totpoint / 2;
+		return 1 + kdtree_bucket_node_count(median) + kdtree_bucket_node_count(totpoint - median);
+	}
+}
+
+/**
+ * Reorder \a points so the one at \a nth is where it would be if they were sorted along \a axis,
+ * with all points before it smaller or equal, all points after it larger or equal.
+ */
+static void kdtree_bucket_select(KDTreeBucketPoint *points, const int totpoint, const int nth, const unsigned int axis)
+{
+	int left = 0, right = totpoint - 1;
+
+	while (left < right) {
+		const float pivot = points[(left + right) / 2].co[axis];
+		int i = left, j = right;
+
+		while (i <= j) {
+			while (points[i].co[axis] < pivot) i++;
+			while (points[j].co[axis] > pivot) j--;
+
+			if (i <= j) {
+				SWAP(KDTreeBucketPoint, points[i], points[j]);
+				i++;
+				j--;
+			}
+		}
+
+		if (nth <= j) {
+			right = j;
+		}
+		else if (nth >= i) {
+			left = i;
+		}
+		else {
+			break;
+		}
+	}
+}
+
+static void kdtree_bucket_balance_leaf(
+        KDTreeBucket *tree, KDTreeBucketNode *node,
+        const unsigned int start, const unsigned int totpoint, const unsigned int bucket)
+{
+	const unsigned int bucket_start = bucket * KD_BUCKET_SIZE;
+	unsigned int i;
+
+	node->axis = KD_BUCKET_LEAF;
+	node->split = 0.0f;
+	node->right = KD_BUCKET_LEAF;
+	node->bucket = bucket;
+	node->totpoint = totpoint;
+
+	for (i = 0; i < KD_BUCKET_SIZE; i++) {
+		/* Pad with the last point, distances to padding are computed but never used. */
+		const KDTreeBucketPoint *point = &tree->points[start + MIN2(i, totpoint - 1)];
+
+		tree->bucket_co[0][bucket_start + i] = point->co[0];
+		tree->bucket_co[1][bucket_start + i] = point->co[1];
+		tree->bucket_co[2][bucket_start + i] = point->co[2];
+		tree->bucket_index[bucket_start + i] = (i < totpoint) ? point->index : -1;
+	}
+}
+
+typedef struct KDTreeBucketBalanceTask {
+	unsigned int node, start, totpoint, bucket;
+	float bounds[2][3];
+} KDTreeBucketBalanceTask;
+
+static void kdtree_bucket_balance_task(TaskPool *__restrict pool, void *taskdata, int threadid);
+
+/**
+ * Balance the subtree of points \a start to \a start + \a totpoint, into nodes starting at \a node_index.
+ *
+ * \param bounds: Cell of the subtree, used to split along the longest axis.
+ * \param pool: When not NULL, split off large subtrees as tasks.
+ */
+static void kdtree_bucket_balance_ex(
+        KDTreeBucket *tree, unsigned int node_index, unsigned int start, unsigned int totpoint,
+        unsigned int bucket, float bounds[2][3],
+        TaskPool *pool, const int threadid)
+{
+	while (totpoint > KD_BUCKET_SIZE) {
+		KDTreeBucketNode *node = &tree->nodes[node_index];
+		const unsigned int median = totpoint / 2;
+		const unsigned int left_totnode = kdtree_bucket_node_count(median);
+		float bounds_right[2][3];
+		float size[3];
+
+		sub_v3_v3v3(size, bounds[1], bounds[0]);
+		node->axis = (unsigned int)axis_dominant_v3_single(size);
+
+		kdtree_bucket_select(&tree->points[start], (int)totpoint, (int)median, node->axis);
+
+		node->split = tree->points[start + median].co[node->axis];
+		node->right = node_index + 1 + left_totnode;
+		node->bucket = node->totpoint = 0;
+
+		memcpy(bounds_right, bounds, sizeof(bounds_right));
+		bounds_right[0][node->axis] = node->split;
+		bounds[1][node->axis] = node->split;
+
+		if (pool && (totpoint - median > KD_BUCKET_PARALLEL_BALANCE_MIN)) {
+			KDTreeBucketBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+
+			task->node = node->right;
+			task->start = start + median;
+			task->totpoint = totpoint - median;
+			task->bucket = bucket + (left_totnode + 1) / 2;
+			memcpy(task->bounds, bounds_right, sizeof(task->bounds));
+
+			BLI_task_pool_push_from_thread(
+			        pool, kdtree_bucket_balance_task, task, true, TASK_PRIORITY_LOW, threadid);
+		}
+		else {
+			kdtree_bucket_balance_ex(
+			        tree, node->right, start + median, totpoint - median,
+			        bucket + (left_totnode + 1) / 2, bounds_right, NULL, threadid);
+		}
+
+		/* Continue with the left child, directly following its parent. */
+		node_index += 1;
+		totpoint = median;
+
+		if (pool && (totpoint <= KD_BUCKET_PARALLEL_BALANCE_MIN)) {
+			pool = NULL;
+		}
+	}
+
+	kdtree_bucket_balance_leaf(tree, &tree->nodes[node_index], start, totpoint, bucket);
+}
+
+static void kdtree_bucket_balance_task(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	KDTreeBucket *tree = BLI_task_pool_userdata(pool);
+	KDTreeBucketBalanceTask *task = taskdata;
+
+	kdtree_bucket_balance_ex(
+	        tree, task->node, task->start, task->totpoint, task->bucket, task->bounds,
+	        pool, threadid);
+}
+
+void BLI_kdtree_bucket_balance(KDTreeBucket *tree)
+{
+	unsigned int totbucket;
+	float bounds[2][3];
+	unsigned int i;
+
+	kdtree_bucket_free_nodes(tree);
+
+#ifdef DEBUG
+	tree->is_balanced = true;
+#endif
+
+	if (tree->totpoint == 0) {
+		return;
+	}
+
+	tree->totnode = kdtree_bucket_node_count(tree->totpoint);
+	totbucket = (tree->totnode + 1) / 2;
+
+	tree->nodes = MEM_mallocN(sizeof(KDTreeBucketNode) * tree->totnode, "KDTreeBucketNode");
+	for (i = 0; i < 3; i++) {
+		tree->bucket_co[i] = MEM_mallocN(sizeof(float) * totbucket * KD_BUCKET_SIZE, "KDTreeBucket.co");
+	}
+	tree->bucket_index = MEM_mallocN(sizeof(int) * totbucket * KD_BUCKET_SIZE, "KDTreeBucket.index");
+
+	INIT_MINMAX(bounds[0], bounds[1]);
+	for (i = 0; i < tree->totpoint; i++) {
+		minmax_v3v3_v3(bounds[0], bounds[1], tree->points[i].co);
+	}
+
+	if (tree->totpoint > KD_BUCKET_PARALLEL_BALANCE_MIN) {
+		TaskScheduler *scheduler = BLI_task_scheduler_get();
+		TaskPool *pool = BLI_task_pool_create(scheduler, tree);
+		KDTreeBucketBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+
+		task->node = 0;
+		task->start = 0;
+		task->totpoint = tree->totpoint;
+		task->bucket = 0;
+		memcpy(task->bounds, bounds, sizeof(task->bounds));
+
+		BLI_task_pool_push(pool, kdtree_bucket_balance_task, task, true, TASK_PRIORITY_HIGH);
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+	}
+	else {
+		kdtree_bucket_balance_ex(tree, 0, 0, tree->totpoint, 0, bounds, NULL, 0);
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Queries
+ * \{ */
+
+/**
+ * Squared distances from \a co to all points of a leaf, padding included.
+ */
+BLI_INLINE void kdtree_bucket_leaf_dist_sq(
+        const KDTreeBucket *tree, const KDTreeBucketNode *node, const float co[3],
+        float r_dist_sq[KD_BUCKET_SIZE])
+{
+	const float *co_x = &tree->bucket_co[0][node->bucket * KD_BUCKET_SIZE];
+	const float *co_y = &tree->bucket_co[1][node->bucket * KD_BUCKET_SIZE];
+	const float *co_z = &tree->bucket_co[2][node->bucket * KD_BUCKET_SIZE];
+	unsigned int i;
+
+	for (i = 0; i < KD_BUCKET_SIZE; i++) {
+		const float dx = co_x[i] - co[0];
+		const float dy = co_y[i] - co[1];
+		const float dz = co_z[i] - co[2];
+		r_dist_sq[i] = dx * dx + dy * dy + dz * dz;
+	}
+}
+
+BLI_INLINE void kdtree_bucket_nearest_set(
+        const KDTreeBucket *tree, const unsigned int bucket_index, const float dist_sq,
+        KDTreeNearest *r_nearest)
+{
+	r_nearest->index = tree->bucket_index[bucket_index];
+	r_nearest->dist = dist_sq;
+	r_nearest->co[0] = tree->bucket_co[0][bucket_index];
+	r_nearest->co[1] = tree->bucket_co[1][bucket_index];
+	r_nearest->co[2] = tree->bucket_co[2][bucket_index];
+}
+
+/**
+ * Find nearest returns index, and -1 if no point is found.
+ */
+int BLI_kdtree_bucket_find_nearest(
+        const KDTreeBucket *tree, const float co[3],
+        KDTreeNearest *r_nearest)
+{
+	const KDTreeBucketNode *nodes = tree->nodes;
+	KDTreeBucketStack stack[KD_BUCKET_STACK_SIZE];
+	unsigned int cur = 0;
+	unsigned int min_index = KD_BUCKET_LEAF;
+	float min_dist = FLT_MAX;
+
+#ifdef DEBUG
+	BLI_assert(tree->is_balanced == true);
+#endif
+
+	if (UNLIKELY(tree->totnode == 0)) {
+		return -1;
+	}
+
+	stack[cur].node = 0;
+	stack[cur++].dist_sq = 0.0f;
+
+	while (cur--) {
+		unsigned int node_index = stack[cur].node;
+		const KDTreeBucketNode *node;
+		float dist_sq[KD_BUCKET_SIZE];
+		unsigned int i;
+
+		if (stack[cur].dist_sq >= min_dist) {
+			continue;
+		}
+
+		/* Walk down to the leaf containing co, keeping the far sides for later. */
+		node = &nodes[node_index];
+		while (node->axis != KD_BUCKET_LEAF) {
+			const float dist_plane = co[node->axis] - node->split;
+
+			BLI_assert(cur < KD_BUCKET_STACK_SIZE);
+			stack[cur].dist_sq = dist_plane * dist_plane;
+
+			if (dist_plane < 0.0f) {
+				stack[cur++].node = node->right;
+				node_index += 1;
+			}
+			else {
+				stack[cur++].node = node_index + 1;
+				node_index = node->right;
+			}
+			node = &nodes[node_index];
+		}
+
+		kdtree_bucket_leaf_dist_sq(tree, node, co, dist_sq);
+
+		for (i = 0; i < node->totpoint; i++) {
+			if (dist_sq[i] < min_dist) {
+				min_dist = dist_sq[i];
+				min_index = node->bucket * KD_BUCKET_SIZE + i;
+			}
+		}
+	}
+
+	if (r_nearest) {
+		kdtree_bucket_nearest_set(tree, min_index, sqrtf(min_dist), r_nearest);
+	}
+
+	return tree->bucket_index[min_index];
+}
+
+static void kdtree_bucket_add_nearest(
+        const KDTreeBucket *tree, KDTreeNearest *ptn, unsigned int *found, const unsigned int n,
+        const unsigned int bucket_index, const float dist_sq)
+{
+	unsigned int i;
+
+	if (*found < n) (*found)++;
+
+	for (i = *found - 1; i > 0; i--) {
+		if (dist_sq >= ptn[i - 1].dist)
+			break;
+		else
+			ptn[i] = ptn[i - 1];
+	}
+
+	kdtree_bucket_nearest_set(tree, bucket_index, dist_sq, &ptn[i]);
+}
+
+/**
+ * Find n nearest returns number of points found, with results in nearest.
+ *
+ * \param r_nearest  An array of nearest, sized at least \a n.
+ */
+int BLI_kdtree_bucket_find_nearest_n(
+        const KDTreeBucket *tree, const float co[3],
+        KDTreeNearest r_nearest[],
+        unsigned int n)
+{
+	const KDTreeBucketNode *nodes = tree->nodes;
+	KDTreeBucketStack stack[KD_BUCKET_STACK_SIZE];
+	unsigned int cur = 0;
+	unsigned int i, found = 0;
+
+#ifdef DEBUG
+	BLI_assert(tree->is_balanced == true);
+#endif
+
+	if (UNLIKELY((tree->totnode == 0) || n == 0)) {
+		return 0;
+	}
+
+	stack[cur].node = 0;
+	stack[cur++].dist_sq = 0.0f;
+
+	while (cur--) {
+		unsigned int node_index = stack[cur].node;
+		const KDTreeBucketNode *node;
+		float dist_sq[KD_BUCKET_SIZE];
+
+		if ((found == n) && (stack[cur].dist_sq >= r_nearest[found - 1].dist)) {
+			continue;
+		}
+
+		node = &nodes[node_index];
+		while (node->axis != KD_BUCKET_LEAF) {
+			const float dist_plane = co[node->axis] - node->split;
+
+			BLI_assert(cur < KD_BUCKET_STACK_SIZE);
+			stack[cur].dist_sq = dist_plane * dist_plane;
+
+			if (dist_plane < 0.0f) {
+				stack[cur++].node = node->right;
+				node_index += 1;
+			}
+			else {
+				stack[cur++].node = node_index + 1;
+				node_index = node->right;
+			}
+			node = &nodes[node_index];
+		}
+
+		kdtree_bucket_leaf_dist_sq(tree, node, co, dist_sq);
+
+		for (i = 0; i < node->totpoint; i++) {
+			if ((found < n) || (dist_sq[i] < r_nearest[found - 1].dist)) {
+				kdtree_bucket_add_nearest(tree, r_nearest, &found, n, node->bucket * KD_BUCKET_SIZE + i, dist_sq[i]);
+			}
+		}
+	}
+
+	for (i = 0; i < found; i++) {
+		r_nearest[i].dist = sqrtf(r_nearest[i].dist);
+	}
+
+	return (int)found;
+}
+
+/**
+ * Run a callback for every point in \a range of \a co.
+ *
+ * \param search_cb: Called for every point found in \a range, false return value performs an early exit.
+ *
+ * \note the order of calls isn't sorted based on distance.
+ */
+void BLI_kdtree_bucket_range_search_cb(
+        const KDTreeBucket *tree, const float co[3], float range,
+        bool (*search_cb)(void *user_data, int index, const float co[3], float dist_sq), void *user_data)
+{
+	const KDTreeBucketNode *nodes = tree->nodes;
+	unsigned int stack[KD_BUCKET_STACK_SIZE];
+	const float range_sq = range * range;
+	unsigned int cur = 0;
+
+#ifdef DEBUG
+	BLI_assert(tree->is_balanced == true);
+#endif
+
+	if (UNLIKELY(tree->totnode == 0)) {
+		return;
+	}
+
+	stack[cur++] = 0;
+
+	while (cur--) {
+		const unsigned int node_index = stack[cur];
+		const KDTreeBucketNode *node = &nodes[node_index];
+
+		if (node->axis != KD_BUCKET_LEAF) {
+			BLI_assert(cur + 2 <= KD_BUCKET_STACK_SIZE);
+
+			if (co[node->axis] - range <= node->split) {
+				stack[cur++] = node_index + 1;
+			}
+			if (co[node->axis] + range >= node->split) {
+				stack[cur++] = node->right;
+			}
+		}
+		else {
+			float dist_sq[KD_BUCKET_SIZE];
+			unsigned int i;
+
+			kdtree_bucket_leaf_dist_sq(tree, node, co, dist_sq);
+
+			for (i = 0; i < node->totpoint; i++) {
+				if (dist_sq[i] <= range_sq) {
+					const unsigned int bucket_index = node->bucket * KD_BUCKET_SIZE + i;
+					const float point_co[3] = {
+					    tree->bucket_co[0][bucket_index],
+					    tree->bucket_co[1][bucket_index],
+					    tree->bucket_co[2][bucket_index],
+					};
+
+					if (search_cb(user_data, tree->bucket_index[bucket_index], point_co, dist_sq[i]) == false) {
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+typedef struct KDTreeBucketBatchData {
+	const KDTreeBucket *tree;
+	const float (*co)[3];
+	KDTreeNearest *r_nearest;
+} KDTreeBucketBatchData;
+
+static void kdtree_bucket_find_nearest_batch_cb(void *userdata, const int iter)
+{
+	KDTreeBucketBatchData *data = userdata;
+	KDTreeNearest *nearest = &data->r_nearest[iter];
+
+	if (BLI_kdtree_bucket_find_nearest(data->tree, data->co[iter], nearest) == -1) {
+		nearest->index = -1;
+		nearest->dist = FLT_MAX;
+		zero_v3(nearest->co);
+	}
+}
+
+/**
+ * Find the nearest point for each of \a co, using threads for large batches.
+ * Points not found (empty tree) have an index of -1.
+ *
+ * \param r_nearest  An array of nearest, sized at least \a co_num.
+ */
+void BLI_kdtree_bucket_find_nearest_batch(
+        const KDTreeBucket *tree, const float (*co)[3], unsigned int co_num,
+        KDTreeNearest *r_nearest)
+{
+	KDTreeBucketBatchData data = {tree, co, r_nearest};
+
+	BLI_task_parallel_range(
+	        0, (int)co_num, &data, kdtree_bucket_find_nearest_batch_cb,
+	        (co_num > KD_BUCKET_PARALLEL_QUERY_MIN));
+}
+
+/** \} */
@@ -36,17 +36,22 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating and freeing from multiple threads
+ *   (between #BLI_mempool_thread_begin and #BLI_mempool_thread_end).
  */
 
 #include <string.h>
 #include <stdlib.h>
 
 #include "BLI_utildefines.h"
+#include "BLI_threads.h"
 
 #include "BLI_mempool.h" /* own include */
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_strict_flags.h"  /* keep last */
 
 #ifdef WITH_MEM_VALGRIND
@@ -118,6 +123,31 @@ typedef struct BLI_mempool_chunk {
 #endif
 } BLI_mempool_chunk;
 
+/**
+ * Per-thread free lists, used between #BLI_mempool_thread_begin and #BLI_mempool_thread_end.
+ *
+ * Allocations are taken from \a free, freed elements are collected in \a freed
+ * and handed back to the other threads in batches of #BLI_mempool.pchunk elements.
+ */
+typedef struct BLI_mempool_thread_cache {
+	BLI_freenode *free;
+	BLI_freenode *freed, *freed_tail;
+	unsigned int totfreed;
+	int totused;  /* allocs minus frees of this thread, may be negative */
+	/* each thread gets its own cache line */
+	char _pad[64 - ((sizeof(void *) * 3) + (sizeof(int) * 2))];
+} BLI_mempool_thread_cache;
+
+typedef struct BLI_mempool_thread {
+	BLI_mempool_thread_cache *cache;
+	unsigned int num_threads;
+	/* (BLI_freenode *) lock-free stack of batches freed by threads,
+	 * only ever emptied as a whole so it can't suffer from ABA. */
+	size_t returned;
+	/* protects #BLI_mempool.chunks and #BLI_mempool.free */
+	SpinLock lock;
+} BLI_mempool_thread;
+
 /**
  * The mempool, stores and tracks memory \a chunks and elements within those chunks \a free.
  */
@@ -139,6 +169,7 @@ struct BLI_mempool {
 #ifdef USE_TOTALLOC
 	unsigned int totalloc;          /* number of elements allocated in total */
 #endif
+	BLI_mempool_thread *thread; /* only set while used from multiple threads */
 };
 
 #define MEMPOOL_ELEM_SIZE_MIN (sizeof(void *) * 2)
@@ -205,23 +236,8 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 	return mpchunk;
 }
 
-/**
- * Initialize a chunk and add into \a pool->chunks
- *
- * \param pool  The pool to add the chunk into.
- * \param mpchunk  The new uninitialized chunk (can be malloc'd)
- * \param lasttail  The last element of the previous chunk
- * (used when building free chunks initially)
- * \return The last chunk,
- */
-static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpchunk,
-                                       BLI_freenode *lasttail)
+static void mempool_chunk_append(BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
 {
-	const unsigned int esize = pool->esize;
-	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
-	unsigned int j;
-
-	/* append */
 	if (pool->chunk_tail) {
 		pool->chunk_tail->next = mpchunk;
 	}
@@ -233,9 +249,21 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpc
 	mpchunk->next = NULL;
 	pool->chunk_tail = mpchunk;
 
-	if (UNLIKELY(pool->free == NULL)) {
-		pool->free = curnode;
-	}
+#ifdef USE_TOTALLOC
+	pool->totalloc += pool->pchunk;
+#endif
+}
+
+/**
+ * Link all elements of \a mpchunk into a free list, starting at the chunk data.
+ *
+ * \return The last element of the list.
+ */
+static BLI_freenode *mempool_chunk_init_free(BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
+{
+	const unsigned int esize = pool->esize;
+	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
+	unsigned int j;
 
 	/* loop through the allocated data, building the pointer structures */
 	j = pool->pchunk;
@@ -258,9 +286,30 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpc
 	curnode = NODE_STEP_PREV(curnode);
 	curnode->next = NULL;
 
-#ifdef USE_TOTALLOC
-	pool->totalloc += pool->pchunk;
-#endif
+	return curnode;
+}
+
+/**
+ * Initialize a chunk and add into \a pool->chunks
+ *
+ * \param pool  The pool to add the chunk into.
+ * \param mpchunk  The new uninitialized chunk (can be malloc'd)
+ * \param lasttail  The last element of the previous chunk
+ * (used when building free chunks initially)
+ * \return The last chunk,
+ */
+static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpchunk,
+                                       BLI_freenode *lasttail)
+{
+	BLI_freenode *curnode;
+
+	mempool_chunk_append(pool, mpchunk);
+
+	if (UNLIKELY(pool->free == NULL)) {
+		pool->free = CHUNK_DATA(mpchunk);
+	}
+
+	curnode = mempool_chunk_init_free(pool, mpchunk);
 
 	/* final pointer in the previously allocated chunk is wrong */
 	if (lasttail) {
@@ -334,6 +383,7 @@ BLI_mempool *BLI_mempool_create(unsigned int esize, unsigned int totelem,
 	pool->totalloc = 0;
 #endif
 	pool->totused = 0;
+	pool->thread = NULL;
 
 	if (totelem) {
 		/* allocate the actual chunks */
@@ -354,6 +404,8 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
 {
 	BLI_freenode *free_pop;
 
+	BLI_assert(pool->thread == NULL);
+
 	if (UNLIKELY(pool->free == NULL)) {
 		/* need to allocate a new chunk */
 		BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -394,6 +446,8 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 {
 	BLI_freenode *newhead = addr;
 
+	BLI_assert(pool->thread == NULL);
+
 #ifndef NDEBUG
 	{
 		BLI_mempool_chunk *chunk;
@@ -472,6 +526,249 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 	}
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Concurrent Access
+ *
+ * Between #BLI_mempool_thread_begin and #BLI_mempool_thread_end each thread allocates from its own cache,
+ * so the common case doesn't touch any shared state.
+ * Elements freed by a thread are returned in batches to a lock-free stack other threads take from,
+ * only taking elements from the pool or adding chunks to it needs a lock.
+ *
+ * \{ */
+
+static void mempool_thread_returned_push(BLI_mempool_thread *thread, BLI_freenode *head, BLI_freenode *tail)
+{
+	size_t returned;
+	do {
+		returned = *(volatile size_t *)&thread->returned;
+		tail->next = (BLI_freenode *)returned;
+	} while (atomic_cas_z(&thread->returned, returned, (size_t)head) != returned);
+}
+
+static BLI_freenode *mempool_thread_returned_pop_all(BLI_mempool_thread *thread)
+{
+	size_t returned;
+	do {
+		returned = *(volatile size_t *)&thread->returned;
+		if (returned == 0) {
+			return NULL;
+		}
+	} while (atomic_cas_z(&thread->returned, returned, 0) != returned);
+	return (BLI_freenode *)returned;
+}
+
+/**
+ * Fill the empty \a cache, from (in order of preference):
+ * elements freed by this thread, elements returned by other threads,
+ * the pools free list and finally a newly allocated chunk.
+ */
+static void mempool_thread_cache_refill(BLI_mempool *pool, BLI_mempool_thread_cache *cache)
+{
+	BLI_mempool_thread *thread = pool->thread;
+	BLI_mempool_chunk *mpchunk;
+
+	BLI_assert(cache->free == NULL);
+
+	if (cache->freed) {
+		cache->free = cache->freed;
+		cache->freed = cache->freed_tail = NULL;
+		cache->totfreed = 0;
+		return;
+	}
+
+	if ((cache->free = mempool_thread_returned_pop_all(thread))) {
+		return;
+	}
+
+	BLI_spin_lock(&thread->lock);
+	if (pool->free) {
+		BLI_freenode *tail = pool->free;
+		unsigned int i;
+		for (i = 1; i < pool->pchunk && tail->next; i++) {
+			tail = tail->next;
+		}
+		cache->free = pool->free;
+		pool->free = tail->next;
+		tail->next = NULL;
+	}
+	BLI_spin_unlock(&thread->lock);
+
+	if (cache->free) {
+		return;
+	}
+
+	/* need to allocate a new chunk, initialize it outside the lock */
+	mpchunk = mempool_chunk_alloc(pool);
+	mempool_chunk_init_free(pool, mpchunk);
+	cache->free = CHUNK_DATA(mpchunk);
+
+	BLI_spin_lock(&thread->lock);
+	mempool_chunk_append(pool, mpchunk);
+	BLI_spin_unlock(&thread->lock);
+}
+
+/**
+ * Prepare \a pool for allocating and freeing from \a num_threads threads at once,
+ * using #BLI_mempool_alloc_thread and #BLI_mempool_free_thread.
+ *
+ * The regular (non-thread) alloc & free functions must not be used until #BLI_mempool_thread_end,
+ * neither can the pool be cleared or iterated over. #BLI_mempool_count is only updated on end.
+ *
+ * \param num_threads: The number of threads, thread id's passed in range from 0 to (num_threads - 1).
+ */
+void BLI_mempool_thread_begin(BLI_mempool *pool, const unsigned int num_threads)
+{
+	BLI_mempool_thread *thread;
+
+	BLI_assert(pool->thread == NULL);
+	BLI_assert(num_threads != 0);
+
+	thread = MEM_mallocN(sizeof(*thread), __func__);
+	thread->cache = MEM_mallocN_aligned(sizeof(*thread->cache) * num_threads, 64, __func__);
+	memset(thread->cache, 0, sizeof(*thread->cache) * num_threads);
+	thread->num_threads = num_threads;
+	thread->returned = 0;
+	BLI_spin_init(&thread->lock);
+
+	pool->thread = thread;
+
+	BLI_begin_threaded_malloc();
+}
+
+/**
+ * Move all elements cached by threads back into the pools free list,
+ * after this the pool can be used as usual again.
+ */
+void BLI_mempool_thread_end(BLI_mempool *pool)
+{
+	BLI_mempool_thread *thread = pool->thread;
+	BLI_freenode *lists[3];
+	int totused = (int)pool->totused;
+	unsigned int i, j;
+
+	BLI_assert(thread != NULL);
+
+	for (i = 0; i < thread->num_threads; i++) {
+		BLI_mempool_thread_cache *cache = &thread->cache[i];
+		totused += cache->totused;
+
+		lists[0] = cache->free;
+		lists[1] = cache->freed;
+		lists[2] = (i == 0) ? mempool_thread_returned_pop_all(thread) : NULL;
+		for (j = 0; j < ARRAY_SIZE(lists); j++) {
+			BLI_freenode *tail = lists[j];
+			if (tail) {
+				while (tail->next) {
+					tail = tail->next;
+				}
+				tail->next = pool->free;
+				pool->free = lists[j];
+			}
+		}
+	}
+
+	BLI_assert(totused >= 0);
+	pool->totused = (unsigned int)totused;
+
+	BLI_spin_end(&thread->lock);
+	MEM_freeN(thread->cache);
+	MEM_freeN(thread);
+	pool->thread = NULL;
+
+	BLI_end_threaded_malloc();
+}
+
+/**
+ * Allocate an element, may only be called by the thread owning \a thread_id.
+ */
+void *BLI_mempool_alloc_thread(BLI_mempool *pool, const int thread_id)
+{
+	BLI_mempool_thread_cache *cache;
+	BLI_freenode *free_pop;
+
+	BLI_assert(pool->thread != NULL);
+	BLI_assert((unsigned int)thread_id < pool->thread->num_threads);
+
+	cache = &pool->thread->cache[thread_id];
+
+	if (UNLIKELY(cache->free == NULL)) {
+		mempool_thread_cache_refill(pool, cache);
+	}
+
+	free_pop = cache->free;
+
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		free_pop->freeword = USEDWORD;
+	}
+
+	cache->free = free_pop->next;
+	cache->totused++;
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
+#endif
+
+	return (void *)free_pop;
+}
+
+void *BLI_mempool_calloc_thread(BLI_mempool *pool, const int thread_id)
+{
+	void *retval = BLI_mempool_alloc_thread(pool, thread_id);
+	memset(retval, 0, (size_t)pool->esize);
+	return retval;
+}
+
+/**
+ * Free an element, which may have been allocated by any thread.
+ *
+ * \note Unlike #BLI_mempool_free, unused chunks are never freed here.
+ */
+void BLI_mempool_free_thread(BLI_mempool *pool, void *addr, const int thread_id)
+{
+	BLI_mempool_thread_cache *cache;
+	BLI_freenode *newhead = addr;
+
+	BLI_assert(pool->thread != NULL);
+	BLI_assert((unsigned int)thread_id < pool->thread->num_threads);
+
+	cache = &pool->thread->cache[thread_id];
+
+#ifndef NDEBUG
+	/* enable for debugging */
+	if (UNLIKELY(mempool_debug_memset)) {
+		memset(addr, 255, pool->esize);
+	}
+#endif
+
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+#ifndef NDEBUG
+		/* this will detect double free's */
+		BLI_assert(newhead->freeword != FREEWORD);
+#endif
+		newhead->freeword = FREEWORD;
+	}
+
+	newhead->next = cache->freed;
+	if (cache->freed == NULL) {
+		cache->freed_tail = newhead;
+	}
+	cache->freed = newhead;
+	cache->totused--;
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+
+	/* let other threads reuse the elements */
+	if (UNLIKELY(++cache->totfreed == pool->pchunk)) {
+		mempool_thread_returned_push(pool->thread, cache->freed, cache->freed_tail);
+		cache->freed = cache->freed_tail = NULL;
+		cache->totfreed = 0;
+	}
+}
+
+/** \} */
+
 int BLI_mempool_count(BLI_mempool *pool)
 {
 	return (int)pool->totused;
@@ -648,6 +945,8 @@ void BLI_mempool_clear_ex(BLI_mempool *pool, const int totelem_reserve)
 	BLI_mempool_chunk *chunks_temp;
 	BLI_freenode *lasttail = NULL;
 
+	BLI_assert(pool->thread == NULL);
+
 #ifdef WITH_MEM_VALGRIND
 	VALGRIND_DESTROY_MEMPOOL(pool);
 	VALGRIND_CREATE_MEMPOOL(pool, 0, false);
@@ -704,6 +1003,8 @@ void BLI_mempool_clear(BLI_mempool *pool)
  */
 void BLI_mempool_destroy(BLI_mempool *pool)
 {
+	BLI_assert(pool->thread == NULL);
+
 	mempool_chunk_free_all(pool->chunks);
 
 #ifdef WITH_MEM_VALGRIND
@@ -139,6 +139,32 @@ struct TaskPool {
 #endif
 };
 
+/* Queue of tasks waiting to be run.
+ *
+ * Every worker thread owns one queue, tasks pushed from inside a task with
+ * BLI_task_pool_push_from_thread() go to the front of the queue of the thread
+ * running that task. The owner pops from the front as well, so the most recent
+ * (and most likely still in cache) task runs first. Idle threads steal from the
+ * back of other threads queues, taking the oldest and usually biggest work.
+ *
+ * Queue 0 is shared and holds the tasks pushed from outside of worker threads,
+ * it keeps the FIFO order with high priority tasks added to the front.
+ *
+ * Each queue has its own spin lock, held only for the few pointer updates of a
+ * push or a pop, so threads only contend when working on the same queue.
+ *
+ * A lock-free Chase-Lev deque only supports taking tasks from its ends, but a
+ * pop here may skip tasks: work_and_wait only runs tasks of its own pool, and
+ * pools limit their number of running threads. Canceling a pool also removes
+ * its tasks from the middle of the queues.
+ */
+typedef struct TaskQueue {
+	ListBase tasks;
+	/* Read without lock to skip empty queues quickly. */
+	volatile int num_tasks;
+	SpinLock lock;
+} TaskQueue;
+
 struct TaskScheduler {
 	pthread_t *threads;
 	struct TaskThread *task_threads;
@@ -146,9 +172,14 @@ struct TaskScheduler {
 	int num_threads;
 	bool background_thread_only;
 
-	ListBase queue;
-	ThreadMutex queue_mutex;
-	ThreadCondition queue_cond;
+	/* num_threads + 1 queues, see TaskQueue. */
+	TaskQueue *queues;
+
+	/* Incremented on every push, used by threads going to sleep to detect work
+	 * which was pushed after they looked for it. */
+	size_t num_pushes;
+	/* Number of worker threads waiting for work. */
+	size_t num_sleeping;
 
 	volatile bool do_exit;
 };
@@ -156,6 +187,12 @@ struct TaskScheduler {
 typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
+
+	/* Idle threads wait on their own condition, so a push wakes up exactly one
+	 * of them instead of all threads competing for a single mutex. */
+	ThreadMutex sleep_mutex;
+	ThreadCondition sleep_cond;
+	volatile bool is_sleeping;
 } TaskThread;
 
 /* Helper */
@@ -256,61 +293,163 @@ static void task_pool_num_increase(TaskPool *pool)
 	BLI_mutex_unlock(&pool->num_mutex);
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+/* Check whether a task of task_pool may run now, and if so count it as running.
+ * When pool is given only tasks from that pool are accepted. */
+static bool task_scheduler_task_acquire(TaskScheduler *scheduler, TaskPool *task_pool, TaskPool *pool)
 {
-	bool found_task = false;
-	BLI_mutex_lock(&scheduler->queue_mutex);
-
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-
-	do {
-		Task *current_task;
-
-		/* Assuming we can only have a void queue in 'exit' case here seems logical (we should only be here after
-		 * our worker thread has been woken up from a condition_wait(), which only happens after a new task was
-		 * added to the queue), but it is wrong.
-		 * Waiting on condition may wake up the thread even if condition is not signaled (spurious wake-ups), and some
-		 * race condition may also empty the queue **after** condition has been signaled, but **before** awoken thread
-		 * reaches this point...
-		 * See http://stackoverflow.com/questions/8594591
-		 *
-		 * So we only abort here if do_exit is set.
-		 */
-		if (scheduler->do_exit) {
-			BLI_mutex_unlock(&scheduler->queue_mutex);
+	if (pool != NULL) {
+		/* Find task from this pool only. If we get a task from another pool,
+		 * we can get into deadlock. */
+		if (task_pool != pool) {
 			return false;
 		}
+	}
+	else if (scheduler->background_thread_only && !task_pool->run_in_background) {
+		return false;
+	}
 
-		for (current_task = scheduler->queue.first;
-		     current_task != NULL;
-		     current_task = current_task->next)
-		{
-			TaskPool *pool = current_task->pool;
+	if (atomic_add_z(&task_pool->currently_running_tasks, 1) <= task_pool->num_threads ||
+	    task_pool->num_threads == 0)
+	{
+		return true;
+	}
 
-			if (scheduler->background_thread_only && !pool->run_in_background) {
-				continue;
-			}
+	atomic_sub_z(&task_pool->currently_running_tasks, 1);
+	return false;
+}
 
-			if (atomic_add_z(&pool->currently_running_tasks, 1) <= pool->num_threads ||
-			    pool->num_threads == 0)
-			{
-				*task = current_task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, *task);
-				break;
-			}
-			else {
-				atomic_sub_z(&pool->currently_running_tasks, 1);
-			}
+static Task *task_queue_pop(TaskScheduler *scheduler, TaskQueue *queue, TaskPool *pool, const bool from_back)
+{
+	Task *task;
+
+	if (queue->num_tasks == 0) {
+		return NULL;
+	}
+
+	BLI_spin_lock(&queue->lock);
+
+	for (task = (from_back) ? queue->tasks.last : queue->tasks.first;
+	     task != NULL;
+	     task = (from_back) ? task->prev : task->next)
+	{
+		if (task_scheduler_task_acquire(scheduler, task->pool, pool)) {
+			BLI_remlink(&queue->tasks, task);
+			queue->num_tasks--;
+			break;
 		}
-		if (!found_task)
-			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-	} while (!found_task);
+	}
 
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	BLI_spin_unlock(&queue->lock);
 
-	return true;
+	return task;
+}
+
+/* Find a task for the given thread: own queue first, then the shared queue,
+ * then steal from the other threads. */
+static Task *task_scheduler_pop(TaskScheduler *scheduler, const int thread_id, TaskPool *pool)
+{
+	const int num_queues = scheduler->num_threads + 1;
+	Task *task;
+	int i;
+
+	if (thread_id != 0) {
+		task = task_queue_pop(scheduler, &scheduler->queues[thread_id], pool, false);
+		if (task != NULL) {
+			return task;
+		}
+	}
+
+	task = task_queue_pop(scheduler, &scheduler->queues[0], pool, false);
+	if (task != NULL) {
+		return task;
+	}
+
+	/* Start with the next thread, so stealing threads spread over the victims. */
+	for (i = 1; i < num_queues; i++) {
+		const int victim = (thread_id + i) % num_queues;
+
+		if (victim == 0 || victim == thread_id) {
+			continue;
+		}
+
+		task = task_queue_pop(scheduler, &scheduler->queues[victim], pool, true);
+		if (task != NULL) {
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+static void task_scheduler_thread_sleep(TaskScheduler *scheduler, TaskThread *thread, const size_t num_pushes)
+{
+	BLI_mutex_lock(&thread->sleep_mutex);
+
+	thread->is_sleeping = true;
+	atomic_add_z(&scheduler->num_sleeping, 1);
+
+	/* Both counters are changed with full barriers: a push which happened after we
+	 * started looking for work either shows up in num_pushes here, or the pushing
+	 * thread sees us sleeping and wakes us up. */
+	if (atomic_add_z(&scheduler->num_pushes, 0) == num_pushes) {
+		/* Spurious wake-ups are possible, so only stop waiting once we were
+		 * explicitly woken up. */
+		while (thread->is_sleeping && !scheduler->do_exit) {
+			BLI_condition_wait(&thread->sleep_cond, &thread->sleep_mutex);
+		}
+	}
+
+	thread->is_sleeping = false;
+	atomic_sub_z(&scheduler->num_sleeping, 1);
+
+	BLI_mutex_unlock(&thread->sleep_mutex);
+}
+
+/* Wake up a single sleeping worker thread, if any, starting with the thread
+ * after the pushing one. */
+static void task_scheduler_wake_one(TaskScheduler *scheduler, const int thread_id)
+{
+	const int start = (thread_id > 0) ? thread_id : 0;
+	int i;
+
+	if (atomic_add_z(&scheduler->num_sleeping, 0) == 0) {
+		return;
+	}
+
+	for (i = 0; i < scheduler->num_threads; i++) {
+		TaskThread *thread = &scheduler->task_threads[(start + i) % scheduler->num_threads];
+
+		if (!thread->is_sleeping) {
+			continue;
+		}
+
+		BLI_mutex_lock(&thread->sleep_mutex);
+		if (thread->is_sleeping) {
+			thread->is_sleeping = false;
+			BLI_condition_notify_one(&thread->sleep_cond);
+			BLI_mutex_unlock(&thread->sleep_mutex);
+			return;
+		}
+		BLI_mutex_unlock(&thread->sleep_mutex);
+	}
+}
+
+static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, TaskThread *thread, Task **task)
+{
+	while (!scheduler->do_exit) {
+		/* Remember the push counter before looking for work, so pushes done
+		 * while we were looking are not missed when going to sleep. */
+		const size_t num_pushes = atomic_add_z(&scheduler->num_pushes, 0);
+
+		*task = task_scheduler_pop(scheduler, thread->id, NULL);
+		if (*task != NULL) {
+			return true;
+		}
+
+		task_scheduler_thread_sleep(scheduler, thread, num_pushes);
+	}
+
+	return false;
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
@@ -321,7 +460,7 @@ static void *task_scheduler_thread_run(void *thread_p)
 	Task *task;
 
 	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
+	while (task_scheduler_thread_wait_pop(scheduler, thread, &task)) {
 		TaskPool *pool = task->pool;
 
 		/* run task */
@@ -345,10 +484,6 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	 * threads, so we keep track of the number of users. */
 	scheduler->do_exit = false;
 
-	BLI_listbase_clear(&scheduler->queue);
-	BLI_mutex_init(&scheduler->queue_mutex);
-	BLI_condition_init(&scheduler->queue_cond);
-
 	if (num_threads == 0) {
 		/* automatic number of threads will be main thread + num cores */
 		num_threads = BLI_system_thread_count();
@@ -363,6 +498,12 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	    num_threads = 1;
 	}
 
+	/* Threads start looking for work right away, queues must be ready. */
+	scheduler->queues = MEM_callocN(sizeof(TaskQueue) * (max_ii(num_threads, 0) + 1), "TaskScheduler queues");
+	for (int i = 0; i < max_ii(num_threads, 0) + 1; i++) {
+		BLI_spin_init(&scheduler->queues[i].lock);
+	}
+
 	/* launch threads that will be waiting for work */
 	if (num_threads > 0) {
 		int i;
@@ -375,6 +516,12 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 			TaskThread *thread = &scheduler->task_threads[i];
 			thread->scheduler = scheduler;
 			thread->id = i + 1;
+			BLI_mutex_init(&thread->sleep_mutex);
+			BLI_condition_init(&thread->sleep_cond);
+		}
+
+		for (i = 0; i < num_threads; i++) {
+			TaskThread *thread = &scheduler->task_threads[i];
 
 			if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
 				fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
@@ -393,10 +540,14 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 	Task *task;
 
 	/* stop all waiting threads */
-	BLI_mutex_lock(&scheduler->queue_mutex);
 	scheduler->do_exit = true;
-	BLI_condition_notify_all(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	for (int i = 0; i < scheduler->num_threads; i++) {
+		TaskThread *thread = &scheduler->task_threads[i];
+
+		BLI_mutex_lock(&thread->sleep_mutex);
+		BLI_condition_notify_one(&thread->sleep_cond);
+		BLI_mutex_unlock(&thread->sleep_mutex);
+	}
 
 	/* delete threads */
 	if (scheduler->threads) {
@@ -412,6 +563,10 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 
 	/* Delete task thread data */
 	if (scheduler->task_threads) {
+		for (int i = 0; i < scheduler->num_threads; i++) {
+			BLI_mutex_end(&scheduler->task_threads[i].sleep_mutex);
+			BLI_condition_end(&scheduler->task_threads[i].sleep_cond);
+		}
 		MEM_freeN(scheduler->task_threads);
 	}
 
@@ -426,14 +581,17 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 	}
 
 	/* delete leftover tasks */
-	for (task = scheduler->queue.first; task; task = task->next) {
-		task_data_free(task, 0);
-	}
-	BLI_freelistN(&scheduler->queue);
+	for (int i = 0; i <= scheduler->num_threads; i++) {
+		TaskQueue *queue = &scheduler->queues[i];
 
-	/* delete mutex/condition */
-	BLI_mutex_end(&scheduler->queue_mutex);
-	BLI_condition_end(&scheduler->queue_cond);
+		for (task = queue->tasks.first; task; task = task->next) {
+			task_data_free(task, 0);
+		}
+		BLI_freelistN(&queue->tasks);
+
+		BLI_spin_end(&queue->lock);
+	}
+	MEM_freeN(scheduler->queues);
 
 	MEM_freeN(scheduler);
 }
@@ -443,20 +601,38 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 	return scheduler->num_threads + 1;
 }
 
-static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
+static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority, const int thread_id)
 {
+	TaskQueue *queue;
+
+	BLI_assert(thread_id <= scheduler->num_threads);
+
 	task_pool_num_increase(task->pool);
 
 	/* add task to queue */
-	BLI_mutex_lock(&scheduler->queue_mutex);
-
-	if (priority == TASK_PRIORITY_HIGH)
-		BLI_addhead(&scheduler->queue, task);
-	else
-		BLI_addtail(&scheduler->queue, task);
+	if (thread_id > 0) {
+		/* Pushed from inside a task, LIFO on the queue of the running thread. */
+		queue = &scheduler->queues[thread_id];
+
+		BLI_spin_lock(&queue->lock);
+		BLI_addhead(&queue->tasks, task);
+		queue->num_tasks++;
+		BLI_spin_unlock(&queue->lock);
+	}
+	else {
+		queue = &scheduler->queues[0];
+
+		BLI_spin_lock(&queue->lock);
+		if (priority == TASK_PRIORITY_HIGH)
+			BLI_addhead(&queue->tasks, task);
+		else
+			BLI_addtail(&queue->tasks, task);
+		queue->num_tasks++;
+		BLI_spin_unlock(&queue->lock);
+	}
 
-	BLI_condition_notify_one(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	atomic_add_z(&scheduler->num_pushes, 1);
+	task_scheduler_wake_one(scheduler, thread_id);
 }
 
 static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
@@ -464,21 +640,26 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 	Task *task, *nexttask;
 	size_t done = 0;
 
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	/* free all tasks from this pool from the queues */
+	for (int i = 0; i <= scheduler->num_threads; i++) {
+		TaskQueue *queue = &scheduler->queues[i];
 
-	/* free all tasks from this pool from the queue */
-	for (task = scheduler->queue.first; task; task = nexttask) {
-		nexttask = task->next;
+		BLI_spin_lock(&queue->lock);
 
-		if (task->pool == pool) {
-			task_data_free(task, 0);
-			BLI_freelinkN(&scheduler->queue, task);
+		for (task = queue->tasks.first; task; task = nexttask) {
+			nexttask = task->next;
+
+			if (task->pool == pool) {
+				task_data_free(task, 0);
+				BLI_freelinkN(&queue->tasks, task);
+				queue->num_tasks--;
 
-			done++;
+				done++;
+			}
 		}
-	}
 
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+		BLI_spin_unlock(&queue->lock);
+	}
 
 	/* notify done */
 	task_pool_num_decrease(pool, done);
@@ -612,7 +793,7 @@ static void task_pool_push(
 	task->freedata = freedata;
 	task->pool = pool;
 
-	task_scheduler_push(pool->scheduler, task, priority);
+	task_scheduler_push(pool->scheduler, task, priority, thread_id);
 }
 
 void BLI_task_pool_push_ex(
@@ -641,39 +822,22 @@ void BLI_task_pool_work_and_wait(TaskPool *pool)
 	BLI_mutex_lock(&pool->num_mutex);
 
 	while (pool->num != 0) {
-		Task *task, *work_task = NULL;
-		bool found_task = false;
+		Task *work_task;
+		bool found_task;
 
 		BLI_mutex_unlock(&pool->num_mutex);
 
-		BLI_mutex_lock(&scheduler->queue_mutex);
-
-		/* find task from this pool. if we get a task from another pool,
-		 * we can get into deadlock */
-
-		if (pool->num_threads == 0 ||
-		    pool->currently_running_tasks < pool->num_threads)
-		{
-			for (task = scheduler->queue.first; task; task = task->next) {
-				if (task->pool == pool) {
-					work_task = task;
-					found_task = true;
-					BLI_remlink(&scheduler->queue, task);
-					break;
-				}
-			}
-		}
-
-		BLI_mutex_unlock(&scheduler->queue_mutex);
+		/* find task from this pool, from any of the queues */
+		work_task = task_scheduler_pop(scheduler, 0, pool);
+		found_task = (work_task != NULL);
 
 		/* if found task, do it, otherwise wait until other tasks are done */
 		if (found_task) {
 			/* run task */
-			atomic_add_z(&pool->currently_running_tasks, 1);
 			work_task->run(pool, work_task->taskdata, 0);
 
 			/* delete task */
-			task_free(pool, task, 0);
+			task_free(pool, work_task, 0);
 
 			/* notify pool task was done */
 			task_pool_num_decrease(pool, 1);
@@ -45,6 +45,8 @@
 #include "BLI_utildefines.h"
 #ifndef WIN32
 #  include <unistd.h> // for read close
+#  include <sys/mman.h> // for mmap
+#  include <sys/stat.h> // for fstat
 #else
 #  include <io.h> // for open close read
 #  include "winsock2.h"
@@ -215,6 +217,13 @@
 /* use GHash for BHead name-based lookups (speeds up linking) */
 #define USE_GHASH_BHEAD
 
+/* Map uncompressed files with native pointer size and endianness, using their blocks in place
+ * (avoids reading the whole file into separately allocated BHeadN's).
+ * Blocks are only 4 byte aligned in the file, so this relies on unaligned loads of BHead.old. */
+#if !defined(WIN32) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#  define USE_BHEAD_MMAP
+#endif
+
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
@@ -229,8 +238,11 @@ typedef struct OldNew {
 typedef struct OldNewMap {
 	OldNew *entries;
 	int nentries, entriessize;
-	bool sorted;
 	int lasthit;
+	/* open addressing hash of 'entries' indices by old address (-1 for empty slots),
+	 * used when 'lasthit' doesn't point to the next entry */
+	int *map;
+	int map_size_exp;
 } OldNewMap;
 
 
@@ -273,31 +285,59 @@ static const char *library_parent_filepath(Library *lib)
 	return lib->parent ? lib->parent->filepath : "<direct>";
 }
 
-static OldNewMap *oldnewmap_new(void) 
+#define OLDNEWMAP_SIZE_EXP_DEFAULT 11  /* 2048 slots for the initial 1024 entries */
+
+#define OLDNEWMAP_HASH(onm, addr) \
+	((unsigned int)(((uint64_t)(uintptr_t)(addr) * 0x9E3779B97F4A7C15ull) >> (64 - (onm)->map_size_exp)))
+
+#define OLDNEWMAP_SLOT_NEXT(onm, slot) \
+	(((slot) + 1) & ((1u << (onm)->map_size_exp) - 1))
+
+static void oldnewmap_map_clear(OldNewMap *onm)
 {
-	OldNewMap *onm= MEM_callocN(sizeof(*onm), "OldNewMap");
-	
-	onm->entriessize = 1024;
-	onm->entries = MEM_mallocN(sizeof(*onm->entries)*onm->entriessize, "OldNewMap.entries");
-	
-	return onm;
+	memset(onm->map, -1, sizeof(*onm->map) * ((size_t)1 << onm->map_size_exp));
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
+/* newer entries for the same address replace older ones */
+static void oldnewmap_map_insert(OldNewMap *onm, const int index)
 {
-	const struct OldNew *x1=v1, *x2=v2;
-	
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
+	const void *addr = onm->entries[index].old;
+	unsigned int slot = OLDNEWMAP_HASH(onm, addr);
+
+	while (onm->map[slot] != -1) {
+		if (onm->entries[onm->map[slot]].old == addr) {
+			break;
+		}
+		slot = OLDNEWMAP_SLOT_NEXT(onm, slot);
+	}
+	onm->map[slot] = index;
 }
 
+static void oldnewmap_map_resize(OldNewMap *onm, const int map_size_exp)
+{
+	int i;
 
-static void oldnewmap_sort(FileData *fd) 
+	onm->map_size_exp = map_size_exp;
+	onm->map = MEM_reallocN(onm->map, sizeof(*onm->map) * ((size_t)1 << onm->map_size_exp));
+	oldnewmap_map_clear(onm);
+
+	for (i = 0; i < onm->nentries; i++) {
+		oldnewmap_map_insert(onm, i);
+	}
+}
+
+static OldNewMap *oldnewmap_new(void) 
 {
-	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
+	OldNewMap *onm= MEM_callocN(sizeof(*onm), "OldNewMap");
+	
+	onm->entriessize = 1024;
+	onm->entries = MEM_mallocN(sizeof(*onm->entries)*onm->entriessize, "OldNewMap.entries");
+
+	onm->map_size_exp = OLDNEWMAP_SIZE_EXP_DEFAULT;
+	onm->map = MEM_mallocN(sizeof(*onm->map) * ((size_t)1 << onm->map_size_exp), "OldNewMap.map");
+	oldnewmap_map_clear(onm);
+	
+	return onm;
 }
 
 /* nr is zero for data, and ID code for libdata */
@@ -316,6 +356,14 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+
+	/* keep the map at most half full */
+	if (UNLIKELY((onm->nentries * 2) > (1 << onm->map_size_exp))) {
+		oldnewmap_map_resize(onm, onm->map_size_exp + 1);
+	}
+	else {
+		oldnewmap_map_insert(onm, onm->nentries - 1);
+	}
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -324,50 +372,20 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 }
 
 /**
- * Do a full search (no state).
- *
- * \param lasthit: Use as a reference position to avoid a full search
- * from either end of the array, giving more efficient lookups.
+ * Lookup the index of the entry for \a addr in the hash, -1 when not found.
  *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
+ * \note The data is written in-order, so the callers check the entry after 'lasthit' first.
  */
-static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
+static int oldnewmap_lookup_entry(const OldNewMap *onm, const void *addr)
 {
-	const int nentries = onm->nentries;
-	const OldNew *entries = onm->entries;
-	int i;
+	unsigned int slot = OLDNEWMAP_HASH(onm, addr);
+	int index;
 
-	/* search relative to lasthit where possible */
-	if (lasthit >= 0 && lasthit < nentries) {
-
-		/* search forwards */
-		i = lasthit;
-		while (++i != nentries) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-
-		/* search backwards */
-		i = lasthit + 1;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-	}
-	else {
-		/* search backwards (full) */
-		i = nentries;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
+	while ((index = onm->map[slot]) != -1) {
+		if (onm->entries[index].old == addr) {
+			return index;
 		}
+		slot = OLDNEWMAP_SLOT_NEXT(onm, slot);
 	}
 
 	return -1;
@@ -389,7 +407,7 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 		}
 	}
 	
-	i = oldnewmap_lookup_entry_full(onm, addr, onm->lasthit);
+	i = oldnewmap_lookup_entry(onm, addr);
 	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
 		BLI_assert(entry->old == addr);
@@ -405,32 +423,19 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 /* for libdata, nr has ID code, no increment */
 static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *lib)
 {
+	int i;
+
 	if (addr == NULL) {
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		const OldNew entry_s = {.old = addr};
-		OldNew *entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
-
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
-		if (i != -1) {
-			OldNew *entry = &onm->entries[i];
-			ID *id = entry->newp;
-			BLI_assert(entry->old == addr);
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
+	i = oldnewmap_lookup_entry(onm, addr);
+	if (i != -1) {
+		OldNew *entry = &onm->entries[i];
+		ID *id = entry->newp;
+		BLI_assert(entry->old == addr);
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
@@ -454,11 +459,19 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
 	onm->nentries = 0;
 	onm->lasthit = 0;
+
+	if (onm->map_size_exp != OLDNEWMAP_SIZE_EXP_DEFAULT) {
+		oldnewmap_map_resize(onm, OLDNEWMAP_SIZE_EXP_DEFAULT);
+	}
+	else {
+		oldnewmap_map_clear(onm);
+	}
 }
 
 static void oldnewmap_free(OldNewMap *onm) 
 {
 	MEM_freeN(onm->entries);
+	MEM_freeN(onm->map);
 	MEM_freeN(onm);
 }
 
@@ -811,11 +824,73 @@ static BHeadN *get_bhead(FileData *fd)
 	return(new_bhead);
 }
 
+#ifdef USE_BHEAD_MMAP
+
+/**
+ * Blocks of a mapped file are used in place, each one directly follows the data of the previous.
+ *
+ * \return NULL at the end of the file or for blocks which don't fit in it.
+ */
+static BHead *bhead_mmap_from_offset(FileData *fd, const size_t offset)
+{
+	BHead *bhead;
+
+	if (offset + sizeof(BHead) > fd->mmap_size) {
+		return NULL;
+	}
+
+	bhead = POINTER_OFFSET(fd->mmap_mem, offset);
+
+	/* make sure people are not trying to pass bad blend files */
+	if (bhead->len < 0 || (offset + sizeof(BHead) + (size_t)bhead->len > fd->mmap_size)) {
+		return NULL;
+	}
+
+	/* blocks are always visited in file order, store new ones for blo_prevbhead */
+	if (fd->mmap_bheads_len == 0 || bhead > fd->mmap_bheads[fd->mmap_bheads_len - 1]) {
+		if (UNLIKELY(fd->mmap_bheads_len == fd->mmap_bheads_alloc)) {
+			fd->mmap_bheads_alloc *= 2;
+			fd->mmap_bheads = MEM_reallocN(fd->mmap_bheads, sizeof(*fd->mmap_bheads) * fd->mmap_bheads_alloc);
+		}
+		fd->mmap_bheads[fd->mmap_bheads_len++] = bhead;
+	}
+
+	return bhead;
+}
+
+static BHead *bhead_mmap_prev(FileData *fd, BHead *thisblock)
+{
+	/* binary search, blocks are stored in order of their address */
+	unsigned int low = 0, high = fd->mmap_bheads_len;
+
+	while (low < high) {
+		const unsigned int mid = (low + high) / 2;
+		if (fd->mmap_bheads[mid] < thisblock) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	BLI_assert(low < fd->mmap_bheads_len && fd->mmap_bheads[low] == thisblock);
+
+	return (low != 0) ? fd->mmap_bheads[low - 1] : NULL;
+}
+
+#endif  /* USE_BHEAD_MMAP */
+
 BHead *blo_firstbhead(FileData *fd)
 {
 	BHeadN *new_bhead;
 	BHead *bhead = NULL;
 	
+#ifdef USE_BHEAD_MMAP
+	if (fd->mmap_mem) {
+		return bhead_mmap_from_offset(fd, SIZEOFBLENDERHEADER);
+	}
+#endif
+
 	/* Rewind the file
 	 * Read in a new block if necessary
 	 */
@@ -831,10 +906,21 @@ BHead *blo_firstbhead(FileData *fd)
 	return(bhead);
 }
 
-BHead *blo_prevbhead(FileData *UNUSED(fd), BHead *thisblock)
+BHead *blo_prevbhead(FileData *fd, BHead *thisblock)
 {
-	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
-	BHeadN *prev = bheadn->prev;
+	BHeadN *bheadn;
+	BHeadN *prev;
+	
+#ifdef USE_BHEAD_MMAP
+	if (fd->mmap_mem) {
+		return bhead_mmap_prev(fd, thisblock);
+	}
+#else
+	UNUSED_VARS(fd);
+#endif
+
+	bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
+	prev = bheadn->prev;
 	
 	return (prev) ? &prev->bhead : NULL;
 }
@@ -844,6 +930,16 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 	BHeadN *new_bhead = NULL;
 	BHead *bhead = NULL;
 	
+#ifdef USE_BHEAD_MMAP
+	if (fd->mmap_mem) {
+		if (thisblock) {
+			const size_t offset = (size_t)((char *)thisblock - (char *)fd->mmap_mem);
+			bhead = bhead_mmap_from_offset(fd, offset + sizeof(BHead) + (size_t)thisblock->len);
+		}
+		return bhead;
+	}
+#endif
+
 	if (thisblock) {
 		/* bhead is actually a sub part of BHeadN
 		 * We calculate the BHeadN pointer from the BHead pointer below */
@@ -922,7 +1018,10 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
 		if (bhead->code == DNA1) {
 			const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
 			
-			fd->filesdna = DNA_sdna_from_data(&bhead[1], bhead->len, do_endian_swap, true, r_error_message);
+			/* a mapped file stays valid until the SDNA is freed with the FileData */
+			const bool data_alloc = (fd->mmap_mem == NULL);
+			
+			fd->filesdna = DNA_sdna_from_data(&bhead[1], bhead->len, do_endian_swap, data_alloc, r_error_message);
 			if (fd->filesdna) {
 				fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
 				/* used to retrieve ID names from (bhead+1) */
@@ -1115,11 +1214,93 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
+#ifdef USE_BHEAD_MMAP
+
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* only used for the file header, blocks are accessed in place */
+	const size_t readsize = MIN2((size_t)size, filedata->mmap_size - (size_t)filedata->seek);
+	
+	memcpy(buffer, (const char *)filedata->mmap_mem + filedata->seek, readsize);
+	filedata->seek += (int)readsize;
+	
+	return (int)readsize;
+}
+
+/**
+ * Map \a filepath when it's an uncompressed blend file written with our pointer size and endianness.
+ *
+ * The mapping is private (copy on write), since a few blocks are patched while reading.
+ *
+ * \return The FileData with its header decoded, NULL when the file can't be read this way.
+ */
+static FileData *blo_openblenderfile_mmap(const char *filepath)
+{
+	FileData *fd;
+	struct stat st;
+	void *mem;
+	int file;
+	
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+	
+	if (fstat(file, &st) == -1 || st.st_size < SIZEOFBLENDERHEADER) {
+		close(file);
+		return NULL;
+	}
+	
+	mem = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file);
+	
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+	
+	fd = filedata_new();
+	fd->mmap_mem = mem;
+	fd->mmap_size = (size_t)st.st_size;
+	fd->mmap_bheads_alloc = 1024;
+	fd->mmap_bheads = MEM_mallocN(sizeof(*fd->mmap_bheads) * fd->mmap_bheads_alloc, "FileData.mmap_bheads");
+	fd->read = fd_read_from_mmap;
+	
+	decode_blender_header(fd);
+	
+	/* compressed files fail the header check too */
+	if (!(fd->flags & FD_FLAGS_FILE_OK) ||
+	    (fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS)))
+	{
+		blo_freefiledata(fd);
+		return NULL;
+	}
+	
+	/* rewind, callers decode the header as for other files */
+	fd->seek = 0;
+	
+	return fd;
+}
+
+#endif  /* USE_BHEAD_MMAP */
+
 /* cannot be called with relative paths anymore! */
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
 	gzFile gzfile;
+	
+#ifdef USE_BHEAD_MMAP
+	{
+		FileData *fd = blo_openblenderfile_mmap(filepath);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+			
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+#endif
+	
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 	
@@ -1147,6 +1328,17 @@ FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 static FileData *blo_openblenderfile_minimal(const char *filepath)
 {
 	gzFile gzfile;
+
+#ifdef USE_BHEAD_MMAP
+	{
+		FileData *fd = blo_openblenderfile_mmap(filepath);
+		if (fd) {
+			decode_blender_header(fd);
+			return fd;
+		}
+	}
+#endif
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 
@@ -1307,6 +1499,16 @@ void blo_freefiledata(FileData *fd)
 		}
 #endif
 
+#ifdef USE_BHEAD_MMAP
+		/* after freeing 'filesdna', which uses the mapped data */
+		if (fd->mmap_mem) {
+			munmap(fd->mmap_mem, fd->mmap_size);
+		}
+		if (fd->mmap_bheads) {
+			MEM_freeN(fd->mmap_bheads);
+		}
+#endif
+
 		MEM_freeN(fd);
 	}
 }
@@ -1534,9 +1736,6 @@ static void change_idid_adr_fd(FileData *fd, const void *old, void *new)
 {
 	int i;
 	
-	/* use a binary search if we have a sorted libmap, for now it's not needed. */
-	BLI_assert(fd->libmap->sorted == false);
-
 	for (i = 0; i < fd->libmap->nentries; i++) {
 		OldNew *entry = &fd->libmap->entries[i];
 		
@@ -8379,8 +8578,6 @@ static void do_versions_after_linking(FileData *fd, Library *lib, Main *main)
 
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-	
 	/* No load UI for undo memfiles */
 	if (fd->memfile == NULL) {
 		lib_link_windowmanager(fd, main);
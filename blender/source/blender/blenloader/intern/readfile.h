@@ -94,6 +94,14 @@ typedef struct FileData {
 
 	/* see: USE_GHASH_BHEAD */
 	struct GHash *bhead_idname_hash;
+
+	/* memory mapped file, blocks are used in place instead of read into BHeadN's,
+	 * see: USE_BHEAD_MMAP */
+	void *mmap_mem;
+	size_t mmap_size;
+	/* blocks in file order, as far as they have been visited (for blo_prevbhead) */
+	struct BHead **mmap_bheads;
+	unsigned int mmap_bheads_len, mmap_bheads_alloc;
 	
 	ListBase *mainlist;
 	ListBase *old_mainlist;  /* Used for undo. */
@@ -284,11 +284,7 @@ static void bm_edge_update_beauty_cost_single(
 	if (edge_in_array(e, edge_array, edge_array_len)) {
 		const int i = BM_elem_index_get(e);
 		GSet *e_state_set = edge_state_arr[i];
-
-		if (eheap_table[i]) {
-			BLI_heap_remove(eheap, eheap_table[i]);
-			eheap_table[i] = NULL;
-		}
+		float cost;
 
 		/* check if we can add it back */
 		BLI_assert(BM_edge_is_manifold(e) == true);
@@ -299,19 +295,27 @@ static void bm_edge_update_beauty_cost_single(
 			erot_state_alternate(e, &e_state_alt);
 			if (BLI_gset_haskey(e_state_set, (void *)&e_state_alt)) {
 				// printf("  skipping, we already have this state\n");
-				return;
+				goto clear;
 			}
 		}
 
-		{
-			/* recalculate edge */
-			const float cost = bm_edge_calc_rotate_beauty(e, flag, method);
-			if (cost < 0.0f) {
-				eheap_table[i] = BLI_heap_insert(eheap, cost, e);
+		/* recalculate edge */
+		cost = bm_edge_calc_rotate_beauty(e, flag, method);
+		if (cost < 0.0f) {
+			/* update in place when already in the heap */
+			if (eheap_table[i]) {
+				BLI_heap_node_value_update(eheap, eheap_table[i], cost);
 			}
 			else {
-				eheap_table[i] = NULL;
+				eheap_table[i] = BLI_heap_insert(eheap, cost, e);
 			}
+			return;
+		}
+
+clear:
+		if (eheap_table[i]) {
+			BLI_heap_remove(eheap, eheap_table[i]);
+			eheap_table[i] = NULL;
 		}
 	}
 }
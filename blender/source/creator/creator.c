@@ -288,21 +288,49 @@ int main(
 	/* NOTE: Special exception for guarded allocator type switch:
 	 *       we need to perform switch from lock-free to fully
 	 *       guarded allocator before any allocation happened.
+	 *       Thread caches and profiling of the lock-free allocator are set up here too,
+	 *       once the allocator is known, so the order of arguments doesn't matter.
 	 */
 	{
 		int i;
+		bool use_guarded_allocator = false;
+		bool use_thread_cache = false;
+		bool use_profiling = false;
 		for (i = 0; i < argc; i++) {
 			if (STREQ(argv[i], "--debug") || STREQ(argv[i], "-d") ||
 			    STREQ(argv[i], "--debug-memory") || STREQ(argv[i], "--debug-all"))
 			{
-				printf("Switching to fully guarded memory allocator.\n");
-				MEM_use_guarded_allocator();
-				break;
+				use_guarded_allocator = true;
+			}
+			else if (STREQ(argv[i], "--debug-memory-profile")) {
+				use_profiling = true;
+			}
+			else if (STREQ(argv[i], "--enable-memory-thread-cache")) {
+				use_thread_cache = true;
 			}
 			else if (STREQ(argv[i], "--")) {
 				break;
 			}
 		}
+
+		if (use_guarded_allocator) {
+			if (use_profiling) {
+				printf("Error: --debug-memory-profile profiles the lock-free memory allocator, "
+				       "it can't be used with --debug, --debug-memory or --debug-all.\n");
+				exit(1);
+			}
+
+			printf("Switching to fully guarded memory allocator.\n");
+			MEM_use_guarded_allocator();
+		}
+		else {
+			if (use_thread_cache) {
+				MEM_use_thread_cache();
+			}
+			if (use_profiling) {
+				MEM_use_profiling();
+			}
+		}
 	}
 
 #ifdef BUILD_DATE
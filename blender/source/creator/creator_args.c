@@ -546,6 +546,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--debug-cycles");
 #endif
 	BLI_argsPrintArgDoc(ba, "--debug-memory");
+	BLI_argsPrintArgDoc(ba, "--debug-memory-profile");
 	BLI_argsPrintArgDoc(ba, "--debug-jobs");
 	BLI_argsPrintArgDoc(ba, "--debug-python");
 	BLI_argsPrintArgDoc(ba, "--debug-depsgraph");
@@ -593,6 +594,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	printf("Experimental Features:\n");
 	BLI_argsPrintArgDoc(ba, "--enable-new-depsgraph");
 	BLI_argsPrintArgDoc(ba, "--enable-new-basic-shader-glsl");
+	BLI_argsPrintArgDoc(ba, "--enable-memory-thread-cache");
 
 	printf("\n");
 	printf("Argument Parsing:\n");
@@ -802,6 +804,24 @@ static int arg_handle_debug_mode_memory_set(int UNUSED(argc), const char **UNUSE
 	return 0;
 }
 
+static const char arg_handle_debug_mode_memory_profile_set_doc[] =
+"\n\tPrint allocation statistics per block name on exit (not with guarded allocation)"
+;
+static int arg_handle_debug_mode_memory_profile_set(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* handled in main(), so allocations made before parsing arguments are included */
+	return 0;
+}
+
+static const char arg_handle_memory_thread_cache_set_doc[] =
+"\n\tKeep freed small memory blocks in per-thread caches for reuse (not with guarded allocation)"
+;
+static int arg_handle_memory_thread_cache_set(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* handled in main(), before any allocation happened */
+	return 0;
+}
+
 static const char arg_handle_debug_value_set_doc[] =
 "<value>\n"
 "\tSet debug value of <value> on startup\n"
@@ -1815,6 +1835,7 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 	BLI_argsAdd(ba, 1, NULL, "--debug-cycles", CB(arg_handle_debug_mode_cycles), NULL);
 #endif
 	BLI_argsAdd(ba, 1, NULL, "--debug-memory", CB(arg_handle_debug_mode_memory_set), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--debug-memory-profile", CB(arg_handle_debug_mode_memory_profile_set), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--debug-value",
 	            CB(arg_handle_debug_value_set), NULL);
@@ -1831,6 +1852,7 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 
 	BLI_argsAdd(ba, 1, NULL, "--enable-new-depsgraph", CB(arg_handle_depsgraph_use_new), NULL);
 	BLI_argsAdd(ba, 1, NULL, "--enable-new-basic-shader-glsl", CB(arg_handle_basic_shader_glsl_use_new), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--enable-memory-thread-cache", CB(arg_handle_memory_thread_cache_set), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--verbose", CB(arg_handle_verbosity_set), NULL);
 
@@ -198,3 +198,179 @@ TEST(ghash, Pop)
 
 	BLI_ghash_free(ghash, NULL, NULL);
 }
+
+/* Same as above tests, with open addressing storage. */
+TEST(ghash, InsertLookupOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	init_keys(keys, 0);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(TESTCASE_SIZE, BLI_ghash_size(ghash));
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(*k, GET_UINT_FROM_POINTER(v));
+	}
+
+	EXPECT_FALSE(BLI_ghash_haskey(ghash, SET_UINT_IN_POINTER(keys[0] + 1)));
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, InsertRemoveShrinkOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i, bkt_size;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK | GHASH_FLAG_OPEN_ADDRESSING);
+	init_keys(keys, 20);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(TESTCASE_SIZE, BLI_ghash_size(ghash));
+	bkt_size = BLI_ghash_buckets_size(ghash);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_popkey(ghash, SET_UINT_IN_POINTER(*k), NULL);
+		EXPECT_EQ(*k, GET_UINT_FROM_POINTER(v));
+		/* Removal shifts entries back, the remaining ones must still be found. */
+		if (i % 1000 == 0) {
+			unsigned int *k_remain;
+			int j;
+			for (j = i, k_remain = k + 1; j--; k_remain++) {
+				EXPECT_TRUE(BLI_ghash_haskey(ghash, SET_UINT_IN_POINTER(*k_remain)));
+			}
+		}
+	}
+
+	EXPECT_EQ(0, BLI_ghash_size(ghash));
+	EXPECT_LT(BLI_ghash_buckets_size(ghash), bkt_size);
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, CopyOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	GHash *ghash_copy;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	init_keys(keys, 30);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	ghash_copy = BLI_ghash_copy(ghash, NULL, NULL);
+
+	EXPECT_EQ(TESTCASE_SIZE, BLI_ghash_size(ghash_copy));
+	EXPECT_EQ(BLI_ghash_buckets_size(ghash), BLI_ghash_buckets_size(ghash_copy));
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash_copy, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(*k, GET_UINT_FROM_POINTER(v));
+	}
+
+	BLI_ghash_free(ghash, NULL, NULL);
+	BLI_ghash_free(ghash_copy, NULL, NULL);
+}
+
+TEST(ghash, PopOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK | GHASH_FLAG_OPEN_ADDRESSING);
+	init_keys(keys, 30);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	GHashIterState pop_state = {0};
+
+	for (i = TESTCASE_SIZE / 2; i--; ) {
+		void *k, *v;
+		bool success = BLI_ghash_pop(ghash, &pop_state, &k, &v);
+		EXPECT_EQ(k, v);
+		EXPECT_EQ(success, true);
+
+		if (i % 2) {
+			BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(i * 4), SET_UINT_IN_POINTER(i * 4));
+		}
+	}
+
+	EXPECT_EQ((TESTCASE_SIZE - TESTCASE_SIZE / 2 + TESTCASE_SIZE / 4), BLI_ghash_size(ghash));
+
+	{
+		void *k, *v;
+		while (BLI_ghash_pop(ghash, &pop_state, &k, &v)) {
+			EXPECT_EQ(k, v);
+		}
+	}
+	EXPECT_EQ(0, BLI_ghash_size(ghash));
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+/* Check ensure_p, iteration, and conversion between both storages. */
+TEST(ghash, EnsureIterConvertOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	GHashIterator gh_iter;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	unsigned int sum = 0, sum_iter = 0;
+	int i;
+
+	init_keys(keys, 40);
+
+	/* Half the keys in chained storage, the other half after conversion. */
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void **val_p;
+
+		if (i == TESTCASE_SIZE / 2) {
+			BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+		}
+
+		EXPECT_FALSE(BLI_ghash_ensure_p(ghash, SET_UINT_IN_POINTER(*k), &val_p));
+		*val_p = SET_UINT_IN_POINTER(*k);
+		EXPECT_TRUE(BLI_ghash_ensure_p(ghash, SET_UINT_IN_POINTER(*k), &val_p));
+		EXPECT_EQ(*k, GET_UINT_FROM_POINTER(*val_p));
+
+		sum += *k;
+	}
+
+	EXPECT_EQ(TESTCASE_SIZE, BLI_ghash_size(ghash));
+
+	i = 0;
+	GHASH_ITER (gh_iter, ghash) {
+		EXPECT_EQ(BLI_ghashIterator_getKey(&gh_iter), BLI_ghashIterator_getValue(&gh_iter));
+		sum_iter += GET_UINT_FROM_POINTER(BLI_ghashIterator_getKey(&gh_iter));
+		i++;
+	}
+	EXPECT_EQ(TESTCASE_SIZE, i);
+	EXPECT_EQ(sum, sum_iter);
+
+	BLI_ghash_flag_clear(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(*k, GET_UINT_FROM_POINTER(v));
+	}
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
@@ -0,0 +1,112 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_heap.h"
+#include "BLI_rand.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests! */
+//#define HEAP_RUN_BIG
+
+/* Number of neighbors re-prioritized for every popped item,
+ * roughly the edges around a collapsed edge when decimating. */
+#define HEAP_NEIGHBORS_NUM 8
+
+/**
+ * Simulate decimation: pop the cheapest item, then change the cost of some items "near" it
+ * (indices close by, as in a mesh with spatially coherent indices).
+ */
+static void heap_churn_test(const int items_total, const bool use_update)
+{
+	Heap *heap = BLI_heap_new_ex((unsigned int)items_total);
+	HeapNode **nodes = (HeapNode **)MEM_mallocN(sizeof(HeapNode *) * items_total, __func__);
+	RNG *rng = BLI_rng_new(0);
+	int items_left = items_total;
+
+	for (int i = 0; i < items_total; i++) {
+		nodes[i] = BLI_heap_insert(heap, BLI_rng_get_float(rng), SET_INT_IN_POINTER(i));
+	}
+
+	/* Collapse half the items. */
+	while (items_left > items_total / 2) {
+		const int index = GET_INT_FROM_POINTER(BLI_heap_popmin(heap));
+		nodes[index] = NULL;
+		items_left--;
+
+		for (int j = 0; j < HEAP_NEIGHBORS_NUM; j++) {
+			const int index_other = (index + (BLI_rng_get_int(rng) % 64) + 1) % items_total;
+			if (nodes[index_other] == NULL) {
+				continue;
+			}
+
+			const float value = BLI_heap_node_value(nodes[index_other]) + BLI_rng_get_float(rng);
+			if (use_update) {
+				BLI_heap_node_value_update(heap, nodes[index_other], value);
+			}
+			else {
+				BLI_heap_remove(heap, nodes[index_other]);
+				nodes[index_other] = BLI_heap_insert(heap, value, SET_INT_IN_POINTER(index_other));
+			}
+		}
+	}
+
+	EXPECT_EQ(items_left, (int)BLI_heap_size(heap));
+
+	BLI_heap_free(heap, NULL);
+	BLI_rng_free(rng);
+	MEM_freeN(nodes);
+}
+
+static void heap_tests(const int items_total)
+{
+	printf("\n========== STARTING %s (%d items) ==========\n", __func__, items_total);
+
+	{
+		TIMEIT_START(heap_insert_popmin);
+
+		Heap *heap = BLI_heap_new();
+		RNG *rng = BLI_rng_new(0);
+		for (int i = 0; i < items_total; i++) {
+			BLI_heap_insert(heap, BLI_rng_get_float(rng), NULL);
+		}
+		while (!BLI_heap_is_empty(heap)) {
+			BLI_heap_popmin(heap);
+		}
+		BLI_heap_free(heap, NULL);
+		BLI_rng_free(rng);
+
+		TIMEIT_END(heap_insert_popmin);
+	}
+
+	{
+		TIMEIT_START(heap_churn_remove_insert);
+		heap_churn_test(items_total, false);
+		TIMEIT_END(heap_churn_remove_insert);
+	}
+
+	{
+		TIMEIT_START(heap_churn_value_update);
+		heap_churn_test(items_total, true);
+		TIMEIT_END(heap_churn_value_update);
+	}
+
+	printf("========== ENDED %s ==========\n\n", __func__);
+}
+
+TEST(heap, Churn1000000)
+{
+	heap_tests(1000000);
+}
+
+#ifdef HEAP_RUN_BIG
+TEST(heap, Churn15000000)
+{
+	/* Edges of a 5M triangle mesh. */
+	heap_tests(15000000);
+}
+#endif
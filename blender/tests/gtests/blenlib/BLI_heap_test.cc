@@ -0,0 +1,196 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_heap.h"
+#include "BLI_rand.h"
+}
+
+#define SIZE 1024
+
+static void range_fl(float *array_tar, const int size)
+{
+	float *array_pt = array_tar + (size - 1);
+	int i = size;
+	while (i--) {
+		*(array_pt--) = (float)i;
+	}
+}
+
+/* Pop everything, checking values are in order and return how many were popped. */
+static int heap_pop_all_check_order(Heap *heap)
+{
+	float value_prev = -FLT_MAX;
+	int num = 0;
+	while (!BLI_heap_is_empty(heap)) {
+		const float value = BLI_heap_node_value(BLI_heap_top(heap));
+		EXPECT_LE(value_prev, value);
+		value_prev = value;
+		BLI_heap_popmin(heap);
+		num++;
+	}
+	return num;
+}
+
+TEST(heap, Empty)
+{
+	Heap *heap = BLI_heap_new();
+
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+	EXPECT_EQ(BLI_heap_size(heap), 0);
+
+	BLI_heap_free(heap, NULL);
+}
+
+TEST(heap, One)
+{
+	Heap *heap = BLI_heap_new();
+	const char *in = "test";
+
+	BLI_heap_insert(heap, 0.0f, (void *)in);
+	EXPECT_FALSE(BLI_heap_is_empty(heap));
+	EXPECT_EQ(BLI_heap_size(heap), 1);
+	EXPECT_EQ(in, BLI_heap_popmin(heap));
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+
+	BLI_heap_free(heap, NULL);
+}
+
+TEST(heap, Range)
+{
+	const int items_total = SIZE;
+	Heap *heap = BLI_heap_new();
+
+	for (int in = 0; in < items_total; in++) {
+		BLI_heap_insert(heap, (float)in, SET_INT_IN_POINTER(in));
+	}
+	for (int out_test = 0; out_test < items_total; out_test++) {
+		EXPECT_EQ(out_test, GET_INT_FROM_POINTER(BLI_heap_popmin(heap)));
+	}
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+
+	BLI_heap_free(heap, NULL);
+}
+
+TEST(heap, RangeReverse)
+{
+	const int items_total = SIZE;
+	Heap *heap = BLI_heap_new();
+
+	for (int in = 0; in < items_total; in++) {
+		BLI_heap_insert(heap, (float)-in, SET_INT_IN_POINTER(-in));
+	}
+	for (int out_test = items_total - 1; out_test >= 0; out_test--) {
+		EXPECT_EQ(-out_test, GET_INT_FROM_POINTER(BLI_heap_popmin(heap)));
+	}
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+
+	BLI_heap_free(heap, NULL);
+}
+
+TEST(heap, RangeRemove)
+{
+	const int items_total = SIZE;
+	Heap *heap = BLI_heap_new();
+	HeapNode **nodes = (HeapNode **)MEM_mallocN(sizeof(HeapNode *) * items_total, __func__);
+
+	for (int in = 0; in < items_total; in++) {
+		nodes[in] = BLI_heap_insert(heap, (float)in, SET_INT_IN_POINTER(in));
+	}
+	for (int i = 0; i < items_total; i += 2) {
+		BLI_heap_remove(heap, nodes[i]);
+		nodes[i] = NULL;
+	}
+	for (int out_test = 1; out_test < items_total; out_test += 2) {
+		EXPECT_EQ(out_test, GET_INT_FROM_POINTER(BLI_heap_popmin(heap)));
+	}
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+
+	BLI_heap_free(heap, NULL);
+	MEM_freeN(nodes);
+}
+
+TEST(heap, Duplicates)
+{
+	const int items_total = SIZE;
+	Heap *heap = BLI_heap_new();
+
+	for (int in = 0; in < items_total; in++) {
+		BLI_heap_insert(heap, 1.0f, 0);
+	}
+	for (int out_test = 0; out_test < items_total; out_test++) {
+		EXPECT_EQ(0, GET_INT_FROM_POINTER(BLI_heap_popmin(heap)));
+	}
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+
+	BLI_heap_free(heap, NULL);
+}
+
+static void random_heap_helper(const int items_total, const int random_seed)
+{
+	Heap *heap = BLI_heap_new();
+	float *values = (float *)MEM_mallocN(sizeof(float) * items_total, __func__);
+
+	range_fl(values, items_total);
+	BLI_array_randomize(values, sizeof(float), items_total, random_seed);
+	for (int i = 0; i < items_total; i++) {
+		BLI_heap_insert(heap, values[i], SET_INT_IN_POINTER((int)values[i]));
+	}
+	for (int out_test = 0; out_test < items_total; out_test++) {
+		EXPECT_EQ(out_test, GET_INT_FROM_POINTER(BLI_heap_popmin(heap)));
+	}
+	EXPECT_TRUE(BLI_heap_is_empty(heap));
+
+	BLI_heap_free(heap, NULL);
+	MEM_freeN(values);
+}
+
+TEST(heap, Rand1)       { random_heap_helper(1, 1234); }
+TEST(heap, Rand2)       { random_heap_helper(2, 1234); }
+TEST(heap, Rand100)     { random_heap_helper(100, 4321); }
+
+/* Mix of value updates and removals on random nodes, like mesh decimation does. */
+TEST(heap, ReInsertUpdate)
+{
+	const int items_total = SIZE;
+	Heap *heap = BLI_heap_new();
+	HeapNode **nodes = (HeapNode **)MEM_mallocN(sizeof(HeapNode *) * items_total, __func__);
+	RNG *rng = BLI_rng_new(0);
+
+	for (int in = 0; in < items_total; in++) {
+		nodes[in] = BLI_heap_insert(heap, BLI_rng_get_float(rng), SET_INT_IN_POINTER(in));
+	}
+
+	for (int i = 0; i < items_total * 8; i++) {
+		const int index = BLI_rng_get_int(rng) % items_total;
+		const float value = BLI_rng_get_float(rng) * 2.0f - 0.5f;
+		if (nodes[index]) {
+			if (i % 5 == 0) {
+				BLI_heap_remove(heap, nodes[index]);
+				nodes[index] = NULL;
+			}
+			else {
+				BLI_heap_node_value_update(heap, nodes[index], value);
+				EXPECT_EQ(value, BLI_heap_node_value(nodes[index]));
+				EXPECT_EQ(index, GET_INT_FROM_POINTER(BLI_heap_node_ptr(nodes[index])));
+			}
+		}
+		else {
+			nodes[index] = BLI_heap_insert(heap, value, SET_INT_IN_POINTER(index));
+		}
+	}
+
+	int items_left = 0;
+	for (int i = 0; i < items_total; i++) {
+		items_left += (nodes[i] != NULL);
+	}
+	EXPECT_EQ(items_left, (int)BLI_heap_size(heap));
+	EXPECT_EQ(items_left, heap_pop_all_check_order(heap));
+
+	BLI_heap_free(heap, NULL);
+	BLI_rng_free(rng);
+	MEM_freeN(nodes);
+}
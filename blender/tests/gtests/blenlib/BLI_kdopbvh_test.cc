@@ -0,0 +1,125 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+}
+
+#define TRIS_NUM 2000
+#define RAYS_GRID 64
+
+typedef struct RayCastTestData {
+	float (*tris)[3][3];
+} RayCastTestData;
+
+static void raycast_tri_cb(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+	RayCastTestData *data = (RayCastTestData *)userdata;
+	const float (*tri)[3] = data->tris[index];
+	float dist;
+
+	if (isect_ray_tri_watertight_v3(ray->origin, ray->isect_precalc, tri[0], tri[1], tri[2], &dist, NULL) &&
+	    (dist < hit->dist))
+	{
+		hit->index = index;
+		hit->dist = dist;
+		madd_v3_v3v3fl(hit->co, ray->origin, ray->direction, dist);
+	}
+}
+
+static void raycast_batch_tests(const float radius, const bool use_callback)
+{
+	const int rays_num = RAYS_GRID * RAYS_GRID + 3;  /* last packet isn't full */
+	RayCastTestData data;
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(*co) * rays_num, __func__);
+	float (*dir)[3] = (float (*)[3])MEM_mallocN(sizeof(*dir) * rays_num, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * rays_num, __func__);
+	RNG *rng = BLI_rng_new(0);
+	int hits_num = 0;
+
+	BLI_threadapi_init();
+
+	/* Small random triangles in a unit cube. */
+	data.tris = (float (*)[3][3])MEM_mallocN(sizeof(*data.tris) * TRIS_NUM, __func__);
+	BVHTree *tree = BLI_bvhtree_new(TRIS_NUM, 0.0f, 4, 6);
+	for (int i = 0; i < TRIS_NUM; i++) {
+		float center[3];
+		center[0] = BLI_rng_get_float(rng);
+		center[1] = BLI_rng_get_float(rng);
+		center[2] = BLI_rng_get_float(rng);
+		for (int j = 0; j < 3; j++) {
+			BLI_rng_get_float_unit_v3(rng, data.tris[i][j]);
+			madd_v3_v3v3fl(data.tris[i][j], center, data.tris[i][j], 0.05f);
+		}
+		BLI_bvhtree_insert(tree, i, &data.tris[i][0][0], 3);
+	}
+	BLI_bvhtree_balance(tree);
+
+	/* Coherent rays from a grid, with a slight random spread. */
+	for (int i = 0; i < rays_num; i++) {
+		co[i][0] = (float)(i % RAYS_GRID) / RAYS_GRID;
+		co[i][1] = (float)((i / RAYS_GRID) % RAYS_GRID) / RAYS_GRID;
+		co[i][2] = -1.0f;
+		dir[i][0] = (BLI_rng_get_float(rng) - 0.5f) * 0.2f;
+		dir[i][1] = (BLI_rng_get_float(rng) - 0.5f) * 0.2f;
+		dir[i][2] = 1.0f;
+		normalize_v3(dir[i]);
+
+		hits[i].index = -1;
+		hits[i].dist = BVH_RAYCAST_DIST_MAX;
+	}
+
+	BLI_bvhtree_ray_cast_batch(
+	        tree, co, dir, rays_num, radius, hits,
+	        use_callback ? raycast_tri_cb : NULL, &data, BVH_RAYCAST_DEFAULT);
+
+	for (int i = 0; i < rays_num; i++) {
+		BVHTreeRayHit hit;
+		hit.index = -1;
+		hit.dist = BVH_RAYCAST_DIST_MAX;
+
+		BLI_bvhtree_ray_cast(
+		        tree, co[i], dir[i], radius, &hit,
+		        use_callback ? raycast_tri_cb : NULL, &data);
+
+		EXPECT_EQ(hit.index, hits[i].index);
+		if (hit.index != -1) {
+			EXPECT_EQ(hit.dist, hits[i].dist);
+			EXPECT_V3_NEAR(hit.co, hits[i].co, 0.0f);
+			hits_num++;
+		}
+	}
+
+	/* Make sure the test doesn't pass by missing everything. */
+	EXPECT_GT(hits_num, rays_num / 4);
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(data.tris);
+	MEM_freeN(co);
+	MEM_freeN(dir);
+	MEM_freeN(hits);
+
+	BLI_threadapi_exit();
+}
+
+TEST(kdopbvh, RayCastBatch)
+{
+	raycast_batch_tests(0.0f, true);
+}
+
+TEST(kdopbvh, RayCastBatchNoCallback)
+{
+	raycast_batch_tests(0.0f, false);
+}
+
+TEST(kdopbvh, RayCastBatchRadius)
+{
+	raycast_batch_tests(0.01f, true);
+}
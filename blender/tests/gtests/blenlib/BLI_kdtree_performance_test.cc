@@ -0,0 +1,143 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdtree.h"
+#include "BLI_kdtree_bucket.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests! */
+//#define KDTREE_RUN_BIG
+
+/* Same points and queries for both trees, results are compared. */
+static void kdtree_tests(const int totpoint, const int totquery, const int n)
+{
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * totpoint, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * totquery, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * totquery, __func__);
+	KDTreeNearest *nearest_bucket = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * totquery, __func__);
+	KDTreeNearest *nearest_n = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest_n) * n, __func__);
+
+	printf("\n========== STARTING kdtree (%d points, %d queries) ==========\n", totpoint, totquery);
+
+	BLI_threadapi_init();
+
+	{
+		RNG *rng = BLI_rng_new(0);
+		for (int i = 0; i < totpoint; i++) {
+			BLI_rng_get_float_unit_v3(rng, points[i]);
+		}
+		for (int i = 0; i < totquery; i++) {
+			BLI_rng_get_float_unit_v3(rng, queries[i]);
+		}
+		BLI_rng_free(rng);
+	}
+
+	printf("KDTree:\n");
+
+	KDTree *tree = BLI_kdtree_new(totpoint);
+	{
+		TIMEIT_START(kdtree_balance);
+
+		for (int i = 0; i < totpoint; i++) {
+			BLI_kdtree_insert(tree, i, points[i]);
+		}
+		BLI_kdtree_balance(tree);
+
+		TIMEIT_END(kdtree_balance);
+	}
+	{
+		TIMEIT_START(kdtree_find_nearest);
+
+		for (int i = 0; i < totquery; i++) {
+			BLI_kdtree_find_nearest(tree, queries[i], &nearest[i]);
+		}
+
+		TIMEIT_END(kdtree_find_nearest);
+	}
+	{
+		TIMEIT_START(kdtree_find_nearest_n);
+
+		for (int i = 0; i < totquery; i++) {
+			BLI_kdtree_find_nearest_n(tree, queries[i], nearest_n, n);
+		}
+
+		TIMEIT_END(kdtree_find_nearest_n);
+	}
+
+	printf("KDTreeBucket:\n");
+
+	KDTreeBucket *tree_bucket = BLI_kdtree_bucket_new(totpoint);
+	{
+		TIMEIT_START(kdtree_bucket_balance);
+
+		for (int i = 0; i < totpoint; i++) {
+			BLI_kdtree_bucket_insert(tree_bucket, i, points[i]);
+		}
+		BLI_kdtree_bucket_balance(tree_bucket);
+
+		TIMEIT_END(kdtree_bucket_balance);
+	}
+	{
+		TIMEIT_START(kdtree_bucket_find_nearest);
+
+		for (int i = 0; i < totquery; i++) {
+			BLI_kdtree_bucket_find_nearest(tree_bucket, queries[i], &nearest_bucket[i]);
+		}
+
+		TIMEIT_END(kdtree_bucket_find_nearest);
+	}
+	for (int i = 0; i < totquery; i++) {
+		EXPECT_EQ(nearest[i].dist, nearest_bucket[i].dist);
+	}
+	{
+		TIMEIT_START(kdtree_bucket_find_nearest_n);
+
+		for (int i = 0; i < totquery; i++) {
+			BLI_kdtree_bucket_find_nearest_n(tree_bucket, queries[i], nearest_n, n);
+		}
+
+		TIMEIT_END(kdtree_bucket_find_nearest_n);
+	}
+	{
+		TIMEIT_START(kdtree_bucket_find_nearest_batch);
+
+		BLI_kdtree_bucket_find_nearest_batch(tree_bucket, queries, totquery, nearest_bucket);
+
+		TIMEIT_END(kdtree_bucket_find_nearest_batch);
+	}
+	for (int i = 0; i < totquery; i++) {
+		EXPECT_EQ(nearest[i].dist, nearest_bucket[i].dist);
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_kdtree_bucket_free(tree_bucket);
+
+	BLI_threadapi_exit();
+
+	MEM_freeN(points);
+	MEM_freeN(queries);
+	MEM_freeN(nearest);
+	MEM_freeN(nearest_bucket);
+	MEM_freeN(nearest_n);
+
+	printf("========== ENDED kdtree ==========\n\n");
+}
+
+TEST(kdtree, Points100000)
+{
+	kdtree_tests(100000, 100000, 10);
+}
+
+#ifdef KDTREE_RUN_BIG
+TEST(kdtree, Points10000000)
+{
+	kdtree_tests(10000000, 1000000, 10);
+}
+#endif
@@ -0,0 +1,229 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_kdtree.h"
+#include "BLI_kdtree_bucket.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+}
+
+/* More than the bucket tree builds in a single thread. */
+#define TESTCASE_SIZE 20000
+#define TESTCASE_QUERIES 1000
+
+static void init_points(float (*points)[3], const int totpoint, const int seed)
+{
+	RNG *rng = BLI_rng_new(seed);
+
+	for (int i = 0; i < totpoint; i++) {
+		points[i][0] = BLI_rng_get_float(rng);
+		points[i][1] = BLI_rng_get_float(rng);
+		points[i][2] = BLI_rng_get_float(rng);
+	}
+
+	BLI_rng_free(rng);
+}
+
+static KDTreeBucket *kdtree_bucket_from_points(const float (*points)[3], const int totpoint)
+{
+	KDTreeBucket *tree = BLI_kdtree_bucket_new(totpoint);
+
+	for (int i = 0; i < totpoint; i++) {
+		BLI_kdtree_bucket_insert(tree, i, points[i]);
+	}
+	BLI_kdtree_bucket_balance(tree);
+
+	return tree;
+}
+
+static float find_nearest_brute_force(const float (*points)[3], const int totpoint, const float co[3])
+{
+	float min_dist_sq = FLT_MAX;
+
+	for (int i = 0; i < totpoint; i++) {
+		min_dist_sq = min_ff(min_dist_sq, len_squared_v3v3(points[i], co));
+	}
+
+	return sqrtf(min_dist_sq);
+}
+
+TEST(kdtree_bucket, FindNearest)
+{
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * TESTCASE_SIZE, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * TESTCASE_QUERIES, __func__);
+
+	BLI_threadapi_init();
+
+	init_points(points, TESTCASE_SIZE, 0);
+	init_points(queries, TESTCASE_QUERIES, 1);
+
+	KDTreeBucket *tree = kdtree_bucket_from_points(points, TESTCASE_SIZE);
+
+	for (int i = 0; i < TESTCASE_QUERIES; i++) {
+		KDTreeNearest nearest;
+		const int index = BLI_kdtree_bucket_find_nearest(tree, queries[i], &nearest);
+
+		ASSERT_NE(-1, index);
+		EXPECT_EQ(index, nearest.index);
+		EXPECT_V3_NEAR(points[index], nearest.co, 0.0f);
+		EXPECT_FLOAT_EQ(find_nearest_brute_force(points, TESTCASE_SIZE, queries[i]), nearest.dist);
+	}
+
+	/* Every point finds itself. */
+	for (int i = 0; i < TESTCASE_SIZE; i += 7) {
+		KDTreeNearest nearest;
+		BLI_kdtree_bucket_find_nearest(tree, points[i], &nearest);
+		EXPECT_EQ(0.0f, nearest.dist);
+	}
+
+	BLI_kdtree_bucket_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(queries);
+
+	BLI_threadapi_exit();
+}
+
+TEST(kdtree_bucket, FindNearestN)
+{
+	const unsigned int n = 20;
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * TESTCASE_SIZE, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * TESTCASE_QUERIES, __func__);
+	KDTreeNearest nearest[20], nearest_ref[20];
+
+	BLI_threadapi_init();
+
+	init_points(points, TESTCASE_SIZE, 2);
+	init_points(queries, TESTCASE_QUERIES, 3);
+
+	KDTreeBucket *tree = kdtree_bucket_from_points(points, TESTCASE_SIZE);
+	KDTree *tree_ref = BLI_kdtree_new(TESTCASE_SIZE);
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_kdtree_insert(tree_ref, i, points[i]);
+	}
+	BLI_kdtree_balance(tree_ref);
+
+	for (int i = 0; i < TESTCASE_QUERIES; i++) {
+		const int found = BLI_kdtree_bucket_find_nearest_n(tree, queries[i], nearest, n);
+		const int found_ref = BLI_kdtree_find_nearest_n(tree_ref, queries[i], nearest_ref, n);
+
+		ASSERT_EQ(found_ref, found);
+		for (int j = 0; j < found; j++) {
+			EXPECT_FLOAT_EQ(nearest_ref[j].dist, nearest[j].dist);
+			EXPECT_FLOAT_EQ(len_v3v3(points[nearest[j].index], queries[i]), nearest[j].dist);
+		}
+	}
+
+	/* Asking for more than the tree holds. */
+	{
+		KDTreeBucket *tree_small = kdtree_bucket_from_points(points, 5);
+		EXPECT_EQ(5, BLI_kdtree_bucket_find_nearest_n(tree_small, queries[0], nearest, n));
+		BLI_kdtree_bucket_free(tree_small);
+	}
+
+	BLI_kdtree_free(tree_ref);
+	BLI_kdtree_bucket_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(queries);
+
+	BLI_threadapi_exit();
+}
+
+static bool range_search_count_cb(void *user_data, int UNUSED(index), const float UNUSED(co[3]), float UNUSED(dist_sq))
+{
+	(*(int *)user_data)++;
+	return true;
+}
+
+TEST(kdtree_bucket, RangeSearch)
+{
+	const float range = 0.05f;
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * TESTCASE_SIZE, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * TESTCASE_QUERIES, __func__);
+
+	BLI_threadapi_init();
+
+	init_points(points, TESTCASE_SIZE, 4);
+	init_points(queries, TESTCASE_QUERIES, 5);
+
+	KDTreeBucket *tree = kdtree_bucket_from_points(points, TESTCASE_SIZE);
+
+	for (int i = 0; i < TESTCASE_QUERIES; i++) {
+		int found = 0, found_ref = 0;
+
+		BLI_kdtree_bucket_range_search_cb(tree, queries[i], range, range_search_count_cb, &found);
+
+		for (int j = 0; j < TESTCASE_SIZE; j++) {
+			if (len_squared_v3v3(points[j], queries[i]) <= range * range) {
+				found_ref++;
+			}
+		}
+
+		EXPECT_EQ(found_ref, found);
+	}
+
+	BLI_kdtree_bucket_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(queries);
+
+	BLI_threadapi_exit();
+}
+
+TEST(kdtree_bucket, FindNearestBatch)
+{
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * TESTCASE_SIZE, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * TESTCASE_SIZE, __func__);
+
+	BLI_threadapi_init();
+
+	init_points(points, TESTCASE_SIZE, 6);
+
+	KDTreeBucket *tree = kdtree_bucket_from_points(points, TESTCASE_SIZE / 2);
+
+	BLI_kdtree_bucket_find_nearest_batch(tree, points, TESTCASE_SIZE, nearest);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		KDTreeNearest nearest_single;
+		BLI_kdtree_bucket_find_nearest(tree, points[i], &nearest_single);
+
+		EXPECT_EQ(nearest_single.index, nearest[i].index);
+		EXPECT_EQ(nearest_single.dist, nearest[i].dist);
+		if (i < TESTCASE_SIZE / 2) {
+			EXPECT_EQ(i, nearest[i].index);
+		}
+	}
+
+	BLI_kdtree_bucket_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(nearest);
+
+	BLI_threadapi_exit();
+}
+
+TEST(kdtree_bucket, Degenerate)
+{
+	const float co[3] = {1.0f, 2.0f, 3.0f};
+	KDTreeNearest nearest[4];
+
+	/* Empty tree. */
+	KDTreeBucket *tree = BLI_kdtree_bucket_new(0);
+	BLI_kdtree_bucket_balance(tree);
+	EXPECT_EQ(-1, BLI_kdtree_bucket_find_nearest(tree, co, NULL));
+	EXPECT_EQ(0, BLI_kdtree_bucket_find_nearest_n(tree, co, nearest, 4));
+	BLI_kdtree_bucket_free(tree);
+
+	/* All points at the same location. */
+	tree = BLI_kdtree_bucket_new(1000);
+	for (int i = 0; i < 1000; i++) {
+		BLI_kdtree_bucket_insert(tree, i, co);
+	}
+	BLI_kdtree_bucket_balance(tree);
+	EXPECT_NE(-1, BLI_kdtree_bucket_find_nearest(tree, co, NULL));
+	EXPECT_EQ(4, BLI_kdtree_bucket_find_nearest_n(tree, co, nearest, 4));
+	EXPECT_EQ(0.0f, nearest[3].dist);
+	BLI_kdtree_bucket_free(tree);
+}
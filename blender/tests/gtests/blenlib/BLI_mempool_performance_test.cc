@@ -0,0 +1,153 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Run the longest tests! */
+//#define MEMPOOL_RUN_BIG
+
+/* Elements allocated by each iteration, freed again in the next pass. */
+#define MEMPOOL_ELEMS_PER_ITER 8
+
+typedef struct ContentionData {
+	BLI_mempool *pool;
+	SpinLock lock;
+	void **elems;
+} ContentionData;
+
+/* Sharing a pool between threads without thread caches. */
+static void locked_alloc_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int UNUSED(thread_id))
+{
+	ContentionData *data = (ContentionData *)userdata;
+	void **elems = &data->elems[iter * MEMPOOL_ELEMS_PER_ITER];
+	for (int i = 0; i < MEMPOOL_ELEMS_PER_ITER; i++) {
+		BLI_spin_lock(&data->lock);
+		elems[i] = BLI_mempool_alloc(data->pool);
+		BLI_spin_unlock(&data->lock);
+	}
+}
+
+static void locked_free_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int UNUSED(thread_id))
+{
+	ContentionData *data = (ContentionData *)userdata;
+	void **elems = &data->elems[iter * MEMPOOL_ELEMS_PER_ITER];
+	for (int i = 0; i < MEMPOOL_ELEMS_PER_ITER; i++) {
+		BLI_spin_lock(&data->lock);
+		BLI_mempool_free(data->pool, elems[i]);
+		BLI_spin_unlock(&data->lock);
+	}
+}
+
+static void thread_alloc_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	ContentionData *data = (ContentionData *)userdata;
+	void **elems = &data->elems[iter * MEMPOOL_ELEMS_PER_ITER];
+	for (int i = 0; i < MEMPOOL_ELEMS_PER_ITER; i++) {
+		elems[i] = BLI_mempool_alloc_thread(data->pool, thread_id);
+	}
+}
+
+static void thread_free_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	ContentionData *data = (ContentionData *)userdata;
+	void **elems = &data->elems[iter * MEMPOOL_ELEMS_PER_ITER];
+	for (int i = 0; i < MEMPOOL_ELEMS_PER_ITER; i++) {
+		BLI_mempool_free_thread(data->pool, elems[i], thread_id);
+	}
+}
+
+/* Allocate from all threads, then free from all threads in a different (dynamic) order,
+ * so most elements are freed by another thread than the one allocating them. */
+static void mempool_contention_tests(const int num_iters, const int num_runs)
+{
+	ContentionData data;
+	const unsigned int flag = BLI_MEMPOOL_ALLOW_ITER;
+
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_get();
+	const int num_threads = BLI_task_scheduler_num_threads(scheduler);
+
+	printf("\n========== STARTING %s (%d threads, %d elements) ==========\n",
+	       __func__, num_threads, num_iters * MEMPOOL_ELEMS_PER_ITER);
+
+	data.elems = (void **)MEM_mallocN(sizeof(*data.elems) * num_iters * MEMPOOL_ELEMS_PER_ITER, __func__);
+	BLI_spin_init(&data.lock);
+
+	{
+		data.pool = BLI_mempool_create(32, 0, 512, flag);
+
+		TIMEIT_START(mempool_single);
+
+		for (int run = 0; run < num_runs; run++) {
+			BLI_task_parallel_range_ex(0, num_iters, &data, NULL, 0, locked_alloc_cb, false, false);
+			BLI_task_parallel_range_ex(0, num_iters, &data, NULL, 0, locked_free_cb, false, false);
+		}
+
+		TIMEIT_END(mempool_single);
+
+		EXPECT_EQ(0, BLI_mempool_count(data.pool));
+		BLI_mempool_destroy(data.pool);
+	}
+
+	{
+		data.pool = BLI_mempool_create(32, 0, 512, flag);
+
+		TIMEIT_START(mempool_locked);
+
+		for (int run = 0; run < num_runs; run++) {
+			BLI_task_parallel_range_ex(0, num_iters, &data, NULL, 0, locked_alloc_cb, true, false);
+			BLI_task_parallel_range_ex(0, num_iters, &data, NULL, 0, locked_free_cb, true, true);
+		}
+
+		TIMEIT_END(mempool_locked);
+
+		EXPECT_EQ(0, BLI_mempool_count(data.pool));
+		BLI_mempool_destroy(data.pool);
+	}
+
+	{
+		data.pool = BLI_mempool_create(32, 0, 512, flag);
+
+		TIMEIT_START(mempool_thread);
+
+		for (int run = 0; run < num_runs; run++) {
+			BLI_mempool_thread_begin(data.pool, (unsigned int)num_threads);
+			BLI_task_parallel_range_ex(0, num_iters, &data, NULL, 0, thread_alloc_cb, true, false);
+			BLI_task_parallel_range_ex(0, num_iters, &data, NULL, 0, thread_free_cb, true, true);
+			BLI_mempool_thread_end(data.pool);
+		}
+
+		TIMEIT_END(mempool_thread);
+
+		EXPECT_EQ(0, BLI_mempool_count(data.pool));
+		BLI_mempool_destroy(data.pool);
+	}
+
+	BLI_spin_end(&data.lock);
+	MEM_freeN(data.elems);
+
+	BLI_threadapi_exit();
+
+	printf("========== ENDED %s ==========\n\n", __func__);
+}
+
+TEST(mempool, Contention1000000)
+{
+	mempool_contention_tests(125000, 10);
+}
+
+#ifdef MEMPOOL_RUN_BIG
+TEST(mempool, Contention10000000)
+{
+	mempool_contention_tests(1250000, 10);
+}
+#endif
@@ -0,0 +1,133 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+}
+
+/* More than fits into a few chunks, so threads need to add their own. */
+#define TESTCASE_SIZE 100000
+
+typedef struct TestElem {
+	int value;
+	int pad[3];
+} TestElem;
+
+typedef struct ThreadTestData {
+	BLI_mempool *pool;
+	TestElem **elems;
+} ThreadTestData;
+
+static void thread_alloc_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	ThreadTestData *data = (ThreadTestData *)userdata;
+	TestElem *elem = (TestElem *)BLI_mempool_alloc_thread(data->pool, thread_id);
+	elem->value = iter;
+	data->elems[iter] = elem;
+}
+
+/* Free every odd element, from whichever thread runs the iteration. */
+static void thread_free_odd_cb(void *userdata, void *UNUSED(userdata_chunk), const int iter, const int thread_id)
+{
+	ThreadTestData *data = (ThreadTestData *)userdata;
+	if (iter & 1) {
+		BLI_mempool_free_thread(data->pool, data->elems[iter], thread_id);
+		data->elems[iter] = NULL;
+	}
+}
+
+/* Check the pool holds exactly the non-NULL elements of 'elems'. */
+static void mempool_check_elems(BLI_mempool *pool, TestElem **elems, const int elems_num, const int used_num)
+{
+	BLI_mempool_iter iter;
+	TestElem *elem;
+	char *found = (char *)MEM_callocN(sizeof(*found) * elems_num, __func__);
+	int found_num = 0;
+
+	EXPECT_EQ(used_num, BLI_mempool_count(pool));
+
+	BLI_mempool_iternew(pool, &iter);
+	while ((elem = (TestElem *)BLI_mempool_iterstep(&iter))) {
+		ASSERT_GE(elem->value, 0);
+		ASSERT_LT(elem->value, elems_num);
+		EXPECT_EQ(elems[elem->value], elem);
+		EXPECT_EQ(0, found[elem->value]);
+		found[elem->value] = 1;
+		found_num++;
+	}
+	EXPECT_EQ(used_num, found_num);
+
+	/* Array matches iteration order, findelem is slow so only check some. */
+	TestElem *array = (TestElem *)BLI_mempool_as_arrayN(pool, __func__);
+	for (int i = 0; i < found_num; i += 997) {
+		EXPECT_EQ(elems[array[i].value], BLI_mempool_findelem(pool, (unsigned int)i));
+	}
+	MEM_freeN(array);
+
+	MEM_freeN(found);
+}
+
+TEST(mempool, AllocFree)
+{
+	BLI_mempool *pool = BLI_mempool_create(sizeof(TestElem), 0, 512, BLI_MEMPOOL_ALLOW_ITER);
+	TestElem **elems = (TestElem **)MEM_mallocN(sizeof(*elems) * TESTCASE_SIZE, __func__);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		elems[i] = (TestElem *)BLI_mempool_alloc(pool);
+		elems[i]->value = i;
+	}
+	mempool_check_elems(pool, elems, TESTCASE_SIZE, TESTCASE_SIZE);
+
+	for (int i = 1; i < TESTCASE_SIZE; i += 2) {
+		BLI_mempool_free(pool, elems[i]);
+		elems[i] = NULL;
+	}
+	mempool_check_elems(pool, elems, TESTCASE_SIZE, TESTCASE_SIZE / 2);
+
+	BLI_mempool_destroy(pool);
+	MEM_freeN(elems);
+}
+
+TEST(mempool, ThreadAllocFree)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_get();
+	const unsigned int num_threads = (unsigned int)BLI_task_scheduler_num_threads(scheduler);
+	ThreadTestData data;
+
+	data.pool = BLI_mempool_create(sizeof(TestElem), 1000, 512, BLI_MEMPOOL_ALLOW_ITER);
+	data.elems = (TestElem **)MEM_mallocN(sizeof(*data.elems) * TESTCASE_SIZE, __func__);
+
+	BLI_mempool_thread_begin(data.pool, num_threads);
+	BLI_task_parallel_range_ex(0, TESTCASE_SIZE, &data, NULL, 0, thread_alloc_cb, true, false);
+	BLI_mempool_thread_end(data.pool);
+	mempool_check_elems(data.pool, data.elems, TESTCASE_SIZE, TESTCASE_SIZE);
+
+	BLI_mempool_thread_begin(data.pool, num_threads);
+	BLI_task_parallel_range_ex(0, TESTCASE_SIZE, &data, NULL, 0, thread_free_odd_cb, true, true);
+	BLI_mempool_thread_end(data.pool);
+	mempool_check_elems(data.pool, data.elems, TESTCASE_SIZE, TESTCASE_SIZE / 2);
+
+	/* Regular use after threads are done, reusing freed elements. */
+	for (int i = 1; i < TESTCASE_SIZE; i += 2) {
+		data.elems[i] = (TestElem *)BLI_mempool_alloc(data.pool);
+		data.elems[i]->value = i;
+	}
+	mempool_check_elems(data.pool, data.elems, TESTCASE_SIZE, TESTCASE_SIZE);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_mempool_free(data.pool, data.elems[i]);
+	}
+	EXPECT_EQ(0, BLI_mempool_count(data.pool));
+
+	BLI_mempool_destroy(data.pool);
+	MEM_freeN(data.elems);
+
+	BLI_threadapi_exit();
+}
@@ -0,0 +1,188 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+
+#include "atomic_ops.h"
+}
+
+/* Run the longest tests! */
+//#define TASK_RUN_BIG
+
+/* Amount of busy work done by each task, small enough for the scheduler
+ * overhead to dominate. */
+#define TASK_WORK_SIZE 100
+
+static size_t task_counter = 0;
+
+static void task_do_work(void)
+{
+	volatile int sum = 0;
+	for (int i = 0; i < TASK_WORK_SIZE; i++) {
+		sum += i;
+	}
+	atomic_add_z(&task_counter, 1);
+}
+
+static void task_leaf_func(TaskPool *__restrict UNUSED(pool), void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	task_do_work();
+}
+
+/* Spawns 4 children per level, pushed from the worker thread running it. */
+static void task_tree_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	const int depth = GET_INT_FROM_POINTER(taskdata);
+
+	task_do_work();
+
+	if (depth > 0) {
+		for (int i = 0; i < 4; i++) {
+			BLI_task_pool_push_from_thread(pool, task_tree_func, SET_INT_IN_POINTER(depth - 1),
+			                               false, TASK_PRIORITY_LOW, threadid);
+		}
+	}
+}
+
+static size_t task_tree_size(const int depth)
+{
+	size_t size = 0, level = 1;
+	for (int i = 0; i <= depth; i++, level *= 4) {
+		size += level;
+	}
+	return size;
+}
+
+static void task_range_func(void *UNUSED(userdata), const int UNUSED(iter))
+{
+	task_do_work();
+}
+
+/* Throughput: many tiny tasks pushed from the main thread. */
+static void task_flat_tests(const int num_threads, const int num_tasks, const int num_runs)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_create(num_threads);
+
+	printf("\n========== STARTING %s (%d threads, %d tasks) ==========\n",
+	       __func__, BLI_task_scheduler_num_threads(scheduler), num_tasks);
+
+	{
+		TIMEIT_START(task_flat);
+
+		for (int run = 0; run < num_runs; run++) {
+			TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+
+			task_counter = 0;
+			for (int i = 0; i < num_tasks; i++) {
+				BLI_task_pool_push(pool, task_leaf_func, NULL, false, TASK_PRIORITY_LOW);
+			}
+			BLI_task_pool_work_and_wait(pool);
+
+			EXPECT_EQ((size_t)num_tasks, task_counter);
+
+			BLI_task_pool_free(pool);
+		}
+
+		TIMEIT_END(task_flat);
+	}
+
+	BLI_task_scheduler_free(scheduler);
+
+	printf("========== ENDED %s ==========\n\n", __func__);
+}
+
+/* Recursive tasks, pushed from inside of other tasks. */
+static void task_tree_tests(const int num_threads, const int depth, const int num_runs)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_create(num_threads);
+
+	printf("\n========== STARTING %s (%d threads, %d tasks) ==========\n",
+	       __func__, BLI_task_scheduler_num_threads(scheduler), (int)task_tree_size(depth));
+
+	{
+		TIMEIT_START(task_tree);
+
+		for (int run = 0; run < num_runs; run++) {
+			TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+
+			task_counter = 0;
+			BLI_task_pool_push(pool, task_tree_func, SET_INT_IN_POINTER(depth), false, TASK_PRIORITY_LOW);
+			BLI_task_pool_work_and_wait(pool);
+
+			EXPECT_EQ(task_tree_size(depth), task_counter);
+
+			BLI_task_pool_free(pool);
+		}
+
+		TIMEIT_END(task_tree);
+	}
+
+	BLI_task_scheduler_free(scheduler);
+
+	printf("========== ENDED %s ==========\n\n", __func__);
+}
+
+/* Scaling over the number of threads, doubling up to the number of cores. */
+static void task_scaling_tests(const int num_tasks, const int depth, const int num_runs)
+{
+	const int max_threads = BLI_system_thread_count();
+
+	BLI_threadapi_init();
+
+	for (int num_threads = 1; ; num_threads *= 2) {
+		num_threads = MIN2(num_threads, max_threads);
+
+		task_flat_tests(num_threads, num_tasks, num_runs);
+		task_tree_tests(num_threads, depth, num_runs);
+
+		if (num_threads == max_threads) {
+			break;
+		}
+	}
+
+	BLI_threadapi_exit();
+}
+
+TEST(task, Scaling10000)
+{
+	task_scaling_tests(10000, 6, 10);
+}
+
+#ifdef TASK_RUN_BIG
+TEST(task, Scaling1000000)
+{
+	task_scaling_tests(1000000, 10, 5);
+}
+#endif
+
+TEST(task, ParallelRange)
+{
+	const int num_iters = 1000000;
+
+	BLI_threadapi_init();
+
+	printf("\n========== STARTING ParallelRange (%d iterations) ==========\n", num_iters);
+
+	{
+		TIMEIT_START(parallel_range);
+
+		for (int run = 0; run < 10; run++) {
+			task_counter = 0;
+			BLI_task_parallel_range(0, num_iters, NULL, task_range_func, true);
+
+			EXPECT_EQ((size_t)num_iters, task_counter);
+		}
+
+		TIMEIT_END(parallel_range);
+	}
+
+	printf("========== ENDED ParallelRange ==========\n\n");
+
+	BLI_threadapi_exit();
+}
@@ -0,0 +1,193 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "PIL_time.h"
+
+#include "atomic_ops.h"
+}
+
+#define NUM_THREADS 4
+#define NUM_TASKS 10000
+
+/* Number of times each task ran, indexed by task. */
+static size_t task_runs[NUM_TASKS];
+
+static void task_runs_clear(void)
+{
+	memset(task_runs, 0, sizeof(task_runs));
+}
+
+static void task_runs_expect_once(const int num_tasks)
+{
+	for (int i = 0; i < num_tasks; i++) {
+		EXPECT_EQ(1, task_runs[i]) << "task " << i;
+	}
+}
+
+static void task_count_func(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	atomic_add_z(&task_runs[GET_INT_FROM_POINTER(taskdata)], 1);
+}
+
+/* Task i pushes tasks 4i+1 to 4i+4 from the thread running it, so most tasks
+ * go through the queues of the worker threads and get stolen. */
+static void task_tree_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	const int index = GET_INT_FROM_POINTER(taskdata);
+
+	atomic_add_z(&task_runs[index], 1);
+
+	for (int i = index * 4 + 1; i <= index * 4 + 4 && i < NUM_TASKS; i++) {
+		BLI_task_pool_push_from_thread(pool, task_tree_func, SET_INT_IN_POINTER(i),
+		                               false, TASK_PRIORITY_LOW, threadid);
+	}
+}
+
+TEST(task, PushRunsOnce)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+
+	task_runs_clear();
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		BLI_task_pool_push(pool, task_count_func, SET_INT_IN_POINTER(i), false,
+		                   (i % 2) ? TASK_PRIORITY_HIGH : TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	task_runs_expect_once(NUM_TASKS);
+	EXPECT_EQ(NUM_TASKS, BLI_task_pool_tasks_done(pool));
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+
+	BLI_threadapi_exit();
+}
+
+TEST(task, PushFromThreadRunsOnce)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+
+	for (int run = 0; run < 10; run++) {
+		TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+
+		task_runs_clear();
+
+		BLI_task_pool_push(pool, task_tree_func, SET_INT_IN_POINTER(0), false, TASK_PRIORITY_LOW);
+		BLI_task_pool_work_and_wait(pool);
+
+		task_runs_expect_once(NUM_TASKS);
+		EXPECT_EQ(NUM_TASKS, BLI_task_pool_tasks_done(pool));
+
+		BLI_task_pool_free(pool);
+	}
+
+	BLI_task_scheduler_free(scheduler);
+
+	BLI_threadapi_exit();
+}
+
+TEST(task, WorkAndWaitOwnPool)
+{
+	BLI_threadapi_init();
+
+	/* Without worker threads, tasks only run from work_and_wait. */
+	TaskScheduler *scheduler = BLI_task_scheduler_create(1);
+	TaskPool *pool_a = BLI_task_pool_create(scheduler, NULL);
+	TaskPool *pool_b = BLI_task_pool_create(scheduler, NULL);
+
+	task_runs_clear();
+
+	for (int i = 0; i < 100; i++) {
+		BLI_task_pool_push(pool_a, task_count_func, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_LOW);
+		BLI_task_pool_push(pool_b, task_count_func, SET_INT_IN_POINTER(100 + i), false, TASK_PRIORITY_LOW);
+	}
+
+	BLI_task_pool_work_and_wait(pool_a);
+
+	task_runs_expect_once(100);
+	for (int i = 100; i < 200; i++) {
+		EXPECT_EQ(0, task_runs[i]);
+	}
+
+	BLI_task_pool_work_and_wait(pool_b);
+
+	task_runs_expect_once(200);
+
+	BLI_task_pool_free(pool_a);
+	BLI_task_pool_free(pool_b);
+	BLI_task_scheduler_free(scheduler);
+
+	BLI_threadapi_exit();
+}
+
+/* Runs until the pool is canceled. */
+static void task_wait_cancel_func(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	while (!BLI_task_pool_canceled(pool)) {
+		PIL_sleep_ms(1);
+	}
+
+	atomic_add_z(&task_runs[GET_INT_FROM_POINTER(taskdata)], 1);
+}
+
+TEST(task, Cancel)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+	TaskPool *pool_other = BLI_task_pool_create(scheduler, NULL);
+
+	task_runs_clear();
+
+	for (int i = 0; i < 100; i++) {
+		BLI_task_pool_push(pool, task_wait_cancel_func, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_LOW);
+		BLI_task_pool_push(pool_other, task_count_func, SET_INT_IN_POINTER(100 + i), false, TASK_PRIORITY_LOW);
+	}
+
+	/* Waits for the running tasks and drops the queued ones, at most one
+	 * task per worker thread can have started. */
+	BLI_task_pool_cancel(pool);
+
+	size_t num_runs = 0;
+	for (int i = 0; i < 100; i++) {
+		EXPECT_GE(1, task_runs[i]);
+		num_runs += task_runs[i];
+	}
+	EXPECT_GE(NUM_THREADS - 1, num_runs);
+	EXPECT_FALSE(BLI_task_pool_canceled(pool));
+
+	/* Tasks of other pools are not affected. */
+	BLI_task_pool_work_and_wait(pool_other);
+	for (int i = 100; i < 200; i++) {
+		EXPECT_EQ(1, task_runs[i]);
+	}
+
+	/* The pool can be used again after canceling. */
+	task_runs_clear();
+
+	for (int i = 0; i < 100; i++) {
+		BLI_task_pool_push(pool, task_count_func, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	task_runs_expect_once(100);
+
+	BLI_task_pool_free(pool);
+	BLI_task_pool_free(pool_other);
+	BLI_task_scheduler_free(scheduler);
+
+	BLI_threadapi_exit();
+}
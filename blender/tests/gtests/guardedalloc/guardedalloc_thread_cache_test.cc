@@ -0,0 +1,101 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <pthread.h>
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define THREADS_NUM 4
+#define ALLOC_NUM 10000
+
+namespace {
+
+/* Mix of sizes around the largest cached size class. */
+size_t test_alloc_len(const int i)
+{
+	return (size_t)((i * 37) % 700) + 1;
+}
+
+void DoAllocChecks(void)
+{
+	void **ptrs = (void **)MEM_mallocN(sizeof(void *) * ALLOC_NUM, "test ptrs");
+
+	for (int i = 0; i < ALLOC_NUM; i++) {
+		const size_t len = test_alloc_len(i);
+		ptrs[i] = MEM_mallocN(len, "test alloc");
+		EXPECT_LE(len, MEM_allocN_len(ptrs[i]));
+		memset(ptrs[i], i & 0xff, len);
+	}
+
+	/* Free half and allocate again, reusing cached blocks. */
+	for (int i = 0; i < ALLOC_NUM; i += 2) {
+		MEM_freeN(ptrs[i]);
+		const size_t len = test_alloc_len(i + 1);
+		char *ptr = (char *)MEM_callocN(len, "test calloc");
+		for (size_t j = 0; j < len; j++) {
+			EXPECT_EQ(0, ptr[j]);
+		}
+		ptrs[i] = ptr;
+	}
+
+	for (int i = 0; i < ALLOC_NUM; i++) {
+		void *ptr_dup = MEM_dupallocN(ptrs[i]);
+		EXPECT_EQ(0, memcmp(ptr_dup, ptrs[i], MEM_allocN_len(ptrs[i])));
+		MEM_freeN(ptrs[i]);
+		ptrs[i] = MEM_reallocN(ptr_dup, test_alloc_len(i * 3));
+	}
+
+	for (int i = 0; i < ALLOC_NUM; i++) {
+		MEM_freeN(ptrs[i]);
+	}
+	MEM_freeN(ptrs);
+}
+
+void *alloc_thread_func(void *UNUSED(data))
+{
+	DoAllocChecks();
+	return NULL;
+}
+
+void DoThreadedAllocChecks(void)
+{
+	const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+	const size_t memory_in_use = MEM_get_memory_in_use();
+	pthread_t threads[THREADS_NUM];
+
+	for (int i = 0; i < THREADS_NUM; i++) {
+		pthread_create(&threads[i], NULL, alloc_thread_func, NULL);
+	}
+	DoAllocChecks();
+	for (int i = 0; i < THREADS_NUM; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	EXPECT_EQ(blocks_in_use, MEM_get_memory_blocks_in_use());
+	EXPECT_EQ(memory_in_use, MEM_get_memory_in_use());
+}
+
+}  // namespace
+
+TEST(guardedalloc, LockfreeAlloc)
+{
+	DoThreadedAllocChecks();
+}
+
+TEST(guardedalloc, LockfreeThreadCache)
+{
+	MEM_use_thread_cache();
+	DoThreadedAllocChecks();
+}
+
+TEST(guardedalloc, LockfreeThreadCacheProfiling)
+{
+	MEM_use_thread_cache();
+	MEM_use_profiling();
+	DoThreadedAllocChecks();
+}
@@ -0,0 +1,124 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Time reading a large synthetic blend file, from disk and from memfile undo,
+# both of which resolve every pointer through the old/new address maps.
+
+"""
+./blender.bin --background -noaudio --factory-startup --python tests/python/bl_blendfile_load_performance.py -- \
+    --objects=20000 --runs=3 --blend=/tmp/bl_blendfile_load_performance.blend
+"""
+
+import bpy
+
+import os
+import sys
+import time
+
+
+def args_parse():
+    import argparse
+
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--objects", type=int, default=20000,
+                        help="Number of objects to create, each with its own mesh, modifiers and vertex groups")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="Number of times each load is timed")
+    parser.add_argument("--blend", default="",
+                        help="Path of the blend file to write (a temporary file by default)")
+    return parser.parse_args(argv)
+
+
+def scene_create(objects_num):
+    """
+    Fill the scene with many small ID's, so the file has many blocks to read and link.
+    """
+    scene = bpy.context.scene
+    material = bpy.data.materials.new("Material")
+
+    verts = [(0.0, 0.0, 0.0), (1.0, 0.0, 0.0), (1.0, 1.0, 0.0), (0.0, 1.0, 0.0)]
+    faces = [(0, 1, 2, 3)]
+
+    for i in range(objects_num):
+        name = "Object.%06d" % i
+        me = bpy.data.meshes.new(name)
+        me.from_pydata(verts, (), faces)
+        me.materials.append(material)
+        me.uv_textures.new()
+
+        ob = bpy.data.objects.new(name, me)
+        ob.location = (i % 100, i // 100, 0.0)
+        ob.vertex_groups.new("Group")
+        ob.vertex_groups.new("Group.001")
+        ob.modifiers.new("Subsurf", 'SUBSURF')
+        ob.modifiers.new("Displace", 'DISPLACE')
+        scene.objects.link(ob)
+
+
+def context_override():
+    window = bpy.context.window_manager.windows[0]
+    return {"window": window, "screen": window.screen}
+
+
+def time_run(label, runs, fn):
+    times = []
+    for _ in range(runs):
+        t = time.time()
+        fn()
+        times.append(time.time() - t)
+    print("%-24s min %.4f  max %.4f  (%d runs)" % (label, min(times), max(times), runs))
+
+
+def main():
+    args = args_parse()
+
+    filepath = args.blend
+    if not filepath:
+        import tempfile
+        filepath = os.path.join(tempfile.gettempdir(), "bl_blendfile_load_performance.blend")
+
+    t = time.time()
+    scene_create(args.objects)
+    bpy.ops.wm.save_as_mainfile(filepath=filepath, check_existing=False)
+    print("Created %d objects, %d bytes in %.4f" % (args.objects, os.path.getsize(filepath), time.time() - t))
+
+    # Reading from disk.
+    time_run("read file", args.runs,
+             lambda: bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False))
+
+    # Reading from memory, each undo/redo step reads the whole memfile.
+    bpy.ops.ed.undo_push(context_override(), message="Initial")
+    bpy.context.scene.frame_current += 1
+    bpy.ops.ed.undo_push(context_override(), message="Frame")
+
+    def undo_redo():
+        bpy.ops.ed.undo(context_override())
+        bpy.ops.ed.redo(context_override())
+
+    time_run("read memfile (x2)", args.runs, undo_redo)
+
+    if not args.blend:
+        os.remove(filepath)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# Apache License, Version 2.0
+
+# Render a scene on two Cycles servers running on this machine, through the
+# multi device of the standalone application, and compare the result with a
+# render on the local CPU.
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def read_ppm(filepath):
+    with open(filepath, "rb") as f:
+        data = f.read()
+    magic, size, maxval, pixels = data.split(b"\n", 3)
+    if magic != b"P6" or maxval != b"255":
+        raise Exception("Unsupported image format: " + filepath)
+    width, height = map(int, size.split())
+    return width, height, pixels
+
+
+def render(output, device):
+    command = (
+        CYCLES,
+        "--background",
+        "--quiet",
+        "--device", device,
+        "--samples", str(SAMPLES),
+        "--output", output,
+        os.path.basename(SCENE),
+        )
+    try:
+        subprocess.check_output(command, cwd=os.path.dirname(SCENE), timeout=600)
+        return True
+    except (subprocess.CalledProcessError, subprocess.TimeoutExpired) as e:
+        print(e.output.decode("utf-8", "replace"))
+        return False
+
+
+def compare(reference, result):
+    ref_width, ref_height, ref_pixels = read_ppm(reference)
+    width, height, pixels = read_ppm(result)
+
+    if (width, height) != (ref_width, ref_height):
+        print("Image size %dx%d does not match %dx%d" % (width, height, ref_width, ref_height))
+        return False
+
+    # Servers render the same samples as the local device, only allow
+    # rounding differences.
+    num_different = sum(1 for a, b in zip(ref_pixels, pixels) if abs(a - b) > 1)
+    if num_different:
+        print("%d of %d pixel components differ" % (num_different, len(pixels)))
+        return False
+
+    return True
+
+
+def run_test(tmpdir):
+    servers = []
+    logs = []
+
+    try:
+        for port in PORTS:
+            log = open(os.path.join(tmpdir, "server_%d.log" % port), "w+")
+            server = subprocess.Popen((SERVER, "--port", str(port), "--threads", "1"),
+                                      stdout=log, stderr=subprocess.STDOUT)
+            servers.append(server)
+            logs.append(log)
+
+        # Give servers time to listen for discovery requests.
+        time.sleep(1.0)
+
+        for server in servers:
+            if server.poll() is not None:
+                print("Server failed to start")
+                return False
+
+        reference = os.path.join(tmpdir, "cpu.ppm")
+        result = os.path.join(tmpdir, "network.ppm")
+
+        if not render(reference, "cpu"):
+            print("Rendering on the CPU failed")
+            return False
+        if not render(result, "multi"):
+            print("Rendering on the servers failed")
+            return False
+    finally:
+        for server in servers:
+            server.terminate()
+            server.wait()
+
+    ok = True
+
+    for port, log in zip(PORTS, logs):
+        log.seek(0)
+        output = log.read()
+        log.close()
+
+        if "Connected to remote client" not in output:
+            print("Server on port %d was not used:" % port)
+            print(output)
+            ok = False
+
+    return compare(reference, result) and ok
+
+
+def create_argparse():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-cycles", nargs=1)
+    parser.add_argument("-server", nargs=1)
+    parser.add_argument("-scene", nargs=1)
+    parser.add_argument("-samples", nargs=1, type=int, default=[128])
+    parser.add_argument("-port", nargs=1, type=int, default=[5130])
+    return parser
+
+
+def main():
+    parser = create_argparse()
+    args = parser.parse_args()
+
+    global CYCLES, SERVER, SCENE, SAMPLES, PORTS
+    CYCLES = args.cycles[0]
+    SERVER = args.server[0]
+    SCENE = os.path.abspath(args.scene[0])
+    SAMPLES = args.samples[0]
+    PORTS = (args.port[0], args.port[0] + 1)
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        ok = run_test(tmpdir)
+
+    print("OK" if ok else "FAILED")
+    sys.exit(not ok)
+
+
+if __name__ == "__main__":
+    main()